@@ -1,8 +1,13 @@
+#include <zlib.h>
 #include "BasicBlock.h"
+#include "JitBlockCache.h"
+#include "CodeArena.h"
 #include "MemStream.h"
 #include "offsetof_def.h"
 #include "MipsJitter.h"
+#include "MipsInterpreter.h"
 #include "Jitter_CodeGenFactory.h"
+#include <memory>
 
 #if defined(AOT_BUILD_CACHE) || defined(AOT_USE_CACHE)
 #define AOT_ENABLED
@@ -10,7 +15,6 @@
 
 #ifdef AOT_ENABLED
 
-#include <zlib.h>
 #include "StdStream.h"
 #include "StdStreamUtils.h"
 
@@ -60,6 +64,13 @@ CBasicBlock::CBasicBlock(CMIPS& context, uint32 begin, uint32 end)
 	}
 }
 
+CBasicBlock::~CBasicBlock()
+{
+#ifndef AOT_USE_CACHE
+	ReleaseFunctionCode();
+#endif
+}
+
 #ifdef AOT_BUILD_CACHE
 
 Framework::CStdStream* CBasicBlock::m_aotBlockOutputStream(nullptr);
@@ -73,38 +84,69 @@ void CBasicBlock::SetAotBlockOutputStream(Framework::CStdStream* outputStream)
 
 #endif
 
-void CBasicBlock::Compile()
+void CBasicBlock::Compile(CJitBlockCache* blockCache, CCodeArena* codeArena)
 {
 #ifndef AOT_USE_CACHE
 
-	Framework::CMemStream stream;
+	if(IsEmpty())
 	{
-		static
-#ifdef AOT_BUILD_CACHE
-		    __declspec(thread)
+		blockCache = nullptr;
+	}
+#ifdef DEBUGGER_INCLUDED
+	//Breakpoint checks are part of the generated code
+	if(HasBreakpoint())
+	{
+		blockCache = nullptr;
+	}
 #endif
-		        CMipsJitter* jitter = nullptr;
-		if(jitter == nullptr)
+
+	AOT_BLOCK_KEY blockKey = {};
+	if(blockCache)
+	{
+		blockKey = GetBlockKey();
+		if(CompileFromCache(*blockCache, blockKey, codeArena))
+		{
+			return;
+		}
+	}
+
+	Framework::CMemStream stream;
+	CJitBlockCache::SymbolReferenceArray symbolReferences;
+	{
+		//Blocks can be compiled on worker threads, each of them needs its own jitter
+		//The jitter owns its code generator and is released when the thread exits
+		static thread_local std::unique_ptr<CMipsJitter> threadJitter;
+		if(!threadJitter)
 		{
 			Jitter::CCodeGen* codeGen = Jitter::CreateCodeGen();
-			jitter = new CMipsJitter(codeGen);
+			threadJitter = std::make_unique<CMipsJitter>(codeGen);
 
 			for(unsigned int i = 0; i < 4; i++)
 			{
-				jitter->SetVariableAsConstant(
+				threadJitter->SetVariableAsConstant(
 				    offsetof(CMIPS, m_State.nGPR[CMIPS::R0].nV[i]),
 				    0);
 			}
 		}
+		auto jitter = threadJitter.get();
 
-		jitter->GetCodeGen()->SetExternalSymbolReferencedHandler([&](auto symbol, auto offset, auto refType) { this->HandleExternalFunctionReference(symbol, offset, refType); });
+		jitter->GetCodeGen()->SetExternalSymbolReferencedHandler(
+		    [&](auto symbol, auto offset, auto refType) {
+			    this->HandleExternalFunctionReference(symbol, offset, refType);
+			    symbolReferences.push_back(CJitBlockCache::SYMBOL_REFERENCE{symbol, offset, refType});
+		    });
 		jitter->SetStream(&stream);
 		jitter->Begin();
 		CompileRange(jitter);
 		jitter->End();
 	}
 
-	m_function = CMemoryFunction(stream.GetBuffer(), stream.GetSize());
+	SetFunctionCode(stream.GetBuffer(), stream.GetSize(), codeArena);
+
+	if(blockCache)
+	{
+		blockCache->RegisterBlock(blockKey, stream.GetBuffer(), stream.GetSize(), symbolReferences);
+	}
 
 #ifdef VTUNE_ENABLED
 	if(iJIT_IsProfilingActive() == iJIT_SAMPLING_ON)
@@ -114,8 +156,8 @@ void CBasicBlock::Compile()
 		jmethod.class_file_name = "";
 		jmethod.source_file_name = __FILE__;
 
-		jmethod.method_load_address = m_function.GetCode();
-		jmethod.method_size = m_function.GetSize();
+		jmethod.method_load_address = GetFunctionCode();
+		jmethod.method_size = stream.GetSize();
 		jmethod.line_number_size = 0;
 
 		auto functionName = string_format("BasicBlock_0x%08X_0x%08X", m_begin, m_end);
@@ -190,6 +232,72 @@ void CBasicBlock::Compile()
 #endif
 }
 
+#ifndef AOT_USE_CACHE
+
+bool CBasicBlock::CompileFromCache(CJitBlockCache& blockCache, const AOT_BLOCK_KEY& blockKey, CCodeArena* codeArena)
+{
+	return blockCache.FindBlock(blockKey,
+	                            [&](const void* code, size_t codeSize, const CJitBlockCache::SymbolReferenceArray& symbolReferences) {
+		                            for(const auto& symbolReference : symbolReferences)
+		                            {
+			                            HandleExternalFunctionReference(symbolReference.symbol, symbolReference.offset, symbolReference.refType);
+		                            }
+		                            SetFunctionCode(code, codeSize, codeArena);
+	                            });
+}
+
+void CBasicBlock::SetFunctionCode(const void* code, size_t size, CCodeArena* codeArena)
+{
+	ReleaseFunctionCode();
+	if(codeArena)
+	{
+		m_arenaCode = codeArena->Allocate(code, size);
+		if(m_arenaCode)
+		{
+			m_codeArena = codeArena;
+			m_arenaCodeSize = size;
+			return;
+		}
+	}
+	m_function = CMemoryFunction(code, size);
+}
+
+void CBasicBlock::ReleaseFunctionCode()
+{
+	if(m_arenaCode)
+	{
+		m_codeArena->Free(m_arenaCode, m_arenaCodeSize);
+		m_codeArena = nullptr;
+		m_arenaCode = nullptr;
+		m_arenaCodeSize = 0;
+	}
+	m_function = CMemoryFunction();
+}
+
+void* CBasicBlock::GetFunctionCode()
+{
+	return m_arenaCode ? m_arenaCode : m_function.GetCode();
+}
+
+void CBasicBlock::PatchFunctionCode(uint32 offset, uintptr_t value)
+{
+	auto code = reinterpret_cast<uint8*>(GetFunctionCode()) + offset;
+	if(m_arenaCode)
+	{
+		m_codeArena->BeginModify(code, sizeof(uintptr_t));
+		*reinterpret_cast<uintptr_t*>(code) = value;
+		m_codeArena->EndModify(code, sizeof(uintptr_t));
+	}
+	else
+	{
+		m_function.BeginModify();
+		*reinterpret_cast<uintptr_t*>(code) = value;
+		m_function.EndModify();
+	}
+}
+
+#endif
+
 void CBasicBlock::CompileRange(CMipsJitter* jitter)
 {
 	if(IsEmpty())
@@ -262,6 +370,24 @@ void CBasicBlock::CompileEpilog(CMipsJitter* jitter)
 		jitter->PushCst(MIPS_INVALID_PC);
 		jitter->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
 
+		if(m_idleLoop)
+		{
+			//The only branch of an idle loop goes back to its beginning, nothing will change
+			//until an interrupt happens. Let the VM skip ahead unless something else is pending.
+			jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+			jitter->PushCst(~MIPS_EXECUTION_STATUS_QUOTADONE);
+			jitter->And();
+			jitter->PushCst(MIPS_EXCEPTION_NONE);
+			jitter->BeginIf(Jitter::CONDITION_EQ);
+			{
+				jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+				jitter->PushCst(MIPS_EXCEPTION_IDLE);
+				jitter->Or();
+				jitter->PullRel(offsetof(CMIPS, m_State.nHasException));
+			}
+			jitter->EndIf();
+		}
+
 #ifndef AOT_BUILD_CACHE
 		jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
 		jitter->PushCst(0);
@@ -274,7 +400,16 @@ void CBasicBlock::CompileEpilog(CMipsJitter* jitter)
 	}
 	jitter->Else();
 	{
-		jitter->PushCst(m_end + 4);
+		if(m_positionIndependent)
+		{
+			jitter->PushRel(offsetof(CMIPS, m_State.nPC));
+			jitter->PushCst(m_end + 4 - m_begin);
+			jitter->Add();
+		}
+		else
+		{
+			jitter->PushCst(m_end + 4);
+		}
 		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
 
 #ifndef AOT_BUILD_CACHE
@@ -292,7 +427,20 @@ void CBasicBlock::CompileEpilog(CMipsJitter* jitter)
 
 void CBasicBlock::Execute()
 {
-	m_function(&m_context);
+	if(m_interpreted)
+	{
+		CMipsInterpreter::ExecuteRange(m_context, m_begin, m_end);
+	}
+#ifndef AOT_USE_CACHE
+	else if(m_arenaCode)
+	{
+		reinterpret_cast<void (*)(void*)>(m_arenaCode)(&m_context);
+	}
+#endif
+	else
+	{
+		m_function(&m_context);
+	}
 
 	assert(m_context.m_State.nGPR[0].nV0 == 0);
 	assert(m_context.m_State.nGPR[0].nV1 == 0);
@@ -306,6 +454,22 @@ void CBasicBlock::Execute()
 	assert(m_context.m_State.nCOP2VI[0] == 0);
 }
 
+AOT_BLOCK_KEY CBasicBlock::GetBlockKey() const
+{
+	assert(!IsEmpty());
+	uint32 blockSize = ((m_end - m_begin) / 4) + 1;
+	std::vector<uint32> blockData(blockSize);
+	for(uint32 i = 0; i < blockSize; i++)
+	{
+		blockData[i] = m_context.m_pMemoryMap->GetWord(m_begin + (i * 4));
+	}
+	AOT_BLOCK_KEY key = {};
+	key.crc = crc32(0, reinterpret_cast<Bytef*>(blockData.data()), blockSize * 4);
+	key.begin = m_begin;
+	key.end = m_end;
+	return key;
+}
+
 uint32 CBasicBlock::GetBeginAddress() const
 {
 	return m_begin;
@@ -319,7 +483,7 @@ uint32 CBasicBlock::GetEndAddress() const
 bool CBasicBlock::IsCompiled() const
 {
 #ifndef AOT_USE_CACHE
-	return !m_function.IsEmpty();
+	return (m_arenaCode != nullptr) || !m_function.IsEmpty();
 #else
 	return (m_function != nullptr);
 #endif
@@ -331,6 +495,42 @@ bool CBasicBlock::IsEmpty() const
 	       (m_end == MIPS_INVALID_PC);
 }
 
+bool CBasicBlock::IsInterpreted() const
+{
+	return m_interpreted;
+}
+
+void CBasicBlock::SetInterpreted(bool interpreted)
+{
+	m_interpreted = interpreted;
+}
+
+bool CBasicBlock::IsIdleLoop() const
+{
+	return m_idleLoop;
+}
+
+void CBasicBlock::SetIdleLoop(bool idleLoop)
+{
+	assert(!IsCompiled());
+	m_idleLoop = idleLoop;
+}
+
+BLOCK_PROFILE* CBasicBlock::GetProfile() const
+{
+	return m_profile;
+}
+
+void CBasicBlock::SetProfile(BLOCK_PROFILE* profile)
+{
+	m_profile = profile;
+}
+
+bool CBasicBlock::IsTrace() const
+{
+	return m_trace;
+}
+
 uint32 CBasicBlock::GetLinkTargetAddress(LINK_SLOT linkSlot)
 {
 	assert(linkSlot < LINK_SLOT_MAX);
@@ -354,11 +554,8 @@ void CBasicBlock::LinkBlock(LINK_SLOT linkSlot, CBasicBlock* otherBlock)
 	assert(m_linkBlock[linkSlot] == nullptr);
 	m_linkBlock[linkSlot] = otherBlock;
 #endif
-	auto patchValue = reinterpret_cast<uintptr_t>(otherBlock->m_function.GetCode());
-	auto code = reinterpret_cast<uint8*>(m_function.GetCode());
-	m_function.BeginModify();
-	*reinterpret_cast<uintptr_t*>(code + m_linkBlockTrampolineOffset[linkSlot]) = patchValue;
-	m_function.EndModify();
+	auto patchValue = reinterpret_cast<uintptr_t>(otherBlock->GetFunctionCode());
+	PatchFunctionCode(m_linkBlockTrampolineOffset[linkSlot], patchValue);
 #endif //!AOT_ENABLED
 }
 
@@ -373,10 +570,7 @@ void CBasicBlock::UnlinkBlock(LINK_SLOT linkSlot)
 	m_linkBlock[linkSlot] = nullptr;
 #endif
 	auto patchValue = reinterpret_cast<uintptr_t>(&NextBlockTrampoline);
-	auto code = reinterpret_cast<uint8*>(m_function.GetCode());
-	m_function.BeginModify();
-	*reinterpret_cast<uintptr_t*>(code + m_linkBlockTrampolineOffset[linkSlot]) = patchValue;
-	m_function.EndModify();
+	PatchFunctionCode(m_linkBlockTrampolineOffset[linkSlot], patchValue);
 #endif //!AOT_ENABLED
 }
 
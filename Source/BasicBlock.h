@@ -35,11 +35,34 @@ struct AOT_BLOCK_KEY
 };
 static_assert(sizeof(AOT_BLOCK_KEY) == 0x0C, "AOT_BLOCK_KEY must be 12 bytes long.");
 
+//Execution statistics of blocks going through the dispatcher in hot trace mode
+struct BLOCK_PROFILE
+{
+	enum
+	{
+		MAX_SUCCESSOR_COUNT = 2,
+	};
+
+	struct SUCCESSOR
+	{
+		uint32 address = MIPS_INVALID_PC;
+		uint32 count = 0;
+	};
+
+	uint32 executionCount = 0;
+	//Settled blocks are done being profiled and can be linked
+	bool settled = false;
+	SUCCESSOR successors[MAX_SUCCESSOR_COUNT];
+};
+
 namespace Jitter
 {
 	class CJitter;
 };
 
+class CJitBlockCache;
+class CCodeArena;
+
 extern "C"
 {
 	void EmptyBlockHandler(CMIPS*);
@@ -57,16 +80,32 @@ public:
 	};
 
 	CBasicBlock(CMIPS&, uint32 = MIPS_INVALID_PC, uint32 = MIPS_INVALID_PC);
-	virtual ~CBasicBlock() = default;
+	virtual ~CBasicBlock();
 	void Execute();
-	void Compile();
+	//Code is stored in the arena if possible, otherwise in its own executable memory
+	void Compile(CJitBlockCache* = nullptr, CCodeArena* = nullptr);
 	virtual void CompileRange(CMipsJitter*);
 
+	virtual AOT_BLOCK_KEY GetBlockKey() const;
 	uint32 GetBeginAddress() const;
 	uint32 GetEndAddress() const;
 	bool IsCompiled() const;
 	bool IsEmpty() const;
 
+	//Interpreted blocks are executed by CMipsInterpreter until their compilation is done
+	bool IsInterpreted() const;
+	void SetInterpreted(bool);
+
+	//Idle loops only branch back to themselves and have no side effects, taking the branch
+	//raises MIPS_EXCEPTION_IDLE. Must be set before the block is compiled.
+	bool IsIdleLoop() const;
+	void SetIdleLoop(bool);
+
+	//Profile is owned by the executor, kept here to avoid looking it up on every dispatch
+	BLOCK_PROFILE* GetProfile() const;
+	void SetProfile(BLOCK_PROFILE*);
+	bool IsTrace() const;
+
 	uint32 GetLinkTargetAddress(LINK_SLOT);
 	void SetLinkTargetAddress(LINK_SLOT, uint32);
 	void LinkBlock(LINK_SLOT, CBasicBlock*);
@@ -80,12 +119,23 @@ protected:
 	uint32 m_begin;
 	uint32 m_end;
 	CMIPS& m_context;
+	//Position independent blocks don't embed their address in their code. Addresses are computed
+	//from nPC instead, which holds the address of the block when it is entered.
+	bool m_positionIndependent = false;
+	bool m_trace = false;
 
 	void CompileProlog(CMipsJitter*);
 	void CompileEpilog(CMipsJitter*);
 
 private:
 	void HandleExternalFunctionReference(uintptr_t, uint32, Jitter::CCodeGen::SYMBOL_REF_TYPE);
+#ifndef AOT_USE_CACHE
+	bool CompileFromCache(CJitBlockCache&, const AOT_BLOCK_KEY&, CCodeArena*);
+	void SetFunctionCode(const void*, size_t, CCodeArena*);
+	void ReleaseFunctionCode();
+	void* GetFunctionCode();
+	void PatchFunctionCode(uint32, uintptr_t);
+#endif
 
 #ifdef DEBUGGER_INCLUDED
 	bool HasBreakpoint() const;
@@ -100,11 +150,17 @@ private:
 
 #ifndef AOT_USE_CACHE
 	CMemoryFunction m_function;
+	CCodeArena* m_codeArena = nullptr;
+	void* m_arenaCode = nullptr;
+	size_t m_arenaCodeSize = 0;
 #else
 	void (*m_function)(void*);
 #endif
 	uint32 m_linkTargetAddress[LINK_SLOT_MAX];
 	uint32 m_linkBlockTrampolineOffset[LINK_SLOT_MAX];
+	bool m_interpreted = false;
+	bool m_idleLoop = false;
+	BLOCK_PROFILE* m_profile = nullptr;
 #ifdef _DEBUG
 	CBasicBlock* m_linkBlock[LINK_SLOT_MAX];
 #endif
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cassert>
+#include "BlockCompileQueue.h"
+#include "string_format.h"
+
+#define MAX_DEFAULT_WORKER_COUNT (4)
+
+CBlockCompileQueue::CBlockCompileQueue()
+    : m_profilerZone(CProfiler::GetInstance().RegisterZone("JIT"))
+{
+}
+
+CBlockCompileQueue::~CBlockCompileQueue()
+{
+	StopWorkers();
+}
+
+void CBlockCompileQueue::SetWorkerCount(unsigned int workerCount)
+{
+	assert(workerCount != 0);
+	workerCount = std::max<unsigned int>(workerCount, 1);
+	if(workerCount == m_workers.size()) return;
+	//Queued jobs are kept and will be picked up by the new workers
+	StopWorkers();
+	StartWorkers(workerCount);
+}
+
+unsigned int CBlockCompileQueue::GetWorkerCount() const
+{
+	return static_cast<unsigned int>(m_workers.size());
+}
+
+void CBlockCompileQueue::Enqueue(const void* owner, JobFunction function)
+{
+	if(m_workers.empty())
+	{
+		unsigned int hardwareThreadCount = std::thread::hardware_concurrency();
+		unsigned int workerCount = std::min<unsigned int>(hardwareThreadCount / 2, MAX_DEFAULT_WORKER_COUNT);
+		StartWorkers(std::max<unsigned int>(workerCount, 1));
+	}
+
+	{
+		std::unique_lock<std::mutex> jobLock(m_jobMutex);
+		JOB job;
+		job.owner = owner;
+		job.function = std::move(function);
+		job.enqueueTime = std::chrono::steady_clock::now();
+		m_jobs.push_back(std::move(job));
+		m_stats.queueDepth = static_cast<uint32>(m_jobs.size());
+		m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, m_stats.queueDepth);
+	}
+	m_jobAvailable.notify_one();
+}
+
+void CBlockCompileQueue::CancelJobs(const void* owner)
+{
+	std::unique_lock<std::mutex> jobLock(m_jobMutex);
+	m_jobs.erase(
+	    std::remove_if(m_jobs.begin(), m_jobs.end(), [owner](const JOB& job) { return job.owner == owner; }),
+	    m_jobs.end());
+	m_stats.queueDepth = static_cast<uint32>(m_jobs.size());
+	//Wait for jobs that are currently running on a worker
+	m_jobFinished.wait(jobLock,
+	                   [&]() {
+		                   return std::find(m_runningJobOwners.begin(), m_runningJobOwners.end(), owner) == m_runningJobOwners.end();
+	                   });
+}
+
+CBlockCompileQueue::STATS CBlockCompileQueue::GetStats() const
+{
+	std::unique_lock<std::mutex> jobLock(m_jobMutex);
+	return m_stats;
+}
+
+void CBlockCompileQueue::ResetStats()
+{
+	std::unique_lock<std::mutex> jobLock(m_jobMutex);
+	m_stats = STATS();
+	m_stats.queueDepth = static_cast<uint32>(m_jobs.size());
+}
+
+void CBlockCompileQueue::StartWorkers(unsigned int workerCount)
+{
+	assert(m_workers.empty());
+	m_terminate = false;
+	m_runningJobOwners.assign(workerCount, nullptr);
+	for(unsigned int i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back([this, i]() { WorkerThreadProc(i); });
+	}
+}
+
+void CBlockCompileQueue::StopWorkers()
+{
+	{
+		std::unique_lock<std::mutex> jobLock(m_jobMutex);
+		m_terminate = true;
+	}
+	m_jobAvailable.notify_all();
+	for(auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_runningJobOwners.clear();
+}
+
+void CBlockCompileQueue::WorkerThreadProc(unsigned int workerIndex)
+{
+	CProfiler::GetInstance().SetThreadName(string_format("JIT%d", workerIndex).c_str());
+	std::unique_lock<std::mutex> jobLock(m_jobMutex);
+	while(true)
+	{
+		m_jobAvailable.wait(jobLock, [this]() { return m_terminate || !m_jobs.empty(); });
+		if(m_terminate) break;
+
+		auto job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		m_stats.queueDepth = static_cast<uint32>(m_jobs.size());
+		m_runningJobOwners[workerIndex] = job.owner;
+
+		jobLock.unlock();
+		{
+#ifdef PROFILE
+			CProfilerZone profilerZone(m_profilerZone);
+#endif
+			job.function();
+		}
+		auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job.enqueueTime);
+		jobLock.lock();
+
+		m_runningJobOwners[workerIndex] = nullptr;
+		m_stats.compiledBlockCount++;
+		m_stats.totalLatencyNs += latency.count();
+		m_stats.maxLatencyNs = std::max<uint64>(m_stats.maxLatencyNs, latency.count());
+		m_jobFinished.notify_all();
+	}
+}
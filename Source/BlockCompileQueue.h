@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "Singleton.h"
+#include "Types.h"
+#include "Profiler.h"
+
+//Worker pool used to compile basic blocks out of the emulation threads.
+//Jobs are tagged with an owner (usually an executor) to allow cancellation.
+class CBlockCompileQueue : public CSingleton<CBlockCompileQueue>
+{
+public:
+	typedef std::function<void()> JobFunction;
+
+	struct STATS
+	{
+		uint32 queueDepth = 0;
+		uint32 maxQueueDepth = 0;
+		uint32 compiledBlockCount = 0;
+		uint64 totalLatencyNs = 0;
+		uint64 maxLatencyNs = 0;
+	};
+
+	CBlockCompileQueue();
+	virtual ~CBlockCompileQueue();
+
+	void SetWorkerCount(unsigned int);
+	unsigned int GetWorkerCount() const;
+
+	void Enqueue(const void*, JobFunction);
+	void CancelJobs(const void*);
+
+	STATS GetStats() const;
+	void ResetStats();
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	struct JOB
+	{
+		const void* owner = nullptr;
+		JobFunction function;
+		TimePoint enqueueTime;
+	};
+
+	typedef std::deque<JOB> JobQueue;
+	typedef std::vector<std::thread> WorkerArray;
+	typedef std::vector<const void*> OwnerArray;
+
+	void StartWorkers(unsigned int);
+	void StopWorkers();
+	void WorkerThreadProc(unsigned int);
+
+	JobQueue m_jobs;
+	WorkerArray m_workers;
+	OwnerArray m_runningJobOwners;
+	STATS m_stats;
+	bool m_terminate = false;
+	CProfiler::ZoneHandle m_profilerZone = 0;
+
+	mutable std::mutex m_jobMutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_jobFinished;
+};
@@ -0,0 +1,204 @@
+#include <cassert>
+#include <cstring>
+#include "CodeArena.h"
+#include "Log.h"
+
+#define LOG_NAME "CodeArena"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#define CODE_ARENA_SUPPORTED
+#elif defined(__APPLE__) || defined(__EMSCRIPTEN__)
+//Apple platforms enforce W^X on JIT pages and Emscripten doesn't run native code,
+//CMemoryFunction knows how to deal with these
+#else
+#include <sys/mman.h>
+#define CODE_ARENA_SUPPORTED
+#endif
+
+float CCodeArena::STATS::GetOccupancy() const
+{
+	if(reservedBytes == 0) return 0;
+	return static_cast<float>(static_cast<double>(liveBytes) / static_cast<double>(reservedBytes));
+}
+
+float CCodeArena::STATS::GetFragmentation() const
+{
+	if(usedBytes == 0) return 0;
+	return static_cast<float>(static_cast<double>(freeBytes) / static_cast<double>(usedBytes));
+}
+
+CCodeArena::CCodeArena(size_t chunkSize)
+    : m_chunkSize(chunkSize)
+{
+	assert((chunkSize % ALLOCATION_ALIGNMENT) == 0);
+}
+
+CCodeArena::~CCodeArena()
+{
+	assert(m_stats.allocationCount == 0);
+	ReleaseChunks(0);
+}
+
+bool CCodeArena::IsSupported()
+{
+#ifdef CODE_ARENA_SUPPORTED
+	return true;
+#else
+	return false;
+#endif
+}
+
+void* CCodeArena::Allocate(const void* code, size_t codeSize)
+{
+#ifdef CODE_ARENA_SUPPORTED
+	size_t allocationSize = GetAllocationSize(codeSize);
+	if((allocationSize == 0) || (allocationSize > m_chunkSize)) return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint8* result = nullptr;
+	auto freeListIterator = m_freeLists.find(allocationSize);
+	if((freeListIterator != std::end(m_freeLists)) && !freeListIterator->second.empty())
+	{
+		result = freeListIterator->second.back();
+		freeListIterator->second.pop_back();
+		m_stats.freeBytes -= allocationSize;
+	}
+	else
+	{
+		if(m_chunks.empty() || ((m_chunks.back().used + allocationSize) > m_chunkSize))
+		{
+			auto memory = AllocateChunkMemory(m_chunkSize);
+			if(memory == nullptr) return nullptr;
+			if(!m_chunks.empty())
+			{
+				//Keep what's left of the current chunk for smaller allocations
+				auto& lastChunk = m_chunks.back();
+				size_t remainingSize = m_chunkSize - lastChunk.used;
+				if(remainingSize != 0)
+				{
+					m_freeLists[remainingSize].push_back(lastChunk.memory + lastChunk.used);
+					lastChunk.used = m_chunkSize;
+					m_stats.usedBytes += remainingSize;
+					m_stats.freeBytes += remainingSize;
+				}
+			}
+			CHUNK chunk;
+			chunk.memory = memory;
+			m_chunks.push_back(chunk);
+			m_stats.chunkCount++;
+			m_stats.reservedBytes += m_chunkSize;
+		}
+		auto& chunk = m_chunks.back();
+		result = chunk.memory + chunk.used;
+		chunk.used += allocationSize;
+		m_stats.usedBytes += allocationSize;
+	}
+
+	memcpy(result, code, codeSize);
+	FlushCode(result, codeSize);
+
+	m_stats.allocationCount++;
+	m_stats.totalAllocationCount++;
+	m_stats.liveBytes += allocationSize;
+	return result;
+#else
+	return nullptr;
+#endif
+}
+
+void CCodeArena::Free(void* code, size_t codeSize)
+{
+	size_t allocationSize = GetAllocationSize(codeSize);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	assert(m_stats.allocationCount != 0);
+	m_freeLists[allocationSize].push_back(reinterpret_cast<uint8*>(code));
+	m_stats.allocationCount--;
+	m_stats.liveBytes -= allocationSize;
+	m_stats.freeBytes += allocationSize;
+}
+
+bool CCodeArena::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	//Code that is still referenced can't be thrown away
+	if(m_stats.allocationCount != 0)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Not resetting arena, %d allocations are still alive.\r\n", m_stats.allocationCount);
+		return false;
+	}
+	//First chunk is kept since it will most likely be needed again
+	ReleaseChunks(1);
+	m_freeLists.clear();
+	if(!m_chunks.empty())
+	{
+		m_chunks[0].used = 0;
+	}
+	m_stats.usedBytes = 0;
+	m_stats.freeBytes = 0;
+	return true;
+}
+
+void CCodeArena::BeginModify(void*, size_t)
+{
+}
+
+void CCodeArena::EndModify(void* code, size_t size)
+{
+	FlushCode(code, size);
+}
+
+CCodeArena::STATS CCodeArena::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+size_t CCodeArena::GetAllocationSize(size_t codeSize)
+{
+	return (codeSize + ALLOCATION_ALIGNMENT - 1) & ~static_cast<size_t>(ALLOCATION_ALIGNMENT - 1);
+}
+
+uint8* CCodeArena::AllocateChunkMemory(size_t size)
+{
+#if defined(_WIN32)
+	return reinterpret_cast<uint8*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#elif defined(CODE_ARENA_SUPPORTED)
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED) return nullptr;
+	return reinterpret_cast<uint8*>(memory);
+#else
+	return nullptr;
+#endif
+}
+
+void CCodeArena::FreeChunkMemory(uint8* memory, size_t size)
+{
+#if defined(_WIN32)
+	VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(CODE_ARENA_SUPPORTED)
+	munmap(memory, size);
+#endif
+}
+
+void CCodeArena::FlushCode(void* code, size_t size)
+{
+#if defined(_WIN32)
+	FlushInstructionCache(GetCurrentProcess(), code, size);
+#elif defined(__arm__) || defined(__aarch64__)
+	auto begin = reinterpret_cast<char*>(code);
+	__builtin___clear_cache(begin, begin + size);
+#endif
+}
+
+void CCodeArena::ReleaseChunks(size_t keepCount)
+{
+	while(m_chunks.size() > keepCount)
+	{
+		FreeChunkMemory(m_chunks.back().memory, m_chunkSize);
+		m_chunks.pop_back();
+		m_stats.chunkCount--;
+		m_stats.reservedBytes -= m_chunkSize;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "Types.h"
+
+//Executable memory allocator for generated code. Code is bump allocated in large
+//chunks to keep blocks close to each other, freed allocations are kept in free
+//lists (one per allocation size) and reused. Everything can be released at once
+//with Reset once no more allocations are alive.
+class CCodeArena
+{
+public:
+	enum
+	{
+		DEFAULT_CHUNK_SIZE = 0x100000,
+		ALLOCATION_ALIGNMENT = 0x40,
+	};
+
+	struct STATS
+	{
+		uint32 chunkCount = 0;
+		uint32 allocationCount = 0;
+		uint32 totalAllocationCount = 0; //Allocations made since the arena was created
+		uint64 reservedBytes = 0; //Total size of chunks
+		uint64 usedBytes = 0;     //Bytes given out by bump allocation
+		uint64 liveBytes = 0;     //Bytes of code currently in use
+		uint64 freeBytes = 0;     //Bytes waiting for reuse in free lists
+
+		//Ratio of reserved memory used by live code
+		float GetOccupancy() const;
+		//Ratio of allocated memory that is wasted in free lists
+		float GetFragmentation() const;
+	};
+
+	CCodeArena(size_t = DEFAULT_CHUNK_SIZE);
+	virtual ~CCodeArena();
+
+	static bool IsSupported();
+
+	//Copies code in the arena, returns nullptr if code can't be stored in the arena
+	void* Allocate(const void*, size_t);
+	void Free(void*, size_t);
+	//Returns false (and keeps everything) if some allocations are still alive
+	bool Reset();
+
+	void BeginModify(void*, size_t);
+	void EndModify(void*, size_t);
+
+	STATS GetStats() const;
+
+private:
+	struct CHUNK
+	{
+		uint8* memory = nullptr;
+		size_t used = 0;
+	};
+	typedef std::vector<CHUNK> ChunkArray;
+	typedef std::unordered_map<size_t, std::vector<uint8*>> FreeListMap;
+
+	static size_t GetAllocationSize(size_t);
+	static uint8* AllocateChunkMemory(size_t);
+	static void FreeChunkMemory(uint8*, size_t);
+	static void FlushCode(void*, size_t);
+
+	void ReleaseChunks(size_t);
+
+	size_t m_chunkSize = 0;
+	ChunkArray m_chunks;
+	FreeListMap m_freeLists;
+	STATS m_stats;
+	mutable std::mutex m_mutex;
+};
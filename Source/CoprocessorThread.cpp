@@ -0,0 +1,179 @@
+#include <cassert>
+#include <chrono>
+#include "CoprocessorThread.h"
+
+CCoprocessorThread::CCoprocessorThread(const SliceFunction& sliceFunction, const WorkerInitFunction& workerInitFunction)
+    : m_sliceFunction(sliceFunction)
+    , m_workerInitFunction(workerInitFunction)
+    , m_sliceRunning(false)
+    , m_eeStopped(true)
+{
+}
+
+CCoprocessorThread::~CCoprocessorThread()
+{
+	StopWorker();
+}
+
+void CCoprocessorThread::SetMode(MODE mode)
+{
+	assert(!m_sliceRunning);
+	if(m_mode == mode) return;
+	StopWorker();
+	m_mode = mode;
+}
+
+CCoprocessorThread::MODE CCoprocessorThread::GetMode() const
+{
+	return m_mode;
+}
+
+bool CCoprocessorThread::IsSliceRunning() const
+{
+	return m_sliceRunning;
+}
+
+void CCoprocessorThread::BeginSlice()
+{
+	assert(!m_sliceRunning);
+	switch(m_mode)
+	{
+	case MODE_SERIAL:
+		break;
+	case MODE_THREADED:
+	{
+		//Started lazily to let the worker initialize itself in the emulation thread's context
+		if(!m_worker.joinable())
+		{
+			StartWorker();
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_eeStopped = false;
+		m_sliceRunning = true;
+		m_slicePending = true;
+		m_sliceStarted.notify_one();
+	}
+	break;
+	case MODE_DETERMINISTIC:
+		m_sliceRunning = true;
+		break;
+	}
+}
+
+void CCoprocessorThread::EndSlice()
+{
+	if(m_mode == MODE_SERIAL)
+	{
+		m_sliceFunction();
+		return;
+	}
+	WaitForSlice();
+}
+
+void CCoprocessorThread::SyncFromEe()
+{
+	if(!m_sliceRunning) return;
+	if(IsWorkerThread()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.eeSyncCount++;
+	}
+	WaitForSlice();
+}
+
+void CCoprocessorThread::SyncFromCoprocessor()
+{
+	//Only the worker needs to wait, in other cases, the EE is not running
+	if(!IsWorkerThread()) return;
+	if(m_eeStopped) return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_stats.coprocessorSyncCount++;
+	m_eeStoppedCondition.wait(lock, [this]() { return m_eeStopped.load(); });
+}
+
+CCoprocessorThread::STATS CCoprocessorThread::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void CCoprocessorThread::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = STATS();
+}
+
+void CCoprocessorThread::StartWorker()
+{
+	assert(!m_worker.joinable());
+	m_terminate = false;
+	m_worker = std::thread([this]() { WorkerThreadProc(); });
+	m_workerId = m_worker.get_id();
+}
+
+void CCoprocessorThread::StopWorker()
+{
+	if(!m_worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminate = true;
+		m_sliceStarted.notify_one();
+	}
+	m_worker.join();
+	m_workerId = std::thread::id();
+}
+
+void CCoprocessorThread::WorkerThreadProc()
+{
+	if(m_workerInitFunction)
+	{
+		m_workerInitFunction();
+	}
+	while(1)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_sliceStarted.wait(lock, [this]() { return m_terminate || m_slicePending; });
+			if(m_terminate) break;
+			m_slicePending = false;
+		}
+
+		auto sliceStartTime = std::chrono::steady_clock::now();
+		m_sliceFunction();
+		auto sliceTime = std::chrono::steady_clock::now() - sliceStartTime;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.sliceTime += std::chrono::duration_cast<std::chrono::nanoseconds>(sliceTime).count();
+			m_sliceRunning = false;
+			m_sliceFinished.notify_one();
+		}
+	}
+}
+
+void CCoprocessorThread::WaitForSlice()
+{
+	if(!m_sliceRunning) return;
+	auto waitStartTime = std::chrono::steady_clock::now();
+	if(m_mode == MODE_DETERMINISTIC)
+	{
+		//Clear the flag first, the slice might access shared state
+		m_sliceRunning = false;
+		m_sliceFunction();
+		auto sliceTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStartTime).count();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.sliceTime += sliceTime;
+		m_stats.eeWaitTime += sliceTime;
+		return;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_eeStopped = true;
+	m_eeStoppedCondition.notify_one();
+	m_sliceFinished.wait(lock, [this]() { return !m_sliceRunning; });
+	m_stats.eeWaitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStartTime).count();
+}
+
+bool CCoprocessorThread::IsWorkerThread() const
+{
+	return std::this_thread::get_id() == m_workerId;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Types.h"
+
+//Runs slices of a processor driven by the EE (IOP, VU1) alongside EE execution. The EE and the
+//coprocessor only run concurrently as long as neither of them touches state owned by the other one:
+//- Before touching coprocessor state, the EE calls SyncFromEe, which waits for the slice to complete.
+//- Before touching EE state, the coprocessor calls SyncFromCoprocessor, which waits for the EE to be
+//  stopped in SyncFromEe (either at a shared state access or at the end of its slice).
+//Once stopped, the other processor stays stopped until the next slice begins.
+class CCoprocessorThread
+{
+public:
+	typedef std::function<void()> SliceFunction;
+	typedef std::function<void()> WorkerInitFunction;
+
+	enum MODE
+	{
+		//Slice runs after the EE slice, on the emulation thread
+		MODE_SERIAL,
+		//Slice runs on a worker thread while the EE slice runs
+		MODE_THREADED,
+		//Slice runs on the emulation thread when the EE reaches its first sync point.
+		//Produces the same ordering of shared state accesses as the threaded mode.
+		MODE_DETERMINISTIC,
+	};
+
+	struct STATS
+	{
+		uint32 eeSyncCount = 0;
+		uint32 coprocessorSyncCount = 0;
+		//Times are in nanoseconds
+		uint64 sliceTime = 0;
+		uint64 eeWaitTime = 0;
+	};
+
+	CCoprocessorThread(const SliceFunction&, const WorkerInitFunction&);
+	virtual ~CCoprocessorThread();
+
+	void SetMode(MODE);
+	MODE GetMode() const;
+
+	bool IsSliceRunning() const;
+
+	void BeginSlice();
+	void EndSlice();
+
+	void SyncFromEe();
+	void SyncFromCoprocessor();
+
+	STATS GetStats() const;
+	void ResetStats();
+
+private:
+	void StartWorker();
+	void StopWorker();
+	void WorkerThreadProc();
+	void WaitForSlice();
+	bool IsWorkerThread() const;
+
+	SliceFunction m_sliceFunction;
+	WorkerInitFunction m_workerInitFunction;
+	MODE m_mode = MODE_SERIAL;
+
+	std::thread m_worker;
+	std::thread::id m_workerId;
+	bool m_terminate = false;
+
+	//Set by the EE when it begins a slice, cleared when the coprocessor is done with it
+	std::atomic<bool> m_sliceRunning;
+	bool m_slicePending = false;
+	//Set by the EE when it stops in SyncFromEe
+	std::atomic<bool> m_eeStopped;
+
+	STATS m_stats;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_sliceStarted;
+	std::condition_variable m_sliceFinished;
+	std::condition_variable m_eeStoppedCondition;
+};
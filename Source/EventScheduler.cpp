@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cassert>
+#include "EventScheduler.h"
+
+CEventScheduler::EventId CEventScheduler::RegisterEvent(const char* name, const EventHandler& handler)
+{
+	EVENT event;
+	event.name = name;
+	event.handler = handler;
+	m_events.push_back(std::move(event));
+	return static_cast<EventId>(m_events.size() - 1);
+}
+
+void CEventScheduler::Reset()
+{
+	for(auto& event : m_events)
+	{
+		event.scheduled = false;
+		event.deadline = 0;
+		event.generation++;
+	}
+	m_heap.clear();
+	m_currentTime = 0;
+}
+
+void CEventScheduler::Schedule(EventId id, uint64 ticks)
+{
+	ScheduleAt(id, m_currentTime + ticks);
+}
+
+void CEventScheduler::Reschedule(EventId id, uint64 ticks)
+{
+	assert(id < m_events.size());
+	ScheduleAt(id, m_events[id].deadline + ticks);
+}
+
+void CEventScheduler::Cancel(EventId id)
+{
+	assert(id < m_events.size());
+	auto& event = m_events[id];
+	if(!event.scheduled) return;
+	event.scheduled = false;
+	event.generation++;
+	DiscardStaleEntries();
+}
+
+bool CEventScheduler::IsScheduled(EventId id) const
+{
+	assert(id < m_events.size());
+	return m_events[id].scheduled;
+}
+
+uint64 CEventScheduler::GetCurrentTime() const
+{
+	return m_currentTime;
+}
+
+uint64 CEventScheduler::GetTicksUntilNextEvent() const
+{
+	if(m_heap.empty())
+	{
+		return NO_EVENT;
+	}
+	uint64 deadline = m_heap.front().deadline;
+	return (deadline > m_currentTime) ? (deadline - m_currentTime) : 0;
+}
+
+void CEventScheduler::AdvanceTime(uint64 ticks)
+{
+	m_currentTime += ticks;
+}
+
+void CEventScheduler::ProcessEvents()
+{
+	while(!m_heap.empty() && (m_heap.front().deadline <= m_currentTime))
+	{
+		auto id = m_heap.front().id;
+		std::pop_heap(m_heap.begin(), m_heap.end(), &IsLaterEntry);
+		m_heap.pop_back();
+
+		auto& event = m_events[id];
+		event.scheduled = false;
+		event.generation++;
+		DiscardStaleEntries();
+
+		event.handler();
+	}
+}
+
+bool CEventScheduler::IsLaterEntry(const HEAP_ENTRY& entry1, const HEAP_ENTRY& entry2)
+{
+	return entry1.deadline > entry2.deadline;
+}
+
+void CEventScheduler::ScheduleAt(EventId id, uint64 deadline)
+{
+	assert(id < m_events.size());
+	auto& event = m_events[id];
+	event.generation++;
+	event.deadline = deadline;
+	event.scheduled = true;
+
+	HEAP_ENTRY entry;
+	entry.deadline = deadline;
+	entry.id = id;
+	entry.generation = event.generation;
+	m_heap.push_back(entry);
+	std::push_heap(m_heap.begin(), m_heap.end(), &IsLaterEntry);
+
+	DiscardStaleEntries();
+}
+
+void CEventScheduler::DiscardStaleEntries()
+{
+	while(!m_heap.empty())
+	{
+		const auto& entry = m_heap.front();
+		const auto& event = m_events[entry.id];
+		if(event.scheduled && (event.generation == entry.generation)) break;
+		std::pop_heap(m_heap.begin(), m_heap.end(), &IsLaterEntry);
+		m_heap.pop_back();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Types.h"
+
+//Keeps the deadlines of timed events in a min-heap. The emulation loop runs processors until the nearest
+//deadline and processes due events at slice boundaries instead of polling each source after every slice.
+//Time is counted in EE cycles.
+class CEventScheduler
+{
+public:
+	typedef uint32 EventId;
+	typedef std::function<void()> EventHandler;
+
+	enum : uint64
+	{
+		NO_EVENT = ~0ULL,
+	};
+
+	EventId RegisterEvent(const char*, const EventHandler&);
+
+	//Cancels all events and sets time back to 0
+	void Reset();
+
+	//Deadline is relative to the current time
+	void Schedule(EventId, uint64);
+	//Deadline is relative to the previous deadline of the event, keeps periodic events from drifting
+	void Reschedule(EventId, uint64);
+	void Cancel(EventId);
+	bool IsScheduled(EventId) const;
+
+	uint64 GetCurrentTime() const;
+	//Returns NO_EVENT if nothing is scheduled, 0 if an event is due
+	uint64 GetTicksUntilNextEvent() const;
+
+	void AdvanceTime(uint64);
+	//Calls the handlers of due events in deadline order, handlers can schedule events
+	void ProcessEvents();
+
+private:
+	struct EVENT
+	{
+		std::string name;
+		EventHandler handler;
+		uint64 deadline = 0;
+		uint32 generation = 0;
+		bool scheduled = false;
+	};
+
+	//Entries become stale when their event is cancelled or scheduled again
+	struct HEAP_ENTRY
+	{
+		uint64 deadline;
+		EventId id;
+		uint32 generation;
+	};
+
+	static bool IsLaterEntry(const HEAP_ENTRY&, const HEAP_ENTRY&);
+	void ScheduleAt(EventId, uint64);
+	void DiscardStaleEntries();
+
+	std::vector<EVENT> m_events;
+	std::vector<HEAP_ENTRY> m_heap;
+	uint64 m_currentTime = 0;
+};
@@ -1,8 +1,18 @@
 #pragma once
 
-#include <list>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 #include "MIPS.h"
 #include "BasicBlock.h"
+#include "BlockCompileQueue.h"
+#include "CodeArena.h"
+#include "MipsInterpreter.h"
+#include "MIPSAnalysis.h"
+#include "TraceBlock.h"
 
 #include "BlockLookupOneWay.h"
 #include "BlockLookupTwoWay.h"
@@ -45,10 +55,35 @@ public:
 		    };
 	}
 
-	virtual ~CGenericMipsExecutor() = default;
+	virtual ~CGenericMipsExecutor()
+	{
+		CBlockCompileQueue::GetInstance().CancelJobs(this);
+	}
+
+	//When enabled, new blocks are executed by the interpreter while they are being compiled by
+	//CBlockCompileQueue's workers. Compiled blocks are installed at the beginning of Execute.
+	void SetAsyncCompileEnabled(bool enabled)
+	{
+		m_asyncCompileEnabled = enabled;
+	}
+
+	//When enabled, blocks are profiled by the dispatcher before being linked and chains of
+	//frequently executed blocks starting at loop headers are compiled as traces.
+	void SetHotTraceEnabled(bool enabled)
+	{
+		m_hotTraceEnabled = enabled;
+	}
+
+	//Compiled code will be fetched from and registered in this cache if set
+	void SetBlockCache(CJitBlockCache* blockCache)
+	{
+		std::lock_guard<std::mutex> compileLock(m_compileMutex);
+		m_blockCache = blockCache;
+	}
 
 	int Execute(int cycles) override
 	{
+		ProcessCompiledBlocks();
 		m_context.m_State.cycleQuota = cycles;
 #ifdef DEBUGGER_INCLUDED
 		m_mustBreak = false;
@@ -58,7 +93,14 @@ public:
 		{
 			uint32 address = m_context.m_State.nPC & m_addressMask;
 			auto block = m_blockLookup.FindBlockAt(address);
-			block->Execute();
+			if(m_hotTraceEnabled)
+			{
+				ExecuteProfiledBlock(block);
+			}
+			else
+			{
+				block->Execute();
+			}
 		}
 		m_context.m_State.nHasException &= ~MIPS_EXECUTION_STATUS_QUOTADONE;
 #ifdef DEBUGGER_INCLUDED
@@ -79,10 +121,65 @@ public:
 
 	void Reset() override
 	{
+		CBlockCompileQueue::GetInstance().CancelJobs(this);
+		{
+			std::lock_guard<std::mutex> compiledBlocksLock(m_compiledBlocksMutex);
+			m_compiledBlocks.clear();
+			m_hasCompiledBlocks = false;
+		}
 		m_blockLookup.Clear();
 		m_blocks.clear();
 		m_blockLinks.clear();
 		m_pendingBlockLinks.clear();
+		m_blockProfiles.clear();
+		m_activeTraces.clear();
+		m_traceProfiles.clear();
+		m_codeArena.Reset();
+	}
+
+	CCodeArena::STATS GetCodeArenaStats() const
+	{
+		return m_codeArena.GetStats();
+	}
+
+	void DumpTraceProfile() const
+	{
+		typedef std::pair<uint32, const TRACE_PROFILE*> TraceProfileItem;
+		std::vector<TraceProfileItem> traceProfiles;
+		for(const auto& traceProfilePair : m_traceProfiles)
+		{
+			traceProfiles.push_back(std::make_pair(traceProfilePair.first, &traceProfilePair.second));
+		}
+		std::sort(traceProfiles.begin(), traceProfiles.end(),
+		          [](const TraceProfileItem& item1, const TraceProfileItem& item2) { return item1.second->entryCount > item2.second->entryCount; });
+
+		printf("Trace Profile Information\r\n");
+		printf("-------------------------\r\n");
+
+		for(const auto& traceProfileItem : traceProfiles)
+		{
+			const auto& traceProfile = *traceProfileItem.second;
+			printf("Head: 0x%08X, Blocks: %d, Loop: %d, Formed: %d, Active: %d, Entries: %llu.\r\n",
+			       traceProfileItem.first,
+			       static_cast<uint32>(traceProfile.ranges.size()),
+			       traceProfile.loop ? 1 : 0,
+			       traceProfile.formCount,
+			       (m_activeTraces.find(traceProfileItem.first) != std::end(m_activeTraces)) ? 1 : 0,
+			       static_cast<unsigned long long>(traceProfile.entryCount));
+			for(const auto& range : traceProfile.ranges)
+			{
+				printf("  Block: 0x%08X - 0x%08X.\r\n", range.begin, range.end);
+			}
+			for(const auto& exit : traceProfile.exits)
+			{
+				if(exit.address == MIPS_INVALID_PC) continue;
+				printf("  Exit: 0x%08X, Count: %llu.\r\n", exit.address, static_cast<unsigned long long>(exit.count));
+			}
+			if(traceProfile.otherExitCount != 0)
+			{
+				printf("  Other Exits, Count: %llu.\r\n", static_cast<unsigned long long>(traceProfile.otherExitCount));
+			}
+		}
 	}
 
 	void ClearActiveBlocksInRange(uint32 start, uint32 end, bool executing) override
@@ -121,8 +218,26 @@ protected:
 		uint32 address;
 	};
 
-	typedef std::list<BasicBlockPtr> BlockList;
-	typedef std::multimap<uint32, BLOCK_LINK> BlockLinkMap;
+	struct COMPILED_BLOCK
+	{
+		BasicBlockPtr block;
+		uint32 branchAddress;
+	};
+
+	enum
+	{
+		HOT_BLOCK_THRESHOLD = 128,
+		MAX_TRACE_BLOCK_COUNT = 16,
+	};
+
+	//Blocks indexed by begin address
+	typedef std::map<uint32, BasicBlockPtr> BlockMap;
+	//Block links indexed by target address
+	typedef std::unordered_multimap<uint32, BLOCK_LINK> BlockLinkMap;
+	typedef std::vector<COMPILED_BLOCK> CompiledBlockArray;
+	typedef std::unordered_map<uint32, BLOCK_PROFILE> BlockProfileMap;
+	typedef std::unordered_map<uint32, CTraceBlock*> ActiveTraceMap;
+	typedef std::map<uint32, TRACE_PROFILE> TraceProfileMap;
 
 	bool HasBlockAt(uint32 address) const
 	{
@@ -135,26 +250,87 @@ protected:
 		assert(!HasBlockAt(start));
 		auto block = BlockFactory(m_context, start, end);
 		m_blockLookup.AddBlock(block.get());
-		m_blocks.push_back(std::move(block));
+		m_blocks[start] = std::move(block);
 	}
 
 	virtual BasicBlockPtr BlockFactory(CMIPS& context, uint32 start, uint32 end)
 	{
 		auto result = std::make_shared<CBasicBlock>(context, start, end);
-		result->Compile();
+		if(m_asyncCompileEnabled && CMipsInterpreter::CanExecuteRange(context, start, end))
+		{
+			result->SetInterpreted(true);
+		}
+		else
+		{
+			CompileBlock(result.get());
+		}
 		return result;
 	}
 
+	//Architecture objects keep decoding state while compiling, compilation of
+	//blocks belonging to the same context must not overlap.
+	void CompileBlock(CBasicBlock* block)
+	{
+		std::lock_guard<std::mutex> compileLock(m_compileMutex);
+		block->Compile(m_blockCache, &m_codeArena);
+	}
+
+	void QueueBlockCompile(CBasicBlock* block, uint32 branchAddress)
+	{
+		auto blockIterator = m_blocks.find(block->GetBeginAddress());
+		assert(blockIterator != std::end(m_blocks));
+		assert(blockIterator->second.get() == block);
+		auto blockPtr = blockIterator->second;
+		CBlockCompileQueue::GetInstance().Enqueue(this,
+		                                          [this, blockPtr, branchAddress]() {
+			                                          CompileBlock(blockPtr.get());
+			                                          std::lock_guard<std::mutex> compiledBlocksLock(m_compiledBlocksMutex);
+			                                          m_compiledBlocks.push_back(COMPILED_BLOCK{blockPtr, branchAddress});
+			                                          m_hasCompiledBlocks = true;
+		                                          });
+	}
+
+	//Swaps interpreted blocks for their compiled version. Blocks that were invalidated
+	//while being compiled are discarded.
+	void ProcessCompiledBlocks()
+	{
+		if(!m_hasCompiledBlocks) return;
+		CompiledBlockArray compiledBlocks;
+		{
+			std::lock_guard<std::mutex> compiledBlocksLock(m_compiledBlocksMutex);
+			std::swap(compiledBlocks, m_compiledBlocks);
+			m_hasCompiledBlocks = false;
+		}
+		for(const auto& compiledBlock : compiledBlocks)
+		{
+			auto block = compiledBlock.block.get();
+			uint32 beginAddress = block->GetBeginAddress();
+			if(m_blockLookup.FindBlockAt(beginAddress) != block) continue;
+			assert(block->IsInterpreted());
+			block->SetInterpreted(false);
+			SetupBlockLinks(beginAddress, block->GetEndAddress(), compiledBlock.branchAddress);
+		}
+	}
+
 	void SetupBlockLinks(uint32 startAddress, uint32 endAddress, uint32 branchAddress)
 	{
 		auto block = m_blockLookup.FindBlockAt(startAddress);
 
+		//Interpreted blocks can't be linked, this will be done once they're compiled
+		if(block->IsInterpreted())
+		{
+			QueueBlockCompile(block, branchAddress);
+			return;
+		}
+
+		bool canLinkBlock = CanLinkBlock(block);
+
 		{
 			uint32 nextBlockAddress = (endAddress + 4) & m_addressMask;
 			block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_NEXT, nextBlockAddress);
 			auto link = std::make_pair(nextBlockAddress, BLOCK_LINK{CBasicBlock::LINK_SLOT_NEXT, startAddress});
 			auto nextBlock = m_blockLookup.FindBlockAt(nextBlockAddress);
-			if(!nextBlock->IsEmpty())
+			if(canLinkBlock && !nextBlock->IsEmpty() && CanLinkBlock(nextBlock))
 			{
 				block->LinkBlock(CBasicBlock::LINK_SLOT_NEXT, nextBlock);
 				m_blockLinks.insert(link);
@@ -171,7 +347,7 @@ protected:
 			block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_BRANCH, branchAddress);
 			auto link = std::make_pair(branchAddress, BLOCK_LINK{CBasicBlock::LINK_SLOT_BRANCH, startAddress});
 			auto branchBlock = m_blockLookup.FindBlockAt(branchAddress);
-			if(!branchBlock->IsEmpty())
+			if(canLinkBlock && !branchBlock->IsEmpty() && CanLinkBlock(branchBlock))
 			{
 				block->LinkBlock(CBasicBlock::LINK_SLOT_BRANCH, branchBlock);
 				m_blockLinks.insert(link);
@@ -183,19 +359,245 @@ protected:
 		}
 
 		//Resolve any block links that could be valid now that block has been created
+		if(canLinkBlock)
 		{
-			auto lowerBound = m_pendingBlockLinks.lower_bound(startAddress);
-			auto upperBound = m_pendingBlockLinks.upper_bound(startAddress);
-			for(auto blockLinkIterator = lowerBound; blockLinkIterator != upperBound; blockLinkIterator++)
+			ResolvePendingBlockLinks(block);
+		}
+	}
+
+	//Allows derived executors to keep some blocks out of traces
+	virtual bool CanTraceBlock(CBasicBlock*) const
+	{
+		return true;
+	}
+
+	bool CanLinkBlock(CBasicBlock* block) const
+	{
+		if(block->IsInterpreted()) return false;
+		if(!m_hotTraceEnabled) return true;
+		//Blocks must go through the dispatcher while being profiled, traces always go through it
+		if(block->IsTrace()) return false;
+		auto profile = block->GetProfile();
+		return profile && profile->settled;
+	}
+
+	//Links pending links that target this block
+	void ResolvePendingBlockLinks(CBasicBlock* block)
+	{
+		auto linkRange = m_pendingBlockLinks.equal_range(block->GetBeginAddress());
+		for(auto blockLinkIterator = linkRange.first; blockLinkIterator != linkRange.second;)
+		{
+			const auto& blockLink = blockLinkIterator->second;
+			auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
+			if(!referringBlock->IsEmpty())
 			{
-				const auto& blockLink = blockLinkIterator->second;
-				auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
-				if(referringBlock->IsEmpty()) continue;
+				if(!CanLinkBlock(referringBlock))
+				{
+					blockLinkIterator++;
+					continue;
+				}
 				referringBlock->LinkBlock(blockLink.slot, block);
 				m_blockLinks.insert(*blockLinkIterator);
 			}
-			m_pendingBlockLinks.erase(lowerBound, upperBound);
+			blockLinkIterator = m_pendingBlockLinks.erase(blockLinkIterator);
+		}
+	}
+
+	//Moves links that target a block back to the pending list
+	void UnlinkIncomingBlockLinks(uint32 address)
+	{
+		auto linkRange = m_blockLinks.equal_range(address);
+		for(auto blockLinkIterator = linkRange.first; blockLinkIterator != linkRange.second; blockLinkIterator++)
+		{
+			const auto& blockLink = blockLinkIterator->second;
+			auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
+			if(referringBlock->IsEmpty()) continue;
+			referringBlock->UnlinkBlock(blockLink.slot);
+			m_pendingBlockLinks.insert(*blockLinkIterator);
 		}
+		m_blockLinks.erase(linkRange.first, linkRange.second);
+	}
+
+	void ExecuteProfiledBlock(CBasicBlock* block)
+	{
+		if(block->IsEmpty())
+		{
+			block->Execute();
+			return;
+		}
+
+		uint32 address = block->GetBeginAddress();
+
+		if(block->IsTrace())
+		{
+			assert(m_activeTraces.find(address)->second == block);
+			auto traceProfile = static_cast<CTraceBlock*>(block)->GetTraceProfile();
+			traceProfile->entryCount++;
+			m_executingTrace = block;
+			block->Execute();
+			m_executingTrace = nullptr;
+			traceProfile->RecordExit(m_context.m_State.nPC & m_addressMask);
+			if(m_executingTraceInvalidated)
+			{
+				m_executingTraceInvalidated = false;
+				RemoveTrace(address);
+			}
+			return;
+		}
+
+		block->Execute();
+
+		//Block might have been invalidated while executing
+		if(m_blockLookup.FindBlockAt(address) != block) return;
+
+		auto profilePtr = block->GetProfile();
+		if(!profilePtr)
+		{
+			profilePtr = &m_blockProfiles[address];
+			block->SetProfile(profilePtr);
+		}
+		auto& profile = *profilePtr;
+		if(profile.settled) return;
+		profile.executionCount++;
+		RecordBlockSuccessor(profile, m_context.m_State.nPC & m_addressMask);
+		if(profile.executionCount < HOT_BLOCK_THRESHOLD) return;
+		//Wait for compilation to be done before settling
+		if(block->IsInterpreted()) return;
+
+		profile.settled = true;
+		if(m_context.m_analysis && m_context.m_analysis->IsLoopHeader(address))
+		{
+			if(FormTrace(address)) return;
+		}
+		SettleBlockLinks(block);
+	}
+
+	static void RecordBlockSuccessor(BLOCK_PROFILE& profile, uint32 address)
+	{
+		auto leastUsedSuccessor = &profile.successors[0];
+		for(auto& successor : profile.successors)
+		{
+			if(successor.address == address)
+			{
+				successor.count++;
+				return;
+			}
+			if(successor.count < leastUsedSuccessor->count)
+			{
+				leastUsedSuccessor = &successor;
+			}
+		}
+		leastUsedSuccessor->address = address;
+		leastUsedSuccessor->count = 1;
+	}
+
+	//Returns the successor taken most of the time or MIPS_INVALID_PC if there's none
+	static uint32 GetHotBlockSuccessor(const BLOCK_PROFILE& profile)
+	{
+		for(const auto& successor : profile.successors)
+		{
+			if(successor.address == MIPS_INVALID_PC) continue;
+			if((successor.count * 2) > profile.executionCount)
+			{
+				return successor.address;
+			}
+		}
+		return MIPS_INVALID_PC;
+	}
+
+	//Links a block that was profiled to its neighbours
+	void SettleBlockLinks(CBasicBlock* block)
+	{
+		uint32 address = block->GetBeginAddress();
+		for(auto linkSlot : {CBasicBlock::LINK_SLOT_NEXT, CBasicBlock::LINK_SLOT_BRANCH})
+		{
+			uint32 linkTargetAddress = block->GetLinkTargetAddress(linkSlot);
+			if(linkTargetAddress == MIPS_INVALID_PC) continue;
+			auto slotIterator = FindBlockLink(m_pendingBlockLinks, linkTargetAddress, address, linkSlot);
+			if(slotIterator == std::end(m_pendingBlockLinks)) continue;
+			auto targetBlock = m_blockLookup.FindBlockAt(linkTargetAddress);
+			if(targetBlock->IsEmpty() || !CanLinkBlock(targetBlock)) continue;
+			block->LinkBlock(linkSlot, targetBlock);
+			m_blockLinks.insert(*slotIterator);
+			m_pendingBlockLinks.erase(slotIterator);
+		}
+		ResolvePendingBlockLinks(block);
+	}
+
+	//Follows the hot path from a block and replaces it with a trace if the path is worth it
+	bool FormTrace(uint32 headAddress)
+	{
+		CTraceBlock::RangeArray ranges;
+		bool loop = false;
+		uint32 address = headAddress;
+		while(ranges.size() < MAX_TRACE_BLOCK_COUNT)
+		{
+			auto block = m_blockLookup.FindBlockAt(address);
+			if(block->IsEmpty()) break;
+			if(!CanTraceBlock(block)) break;
+			if(block->IsTrace()) break;
+			ranges.push_back(CTraceBlock::RANGE{block->GetBeginAddress(), block->GetEndAddress()});
+
+			auto profile = block->GetProfile();
+			if(!profile) break;
+			uint32 nextAddress = GetHotBlockSuccessor(*profile);
+			if(nextAddress == MIPS_INVALID_PC) break;
+			if(nextAddress == headAddress)
+			{
+				loop = true;
+				break;
+			}
+			bool visited = std::any_of(ranges.begin(), ranges.end(),
+			                           [nextAddress](const CTraceBlock::RANGE& range) { return range.begin == nextAddress; });
+			if(visited) break;
+			address = nextAddress;
+		}
+
+		if(!loop && (ranges.size() < 2)) return false;
+
+		auto& traceProfile = m_traceProfiles[headAddress];
+		auto trace = std::make_shared<CTraceBlock>(m_context, ranges, loop);
+		trace->SetTraceProfile(&traceProfile);
+		{
+			std::lock_guard<std::mutex> compileLock(m_compileMutex);
+			trace->Compile(nullptr, &m_codeArena);
+		}
+
+		//Replace head block by the trace, nothing links to or from traces
+		{
+			auto headBlockIterator = m_blocks.find(headAddress);
+			assert(headBlockIterator != std::end(m_blocks));
+			auto headBlock = headBlockIterator->second.get();
+			OrphanBlock(headBlock);
+			UnlinkIncomingBlockLinks(headAddress);
+			m_blockLookup.DeleteBlock(headBlock);
+			m_blockLookup.AddBlock(trace.get());
+			m_activeTraces[headAddress] = trace.get();
+			headBlockIterator->second = std::move(trace);
+		}
+
+		traceProfile.ranges = std::move(ranges);
+		traceProfile.loop = loop;
+		traceProfile.formCount++;
+		return true;
+	}
+
+	bool TraceOverlapsRange(const CTraceBlock* trace, uint32 start, uint32 end) const
+	{
+		const auto& ranges = trace->GetRanges();
+		return std::any_of(ranges.begin(), ranges.end(),
+		                   [&](const CTraceBlock::RANGE& range) { return RangesOverlap(range.begin, range.end, start, end); });
+	}
+
+	void RemoveTrace(uint32 address)
+	{
+		auto blockIterator = m_blocks.find(address);
+		assert(blockIterator != std::end(m_blocks));
+		std::vector<BasicBlockPtr> removedBlocks;
+		m_blockLookup.DeleteBlock(blockIterator->second.get());
+		removedBlocks.push_back(std::move(blockIterator->second));
+		m_blocks.erase(blockIterator);
+		DiscardBlocks(removedBlocks);
 	}
 
 	virtual void PartitionFunction(uint32 startAddress)
@@ -224,22 +626,34 @@ protected:
 		SetupBlockLinks(startAddress, endAddress, branchAddress);
 	}
 
+	//Finds the outgoing link of a block in a link map. Links are indexed by target
+	//address, so only links going to the same target need to be looked at.
+	static typename BlockLinkMap::iterator FindBlockLink(BlockLinkMap& blockLinks, uint32 targetAddress, uint32 blockAddress, CBasicBlock::LINK_SLOT linkSlot)
+	{
+		auto linkRange = blockLinks.equal_range(targetAddress);
+		for(auto blockLinkIterator = linkRange.first; blockLinkIterator != linkRange.second; blockLinkIterator++)
+		{
+			const auto& blockLink = blockLinkIterator->second;
+			if((blockLink.address == blockAddress) && (blockLink.slot == linkSlot))
+			{
+				return blockLinkIterator;
+			}
+		}
+		return std::end(blockLinks);
+	}
+
 	//Unlink and removes block from all of our bookkeeping structures
 	void OrphanBlock(CBasicBlock* block)
 	{
 		auto orphanBlockLinkSlot =
 		    [&](CBasicBlock::LINK_SLOT linkSlot) {
-			    auto slotSearch =
-			        [&](const std::pair<uint32, BLOCK_LINK>& link) {
-				        return (link.second.address == block->GetBeginAddress()) &&
-				               (link.second.slot == linkSlot);
-			        };
 			    uint32 linkTargetAddress = block->GetLinkTargetAddress(linkSlot);
 			    //Check if block has this specific link slot
 			    if(linkTargetAddress != MIPS_INVALID_PC)
 			    {
 				    //If it has that link slot, it's either linked or pending to be linked
-				    auto slotIterator = std::find_if(m_blockLinks.begin(), m_blockLinks.end(), slotSearch);
+				    uint32 blockAddress = block->GetBeginAddress();
+				    auto slotIterator = FindBlockLink(m_blockLinks, linkTargetAddress, blockAddress, linkSlot);
 				    if(slotIterator != std::end(m_blockLinks))
 				    {
 					    block->UnlinkBlock(linkSlot);
@@ -247,7 +661,7 @@ protected:
 				    }
 				    else
 				    {
-					    slotIterator = std::find_if(m_pendingBlockLinks.begin(), m_pendingBlockLinks.end(), slotSearch);
+					    slotIterator = FindBlockLink(m_pendingBlockLinks, linkTargetAddress, blockAddress, linkSlot);
 					    assert(slotIterator != std::end(m_pendingBlockLinks));
 					    m_pendingBlockLinks.erase(slotIterator);
 				    }
@@ -264,46 +678,76 @@ protected:
 		uint32 scanEnd = end;
 		assert(scanEnd > scanStart);
 
-		std::set<CBasicBlock*> clearedBlocks;
-		for(uint32 address = scanStart; address < scanEnd; address += 4)
+		std::vector<BasicBlockPtr> clearedBlocks;
+		auto clearBlock =
+		    [&](typename BlockMap::iterator blockIterator) {
+			    m_blockLookup.DeleteBlock(blockIterator->second.get());
+			    clearedBlocks.push_back(std::move(blockIterator->second));
+			    return m_blocks.erase(blockIterator);
+		    };
+
+		//Traces contain code from blocks that can be far away from their head
+		for(const auto& activeTracePair : m_activeTraces)
 		{
-			auto block = m_blockLookup.FindBlockAt(address);
-			if(block->IsEmpty()) continue;
-			if(block == protectedBlock) continue;
-			if(!RangesOverlap(block->GetBeginAddress(), block->GetEndAddress(), start, end)) continue;
-			clearedBlocks.insert(block);
-			m_blockLookup.DeleteBlock(block);
+			auto trace = activeTracePair.second;
+			if(trace == protectedBlock) continue;
+			if(!TraceOverlapsRange(trace, start, end)) continue;
+			if(trace == m_executingTrace)
+			{
+				//Will be removed when it returns
+				m_executingTraceInvalidated = true;
+				continue;
+			}
+			auto blockIterator = m_blocks.find(activeTracePair.first);
+			assert(blockIterator != std::end(m_blocks));
+			clearBlock(blockIterator);
 		}
 
+		//Only visit blocks that begin in the scan range
+		for(auto blockIterator = m_blocks.lower_bound(scanStart);
+		    (blockIterator != std::end(m_blocks)) && (blockIterator->first < scanEnd);)
+		{
+			auto block = blockIterator->second.get();
+			if(
+			    (block == protectedBlock) ||
+			    block->IsTrace() ||
+			    !RangesOverlap(block->GetBeginAddress(), block->GetEndAddress(), start, end))
+			{
+				blockIterator++;
+				continue;
+			}
+			blockIterator = clearBlock(blockIterator);
+		}
+
+		DiscardBlocks(clearedBlocks);
+	}
+
+	//Removes blocks that are not in the lookup table anymore from our bookkeeping structures
+	void DiscardBlocks(const std::vector<BasicBlockPtr>& blocks)
+	{
 		//Remove pending block link entries for the blocks that are about to be cleared
-		for(auto& block : clearedBlocks)
+		for(const auto& block : blocks)
 		{
-			OrphanBlock(block);
+			OrphanBlock(block.get());
 		}
 
 		//Undo all stale links
-		for(auto& block : clearedBlocks)
+		for(const auto& block : blocks)
 		{
-			auto lowerBound = m_blockLinks.lower_bound(block->GetBeginAddress());
-			auto upperBound = m_blockLinks.upper_bound(block->GetBeginAddress());
-			for(auto blockLinkIterator = lowerBound; blockLinkIterator != upperBound; blockLinkIterator++)
+			uint32 address = block->GetBeginAddress();
+			UnlinkIncomingBlockLinks(address);
+			m_blockProfiles.erase(address);
+			auto activeTraceIterator = m_activeTraces.find(address);
+			if((activeTraceIterator != std::end(m_activeTraces)) && (activeTraceIterator->second == block.get()))
 			{
-				const auto& blockLink = blockLinkIterator->second;
-				auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
-				if(referringBlock->IsEmpty()) continue;
-				referringBlock->UnlinkBlock(blockLink.slot);
-				m_pendingBlockLinks.insert(*blockLinkIterator);
+				m_activeTraces.erase(activeTraceIterator);
 			}
-			m_blockLinks.erase(lowerBound, upperBound);
-		}
-
-		if(!clearedBlocks.empty())
-		{
-			m_blocks.remove_if([&](const BasicBlockPtr& block) { return clearedBlocks.find(block.get()) != std::end(clearedBlocks); });
 		}
 	}
 
-	BlockList m_blocks;
+	//Must outlive blocks since it holds their code
+	CCodeArena m_codeArena;
+	BlockMap m_blocks;
 	BasicBlockPtr m_emptyBlock;
 	BlockLinkMap m_blockLinks;
 	BlockLinkMap m_pendingBlockLinks;
@@ -313,6 +757,20 @@ protected:
 
 	BlockLookupType m_blockLookup;
 
+	bool m_asyncCompileEnabled = false;
+	CJitBlockCache* m_blockCache = nullptr;
+	std::mutex m_compileMutex;
+	std::mutex m_compiledBlocksMutex;
+	std::atomic<bool> m_hasCompiledBlocks = {false};
+	CompiledBlockArray m_compiledBlocks;
+
+	bool m_hotTraceEnabled = false;
+	BlockProfileMap m_blockProfiles;
+	ActiveTraceMap m_activeTraces;
+	TraceProfileMap m_traceProfiles;
+	CBasicBlock* m_executingTrace = nullptr;
+	bool m_executingTraceInvalidated = false;
+
 #ifdef DEBUGGER_INCLUDED
 	bool m_mustBreak = false;
 	bool m_breakpointsDisabledOnce = false;
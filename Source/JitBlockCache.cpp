@@ -0,0 +1,363 @@
+#include "JitBlockCache.h"
+#include "MemoryUtils.h"
+#include "StdStreamUtils.h"
+#include "Log.h"
+#include "string_format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <dlfcn.h>
+#include <mach-o/loader.h>
+#elif defined(__unix__) || defined(__ANDROID__)
+#include <dlfcn.h>
+#include <link.h>
+#endif
+
+#define LOG_NAME "JitBlockCache"
+
+#define CACHE_FILE_MAGIC (0x54494A50) //'PJIT'
+#define CACHE_FILE_VERSION (2)
+#define MAX_BUILD_ID_SIZE (0x100)
+#define MAX_BLOCK_CODE_SIZE (0x100000)
+
+#define MODULE_HASH_CHUNK_SIZE (0x10000)
+
+uintptr_t CJitBlockCache::GetAnchor()
+{
+	return reinterpret_cast<uintptr_t>(&NextBlockTrampoline);
+}
+
+//Hashes the binary that contains the anchor. Native code is only valid for the
+//exact binary that produced it, any rebuild that changes it invalidates caches.
+static std::string GetModuleBuildId(const boost::filesystem::path& modulePath)
+{
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(modulePath.native());
+		uint64 remaining = boost::filesystem::file_size(modulePath);
+		uint64 moduleSize = remaining;
+		std::vector<uint8> chunk(MODULE_HASH_CHUNK_SIZE);
+		uLong crc = crc32(0, Z_NULL, 0);
+		while(remaining != 0)
+		{
+			uint32 chunkSize = static_cast<uint32>(std::min<uint64>(remaining, MODULE_HASH_CHUNK_SIZE));
+			stream.Read(chunk.data(), chunkSize);
+			crc = crc32(crc, reinterpret_cast<Bytef*>(chunk.data()), chunkSize);
+			remaining -= chunkSize;
+		}
+		return string_format("%08x-%llx", static_cast<uint32>(crc), static_cast<unsigned long long>(moduleSize));
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to hash module '%s': %s.\r\n", modulePath.string().c_str(), exception.what());
+		return std::string();
+	}
+}
+
+#if defined(__unix__) || defined(__ANDROID__)
+struct MODULE_RANGE
+{
+	uintptr_t anchor = 0;
+	uintptr_t begin = 0;
+	uintptr_t end = 0;
+};
+
+//Finds the extent of the loaded object that contains the anchor
+static int FindAnchorModuleRange(dl_phdr_info* info, size_t, void* data)
+{
+	auto range = reinterpret_cast<MODULE_RANGE*>(data);
+	uintptr_t begin = UINTPTR_MAX;
+	uintptr_t end = 0;
+	bool containsAnchor = false;
+	for(unsigned int i = 0; i < info->dlpi_phnum; i++)
+	{
+		const auto& header = info->dlpi_phdr[i];
+		if(header.p_type != PT_LOAD) continue;
+		uintptr_t segmentBegin = info->dlpi_addr + header.p_vaddr;
+		uintptr_t segmentEnd = segmentBegin + header.p_memsz;
+		begin = std::min(begin, segmentBegin);
+		end = std::max(end, segmentEnd);
+		containsAnchor |= (range->anchor >= segmentBegin) && (range->anchor < segmentEnd);
+	}
+	if(!containsAnchor) return 0;
+	range->begin = begin;
+	range->end = end;
+	return 1;
+}
+#endif
+
+const CJitBlockCache::MODULE_INFO& CJitBlockCache::GetAnchorModule()
+{
+	static const MODULE_INFO anchorModule =
+	    []() {
+		    MODULE_INFO module;
+		    boost::filesystem::path modulePath;
+#ifdef _WIN32
+		    HMODULE moduleHandle = NULL;
+		    DWORD flags = GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT;
+		    if(!GetModuleHandleExW(flags, reinterpret_cast<LPCWSTR>(GetAnchor()), &moduleHandle)) return module;
+		    auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(moduleHandle);
+		    auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(reinterpret_cast<const uint8*>(moduleHandle) + dosHeader->e_lfanew);
+		    module.begin = reinterpret_cast<uintptr_t>(moduleHandle);
+		    module.end = module.begin + ntHeaders->OptionalHeader.SizeOfImage;
+		    wchar_t moduleFileName[MAX_PATH];
+		    DWORD moduleFileNameLength = GetModuleFileNameW(moduleHandle, moduleFileName, MAX_PATH);
+		    if((moduleFileNameLength == 0) || (moduleFileNameLength == MAX_PATH)) return module;
+		    modulePath = moduleFileName;
+#elif defined(__APPLE__)
+		    Dl_info anchorInfo = {};
+		    if(!dladdr(reinterpret_cast<void*>(GetAnchor()), &anchorInfo)) return module;
+		    auto header = reinterpret_cast<const mach_header_64*>(anchorInfo.dli_fbase);
+		    auto command = reinterpret_cast<const load_command*>(header + 1);
+		    uintptr_t begin = UINTPTR_MAX;
+		    uintptr_t end = 0;
+		    intptr_t slide = 0;
+		    for(uint32 i = 0; i < header->ncmds; i++)
+		    {
+			    if(command->cmd == LC_SEGMENT_64)
+			    {
+				    auto segment = reinterpret_cast<const segment_command_64*>(command);
+				    if(!strcmp(segment->segname, SEG_TEXT))
+				    {
+					    slide = reinterpret_cast<intptr_t>(header) - static_cast<intptr_t>(segment->vmaddr);
+				    }
+				    //__PAGEZERO isn't mapped
+				    if(segment->filesize != 0)
+				    {
+					    begin = std::min<uintptr_t>(begin, segment->vmaddr);
+					    end = std::max<uintptr_t>(end, segment->vmaddr + segment->vmsize);
+				    }
+			    }
+			    command = reinterpret_cast<const load_command*>(reinterpret_cast<const uint8*>(command) + command->cmdsize);
+		    }
+		    if(begin >= end) return module;
+		    module.begin = begin + slide;
+		    module.end = end + slide;
+		    modulePath = anchorInfo.dli_fname;
+#elif defined(__unix__) || defined(__ANDROID__)
+		    MODULE_RANGE range;
+		    range.anchor = GetAnchor();
+		    if(!dl_iterate_phdr(&FindAnchorModuleRange, &range)) return module;
+		    Dl_info anchorInfo = {};
+		    if(!dladdr(reinterpret_cast<void*>(range.anchor), &anchorInfo)) return module;
+		    module.begin = range.begin;
+		    module.end = range.end;
+		    modulePath = anchorInfo.dli_fname;
+#endif
+		    if(!modulePath.empty())
+		    {
+			    module.buildId = GetModuleBuildId(modulePath);
+		    }
+		    return module;
+	    }();
+	return anchorModule;
+}
+
+bool CJitBlockCache::IsSymbolRelocatable(uintptr_t symbol)
+{
+	//Only symbols that live in the same module as the anchor will be at the same
+	//relative location in another session
+	const auto& anchorModule = GetAnchorModule();
+	return (symbol >= anchorModule.begin) && (symbol < anchorModule.end);
+}
+
+bool CJitBlockCache::Load(const boost::filesystem::path& cachePath)
+{
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+
+	m_blocks.clear();
+	m_dirty = false;
+	m_stats = STATS();
+
+	if(!boost::filesystem::exists(cachePath)) return false;
+
+	const auto& buildId = GetAnchorModule().buildId;
+	if(buildId.empty()) return false;
+
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(cachePath.native());
+
+		uint32 magic = stream.Read32();
+		uint32 version = stream.Read32();
+		uint32 pointerSize = stream.Read32();
+		uint32 buildIdSize = stream.Read32();
+		std::string fileBuildId;
+		if(buildIdSize <= MAX_BUILD_ID_SIZE)
+		{
+			fileBuildId.resize(buildIdSize);
+			stream.Read(&fileBuildId[0], buildIdSize);
+		}
+		if(
+		    (magic != CACHE_FILE_MAGIC) ||
+		    (version != CACHE_FILE_VERSION) ||
+		    (pointerSize != sizeof(uintptr_t)) ||
+		    (buildIdSize > MAX_BUILD_ID_SIZE) ||
+		    (fileBuildId != buildId))
+		{
+			CLog::GetInstance().Print(LOG_NAME, "Ignoring incompatible cache file '%s'.\r\n", cachePath.string().c_str());
+			return false;
+		}
+
+		uint32 blockCount = stream.Read32();
+		for(uint32 i = 0; i < blockCount; i++)
+		{
+			AOT_BLOCK_KEY key = {};
+			key.crc = stream.Read32();
+			key.begin = stream.Read32();
+			key.end = stream.Read32();
+			uint32 codeSize = stream.Read32();
+			uint32 relocationCount = stream.Read32();
+			if(stream.IsEOF() || (codeSize > MAX_BLOCK_CODE_SIZE) || (relocationCount > (codeSize / sizeof(uintptr_t))))
+			{
+				throw std::runtime_error("Invalid block header.");
+			}
+
+			BLOCK block;
+			block.code.resize(codeSize);
+			stream.Read(block.code.data(), codeSize);
+			block.relocations.resize(relocationCount);
+			for(auto& relocation : block.relocations)
+			{
+				relocation.offset = stream.Read32();
+				stream.Read(&relocation.symbolOffset, sizeof(int64));
+				if((relocation.offset + sizeof(uintptr_t)) > codeSize)
+				{
+					throw std::runtime_error("Invalid relocation offset.");
+				}
+			}
+			ResolveRelocations(block);
+			m_blocks.insert(std::make_pair(key, std::move(block)));
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to load cache file '%s': %s.\r\n", cachePath.string().c_str(), exception.what());
+		m_blocks.clear();
+		return false;
+	}
+
+	CLog::GetInstance().Print(LOG_NAME, "Loaded %d blocks from '%s'.\r\n", static_cast<uint32>(m_blocks.size()), cachePath.string().c_str());
+	return true;
+}
+
+void CJitBlockCache::Save(const boost::filesystem::path& cachePath)
+{
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+
+	if(!m_dirty) return;
+
+	const auto& buildId = GetAnchorModule().buildId;
+	if(buildId.empty()) return;
+
+	try
+	{
+		auto stream = Framework::CreateOutputStdStream(cachePath.native());
+
+		stream.Write32(CACHE_FILE_MAGIC);
+		stream.Write32(CACHE_FILE_VERSION);
+		stream.Write32(sizeof(uintptr_t));
+		stream.Write32(static_cast<uint32>(buildId.size()));
+		stream.Write(buildId.data(), buildId.size());
+
+		stream.Write32(static_cast<uint32>(m_blocks.size()));
+		for(const auto& blockPair : m_blocks)
+		{
+			const auto& key = blockPair.first;
+			const auto& block = blockPair.second;
+			stream.Write32(key.crc);
+			stream.Write32(key.begin);
+			stream.Write32(key.end);
+			stream.Write32(static_cast<uint32>(block.code.size()));
+			stream.Write32(static_cast<uint32>(block.relocations.size()));
+			stream.Write(block.code.data(), block.code.size());
+			for(const auto& relocation : block.relocations)
+			{
+				stream.Write32(relocation.offset);
+				stream.Write(&relocation.symbolOffset, sizeof(int64));
+			}
+		}
+
+		m_dirty = false;
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Print(LOG_NAME, "Failed to save cache file '%s': %s.\r\n", cachePath.string().c_str(), exception.what());
+	}
+}
+
+void CJitBlockCache::Clear()
+{
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+	m_blocks.clear();
+	m_dirty = false;
+	m_stats = STATS();
+}
+
+bool CJitBlockCache::FindBlock(const AOT_BLOCK_KEY& key, const BlockHandler& blockHandler)
+{
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+
+	auto blockIterator = m_blocks.find(key);
+	if(blockIterator == std::end(m_blocks))
+	{
+		m_stats.misses++;
+		return false;
+	}
+
+	const auto& block = blockIterator->second;
+	blockHandler(block.code.data(), block.code.size(), block.symbolReferences);
+
+	m_stats.hits++;
+	return true;
+}
+
+void CJitBlockCache::RegisterBlock(const AOT_BLOCK_KEY& key, const void* code, size_t codeSize, const SymbolReferenceArray& symbolReferences)
+{
+	BLOCK block;
+	for(const auto& symbolReference : symbolReferences)
+	{
+		if(
+		    (symbolReference.refType != Jitter::CCodeGen::SYMBOL_REF_TYPE::NATIVE_POINTER) ||
+		    !IsSymbolRelocatable(symbolReference.symbol))
+		{
+			std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+			m_stats.rejected++;
+			return;
+		}
+		RELOCATION relocation;
+		relocation.offset = symbolReference.offset;
+		relocation.symbolOffset = static_cast<int64>(symbolReference.symbol) - static_cast<int64>(GetAnchor());
+		block.relocations.push_back(relocation);
+	}
+	auto codeBytes = reinterpret_cast<const uint8*>(code);
+	block.code.assign(codeBytes, codeBytes + codeSize);
+	ResolveRelocations(block);
+
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+	m_blocks[key] = std::move(block);
+	m_dirty = true;
+}
+
+void CJitBlockCache::ResolveRelocations(BLOCK& block)
+{
+	//The anchor doesn't move during a session, blocks can be fixed up once and handed out as is
+	block.symbolReferences.clear();
+	for(const auto& relocation : block.relocations)
+	{
+		auto symbol = static_cast<uintptr_t>(static_cast<int64>(GetAnchor()) + relocation.symbolOffset);
+		*reinterpret_cast<uintptr_t*>(block.code.data() + relocation.offset) = symbol;
+		block.symbolReferences.push_back(SYMBOL_REFERENCE{symbol, relocation.offset, Jitter::CCodeGen::SYMBOL_REF_TYPE::NATIVE_POINTER});
+	}
+}
+
+CJitBlockCache::STATS CJitBlockCache::GetStats() const
+{
+	std::lock_guard<std::mutex> blocksLock(m_blocksMutex);
+	return m_stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "Types.h"
+#include "BasicBlock.h"
+
+//Keeps code generated for basic blocks so that it can be reused in another session
+//without going through the code generator again. External symbol references
+//are stored relative to an anchor symbol and are fixed up when a block is fetched.
+class CJitBlockCache
+{
+public:
+	struct SYMBOL_REFERENCE
+	{
+		uintptr_t symbol;
+		uint32 offset;
+		Jitter::CCodeGen::SYMBOL_REF_TYPE refType;
+	};
+	typedef std::vector<SYMBOL_REFERENCE> SymbolReferenceArray;
+	typedef std::function<void(const void*, size_t, const SymbolReferenceArray&)> BlockHandler;
+
+	struct STATS
+	{
+		uint32 hits = 0;
+		uint32 misses = 0;
+		uint32 rejected = 0;
+	};
+
+	bool Load(const boost::filesystem::path&);
+	void Save(const boost::filesystem::path&);
+	void Clear();
+
+	//Calls the handler with fixed up code and its symbol references in emission order.
+	//The cache is locked while the handler runs, code must be copied out before it returns.
+	bool FindBlock(const AOT_BLOCK_KEY&, const BlockHandler&);
+	void RegisterBlock(const AOT_BLOCK_KEY&, const void*, size_t, const SymbolReferenceArray&);
+
+	STATS GetStats() const;
+
+private:
+	struct RELOCATION
+	{
+		uint32 offset;
+		int64 symbolOffset;
+	};
+	typedef std::vector<RELOCATION> RelocationArray;
+
+	struct BLOCK
+	{
+		std::vector<uint8> code;
+		RelocationArray relocations;
+		SymbolReferenceArray symbolReferences;
+	};
+	typedef std::map<AOT_BLOCK_KEY, BLOCK> BlockMap;
+
+	struct MODULE_INFO
+	{
+		uintptr_t begin = 0;
+		uintptr_t end = 0;
+		std::string buildId;
+	};
+
+	static uintptr_t GetAnchor();
+	static const MODULE_INFO& GetAnchorModule();
+	static bool IsSymbolRelocatable(uintptr_t);
+	static void ResolveRelocations(BLOCK&);
+
+	BlockMap m_blocks;
+	bool m_dirty = false;
+	STATS m_stats;
+	mutable std::mutex m_blocksMutex;
+};
@@ -77,6 +77,24 @@ void CMIPSAnalysis::ChangeSubroutineEnd(uint32 start, uint32 newEnd)
 	subroutine.end = newEnd;
 }
 
+bool CMIPSAnalysis::IsLoopHeader(uint32 address) const
+{
+	//Limit search to the subroutine containing the address if we know about it
+	uint32 searchEnd = address + DEFAULT_LOOP_SEARCH_SIZE;
+	if(auto subroutine = FindSubroutine(address))
+	{
+		searchEnd = subroutine->end;
+	}
+	for(uint32 searchAddress = address; searchAddress <= searchEnd; searchAddress += 4)
+	{
+		uint32 opcode = m_ctx->m_pMemoryMap->GetInstruction(searchAddress);
+		if(m_ctx->m_pArch->IsInstructionBranch(m_ctx, searchAddress, opcode) != MIPS_BRANCH_NORMAL) continue;
+		uint32 target = m_ctx->m_pArch->GetInstructionEffectiveAddress(m_ctx, searchAddress, opcode);
+		if(target == address) return true;
+	}
+	return false;
+}
+
 void CMIPSAnalysis::AnalyseSubroutines(uint32 start, uint32 end, uint32 entryPoint)
 {
 	start &= ~0x3;
@@ -32,9 +32,17 @@ public:
 	void ChangeSubroutineStart(uint32, uint32);
 	void ChangeSubroutineEnd(uint32, uint32);
 
+	//Checks if a branch located at or after an address jumps back to it
+	bool IsLoopHeader(uint32) const;
+
 	static CallStackItemArray GetCallStack(CMIPS*, uint32 pc, uint32 sp, uint32 ra);
 
 private:
+	enum
+	{
+		DEFAULT_LOOP_SEARCH_SIZE = 0x400,
+	};
+
 	typedef std::map<uint32, SUBROUTINE, std::greater<uint32>> SubroutineList;
 
 	void AnalyseSubroutines(uint32, uint32, uint32);
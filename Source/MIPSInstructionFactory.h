@@ -26,6 +26,8 @@ public:
 	virtual void CompileInstruction(uint32, CMipsJitter*, CMIPS*) = 0;
 	void Illegal();
 
+	MIPS_REGSIZE GetRegSize() const;
+
 protected:
 	void ComputeMemAccessAddr();
 	void ComputeMemAccessAddrNoXlat();
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include "MemoryMap.h"
 #include "Log.h"
@@ -16,6 +17,12 @@ void CMemoryMap::InsertReadMap(uint32 start, uint32 end, const MemoryMapHandlerT
 	InsertMap(m_readMap, start, end, handler, key);
 }
 
+void CMemoryMap::InsertReadMap(uint32 start, uint32 end, MemoryMapRawHandlerType handler, void* context, unsigned char key)
+{
+	assert(GetReadMap(start) == nullptr);
+	InsertMap(m_readMap, start, end, handler, context, key);
+}
+
 void CMemoryMap::InsertWriteMap(uint32 start, uint32 end, void* pointer, unsigned char key)
 {
 	assert(GetWriteMap(start) == nullptr);
@@ -28,12 +35,24 @@ void CMemoryMap::InsertWriteMap(uint32 start, uint32 end, const MemoryMapHandler
 	InsertMap(m_writeMap, start, end, handler, key);
 }
 
+void CMemoryMap::InsertWriteMap(uint32 start, uint32 end, MemoryMapRawHandlerType handler, void* context, unsigned char key)
+{
+	assert(GetWriteMap(start) == nullptr);
+	InsertMap(m_writeMap, start, end, handler, context, key);
+}
+
 void CMemoryMap::InsertInstructionMap(uint32 start, uint32 end, void* pointer, unsigned char key)
 {
 	assert(GetMap(m_instructionMap, start) == nullptr);
 	InsertMap(m_instructionMap, start, end, pointer, key);
 }
 
+void CMemoryMap::SetMemoryAccessHandler(uint32 address, MemoryMapRawHandlerType handler, void* context)
+{
+	SetMemoryAccessHandler(m_readMap, address, handler, context);
+	SetMemoryAccessHandler(m_writeMap, address, handler, context);
+}
+
 const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetReadMap(uint32 address) const
 {
 	return GetMap(m_readMap, address);
@@ -44,31 +63,92 @@ const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetWriteMap(uint32 address) cons
 	return GetMap(m_writeMap, address);
 }
 
-void CMemoryMap::InsertMap(MemoryMapListType& memoryMap, uint32 start, uint32 end, void* pointer, unsigned char key)
+void CMemoryMap::InsertMap(MEMORYMAP& memoryMap, uint32 start, uint32 end, void* pointer, unsigned char key)
 {
 	MEMORYMAPELEMENT element;
 	element.nStart = start;
 	element.nEnd = end;
 	element.pPointer = pointer;
+	element.rawHandler = nullptr;
+	element.handlerContext = nullptr;
 	element.nType = MEMORYMAP_TYPE_MEMORY;
-	memoryMap.push_back(element);
+	InsertElement(memoryMap, element);
 }
 
-void CMemoryMap::InsertMap(MemoryMapListType& memoryMap, uint32 start, uint32 end, const MemoryMapHandlerType& handler, unsigned char key)
+void CMemoryMap::InsertMap(MEMORYMAP& memoryMap, uint32 start, uint32 end, const MemoryMapHandlerType& handler, unsigned char key)
 {
 	MEMORYMAPELEMENT element;
 	element.nStart = start;
 	element.nEnd = end;
 	element.handler = handler;
+	element.rawHandler = nullptr;
+	element.handlerContext = nullptr;
+	element.pPointer = nullptr;
+	element.nType = MEMORYMAP_TYPE_FUNCTION;
+	InsertElement(memoryMap, element);
+}
+
+void CMemoryMap::InsertMap(MEMORYMAP& memoryMap, uint32 start, uint32 end, MemoryMapRawHandlerType handler, void* context, unsigned char key)
+{
+	MEMORYMAPELEMENT element;
+	element.nStart = start;
+	element.nEnd = end;
+	element.rawHandler = handler;
+	element.handlerContext = context;
 	element.pPointer = nullptr;
 	element.nType = MEMORYMAP_TYPE_FUNCTION;
-	memoryMap.push_back(element);
+	InsertElement(memoryMap, element);
 }
 
-const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetMap(const MemoryMapListType& memoryMap, uint32 nAddress)
+void CMemoryMap::InsertElement(MEMORYMAP& memoryMap, const MEMORYMAPELEMENT& element)
 {
-	for(const auto& mapElement : memoryMap)
+	assert(memoryMap.elements.size() < PAGE_ENTRY_INDEX_MASK);
+	memoryMap.elements.push_back(element);
+
+	//Only pages that weren't touched by previous elements need to be updated
+	for(uint64 pageStart = (element.nStart & ~(PAGE_SIZE - 1)); pageStart <= element.nEnd; pageStart += PAGE_SIZE)
 	{
+		uint32 pageAddress = static_cast<uint32>(pageStart);
+		auto& pageTable = memoryMap.pageTables[pageAddress >> (PAGE_SHIFT + PAGE_TABLE_SHIFT)];
+		if(!pageTable)
+		{
+			pageTable = std::make_unique<uint32[]>(PAGE_TABLE_SIZE);
+			std::fill(pageTable.get(), pageTable.get() + PAGE_TABLE_SIZE, PAGE_ENTRY_EMPTY);
+		}
+		auto& pageEntry = pageTable[(pageAddress >> PAGE_SHIFT) & (PAGE_TABLE_SIZE - 1)];
+		if(pageEntry != PAGE_ENTRY_EMPTY) continue;
+
+		//Look for the first element that ends in or after this page, like a linear lookup would
+		uint32 firstIndex = 0;
+		while(memoryMap.elements[firstIndex].nEnd < pageAddress)
+		{
+			firstIndex++;
+		}
+		assert(firstIndex < memoryMap.elements.size());
+
+		const auto& firstElement = memoryMap.elements[firstIndex];
+		uint64 pageEnd = pageStart + PAGE_SIZE - 1;
+		bool fullPage = (firstElement.nStart <= pageStart) && (firstElement.nEnd >= pageEnd);
+		pageEntry = firstIndex | (fullPage ? PAGE_ENTRY_FULL : 0);
+	}
+}
+
+void CMemoryMap::SetMemoryAccessHandler(MEMORYMAP& memoryMap, uint32 address, MemoryMapRawHandlerType handler, void* context)
+{
+	for(auto& element : memoryMap.elements)
+	{
+		if(element.nType != MEMORYMAP_TYPE_MEMORY) continue;
+		if((address < element.nStart) || (address > element.nEnd)) continue;
+		element.rawHandler = handler;
+		element.handlerContext = context;
+	}
+}
+
+const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::FindElement(const MEMORYMAP& memoryMap, uint32 firstIndex, uint32 nAddress)
+{
+	for(uint32 i = firstIndex; i < memoryMap.elements.size(); i++)
+	{
+		const auto& mapElement = memoryMap.elements[i];
 		if(nAddress <= mapElement.nEnd)
 		{
 			if(!(nAddress >= mapElement.nStart)) return nullptr;
@@ -78,6 +158,18 @@ const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetMap(const MemoryMapListType&
 	return nullptr;
 }
 
+const CMemoryMap::MEMORYMAPELEMENT* CMemoryMap::GetMap(const MEMORYMAP& memoryMap, uint32 nAddress)
+{
+	const auto& pageTable = memoryMap.pageTables[nAddress >> (PAGE_SHIFT + PAGE_TABLE_SHIFT)];
+	if(!pageTable) return nullptr;
+	uint32 pageEntry = pageTable[(nAddress >> PAGE_SHIFT) & (PAGE_TABLE_SIZE - 1)];
+	if(pageEntry == PAGE_ENTRY_EMPTY) return nullptr;
+	uint32 elementIndex = pageEntry & PAGE_ENTRY_INDEX_MASK;
+	if(pageEntry & PAGE_ENTRY_FULL) return &memoryMap.elements[elementIndex];
+	//Page is shared by many elements or is partially mapped
+	return FindElement(memoryMap, elementIndex, nAddress);
+}
+
 uint8 CMemoryMap::GetByte(uint32 nAddress)
 {
 	const auto e = GetMap(m_readMap, nAddress);
@@ -89,10 +181,11 @@ uint8 CMemoryMap::GetByte(uint32 nAddress)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		return *(uint8*)&((uint8*)e->pPointer)[nAddress - e->nStart];
 		break;
 	case MEMORYMAP_TYPE_FUNCTION:
-		return static_cast<uint8>(e->handler(nAddress, 0));
+		return static_cast<uint8>(e->CallHandler(nAddress, 0));
 		break;
 	default:
 		assert(0);
@@ -112,10 +205,11 @@ void CMemoryMap::SetByte(uint32 nAddress, uint8 nValue)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		*(uint8*)&((uint8*)e->pPointer)[nAddress - e->nStart] = nValue;
 		break;
 	case MEMORYMAP_TYPE_FUNCTION:
-		e->handler(nAddress, nValue);
+		e->CallHandler(nAddress, nValue);
 		break;
 	default:
 		assert(0);
@@ -139,10 +233,11 @@ uint16 CMemoryMap_LSBF::GetHalf(uint32 nAddress)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		return *(uint16*)&((uint8*)e->pPointer)[nAddress - e->nStart];
 		break;
 	default:
-		return static_cast<uint16>(e->handler(nAddress, 0));
+		return static_cast<uint16>(e->CallHandler(nAddress, 0));
 		break;
 	}
 }
@@ -159,10 +254,11 @@ uint32 CMemoryMap_LSBF::GetWord(uint32 nAddress)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		return *(uint32*)&((uint8*)e->pPointer)[nAddress - e->nStart];
 		break;
 	case MEMORYMAP_TYPE_FUNCTION:
-		return e->handler(nAddress, 0);
+		return e->CallHandler(nAddress, 0);
 		break;
 	default:
 		assert(0);
@@ -200,10 +296,11 @@ void CMemoryMap_LSBF::SetHalf(uint32 nAddress, uint16 nValue)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		*reinterpret_cast<uint16*>(&reinterpret_cast<uint8*>(e->pPointer)[nAddress - e->nStart]) = nValue;
 		break;
 	case MEMORYMAP_TYPE_FUNCTION:
-		e->handler(nAddress, nValue);
+		e->CallHandler(nAddress, nValue);
 		break;
 	default:
 		assert(0);
@@ -223,10 +320,11 @@ void CMemoryMap_LSBF::SetWord(uint32 nAddress, uint32 nValue)
 	switch(e->nType)
 	{
 	case MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(nAddress);
 		*(uint32*)&((uint8*)e->pPointer)[nAddress - e->nStart] = nValue;
 		break;
 	case MEMORYMAP_TYPE_FUNCTION:
-		e->handler(nAddress, nValue);
+		e->CallHandler(nAddress, nValue);
 		break;
 	default:
 		assert(0);
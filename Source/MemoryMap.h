@@ -2,7 +2,9 @@
 #define _MEMORYMAP_H_
 
 #include "Types.h"
+#include <array>
 #include <functional>
+#include <memory>
 #include <vector>
 
 enum MEMORYMAP_ENDIANESS
@@ -15,6 +17,8 @@ class CMemoryMap
 {
 public:
 	typedef std::function<uint32(uint32, uint32)> MemoryMapHandlerType;
+	//Arguments: context, address, value
+	typedef uint32 (*MemoryMapRawHandlerType)(void*, uint32, uint32);
 
 	enum MEMORYMAP_TYPE
 	{
@@ -28,9 +32,35 @@ public:
 		uint32 nEnd;
 		void* pPointer;
 		MemoryMapHandlerType handler;
+		MemoryMapRawHandlerType rawHandler;
+		void* handlerContext;
 		MEMORYMAP_TYPE nType;
+
+		uint32 CallHandler(uint32 address, uint32 value) const
+		{
+			return rawHandler ? rawHandler(handlerContext, address, value) : handler(address, value);
+		}
+
+		//Memory elements can have a raw handler that is called before they are accessed
+		void NotifyAccess(uint32 address) const
+		{
+			if(rawHandler) rawHandler(handlerContext, address, 0);
+		}
 	};
 
+	//Adapters to use member functions as raw handlers
+	template <typename ObjectType, uint32 (ObjectType::*Handler)(uint32)>
+	static uint32 ReadHandlerProxy(void* context, uint32 address, uint32)
+	{
+		return (reinterpret_cast<ObjectType*>(context)->*Handler)(address);
+	}
+
+	template <typename ObjectType, uint32 (ObjectType::*Handler)(uint32, uint32)>
+	static uint32 WriteHandlerProxy(void* context, uint32 address, uint32 value)
+	{
+		return (reinterpret_cast<ObjectType*>(context)->*Handler)(address, value);
+	}
+
 	virtual ~CMemoryMap() = default;
 	uint8 GetByte(uint32);
 	virtual uint16 GetHalf(uint32) = 0;
@@ -41,24 +71,57 @@ public:
 	virtual void SetWord(uint32, uint32) = 0;
 	void InsertReadMap(uint32, uint32, void*, unsigned char);
 	void InsertReadMap(uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	void InsertReadMap(uint32, uint32, MemoryMapRawHandlerType, void*, unsigned char);
 	void InsertWriteMap(uint32, uint32, void*, unsigned char);
 	void InsertWriteMap(uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	void InsertWriteMap(uint32, uint32, MemoryMapRawHandlerType, void*, unsigned char);
 	void InsertInstructionMap(uint32, uint32, void*, unsigned char);
+	void SetMemoryAccessHandler(uint32, MemoryMapRawHandlerType, void*);
 	const MEMORYMAPELEMENT* GetReadMap(uint32) const;
 	const MEMORYMAPELEMENT* GetWriteMap(uint32) const;
 
 protected:
+	enum
+	{
+		PAGE_SHIFT = 12,
+		PAGE_SIZE = (1 << PAGE_SHIFT),
+		PAGE_TABLE_SHIFT = 10,
+		PAGE_TABLE_SIZE = (1 << PAGE_TABLE_SHIFT),
+		PAGE_DIRECTORY_SIZE = (1 << (32 - PAGE_SHIFT - PAGE_TABLE_SHIFT)),
+	};
+
+	enum : uint32
+	{
+		PAGE_ENTRY_EMPTY = ~0U,
+		PAGE_ENTRY_FULL = 0x80000000,
+		PAGE_ENTRY_INDEX_MASK = ~PAGE_ENTRY_FULL,
+	};
+
 	typedef std::vector<MEMORYMAPELEMENT> MemoryMapListType;
+	typedef std::unique_ptr<uint32[]> PageTablePtr;
+
+	//Every page entry holds the index of the element the old linear lookup would have
+	//started from. If that element covers the whole page, it is flagged as such and
+	//doesn't need to be checked again.
+	struct MEMORYMAP
+	{
+		MemoryMapListType elements;
+		std::array<PageTablePtr, PAGE_DIRECTORY_SIZE> pageTables;
+	};
 
-	static const MEMORYMAPELEMENT* GetMap(const MemoryMapListType&, uint32);
+	static const MEMORYMAPELEMENT* GetMap(const MEMORYMAP&, uint32);
 
-	MemoryMapListType m_instructionMap;
-	MemoryMapListType m_readMap;
-	MemoryMapListType m_writeMap;
+	MEMORYMAP m_instructionMap;
+	MEMORYMAP m_readMap;
+	MEMORYMAP m_writeMap;
 
 private:
-	static void InsertMap(MemoryMapListType&, uint32, uint32, void*, unsigned char);
-	static void InsertMap(MemoryMapListType&, uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	static void InsertMap(MEMORYMAP&, uint32, uint32, void*, unsigned char);
+	static void InsertMap(MEMORYMAP&, uint32, uint32, const MemoryMapHandlerType&, unsigned char);
+	static void InsertMap(MEMORYMAP&, uint32, uint32, MemoryMapRawHandlerType, void*, unsigned char);
+	static void InsertElement(MEMORYMAP&, const MEMORYMAPELEMENT&);
+	static const MEMORYMAPELEMENT* FindElement(const MEMORYMAP&, uint32, uint32);
+	static void SetMemoryAccessHandler(MEMORYMAP&, uint32, MemoryMapRawHandlerType, void*);
 };
 
 class CMemoryMap_LSBF : public CMemoryMap
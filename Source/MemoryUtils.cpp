@@ -36,12 +36,13 @@ uint64 MemoryUtils_GetDoubleProxy(CMIPS* context, uint32 vAddress)
 		switch(e->nType)
 		{
 		case CMemoryMap::MEMORYMAP_TYPE_MEMORY:
+			e->NotifyAccess(address);
 			result.q = *reinterpret_cast<uint64*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart));
 			break;
 		case CMemoryMap::MEMORYMAP_TYPE_FUNCTION:
 			for(unsigned int i = 0; i < 2; i++)
 			{
-				result.d[i] = e->handler(address + (i * 4), 0);
+				result.d[i] = e->CallHandler(address + (i * 4), 0);
 			}
 			break;
 		default:
@@ -66,12 +67,13 @@ uint128 MemoryUtils_GetQuadProxy(CMIPS* context, uint32 vAddress)
 		switch(e->nType)
 		{
 		case CMemoryMap::MEMORYMAP_TYPE_MEMORY:
+			e->NotifyAccess(address);
 			result = *reinterpret_cast<uint128*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart));
 			break;
 		case CMemoryMap::MEMORYMAP_TYPE_FUNCTION:
 			for(unsigned int i = 0; i < 4; i++)
 			{
-				result.nV[i] = e->handler(address + (i * 4), 0);
+				result.nV[i] = e->CallHandler(address + (i * 4), 0);
 			}
 			break;
 		default:
@@ -116,12 +118,13 @@ void MemoryUtils_SetDoubleProxy(CMIPS* context, uint64 value64, uint32 vAddress)
 	switch(e->nType)
 	{
 	case CMemoryMap::MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(address);
 		*reinterpret_cast<uint64*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart)) = value.q;
 		break;
 	case CMemoryMap::MEMORYMAP_TYPE_FUNCTION:
 		for(unsigned int i = 0; i < 2; i++)
 		{
-			e->handler(address + (i * 4), value.d[i]);
+			e->CallHandler(address + (i * 4), value.d[i]);
 		}
 		break;
 	default:
@@ -144,12 +147,13 @@ void MemoryUtils_SetQuadProxy(CMIPS* context, const uint128& value, uint32 vAddr
 	switch(e->nType)
 	{
 	case CMemoryMap::MEMORYMAP_TYPE_MEMORY:
+		e->NotifyAccess(address);
 		*reinterpret_cast<uint128*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart)) = value;
 		break;
 	case CMemoryMap::MEMORYMAP_TYPE_FUNCTION:
 		for(unsigned int i = 0; i < 4; i++)
 		{
-			e->handler(address + (i * 4), value.nV[i]);
+			e->CallHandler(address + (i * 4), value.nV[i]);
 		}
 		break;
 	default:
@@ -0,0 +1,484 @@
+#include "MipsInterpreter.h"
+#include "MemoryUtils.h"
+
+//Memory accesses mirror what the JIT emits: use the page lookup table when available
+//and fall back to the memory map proxies otherwise.
+
+template <typename ValueType>
+static ValueType* GetPageRef(CMIPS& context, uint32 address)
+{
+	if(context.m_pageLookup == nullptr) return nullptr;
+	auto page = reinterpret_cast<uint8*>(context.m_pageLookup[address / MIPS_PAGE_SIZE]);
+	if(page == nullptr) return nullptr;
+	return reinterpret_cast<ValueType*>(page + (address & (MIPS_PAGE_SIZE - sizeof(ValueType))));
+}
+
+static uint32 LoadByte(CMIPS& context, uint32 address)
+{
+	if(auto ref = GetPageRef<uint8>(context, address)) return *ref;
+	return MemoryUtils_GetByteProxy(&context, address);
+}
+
+static uint32 LoadHalf(CMIPS& context, uint32 address)
+{
+	if(auto ref = GetPageRef<uint16>(context, address)) return *ref;
+	return MemoryUtils_GetHalfProxy(&context, address);
+}
+
+static uint32 LoadWord(CMIPS& context, uint32 address)
+{
+	if(auto ref = GetPageRef<uint32>(context, address)) return *ref;
+	return MemoryUtils_GetWordProxy(&context, address);
+}
+
+static uint64 LoadDouble(CMIPS& context, uint32 address)
+{
+	if(auto ref = GetPageRef<uint64>(context, address)) return *ref;
+	return MemoryUtils_GetDoubleProxy(&context, address);
+}
+
+static void StoreByte(CMIPS& context, uint32 address, uint32 value)
+{
+	if(auto ref = GetPageRef<uint8>(context, address))
+	{
+		(*ref) = static_cast<uint8>(value);
+		return;
+	}
+	MemoryUtils_SetByteProxy(&context, value, address);
+}
+
+static void StoreHalf(CMIPS& context, uint32 address, uint32 value)
+{
+	if(auto ref = GetPageRef<uint16>(context, address))
+	{
+		(*ref) = static_cast<uint16>(value);
+		return;
+	}
+	MemoryUtils_SetHalfProxy(&context, value, address);
+}
+
+static void StoreWord(CMIPS& context, uint32 address, uint32 value)
+{
+	if(auto ref = GetPageRef<uint32>(context, address))
+	{
+		(*ref) = value;
+		return;
+	}
+	MemoryUtils_SetWordProxy(&context, value, address);
+}
+
+static void StoreDouble(CMIPS& context, uint32 address, uint64 value)
+{
+	if(auto ref = GetPageRef<uint64>(context, address))
+	{
+		(*ref) = value;
+		return;
+	}
+	MemoryUtils_SetDoubleProxy(&context, value, address);
+}
+
+//Writes a 32-bit result, sign extending it to 64-bits if needed
+static void SetGpr32(CMIPS& context, uint32 reg, uint32 value, MIPS_REGSIZE regSize)
+{
+	if(reg == 0) return;
+	auto& gpr = context.m_State.nGPR[reg];
+	gpr.nV[0] = value;
+	if(regSize == MIPS_REGSIZE_64)
+	{
+		gpr.nV[1] = (value & 0x80000000) ? 0xFFFFFFFF : 0;
+	}
+}
+
+static void SetGpr64(CMIPS& context, uint32 reg, uint64 value)
+{
+	if(reg == 0) return;
+	context.m_State.nGPR[reg].nD0 = value;
+}
+
+bool CMipsInterpreter::CanExecuteRange(CMIPS& context, uint32 begin, uint32 end)
+{
+#ifdef DEBUGGER_INCLUDED
+	//Breakpoints are only checked by compiled code
+	for(auto breakpointAddress : context.m_breakpoints)
+	{
+		if(breakpointAddress >= begin && breakpointAddress <= end) return false;
+	}
+#endif
+	auto regSize = context.m_pArch->GetRegSize();
+	for(uint32 address = begin; address <= end; address += 4)
+	{
+		uint32 opcode = context.m_pMemoryMap->GetInstruction(address);
+		if(!CanExecuteInstruction(opcode, regSize)) return false;
+	}
+	return true;
+}
+
+void CMipsInterpreter::ExecuteRange(CMIPS& context, uint32 begin, uint32 end)
+{
+	auto& state = context.m_State;
+	auto regSize = context.m_pArch->GetRegSize();
+
+	//nPC stays on the beginning of the block during execution, like compiled code
+	assert(state.nPC == begin);
+	for(uint32 address = begin; address <= end; address += 4)
+	{
+		uint32 opcode = context.m_pMemoryMap->GetInstruction(address);
+		if(!ExecuteInstruction(context, address, opcode, regSize)) break;
+	}
+
+	//Same as CBasicBlock::CompileEpilog
+	state.cycleQuota -= ((end - begin) / 4) + 1;
+	if(state.cycleQuota <= 0)
+	{
+		state.nHasException |= MIPS_EXECUTION_STATUS_QUOTADONE;
+	}
+
+	if(state.nDelayedJumpAddr != MIPS_INVALID_PC)
+	{
+		state.nPC = state.nDelayedJumpAddr;
+		state.nDelayedJumpAddr = MIPS_INVALID_PC;
+	}
+	else
+	{
+		state.nPC = end + 4;
+	}
+}
+
+bool CMipsInterpreter::CanExecuteInstruction(uint32 opcode, MIPS_REGSIZE regSize)
+{
+	uint32 rs = (opcode >> 21) & 0x1F;
+	uint32 rt = (opcode >> 16) & 0x1F;
+	bool is64 = (regSize == MIPS_REGSIZE_64);
+
+	if(opcode == 0) return true;
+
+	switch(opcode >> 26)
+	{
+	case 0x00:
+		//SPECIAL
+		switch(opcode & 0x3F)
+		{
+		case 0x00: //SLL
+		case 0x02: //SRL
+		case 0x03: //SRA
+		case 0x04: //SLLV
+		case 0x06: //SRLV
+		case 0x07: //SRAV
+		case 0x08: //JR
+		case 0x09: //JALR
+		case 0x21: //ADDU
+		case 0x23: //SUBU
+		case 0x24: //AND
+		case 0x25: //OR
+		case 0x26: //XOR
+		case 0x27: //NOR
+		case 0x2A: //SLT
+		case 0x2B: //SLTU
+			return true;
+		case 0x2D: //DADDU
+		case 0x38: //DSLL
+		case 0x3A: //DSRL
+		case 0x3B: //DSRA
+		case 0x3C: //DSLL32
+		case 0x3E: //DSRL32
+		case 0x3F: //DSRA32
+			return is64;
+		default:
+			return false;
+		}
+	case 0x01:
+		//REGIMM
+		return (rt <= 0x03); //BLTZ, BGEZ, BLTZL, BGEZL
+	case 0x02: //J
+	case 0x03: //JAL
+	case 0x04: //BEQ
+	case 0x05: //BNE
+	case 0x06: //BLEZ
+	case 0x07: //BGTZ
+	case 0x0A: //SLTI
+	case 0x0B: //SLTIU
+	case 0x0C: //ANDI
+	case 0x0D: //ORI
+	case 0x0E: //XORI
+	case 0x0F: //LUI
+	case 0x14: //BEQL
+	case 0x15: //BNEL
+	case 0x16: //BLEZL
+	case 0x17: //BGTZL
+	case 0x20: //LB
+	case 0x21: //LH
+	case 0x23: //LW
+	case 0x24: //LBU
+	case 0x25: //LHU
+	case 0x28: //SB
+	case 0x29: //SH
+	case 0x2B: //SW
+		return true;
+	case 0x09: //ADDIU
+		//ADDIU R0, R0, $x is used by the IOP for dynamic linking and raises a syscall
+		return !((rs == 0) && (rt == 0));
+	case 0x19: //DADDIU
+	case 0x37: //LD
+	case 0x3F: //SD
+		return is64;
+	default:
+		return false;
+	}
+}
+
+bool CMipsInterpreter::ExecuteInstruction(CMIPS& context, uint32 address, uint32 opcode, MIPS_REGSIZE regSize)
+{
+	auto& state = context.m_State;
+	auto& gpr = state.nGPR;
+
+	uint32 rs = (opcode >> 21) & 0x1F;
+	uint32 rt = (opcode >> 16) & 0x1F;
+	uint32 rd = (opcode >> 11) & 0x1F;
+	uint32 sa = (opcode >> 6) & 0x1F;
+	uint16 immediate = static_cast<uint16>(opcode & 0xFFFF);
+	uint32 memAddress = gpr[rs].nV[0] + static_cast<int16>(immediate);
+	uint32 branchTarget = (address + 4) + CMIPS::GetBranch(immediate);
+	bool is64 = (regSize == MIPS_REGSIZE_64);
+
+	//Used by branches to evaluate their condition
+	int64 rsValue = is64 ? static_cast<int64>(gpr[rs].nD0) : static_cast<int32>(gpr[rs].nV[0]);
+	int64 rtValue = is64 ? static_cast<int64>(gpr[rt].nD0) : static_cast<int32>(gpr[rt].nV[0]);
+	bool rsNegative = ((is64 ? gpr[rs].nV[1] : gpr[rs].nV[0]) & 0x80000000) != 0;
+
+	const auto branch =
+	    [&](bool condition, bool likely) {
+		    state.nDelayedJumpAddr = MIPS_INVALID_PC;
+		    if(condition)
+		    {
+			    state.nDelayedJumpAddr = branchTarget;
+		    }
+		    else if(likely)
+		    {
+			    //Skip delay slot
+			    state.nPC = address + 8;
+			    return false;
+		    }
+		    return true;
+	    };
+
+	if(opcode == 0) return true;
+
+	switch(opcode >> 26)
+	{
+	case 0x00:
+		//SPECIAL
+		switch(opcode & 0x3F)
+		{
+		case 0x00: //SLL
+			SetGpr32(context, rd, gpr[rt].nV[0] << sa, regSize);
+			break;
+		case 0x02: //SRL
+			SetGpr32(context, rd, gpr[rt].nV[0] >> sa, regSize);
+			break;
+		case 0x03: //SRA
+			SetGpr32(context, rd, static_cast<int32>(gpr[rt].nV[0]) >> sa, regSize);
+			break;
+		case 0x04: //SLLV
+			SetGpr32(context, rd, gpr[rt].nV[0] << (gpr[rs].nV[0] & 0x1F), regSize);
+			break;
+		case 0x06: //SRLV
+			SetGpr32(context, rd, gpr[rt].nV[0] >> (gpr[rs].nV[0] & 0x1F), regSize);
+			break;
+		case 0x07: //SRAV
+			SetGpr32(context, rd, static_cast<int32>(gpr[rt].nV[0]) >> (gpr[rs].nV[0] & 0x1F), regSize);
+			break;
+		case 0x08: //JR
+			state.nDelayedJumpAddr = gpr[rs].nV[0];
+			break;
+		case 0x09: //JALR
+			state.nDelayedJumpAddr = gpr[rs].nV[0];
+			if(rd != 0)
+			{
+				gpr[rd].nV[0] = address + 8;
+			}
+			break;
+		case 0x21: //ADDU
+			SetGpr32(context, rd, gpr[rs].nV[0] + gpr[rt].nV[0], regSize);
+			break;
+		case 0x23: //SUBU
+			SetGpr32(context, rd, gpr[rs].nV[0] - gpr[rt].nV[0], regSize);
+			break;
+		case 0x24: //AND
+			if(rd == 0) break;
+			gpr[rd].nV[0] = gpr[rs].nV[0] & gpr[rt].nV[0];
+			if(is64) gpr[rd].nV[1] = gpr[rs].nV[1] & gpr[rt].nV[1];
+			break;
+		case 0x25: //OR
+			if(rd == 0) break;
+			gpr[rd].nV[0] = gpr[rs].nV[0] | gpr[rt].nV[0];
+			if(is64) gpr[rd].nV[1] = gpr[rs].nV[1] | gpr[rt].nV[1];
+			break;
+		case 0x26: //XOR
+			if(rd == 0) break;
+			gpr[rd].nV[0] = gpr[rs].nV[0] ^ gpr[rt].nV[0];
+			if(is64) gpr[rd].nV[1] = gpr[rs].nV[1] ^ gpr[rt].nV[1];
+			break;
+		case 0x27: //NOR
+			if(rd == 0) break;
+			gpr[rd].nV[0] = ~(gpr[rs].nV[0] | gpr[rt].nV[0]);
+			if(is64) gpr[rd].nV[1] = ~(gpr[rs].nV[1] | gpr[rt].nV[1]);
+			break;
+		case 0x2A: //SLT
+			if(rd == 0) break;
+			gpr[rd].nV[0] = (rsValue < rtValue) ? 1 : 0;
+			if(is64) gpr[rd].nV[1] = 0;
+			break;
+		case 0x2B: //SLTU
+			if(rd == 0) break;
+			gpr[rd].nV[0] = (is64 ? (gpr[rs].nD0 < gpr[rt].nD0) : (gpr[rs].nV[0] < gpr[rt].nV[0])) ? 1 : 0;
+			if(is64) gpr[rd].nV[1] = 0;
+			break;
+		case 0x2D: //DADDU
+			SetGpr64(context, rd, gpr[rs].nD0 + gpr[rt].nD0);
+			break;
+		case 0x38: //DSLL
+			SetGpr64(context, rd, gpr[rt].nD0 << sa);
+			break;
+		case 0x3A: //DSRL
+			SetGpr64(context, rd, gpr[rt].nD0 >> sa);
+			break;
+		case 0x3B: //DSRA
+			SetGpr64(context, rd, static_cast<int64>(gpr[rt].nD0) >> sa);
+			break;
+		case 0x3C: //DSLL32
+			SetGpr64(context, rd, gpr[rt].nD0 << (sa + 32));
+			break;
+		case 0x3E: //DSRL32
+			SetGpr64(context, rd, gpr[rt].nD0 >> (sa + 32));
+			break;
+		case 0x3F: //DSRA32
+			SetGpr64(context, rd, static_cast<int64>(gpr[rt].nD0) >> (sa + 32));
+			break;
+		default:
+			assert(false);
+			break;
+		}
+		break;
+	case 0x01:
+		//REGIMM
+		switch(rt)
+		{
+		case 0x00: //BLTZ
+			return branch(rsNegative, false);
+		case 0x01: //BGEZ
+			return branch(!rsNegative, false);
+		case 0x02: //BLTZL
+			return branch(rsNegative, true);
+		case 0x03: //BGEZL
+			return branch(!rsNegative, true);
+		default:
+			assert(false);
+			break;
+		}
+		break;
+	case 0x02: //J
+		state.nDelayedJumpAddr = (address & 0xF0000000) | ((opcode & 0x03FFFFFF) << 2);
+		break;
+	case 0x03: //JAL
+		gpr[CMIPS::RA].nV[0] = address + 8;
+		state.nDelayedJumpAddr = (address & 0xF0000000) | ((opcode & 0x03FFFFFF) << 2);
+		break;
+	case 0x04: //BEQ
+		return branch(rsValue == rtValue, false);
+	case 0x05: //BNE
+		return branch(rsValue != rtValue, false);
+	case 0x06: //BLEZ
+		return branch(rsValue <= 0, false);
+	case 0x07: //BGTZ
+		return branch(rsValue > 0, false);
+	case 0x09: //ADDIU
+		SetGpr32(context, rt, gpr[rs].nV[0] + static_cast<int16>(immediate), regSize);
+		break;
+	case 0x0A: //SLTI
+		if(rt == 0) break;
+		gpr[rt].nV[0] = (rsValue < static_cast<int16>(immediate)) ? 1 : 0;
+		if(is64) gpr[rt].nV[1] = 0;
+		break;
+	case 0x0B: //SLTIU
+		if(rt == 0) break;
+		if(is64)
+		{
+			gpr[rt].nV[0] = (gpr[rs].nD0 < static_cast<uint64>(static_cast<int64>(static_cast<int16>(immediate)))) ? 1 : 0;
+			gpr[rt].nV[1] = 0;
+		}
+		else
+		{
+			gpr[rt].nV[0] = (gpr[rs].nV[0] < static_cast<uint32>(static_cast<int16>(immediate))) ? 1 : 0;
+		}
+		break;
+	case 0x0C: //ANDI
+		if(rt == 0) break;
+		gpr[rt].nV[0] = gpr[rs].nV[0] & immediate;
+		if(is64) gpr[rt].nV[1] = 0;
+		break;
+	case 0x0D: //ORI
+		if(rt == 0) break;
+		gpr[rt].nV[0] = gpr[rs].nV[0] | immediate;
+		if(is64) gpr[rt].nV[1] = gpr[rs].nV[1];
+		break;
+	case 0x0E: //XORI
+		if(rt == 0) break;
+		gpr[rt].nV[0] = gpr[rs].nV[0] ^ immediate;
+		if(is64) gpr[rt].nV[1] = gpr[rs].nV[1];
+		break;
+	case 0x0F: //LUI
+		SetGpr32(context, rt, immediate << 16, regSize);
+		break;
+	case 0x14: //BEQL
+		return branch(rsValue == rtValue, true);
+	case 0x15: //BNEL
+		return branch(rsValue != rtValue, true);
+	case 0x16: //BLEZL
+		return branch(rsValue <= 0, true);
+	case 0x17: //BGTZL
+		return branch(rsValue > 0, true);
+	case 0x19: //DADDIU
+		SetGpr64(context, rt, gpr[rs].nD0 + static_cast<int64>(static_cast<int16>(immediate)));
+		break;
+	case 0x20: //LB
+		if(rt == 0) break;
+		SetGpr32(context, rt, static_cast<int8>(LoadByte(context, memAddress)), regSize);
+		break;
+	case 0x21: //LH
+		if(rt == 0) break;
+		SetGpr32(context, rt, static_cast<int16>(LoadHalf(context, memAddress)), regSize);
+		break;
+	case 0x23: //LW
+		if(rt == 0) break;
+		SetGpr32(context, rt, LoadWord(context, memAddress), regSize);
+		break;
+	case 0x24: //LBU
+		if(rt == 0) break;
+		SetGpr32(context, rt, LoadByte(context, memAddress), regSize);
+		break;
+	case 0x25: //LHU
+		if(rt == 0) break;
+		SetGpr32(context, rt, LoadHalf(context, memAddress), regSize);
+		break;
+	case 0x28: //SB
+		StoreByte(context, memAddress, gpr[rt].nV[0]);
+		break;
+	case 0x29: //SH
+		StoreHalf(context, memAddress, gpr[rt].nV[0]);
+		break;
+	case 0x2B: //SW
+		StoreWord(context, memAddress, gpr[rt].nV[0]);
+		break;
+	case 0x37: //LD
+		if(rt == 0) break;
+		SetGpr64(context, rt, LoadDouble(context, memAddress));
+		break;
+	case 0x3F: //SD
+		StoreDouble(context, memAddress, gpr[rt].nD0);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+	return true;
+}
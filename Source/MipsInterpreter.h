@@ -0,0 +1,18 @@
+#pragma once
+
+#include "MIPS.h"
+
+//Lightweight interpreter used to run basic blocks while they are waiting to be compiled.
+//Only handles a subset of the integer instruction set. Blocks that contain anything else
+//must be compiled before being executed.
+class CMipsInterpreter
+{
+public:
+	static bool CanExecuteRange(CMIPS&, uint32, uint32);
+	static void ExecuteRange(CMIPS&, uint32, uint32);
+
+private:
+	static bool CanExecuteInstruction(uint32, MIPS_REGSIZE);
+	//Returns false if execution of the range must stop (branch likely not taken)
+	static bool ExecuteInstruction(CMIPS&, uint32, uint32, MIPS_REGSIZE);
+};
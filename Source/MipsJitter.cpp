@@ -70,6 +70,8 @@ void CMipsJitter::MarkFinalBlockLabel()
 	if(m_lastBlockLabel != -1)
 	{
 		MarkLabel(m_lastBlockLabel);
+		//Blocks compiled after this one in the same unit will need their own label
+		m_lastBlockLabel = -1;
 	}
 }
 
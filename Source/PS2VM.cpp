@@ -9,12 +9,14 @@
 #include "PS2VM_Preferences.h"
 #include "ee/PS2OS.h"
 #include "ee/EeExecutor.h"
+#include "BlockCompileQueue.h"
 #include "Ps2Const.h"
 #include "iop/Iop_SifManPs2.h"
 #include "StdStream.h"
 #include "StdStreamUtils.h"
 #include "GZipStream.h"
 #include "states/MemoryStateFile.h"
+#include "MemStream.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
 #include "xml/Node.h"
@@ -39,6 +41,17 @@
 #define ONSCREEN_TICKS (FRAME_TICKS * 9 / 10)
 #define VBLANK_TICKS (FRAME_TICKS / 10)
 
+//EE ticks executed between two synchronization points with the IOP
+#define DEFAULT_TICK_STEP (4800)
+#define MIN_TICK_STEP (480)
+#define MAX_TICK_STEP (48000)
+//Longest slice used when both CPUs are idle
+#define MAX_IDLE_TICK_STEP (MAX_TICK_STEP)
+
+//Frames between two rewind states and memory budget (in megabytes) of the rewind buffer
+#define DEFAULT_REWIND_INTERVAL (30)
+#define DEFAULT_REWIND_MEMORYBUDGET (256)
+
 namespace filesystem = boost::filesystem;
 
 CPS2VM::CPS2VM()
@@ -49,17 +62,24 @@ CPS2VM::CPS2VM()
     , m_singleStepIop(false)
     , m_singleStepVu0(false)
     , m_singleStepVu1(false)
-    , m_vblankTicks(0)
     , m_inVblank(false)
     , m_eeExecutionTicks(0)
     , m_iopExecutionTicks(0)
-    , m_spuUpdateTicks(SPU_UPDATE_TICKS)
     , m_eeProfilerZone(CProfiler::GetInstance().RegisterZone("EE"))
     , m_iopProfilerZone(CProfiler::GetInstance().RegisterZone("IOP"))
+    , m_iopSyncProfilerZone(CProfiler::GetInstance().RegisterZone("IOPSYNC"))
+    , m_vu1SyncProfilerZone(CProfiler::GetInstance().RegisterZone("VU1SYNC"))
     , m_spuProfilerZone(CProfiler::GetInstance().RegisterZone("SPU"))
     , m_gsSyncProfilerZone(CProfiler::GetInstance().RegisterZone("GSSYNC"))
     , m_otherProfilerZone(CProfiler::GetInstance().RegisterZone("OTHER"))
+    , m_rewindProfilerZone(CProfiler::GetInstance().RegisterZone("REWIND"))
+    , m_iopThread(std::bind(&CPS2VM::ExecuteIop, this), std::bind(&CPS2VM::InitIopThread, this))
 {
+	m_vblankEvent = m_scheduler.RegisterEvent("VBLANK", [this]() { OnVBlankEvent(); });
+	m_spuUpdateEvent = m_scheduler.RegisterEvent("SPUUPDATE", [this]() { OnSpuUpdateEvent(); });
+	m_scheduler.Schedule(m_vblankEvent, 0);
+	m_scheduler.Schedule(m_spuUpdateEvent, 0);
+
 	static const std::pair<const char*, const char*> basicDirectorySettings[] =
 	    {
 	        std::make_pair(PREF_PS2_HOST_DIRECTORY, PREF_PS2_HOST_DIRECTORY_DEFAULT),
@@ -91,10 +111,71 @@ CPS2VM::CPS2VM()
 	auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
 
 	m_ee = std::make_unique<Ee::CSubSystem>(m_iop->m_ram, *iopOs);
+	m_ee->m_sif.SetIopSyncHandler(std::bind(&CCoprocessorThread::SyncFromEe, &m_iopThread));
 	m_OnRequestLoadExecutableConnection = m_ee->m_os->OnRequestLoadExecutable.Connect(std::bind(&CPS2VM::ReloadExecutable, this, std::placeholders::_1, std::placeholders::_2));
+	m_OnExecutableChangeConnection = m_ee->m_os->OnExecutableChange.Connect(std::bind(&CPS2VM::OnEeExecutableChange, this));
+	m_OnExecutableUnloadingConnection = m_ee->m_os->OnExecutableUnloading.Connect(std::bind(&CPS2VM::OnEeExecutableUnloading, this));
 
 	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT, 100);
 	m_spuBlockCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT);
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_AUDIO_SPUMIXTHREAD_ENABLED, false);
+	if(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_AUDIO_SPUMIXTHREAD_ENABLED))
+	{
+		m_spuMixer = std::make_unique<Iop::CSpuMixer>(m_iop->m_spuCore0, m_iop->m_spuCore1, m_iop->m_spuRam, PS2::SPU_RAM_SIZE);
+		m_iop->SetSpuMixer(m_spuMixer.get());
+	}
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_EE_JITCACHE_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_EE_ASYNCJIT_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_EE_ASYNCJIT_WORKERCOUNT, 2);
+	if(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_EE_ASYNCJIT_ENABLED))
+	{
+		auto workerCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_EE_ASYNCJIT_WORKERCOUNT);
+		CBlockCompileQueue::GetInstance().SetWorkerCount(std::max(workerCount, 1));
+		m_ee->SetAsyncCompileEnabled(true);
+	}
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_EE_HOTTRACE_ENABLED, false);
+	m_ee->SetHotTraceEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_EE_HOTTRACE_ENABLED));
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_EE_IDLELOOPDETECTION_ENABLED, false);
+	m_ee->SetIdleLoopDetectionEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_EE_IDLELOOPDETECTION_ENABLED));
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_VU_JITCACHE_ENABLED, false);
+
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_IOP_THREADMODE, CCoprocessorThread::MODE_SERIAL);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_IOP_SYNCWINDOW, DEFAULT_TICK_STEP);
+	{
+		auto threadMode = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_IOP_THREADMODE);
+		if((threadMode == CCoprocessorThread::MODE_THREADED) || (threadMode == CCoprocessorThread::MODE_DETERMINISTIC))
+		{
+			m_iopThread.SetMode(static_cast<CCoprocessorThread::MODE>(threadMode));
+		}
+		auto tickStep = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_IOP_SYNCWINDOW);
+		//Keep a multiple of 8 to keep the EE/IOP clock ratio exact
+		m_tickStep = std::min<int>(std::max<int>(tickStep, MIN_TICK_STEP), MAX_TICK_STEP) & ~7;
+	}
+
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_VU1_THREADMODE, CCoprocessorThread::MODE_SERIAL);
+	{
+		auto threadMode = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_VU1_THREADMODE);
+		if((threadMode == CCoprocessorThread::MODE_THREADED) || (threadMode == CCoprocessorThread::MODE_DETERMINISTIC))
+		{
+			m_ee->m_vpu1->SetThreadMode(static_cast<CCoprocessorThread::MODE>(threadMode));
+		}
+	}
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_REWIND_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_INTERVAL, DEFAULT_REWIND_INTERVAL);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET, DEFAULT_REWIND_MEMORYBUDGET);
+	if(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_REWIND_ENABLED))
+	{
+		//Budget is in megabytes
+		auto memoryBudget = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET), 1);
+		m_rewindBuffer = std::make_unique<CRewindBuffer>(static_cast<size_t>(memoryBudget) * 0x100000);
+		m_rewindInterval = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_INTERVAL), 1);
+	}
 }
 
 //////////////////////////////////////////////////
@@ -226,6 +307,21 @@ void CPS2VM::DumpEEDmacHandlers()
 	m_ee->m_os->DumpDmacHandlers();
 }
 
+void CPS2VM::DumpEETraceProfile()
+{
+	m_mailBox.SendCall([this]() { m_ee->DumpTraceProfile(); }, true);
+}
+
+void CPS2VM::DumpEEPageFaultStats()
+{
+	m_mailBox.SendCall([this]() { m_ee->DumpPageFaultStats(); }, true);
+}
+
+void CPS2VM::DumpEEIdleLoops()
+{
+	m_mailBox.SendCall([this]() { m_ee->DumpIdleLoops(); }, true);
+}
+
 void CPS2VM::Initialize()
 {
 	CreateVM();
@@ -237,6 +333,7 @@ void CPS2VM::Destroy()
 {
 	m_mailBox.SendCall(std::bind(&CPS2VM::DestroyImpl, this));
 	m_thread.join();
+	WaitForStateWrite();
 	DestroyVM();
 }
 
@@ -257,8 +354,18 @@ std::future<bool> CPS2VM::SaveState(const filesystem::path& statePath)
 	auto future = promise->get_future();
 	m_mailBox.SendCall(
 	    [this, promise, statePath]() {
-		    auto result = SaveVMState(statePath);
-		    promise->set_value(result);
+		    SaveVMState(statePath, false, promise);
+	    });
+	return future;
+}
+
+std::future<bool> CPS2VM::SaveIncrementalState(const filesystem::path& statePath)
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, statePath]() {
+		    SaveVMState(statePath, true, promise);
 	    });
 	return future;
 }
@@ -275,6 +382,18 @@ std::future<bool> CPS2VM::LoadState(const filesystem::path& statePath)
 	return future;
 }
 
+std::future<bool> CPS2VM::Rewind()
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise]() {
+		    auto result = RewindVMState();
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
 void CPS2VM::TriggerFrameDump(const FrameDumpCallback& frameDumpCallback)
 {
 	m_mailBox.SendCall(
@@ -291,6 +410,29 @@ CPS2VM::CPU_UTILISATION_INFO CPS2VM::GetCpuUtilisationInfo() const
 	return m_cpuUtilisation;
 }
 
+CPS2VM::CODE_ARENA_INFO CPS2VM::GetCodeArenaInfo() const
+{
+	CODE_ARENA_INFO result;
+	result.ee = m_ee->GetEeCodeArenaStats();
+	result.vu0 = m_ee->GetVuCodeArenaStats(0);
+	result.vu1 = m_ee->GetVuCodeArenaStats(1);
+	result.iop = m_iop->GetCodeArenaStats();
+	return result;
+}
+
+CPS2VM::VU_CACHE_INFO CPS2VM::GetVuCacheInfo() const
+{
+	VU_CACHE_INFO result;
+	result.vu0 = m_ee->GetVuMicroprogramCacheStats(0);
+	result.vu1 = m_ee->GetVuMicroprogramCacheStats(1);
+	return result;
+}
+
+CJitBlockCache::STATS CPS2VM::GetEeBlockCacheStats() const
+{
+	return m_eeBlockCache.GetStats();
+}
+
 #ifdef DEBUGGER_INCLUDED
 
 #define TAGS_SECTION_TAGS ("tags")
@@ -380,6 +522,15 @@ void CPS2VM::ResetVM()
 {
 	m_ee->Reset();
 	m_iop->Reset();
+	if(m_spuMixer)
+	{
+		m_spuMixer->Resync();
+	}
+	if(m_rewindBuffer)
+	{
+		m_rewindBuffer->Clear();
+		m_rewindFrameCount = 0;
+	}
 
 	//LoadBIOS();
 
@@ -392,7 +543,9 @@ void CPS2VM::ResetVM()
 		auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
 		assert(iopOs);
 
-		iopOs->Reset(std::make_shared<Iop::CSifManPs2>(m_ee->m_sif, m_ee->m_ram, m_iop->m_ram));
+		auto sifMan = std::make_shared<Iop::CSifManPs2>(m_ee->m_sif, m_ee->m_ram, m_iop->m_ram);
+		sifMan->SetEeSyncHandler(std::bind(&CCoprocessorThread::SyncFromCoprocessor, &m_iopThread));
+		iopOs->Reset(sifMan);
 
 		iopOs->GetIoman()->RegisterDevice("host", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_HOST_DIRECTORY)));
 		iopOs->GetIoman()->RegisterDevice("mc0", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_MC0_DIRECTORY)));
@@ -405,13 +558,14 @@ void CPS2VM::ResetVM()
 
 	CDROM0_SyncPath();
 
-	m_vblankTicks = ONSCREEN_TICKS;
 	m_inVblank = false;
+	m_scheduler.Reset();
+	m_scheduler.Schedule(m_vblankEvent, ONSCREEN_TICKS);
+	m_scheduler.Schedule(m_spuUpdateEvent, SPU_UPDATE_TICKS * 8);
 
 	m_eeExecutionTicks = 0;
 	m_iopExecutionTicks = 0;
 
-	m_spuUpdateTicks = SPU_UPDATE_TICKS;
 	m_currentSpuBlock = 0;
 
 	RegisterModulesInPadHandler();
@@ -422,31 +576,95 @@ void CPS2VM::DestroyVM()
 	CDROM0_Reset();
 }
 
-bool CPS2VM::SaveVMState(const filesystem::path& statePath)
+void CPS2VM::SaveVMState(const filesystem::path& statePath, bool incremental, const StatePromisePtr& promise)
 {
 	if(m_ee->m_gs == NULL)
 	{
 		printf("PS2VM: GS Handler was not instancied. Cannot save state.\r\n");
-		return false;
+		promise->set_value(false);
+		return;
 	}
 
-	try
+	//Snapshots can't be captured again before they are written
+	WaitForStateWrite();
+
+	//The base state is about to be replaced, the new state must be complete
+	if(m_baseStatePath.empty() || (m_baseStatePath == statePath))
 	{
-		auto stateStream = Framework::CreateOutputStdStream(statePath.native());
-		Framework::CZipArchiveWriter archive;
+		incremental = false;
+	}
 
-		m_ee->SaveState(archive);
-		m_iop->SaveState(archive);
-		m_ee->m_gs->SaveState(archive);
+	auto& snapshot = incremental ? m_stateSnapshot : m_baseStateSnapshot;
+	filesystem::path baseStatePath;
+	filesystem::path baseStateCopyPath;
+	if(incremental)
+	{
+		baseStatePath = m_baseStatePath;
+		baseStateCopyPath = GetBaseStatePath(statePath, m_baseStateSnapshot.GetId());
+	}
+	else
+	{
+		m_baseStatePath.clear();
+	}
 
-		archive.Write(stateStream);
+	try
+	{
+		auto stateStream = std::make_shared<Framework::CStdStream>(Framework::CreateOutputStdStream(statePath.native()));
+		snapshot.Capture(
+		    [this](Framework::CZipArchiveWriter& archive) {
+			    m_ee->SaveState(archive);
+			    m_iop->SaveState(archive);
+			    m_ee->m_gs->SaveState(archive);
+		    },
+		    incremental ? &m_baseStateSnapshot : nullptr);
+
+		//Compression and writing is done while emulation continues
+		m_stateWriteFuture = std::async(std::launch::async,
+		                                [&snapshot, stateStream, promise, baseStatePath, baseStateCopyPath]() mutable {
+			                                bool result = true;
+			                                try
+			                                {
+				                                if(!baseStateCopyPath.empty() && !filesystem::exists(baseStateCopyPath))
+				                                {
+					                                filesystem::copy_file(baseStatePath, baseStateCopyPath);
+				                                }
+				                                snapshot.Write(*stateStream);
+			                                }
+			                                catch(...)
+			                                {
+				                                result = false;
+			                                }
+			                                //Make sure the file is closed before reporting completion
+			                                stateStream.reset();
+			                                promise->set_value(result);
+			                                return result;
+		                                });
+		if(!incremental)
+		{
+			m_pendingBaseStatePath = statePath;
+		}
 	}
 	catch(...)
 	{
-		return false;
+		promise->set_value(false);
+	}
+}
+
+void CPS2VM::WaitForStateWrite()
+{
+	if(!m_stateWriteFuture.valid()) return;
+	bool result = m_stateWriteFuture.get();
+	if(result && !m_pendingBaseStatePath.empty())
+	{
+		m_baseStatePath = m_pendingBaseStatePath;
 	}
+	m_pendingBaseStatePath.clear();
+}
 
-	return true;
+filesystem::path CPS2VM::GetBaseStatePath(const filesystem::path& statePath, uint64 baseStateId)
+{
+	auto baseStateFileName = string_format("base_%016llx.zip", static_cast<unsigned long long>(baseStateId));
+	return statePath.parent_path() / baseStateFileName;
 }
 
 bool CPS2VM::LoadVMState(const filesystem::path& statePath)
@@ -462,17 +680,23 @@ bool CPS2VM::LoadVMState(const filesystem::path& statePath)
 		auto stateStream = Framework::CreateInputStdStream(statePath.native());
 		Framework::CZipArchiveReader archive(stateStream);
 
-		try
+		auto baseStateId = CStateSnapshot::GetBaseStateId(archive);
+		if(baseStateId != 0)
 		{
-			m_ee->LoadState(archive);
-			m_iop->LoadState(archive);
-			m_ee->m_gs->LoadState(archive);
+			//Incremental state, rebuild the complete state with its base
+			auto baseStatePath = GetBaseStatePath(statePath, baseStateId);
+			auto baseStateStream = Framework::CreateInputStdStream(baseStatePath.native());
+			Framework::CZipArchiveReader baseArchive(baseStateStream);
+
+			Framework::CMemStream completeStateStream;
+			CStateSnapshot::ExpandIncrementalState(archive, baseArchive, completeStateStream);
+			completeStateStream.Seek(0, Framework::STREAM_SEEK_SET);
+			Framework::CZipArchiveReader completeArchive(completeStateStream);
+			LoadVMState(completeArchive);
 		}
-		catch(...)
+		else
 		{
-			//Any error that occurs in the previous block is critical
-			PauseImpl();
-			throw;
+			LoadVMState(archive);
 		}
 	}
 	catch(...)
@@ -485,6 +709,79 @@ bool CPS2VM::LoadVMState(const filesystem::path& statePath)
 	return true;
 }
 
+void CPS2VM::LoadVMState(Framework::CZipArchiveReader& archive)
+{
+	try
+	{
+		m_ee->LoadState(archive);
+		m_iop->LoadState(archive);
+		m_ee->m_gs->LoadState(archive);
+		if(m_spuMixer)
+		{
+			m_spuMixer->Resync();
+		}
+	}
+	catch(...)
+	{
+		//Any error that occurs in the previous block is critical
+		PauseImpl();
+		throw;
+	}
+}
+
+void CPS2VM::CaptureRewindState()
+{
+	if(m_ee->m_gs == NULL) return;
+
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_rewindProfilerZone);
+#endif
+
+	try
+	{
+		m_rewindBuffer->Capture(
+		    [this](Framework::CZipArchiveWriter& archive) {
+			    m_ee->SaveState(archive);
+			    m_iop->SaveState(archive);
+			    m_ee->m_gs->SaveState(archive);
+		    });
+	}
+	catch(...)
+	{
+		m_rewindBuffer->Clear();
+	}
+}
+
+bool CPS2VM::RewindVMState()
+{
+	if(!m_rewindBuffer || (m_ee->m_gs == NULL))
+	{
+		return false;
+	}
+
+	bool result = false;
+	try
+	{
+		result = m_rewindBuffer->Rewind(
+		    [this](Framework::CZipArchiveReader& archive) {
+			    LoadVMState(archive);
+		    });
+	}
+	catch(...)
+	{
+		m_rewindBuffer->Clear();
+		return false;
+	}
+
+	m_rewindFrameCount = 0;
+	if(result)
+	{
+		OnMachineStateChange();
+	}
+
+	return result;
+}
+
 void CPS2VM::PauseImpl()
 {
 	m_nStatus = PAUSED;
@@ -577,6 +874,113 @@ void CPS2VM::OnGsNewFrame()
 #endif
 }
 
+void CPS2VM::OnVBlankEvent()
+{
+	m_inVblank = !m_inVblank;
+	if(m_inVblank)
+	{
+		m_scheduler.Reschedule(m_vblankEvent, VBLANK_TICKS);
+		m_ee->NotifyVBlankStart();
+		m_iop->NotifyVBlankStart();
+
+		if(m_ee->m_gs != NULL)
+		{
+#ifdef PROFILE
+			CProfilerZone profilerZone(m_gsSyncProfilerZone);
+#endif
+			m_ee->m_gs->SetVBlank();
+		}
+
+		if(m_pad != NULL)
+		{
+			m_pad->Update(m_ee->m_ram);
+		}
+
+		if(m_rewindBuffer && (++m_rewindFrameCount >= m_rewindInterval))
+		{
+			CaptureRewindState();
+			m_rewindFrameCount = 0;
+		}
+#ifdef PROFILE
+		{
+			auto iopThreadStats = m_iopThread.GetStats();
+			m_cpuUtilisation.eeSyncCount = iopThreadStats.eeSyncCount;
+			m_cpuUtilisation.iopSyncCount = iopThreadStats.coprocessorSyncCount;
+			m_iopThread.ResetStats();
+
+			auto vu1ThreadStats = m_ee->m_vpu1->GetThreadStats();
+			m_cpuUtilisation.vu1SyncCount = vu1ThreadStats.eeSyncCount;
+			m_cpuUtilisation.vu1RunTime = vu1ThreadStats.sliceTime;
+			m_cpuUtilisation.vu1WaitTime = vu1ThreadStats.eeWaitTime;
+			m_ee->m_vpu1->ResetThreadStats();
+
+			if(m_spuMixer)
+			{
+				auto spuMixerStats = m_spuMixer->GetStats();
+				m_cpuUtilisation.spuUnderrunCount = spuMixerStats.underrunCount;
+				m_cpuUtilisation.spuMixTime = spuMixerStats.mixTime;
+				m_cpuUtilisation.spuMaxLatency = spuMixerStats.maxLatency;
+				m_spuMixer->ResetStats();
+			}
+
+			CProfiler::GetInstance().CountCurrentZone();
+			auto stats = CProfiler::GetInstance().GetStats();
+			ProfileFrameDone(stats);
+			CProfiler::GetInstance().Reset();
+		}
+
+		m_cpuUtilisation = CPU_UTILISATION_INFO();
+#endif
+
+		VBlankStart();
+	}
+	else
+	{
+		m_scheduler.Reschedule(m_vblankEvent, ONSCREEN_TICKS);
+		m_ee->NotifyVBlankEnd();
+		m_iop->NotifyVBlankEnd();
+		if(m_ee->m_gs != NULL)
+		{
+			m_ee->m_gs->ResetVBlank();
+		}
+	}
+}
+
+void CPS2VM::OnSpuUpdateEvent()
+{
+	UpdateSpu();
+	//Update rate is based on IOP time, EE CPU is 8 times faster than the IOP CPU
+	m_scheduler.Reschedule(m_spuUpdateEvent, SPU_UPDATE_TICKS * 8);
+}
+
+int CPS2VM::GetSliceTicks()
+{
+	int sliceTicks = m_tickStep;
+
+	//Idle stretches run in one slice, up to the next device event that could wake up a CPU.
+	//The IOP needs to run on this thread to be able to tell whether it's still idle.
+	bool singleStep = m_singleStepEe || m_singleStepIop || m_singleStepVu0 || m_singleStepVu1;
+	if(
+	    !singleStep &&
+	    (m_iopThread.GetMode() == CCoprocessorThread::MODE_SERIAL) &&
+	    m_ee->IsCpuIdle() && m_iop->IsCpuIdle())
+	{
+		uint64 idleTicks = std::min<uint64>(m_ee->GetTicksUntilNextEvent(), m_iop->GetTicksUntilNextEvent() * 8);
+		idleTicks = std::min<uint64>(idleTicks, MAX_IDLE_TICK_STEP);
+		sliceTicks = std::max<int>(sliceTicks, static_cast<int>(idleTicks));
+	}
+
+	//Stop at the next scheduled event
+	uint64 eventTicks = m_scheduler.GetTicksUntilNextEvent();
+	if(eventTicks < static_cast<uint64>(sliceTicks))
+	{
+		sliceTicks = static_cast<int>(eventTicks);
+	}
+
+	//Keep a multiple of 8 to keep the EE/IOP clock ratio exact
+	return std::max<int>(sliceTicks & ~7, 8);
+}
+
 void CPS2VM::UpdateEe()
 {
 #ifdef PROFILE
@@ -602,16 +1006,37 @@ void CPS2VM::UpdateEe()
 
 		m_eeExecutionTicks -= executed;
 		m_ee->CountTicks(executed);
-		m_vblankTicks -= executed;
+		m_scheduler.AdvanceTime(executed);
 
 #ifdef DEBUGGER_INCLUDED
 		if(m_singleStepEe) break;
 		if(m_ee->m_EE.m_executor->MustBreak()) break;
 #endif
 	}
+
+	{
+#ifdef PROFILE
+		CProfilerZone profilerZone(m_vu1SyncProfilerZone);
+#endif
+		m_ee->m_vpu1->FinishMicroProgram();
+	}
 }
 
 void CPS2VM::UpdateIop()
+{
+	ExecuteIop();
+}
+
+void CPS2VM::InitIopThread()
+{
+	fesetround(FE_TOWARDZERO);
+	CProfiler::GetInstance().SetThreadName("IOP");
+	//IOP writes to EE RAM that is protected by the EE executor
+	static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->AttachExceptionHandlerToThread();
+}
+
+//Might be called from the IOP thread
+void CPS2VM::ExecuteIop()
 {
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_iopProfilerZone);
@@ -632,7 +1057,6 @@ void CPS2VM::UpdateIop()
 #endif
 
 		m_iopExecutionTicks -= executed;
-		m_spuUpdateTicks -= executed;
 		m_iop->CountTicks(executed);
 
 #ifdef DEBUGGER_INCLUDED
@@ -648,35 +1072,54 @@ void CPS2VM::UpdateSpu()
 	CProfilerZone profilerZone(m_spuProfilerZone);
 #endif
 
-	unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
-	int16* samplesSpu0 = m_samples + blockOffset;
-
-	m_iop->m_spuCore0.Render(samplesSpu0, BLOCK_SIZE, DST_SAMPLE_RATE);
-
-	if(m_iop->m_spuCore1.IsEnabled())
+	if(m_spuMixer)
 	{
-		int16 samplesSpu1[BLOCK_SIZE];
-		m_iop->m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, DST_SAMPLE_RATE);
+		//Only update the state visible to the IOP, samples are mixed on the mixer thread
+		m_iop->m_spuCore0.Render(nullptr, BLOCK_SIZE, DST_SAMPLE_RATE);
+		if(m_iop->m_spuCore1.IsEnabled())
+		{
+			m_iop->m_spuCore1.Render(nullptr, BLOCK_SIZE, DST_SAMPLE_RATE);
+		}
+		m_spuMixer->Render(BLOCK_SIZE, DST_SAMPLE_RATE);
+	}
+	else
+	{
+		unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
+		int16* samplesSpu0 = m_samples + blockOffset;
+
+		m_iop->m_spuCore0.Render(samplesSpu0, BLOCK_SIZE, DST_SAMPLE_RATE);
 
-		for(unsigned int i = 0; i < BLOCK_SIZE; i++)
+		if(m_iop->m_spuCore1.IsEnabled())
 		{
-			int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
-			resultSample = std::max<int32>(resultSample, SHRT_MIN);
-			resultSample = std::min<int32>(resultSample, SHRT_MAX);
-			samplesSpu0[i] = static_cast<int16>(resultSample);
+			int16 samplesSpu1[BLOCK_SIZE];
+			m_iop->m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, DST_SAMPLE_RATE);
+
+			for(unsigned int i = 0; i < BLOCK_SIZE; i++)
+			{
+				int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
+				resultSample = std::max<int32>(resultSample, SHRT_MIN);
+				resultSample = std::min<int32>(resultSample, SHRT_MAX);
+				samplesSpu0[i] = static_cast<int16>(resultSample);
+			}
 		}
 	}
 
 	m_currentSpuBlock++;
 	if(m_currentSpuBlock == m_spuBlockCount)
 	{
-		if(m_soundHandler)
+		unsigned int sampleCount = BLOCK_SIZE * m_spuBlockCount;
+		if(m_spuMixer)
+		{
+			//The mixer lags behind the emulation, hand over whatever it has produced so far
+			sampleCount = m_spuMixer->ReadSamples(m_samples, sampleCount);
+		}
+		if(m_soundHandler && (sampleCount != 0))
 		{
 			if(m_soundHandler->HasFreeBuffers())
 			{
 				m_soundHandler->RecycleBuffers();
 			}
-			m_soundHandler->Write(m_samples, BLOCK_SIZE * m_spuBlockCount, DST_SAMPLE_RATE);
+			m_soundHandler->Write(m_samples, sampleCount, DST_SAMPLE_RATE);
 		}
 		m_currentSpuBlock = 0;
 	}
@@ -733,14 +1176,67 @@ void CPS2VM::RegisterModulesInPadHandler()
 
 void CPS2VM::ReloadExecutable(const char* executablePath, const CPS2OS::ArgumentList& arguments)
 {
+	m_iopThread.SyncFromEe();
 	ResetVM();
 	m_ee->m_os->BootFromVirtualPath(executablePath, arguments);
 }
 
+#define JITCACHE_PATH ("jitcache/")
+
+boost::filesystem::path CPS2VM::GetEeBlockCachePath() const
+{
+	auto cacheDirectoryPath = CAppConfig::GetBasePath() / boost::filesystem::path(JITCACHE_PATH);
+	Framework::PathUtils::EnsurePathExists(cacheDirectoryPath);
+	auto cacheFileName = std::string(m_ee->m_os->GetExecutableName()) + ".jitcache";
+	return cacheDirectoryPath / boost::filesystem::path(cacheFileName);
+}
+
+boost::filesystem::path CPS2VM::GetVuBlockCachePath(unsigned int vuNumber) const
+{
+	auto cacheDirectoryPath = CAppConfig::GetBasePath() / boost::filesystem::path(JITCACHE_PATH);
+	Framework::PathUtils::EnsurePathExists(cacheDirectoryPath);
+	auto cacheFileName = string_format("%s.vu%d.jitcache", m_ee->m_os->GetExecutableName(), vuNumber);
+	return cacheDirectoryPath / boost::filesystem::path(cacheFileName);
+}
+
+void CPS2VM::OnEeExecutableChange()
+{
+	if(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_VU_JITCACHE_ENABLED))
+	{
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			m_ee->GetVuMicroprogramCache(i).Load(GetVuBlockCachePath(i));
+		}
+	}
+
+	if(!CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_EE_JITCACHE_ENABLED)) return;
+	m_eeBlockCache.Load(GetEeBlockCachePath());
+	m_ee->SetBlockCache(&m_eeBlockCache);
+}
+
+void CPS2VM::OnEeExecutableUnloading()
+{
+	//Make sure no block gets registered while saving
+	m_ee->SetBlockCache(nullptr);
+	m_eeBlockCache.Save(GetEeBlockCachePath());
+	m_eeBlockCache.Clear();
+
+	//Microprogram caches are kept in memory if they are not persisted
+	if(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_VU_JITCACHE_ENABLED))
+	{
+		for(unsigned int i = 0; i < 2; i++)
+		{
+			auto& microprogramCache = m_ee->GetVuMicroprogramCache(i);
+			microprogramCache.Save(GetVuBlockCachePath(i));
+			microprogramCache.Clear();
+		}
+	}
+}
+
 void CPS2VM::EmuThread()
 {
 	fesetround(FE_TOWARDZERO);
-	CProfiler::GetInstance().SetWorkThread();
+	CProfiler::GetInstance().SetThreadName("EE");
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_otherProfilerZone);
 #endif
@@ -758,66 +1254,29 @@ void CPS2VM::EmuThread()
 		}
 		if(m_nStatus == RUNNING)
 		{
-			if(m_spuUpdateTicks <= 0)
-			{
-				UpdateSpu();
-				m_spuUpdateTicks += SPU_UPDATE_TICKS;
-			}
+			m_scheduler.ProcessEvents();
 
 			//EE execution
 			{
-				//Check vblank stuff
-				if(m_vblankTicks <= 0)
-				{
-					m_inVblank = !m_inVblank;
-					if(m_inVblank)
-					{
-						m_vblankTicks += VBLANK_TICKS;
-						m_ee->NotifyVBlankStart();
-						m_iop->NotifyVBlankStart();
-
-						if(m_ee->m_gs != NULL)
-						{
-#ifdef PROFILE
-							CProfilerZone profilerZone(m_gsSyncProfilerZone);
-#endif
-							m_ee->m_gs->SetVBlank();
-						}
+				int sliceTicks = GetSliceTicks();
+				//EE CPU is 8 times faster than the IOP CPU
+				m_eeExecutionTicks += sliceTicks;
+				m_iopExecutionTicks += sliceTicks / 8;
 
-						if(m_pad != NULL)
-						{
-							m_pad->Update(m_ee->m_ram);
-						}
+				if(m_iopThread.GetMode() == CCoprocessorThread::MODE_SERIAL)
+				{
+					UpdateEe();
+					UpdateIop();
+				}
+				else
+				{
+					m_iopThread.BeginSlice();
+					UpdateEe();
 #ifdef PROFILE
-						{
-							CProfiler::GetInstance().CountCurrentZone();
-							auto stats = CProfiler::GetInstance().GetStats();
-							ProfileFrameDone(stats);
-							CProfiler::GetInstance().Reset();
-						}
-
-						m_cpuUtilisation = CPU_UTILISATION_INFO();
+					CProfilerZone profilerZone(m_iopSyncProfilerZone);
 #endif
-					}
-					else
-					{
-						m_vblankTicks += ONSCREEN_TICKS;
-						m_ee->NotifyVBlankEnd();
-						m_iop->NotifyVBlankEnd();
-						if(m_ee->m_gs != NULL)
-						{
-							m_ee->m_gs->ResetVBlank();
-						}
-					}
+					m_iopThread.EndSlice();
 				}
-
-				//EE CPU is 8 times faster than the IOP CPU
-				static const int tickStep = 4800;
-				m_eeExecutionTicks += tickStep;
-				m_iopExecutionTicks += tickStep / 8;
-
-				UpdateEe();
-				UpdateIop();
 			}
 #ifdef DEBUGGER_INCLUDED
 			if(
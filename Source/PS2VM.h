@@ -15,6 +15,12 @@
 #include "../tools/PsfPlayer/Source/SoundHandler.h"
 #include "FrameDump.h"
 #include "Profiler.h"
+#include "JitBlockCache.h"
+#include "CodeArena.h"
+#include "CoprocessorThread.h"
+#include "EventScheduler.h"
+#include "states/StateSnapshot.h"
+#include "states/RewindBuffer.h"
 
 class CPS2VM : public CVirtualMachine
 {
@@ -26,12 +32,43 @@ public:
 
 		int32 iopTotalTicks = 0;
 		int32 iopIdleTicks = 0;
+
+		//Number of times a processor had to wait for the other one in the middle of a time slice
+		int32 eeSyncCount = 0;
+		int32 iopSyncCount = 0;
+
+		//Time spent running VU1 microprograms on the VU thread and time the EE spent waiting
+		//for them, in nanoseconds. Their difference is the time both processors ran concurrently.
+		int32 vu1SyncCount = 0;
+		uint64 vu1RunTime = 0;
+		uint64 vu1WaitTime = 0;
+
+		//SPU mixer thread: times the sound handler ran out of mixed samples, time spent mixing and
+		//largest delay between emulation and sound output, in nanoseconds.
+		int32 spuUnderrunCount = 0;
+		uint64 spuMixTime = 0;
+		uint64 spuMaxLatency = 0;
+	};
+
+	struct CODE_ARENA_INFO
+	{
+		CCodeArena::STATS ee;
+		CCodeArena::STATS vu0;
+		CCodeArena::STATS vu1;
+		CCodeArena::STATS iop;
+	};
+
+	struct VU_CACHE_INFO
+	{
+		CVuExecutor::MICROPROGRAM_CACHE_STATS vu0;
+		CVuExecutor::MICROPROGRAM_CACHE_STATS vu1;
 	};
 
 	typedef std::unique_ptr<Ee::CSubSystem> EeSubSystemPtr;
 	typedef std::unique_ptr<Iop::CSubSystem> IopSubSystemPtr;
 	typedef std::function<void(const CFrameDump&)> FrameDumpCallback;
 	typedef Framework::CSignal<void(const CProfiler::ZoneArray&)> ProfileFrameDoneSignal;
+	typedef Framework::CSignal<void()> VBlankStartSignal;
 
 	CPS2VM();
 	virtual ~CPS2VM() = default;
@@ -52,6 +89,9 @@ public:
 
 	void DumpEEIntcHandlers();
 	void DumpEEDmacHandlers();
+	void DumpEETraceProfile();
+	void DumpEEPageFaultStats();
+	void DumpEEIdleLoops();
 
 	void CreateGSHandler(const CGSHandler::FactoryFunction&);
 	CGSHandler* GetGSHandler();
@@ -69,12 +109,21 @@ public:
 	static boost::filesystem::path GetStateDirectoryPath();
 	boost::filesystem::path GenerateStatePath(unsigned int) const;
 
+	//Futures are set once the state is written, emulation only stops while the state is captured
 	std::future<bool> SaveState(const boost::filesystem::path&);
+	//Saves the pages that changed since the last complete state. A copy of that state is kept next to
+	//the incremental state, so the slot it was saved to can be overwritten.
+	std::future<bool> SaveIncrementalState(const boost::filesystem::path&);
 	std::future<bool> LoadState(const boost::filesystem::path&);
+	//Goes back to the most recent state kept by the rewind buffer, each call goes further back
+	std::future<bool> Rewind();
 
 	void TriggerFrameDump(const FrameDumpCallback&);
 
 	CPU_UTILISATION_INFO GetCpuUtilisationInfo() const;
+	CODE_ARENA_INFO GetCodeArenaInfo() const;
+	VU_CACHE_INFO GetVuCacheInfo() const;
+	CJitBlockCache::STATS GetEeBlockCacheStats() const;
 
 #ifdef DEBUGGER_INCLUDED
 	std::string MakeDebugTagsPackagePath(const char*);
@@ -88,18 +137,32 @@ public:
 	IopSubSystemPtr m_iop;
 
 	ProfileFrameDoneSignal ProfileFrameDone;
+	//Raised on the emulation thread, after the frame's profiling information was reported
+	VBlankStartSignal VBlankStart;
 
 private:
 	typedef std::unique_ptr<COpticalMedia> OpticalMediaPtr;
+	typedef std::shared_ptr<std::promise<bool>> StatePromisePtr;
 
 	void CreateVM();
 	void ResetVM();
 	void DestroyVM();
-	bool SaveVMState(const boost::filesystem::path&);
+	void SaveVMState(const boost::filesystem::path&, bool, const StatePromisePtr&);
 	bool LoadVMState(const boost::filesystem::path&);
+	void LoadVMState(Framework::CZipArchiveReader&);
+	void WaitForStateWrite();
+	void CaptureRewindState();
+	bool RewindVMState();
+	//Incremental states keep their own copy of their base, user saves never overwrite it
+	static boost::filesystem::path GetBaseStatePath(const boost::filesystem::path&, uint64);
 
 	void ReloadExecutable(const char*, const CPS2OS::ArgumentList&);
 
+	boost::filesystem::path GetEeBlockCachePath() const;
+	boost::filesystem::path GetVuBlockCachePath(unsigned int) const;
+	void OnEeExecutableChange();
+	void OnEeExecutableUnloading();
+
 	void ResumeImpl();
 	void PauseImpl();
 	void DestroyImpl();
@@ -115,9 +178,14 @@ private:
 
 	void UpdateEe();
 	void UpdateIop();
+	void ExecuteIop();
+	void InitIopThread();
 	void UpdateSpu();
 
 	void OnGsNewFrame();
+	void OnVBlankEvent();
+	void OnSpuUpdateEvent();
+	int GetSliceTicks();
 
 	void CDROM0_SyncPath();
 	void CDROM0_Reset();
@@ -132,11 +200,13 @@ private:
 	STATUS m_nStatus;
 	bool m_nEnd;
 
-	int m_vblankTicks = 0;
+	CEventScheduler m_scheduler;
+	CEventScheduler::EventId m_vblankEvent = 0;
+	CEventScheduler::EventId m_spuUpdateEvent = 0;
 	bool m_inVblank = 0;
-	int m_spuUpdateTicks = 0;
 	int m_eeExecutionTicks = 0;
 	int m_iopExecutionTicks = 0;
+	int m_tickStep = 0;
 
 	CPU_UTILISATION_INFO m_cpuUtilisation;
 
@@ -152,6 +222,20 @@ private:
 
 	OpticalMediaPtr m_cdrom0;
 
+	//Save states
+	CStateSnapshot m_stateSnapshot;
+	CStateSnapshot m_baseStateSnapshot;
+	//Empty if the base snapshot can't be used for incremental states
+	boost::filesystem::path m_baseStatePath;
+	//Set while the base snapshot is being written
+	boost::filesystem::path m_pendingBaseStatePath;
+	std::future<bool> m_stateWriteFuture;
+
+	//Rewind
+	std::unique_ptr<CRewindBuffer> m_rewindBuffer;
+	int m_rewindInterval = 0;
+	int m_rewindFrameCount = 0;
+
 	//SPU update parameters
 	enum
 	{
@@ -167,13 +251,22 @@ private:
 	int m_currentSpuBlock = 0;
 	int m_spuBlockCount;
 	CSoundHandler* m_soundHandler = nullptr;
+	std::unique_ptr<Iop::CSpuMixer> m_spuMixer;
 
 	CProfiler::ZoneHandle m_eeProfilerZone = 0;
 	CProfiler::ZoneHandle m_iopProfilerZone = 0;
+	CProfiler::ZoneHandle m_iopSyncProfilerZone = 0;
+	CProfiler::ZoneHandle m_vu1SyncProfilerZone = 0;
 	CProfiler::ZoneHandle m_spuProfilerZone = 0;
 	CProfiler::ZoneHandle m_gsSyncProfilerZone = 0;
 	CProfiler::ZoneHandle m_otherProfilerZone = 0;
+	CProfiler::ZoneHandle m_rewindProfilerZone = 0;
+
+	CJitBlockCache m_eeBlockCache;
+	CCoprocessorThread m_iopThread;
 
 	CPS2OS::RequestLoadExecutableEvent::Connection m_OnRequestLoadExecutableConnection;
+	Framework::CSignal<void()>::Connection m_OnExecutableChangeConnection;
+	Framework::CSignal<void()>::Connection m_OnExecutableUnloadingConnection;
 	Framework::CSignal<void(uint32)>::Connection m_OnNewFrameConnection;
 };
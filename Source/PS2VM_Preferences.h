@@ -6,4 +6,18 @@
 #define PREF_PS2_MC0_DIRECTORY ("ps2.mc0.directory.v2")
 #define PREF_PS2_MC1_DIRECTORY ("ps2.mc1.directory.v2")
 
+#define PREF_PS2_EE_ASYNCJIT_ENABLED ("ps2.ee.asyncjit.enabled")
+#define PREF_PS2_EE_ASYNCJIT_WORKERCOUNT ("ps2.ee.asyncjit.workercount")
+#define PREF_PS2_EE_JITCACHE_ENABLED ("ps2.ee.jitcache.enabled")
+#define PREF_PS2_EE_HOTTRACE_ENABLED ("ps2.ee.hottrace.enabled")
+#define PREF_PS2_EE_IDLELOOPDETECTION_ENABLED ("ps2.ee.idleloopdetection.enabled")
+#define PREF_PS2_VU_JITCACHE_ENABLED ("ps2.vu.jitcache.enabled")
+#define PREF_PS2_IOP_THREADMODE ("ps2.iop.threadmode")
+#define PREF_PS2_IOP_SYNCWINDOW ("ps2.iop.syncwindow")
+#define PREF_PS2_VU1_THREADMODE ("ps2.vu1.threadmode")
+#define PREF_PS2_REWIND_ENABLED ("ps2.rewind.enabled")
+#define PREF_PS2_REWIND_INTERVAL ("ps2.rewind.interval")
+#define PREF_PS2_REWIND_MEMORYBUDGET ("ps2.rewind.memorybudget")
+
 #define PREF_AUDIO_SPUBLOCKCOUNT ("audio.spublockcount")
+#define PREF_AUDIO_SPUMIXTHREAD_ENABLED ("audio.spumixthread.enabled")
@@ -1,100 +1,366 @@
 #include "Profiler.h"
 
+#include <algorithm>
 #include <cassert>
+#include "string_format.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_TICKS_TSC
+#elif(defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILER_TICKS_TSC
+#elif(defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define PROFILER_TICKS_CNTVCT
+#endif
+
+#define TRACE_PROCESS_ID (1)
+
+//Gives back the state of a thread to the profiler when the thread ends
+class CProfilerThreadStateHolder
+{
+public:
+	~CProfilerThreadStateHolder()
+	{
+		if(state)
+		{
+			CProfiler::GetInstance().ReleaseThreadState(state);
+		}
+	}
+
+	CProfiler::THREAD_STATE* state = nullptr;
+};
+
+static thread_local CProfilerThreadStateHolder g_threadStateHolder;
+
+static std::string EscapeTraceString(const std::string& input)
+{
+	std::string result;
+	for(auto character : input)
+	{
+		if((character == '"') || (character == '\\'))
+		{
+			result += '\\';
+		}
+		result += character;
+	}
+	return result;
+}
 
 CProfiler::CProfiler()
 {
+	m_zoneCount = 0;
+	m_traceEnabled = false;
+	m_startTicks = GetTicks();
+	m_startTime = std::chrono::steady_clock::now();
 }
 
 CProfiler::~CProfiler()
 {
+	for(const auto& threadState : m_threadStates)
+	{
+		delete[] threadState->traceEvents.load();
+	}
 }
 
 CProfiler::ZoneHandle CProfiler::RegisterZone(const char* name)
 {
 #ifdef PROFILE
-	for(unsigned int i = 0; i < m_zones.size(); i++)
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32 zoneCount = m_zoneCount;
+	for(uint32 i = 0; i < zoneCount; i++)
 	{
-		const auto& zone(m_zones[i]);
-		if(zone.name == name) return i;
+		if(m_zoneNames[i] == name) return i;
 	}
-	auto newZone = ZONE();
-	newZone.name = name;
-	newZone.totalTime = 0;
-	m_zones.push_back(newZone);
-	return static_cast<CProfiler::ZoneHandle>(m_zones.size() - 1);
+	assert(zoneCount < MAX_ZONES);
+	if(zoneCount == MAX_ZONES) return 0;
+	m_zoneNames[zoneCount] = name;
+	m_zoneCount = zoneCount + 1;
+	return zoneCount;
 #else
 	return 0;
 #endif
 }
 
+void CProfiler::SetThreadName(const char* name)
+{
+#ifdef PROFILE
+	auto& threadState = GetThreadState();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	threadState.name = name;
+#endif
+}
+
 void CProfiler::CountCurrentZone()
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	assert(!m_zoneStack.empty());
+	AddTicksToCurrentZone(GetThreadState(), GetTicks());
+}
 
-	auto thisTime = std::chrono::high_resolution_clock::now();
+void CProfiler::EnterZone(ZoneHandle zoneHandle)
+{
+	assert(zoneHandle < m_zoneCount);
+	auto& threadState = GetThreadState();
+	uint64 ticks = GetTicks();
 
+	if((threadState.overflowDepth != 0) || (threadState.zoneDepth == MAX_ZONE_DEPTH))
 	{
-		auto topZoneHandle = m_zoneStack.top();
-		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - m_currentTime);
-		AddTimeToZone(topZoneHandle, duration.count());
+		assert(false);
+		threadState.overflowDepth++;
+		return;
 	}
 
-	m_currentTime = thisTime;
+	AddTicksToCurrentZone(threadState, ticks);
+	threadState.zoneStack[threadState.zoneDepth] = zoneHandle;
+	threadState.zoneBeginTicks[threadState.zoneDepth] = ticks;
+	threadState.zoneDepth++;
 }
 
-void CProfiler::EnterZone(ZoneHandle zoneHandle)
+void CProfiler::ExitZone()
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
+	auto& threadState = GetThreadState();
+	uint64 ticks = GetTicks();
+
+	if(threadState.overflowDepth != 0)
+	{
+		threadState.overflowDepth--;
+		return;
+	}
+
+	assert(threadState.zoneDepth != 0);
+	if(threadState.zoneDepth == 0) return;
 
-	auto thisTime = std::chrono::high_resolution_clock::now();
+	AddTicksToCurrentZone(threadState, ticks);
+	threadState.zoneDepth--;
 
-	if(!m_zoneStack.empty())
+	if(m_traceEnabled.load(std::memory_order_relaxed))
 	{
-		auto topZoneHandle = m_zoneStack.top();
-		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - m_currentTime);
-		AddTimeToZone(topZoneHandle, duration.count());
+		uint32 depth = threadState.zoneDepth;
+		AddTraceEvent(threadState, threadState.zoneStack[depth], threadState.zoneBeginTicks[depth], ticks);
 	}
+}
 
-	m_zoneStack.push(zoneHandle);
+CProfiler::ZoneArray CProfiler::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32 zoneCount = m_zoneCount;
+	std::vector<uint64> zoneTicks(zoneCount, 0);
+	for(const auto& threadState : m_threadStates)
+	{
+		for(uint32 i = 0; i < zoneCount; i++)
+		{
+			zoneTicks[i] += threadState->zoneTicks[i].load(std::memory_order_relaxed) - threadState->resetTicks[i];
+		}
+	}
 
-	m_currentTime = thisTime;
+	double ticksPerNanosecond = GetTicksPerNanosecond();
+	ZoneArray result(zoneCount);
+	for(uint32 i = 0; i < zoneCount; i++)
+	{
+		result[i].name = m_zoneNames[i];
+		result[i].totalTime = static_cast<uint64>(static_cast<double>(zoneTicks[i]) / ticksPerNanosecond);
+	}
+	return result;
 }
 
-void CProfiler::ExitZone()
+void CProfiler::Reset()
 {
-	CountCurrentZone();
-	m_zoneStack.pop();
+	//Totals are only written by their thread, they are remembered as the new starting point instead of being cleared
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(const auto& threadState : m_threadStates)
+	{
+		for(uint32 i = 0; i < MAX_ZONES; i++)
+		{
+			threadState->resetTicks[i] = threadState->zoneTicks[i].load(std::memory_order_relaxed);
+		}
+	}
 }
 
-CProfiler::ZoneArray CProfiler::GetStats() const
+void CProfiler::SetTraceEnabled(bool traceEnabled)
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	return m_zones;
+	m_traceEnabled = traceEnabled;
 }
 
-void CProfiler::Reset()
+void CProfiler::WriteTrace(Framework::CStream& stream) const
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	for(auto& zone : m_zones)
+	std::lock_guard<std::mutex> lock(m_mutex);
+	double ticksPerMicrosecond = GetTicksPerNanosecond() * 1000.0;
+	std::string output = "{\"traceEvents\":[";
+	bool firstEvent = true;
+	auto beginEvent =
+	    [&]() {
+		    if(!firstEvent) output += ",";
+		    output += "\n";
+		    firstEvent = false;
+	    };
+
+	for(const auto& threadState : m_threadStates)
 	{
-		zone.totalTime = 0;
+		beginEvent();
+		auto threadName = threadState->name.empty() ? string_format("Thread %d", threadState->id) : threadState->name;
+		output += string_format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		                        TRACE_PROCESS_ID, threadState->id, EscapeTraceString(threadName).c_str());
+
+		auto traceEvents = threadState->traceEvents.load(std::memory_order_acquire);
+		if(traceEvents == nullptr) continue;
+
+		//Events are copied first, those that could have been overwritten while copying are dropped
+		uint64 eventCount = threadState->traceEventCount.load(std::memory_order_acquire);
+		uint64 firstEventIndex = (eventCount > TRACE_EVENT_COUNT) ? (eventCount - TRACE_EVENT_COUNT) : 0;
+		struct EVENT_COPY
+		{
+			uint64 index;
+			uint64 beginTicks;
+			uint64 endTicks;
+			uint32 zone;
+		};
+		std::vector<EVENT_COPY> eventCopies;
+		eventCopies.reserve(eventCount - firstEventIndex);
+		for(uint64 i = firstEventIndex; i < eventCount; i++)
+		{
+			const auto& traceEvent = traceEvents[i % TRACE_EVENT_COUNT];
+			EVENT_COPY eventCopy;
+			eventCopy.index = i;
+			eventCopy.beginTicks = traceEvent.beginTicks.load(std::memory_order_relaxed);
+			eventCopy.endTicks = traceEvent.endTicks.load(std::memory_order_relaxed);
+			eventCopy.zone = traceEvent.zone.load(std::memory_order_relaxed);
+			eventCopies.push_back(eventCopy);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64 newEventCount = threadState->traceEventCount.load(std::memory_order_relaxed);
+
+		for(const auto& eventCopy : eventCopies)
+		{
+			if((eventCopy.index + TRACE_EVENT_COUNT) <= newEventCount) continue;
+			if(eventCopy.zone >= m_zoneCount) continue;
+			double beginTime = static_cast<double>(eventCopy.beginTicks - m_startTicks) / ticksPerMicrosecond;
+			double duration = static_cast<double>(eventCopy.endTicks - eventCopy.beginTicks) / ticksPerMicrosecond;
+			beginEvent();
+			output += string_format("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+			                        EscapeTraceString(m_zoneNames[eventCopy.zone]).c_str(), beginTime, duration,
+			                        TRACE_PROCESS_ID, threadState->id);
+		}
+
+		stream.Write(output.data(), output.size());
+		output.clear();
+
+		//Ended threads won't add events anymore, their state can now be reused
+		if(!threadState->inUse)
+		{
+			threadState->traceExported = true;
+		}
 	}
+
+	output += "\n],\"displayTimeUnit\":\"ns\"}\n";
+	stream.Write(output.data(), output.size());
+}
+
+uint64 CProfiler::GetTicks()
+{
+#if defined(PROFILER_TICKS_TSC)
+	return __rdtsc();
+#elif defined(PROFILER_TICKS_CNTVCT)
+	uint64 ticks = 0;
+	__asm__ volatile("mrs %0, cntvct_el0"
+	                 : "=r"(ticks));
+	return ticks;
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
 }
 
-void CProfiler::SetWorkThread()
+//Tick frequency is measured over the time elapsed since the profiler was created
+double CProfiler::GetTicksPerNanosecond() const
 {
-#ifdef _DEBUG
-	m_workThreadId = std::this_thread::get_id();
+#if defined(PROFILER_TICKS_TSC) || defined(PROFILER_TICKS_CNTVCT)
+	auto elapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+	uint64 elapsedTicks = GetTicks() - m_startTicks;
+	if((elapsedTime <= 0) || (elapsedTicks == 0)) return 1.0;
+	return static_cast<double>(elapsedTicks) / static_cast<double>(elapsedTime);
+#else
+	return 1.0;
 #endif
 }
 
-void CProfiler::AddTimeToZone(ZoneHandle zoneHandle, uint64 timeNs)
+CProfiler::THREAD_STATE& CProfiler::GetThreadState()
 {
-	assert(m_zones.size() > zoneHandle);
-	auto& zone = m_zones[zoneHandle];
-	zone.totalTime += timeNs;
+	auto threadState = g_threadStateHolder.state;
+	if(threadState == nullptr)
+	{
+		threadState = AcquireThreadState();
+		g_threadStateHolder.state = threadState;
+	}
+	return *threadState;
+}
+
+//States of threads that ended are reused, their totals keep counting in the stats. States holding
+//trace events are only reused once these events were written in a trace.
+CProfiler::THREAD_STATE* CProfiler::AcquireThreadState()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto threadStateIterator = std::find_if(m_threadStates.begin(), m_threadStates.end(),
+	                                        [](const ThreadStatePtr& threadState) {
+		                                        if(threadState->inUse) return false;
+		                                        return (threadState->traceEventCount == 0) || threadState->traceExported;
+	                                        });
+	THREAD_STATE* threadState = nullptr;
+	if(threadStateIterator != std::end(m_threadStates))
+	{
+		threadState = threadStateIterator->get();
+	}
+	else
+	{
+		auto newThreadState = std::make_unique<THREAD_STATE>();
+		newThreadState->id = static_cast<unsigned int>(m_threadStates.size());
+		for(uint32 i = 0; i < MAX_ZONES; i++)
+		{
+			newThreadState->zoneTicks[i] = 0;
+			newThreadState->resetTicks[i] = 0;
+		}
+		newThreadState->traceEvents = nullptr;
+		threadState = newThreadState.get();
+		m_threadStates.push_back(std::move(newThreadState));
+	}
+	threadState->inUse = true;
+	threadState->traceExported = false;
+	threadState->name.clear();
+	threadState->zoneDepth = 0;
+	threadState->overflowDepth = 0;
+	threadState->currentTicks = 0;
+	threadState->traceEventCount = 0;
+	return threadState;
+}
+
+void CProfiler::ReleaseThreadState(THREAD_STATE* threadState)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	threadState->inUse = false;
+}
+
+void CProfiler::AddTicksToCurrentZone(THREAD_STATE& threadState, uint64 ticks)
+{
+	if(threadState.zoneDepth != 0)
+	{
+		//Only this thread writes to its totals, no need for an atomic addition
+		auto& zoneTicks = threadState.zoneTicks[threadState.zoneStack[threadState.zoneDepth - 1]];
+		zoneTicks.store(zoneTicks.load(std::memory_order_relaxed) + (ticks - threadState.currentTicks), std::memory_order_relaxed);
+	}
+	threadState.currentTicks = ticks;
+}
+
+void CProfiler::AddTraceEvent(THREAD_STATE& threadState, ZoneHandle zoneHandle, uint64 beginTicks, uint64 endTicks)
+{
+	auto traceEvents = threadState.traceEvents.load(std::memory_order_relaxed);
+	if(traceEvents == nullptr)
+	{
+		traceEvents = new TRACE_EVENT[TRACE_EVENT_COUNT];
+		threadState.traceEvents.store(traceEvents, std::memory_order_release);
+	}
+	uint64 eventIndex = threadState.traceEventCount.load(std::memory_order_relaxed);
+	auto& traceEvent = traceEvents[eventIndex % TRACE_EVENT_COUNT];
+	traceEvent.beginTicks.store(beginTicks, std::memory_order_relaxed);
+	traceEvent.endTicks.store(endTicks, std::memory_order_relaxed);
+	traceEvent.zone.store(zoneHandle, std::memory_order_relaxed);
+	threadState.traceEventCount.store(eventIndex + 1, std::memory_order_release);
 }
 
 //////////////////////////////////////////////////////////////////////////
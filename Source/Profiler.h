@@ -1,13 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <stack>
-#include <thread>
 #include <vector>
-#include <chrono>
 #include "Singleton.h"
 #include "Types.h"
+#include "Stream.h"
 
+//Zones can be entered from any thread. Each thread keeps its own zone stack, its own time totals
+//and its own ring of trace events, which are only written by that thread. Totals and traces are
+//read by other threads without stopping profiled threads. Time spent in a nested zone isn't
+//counted in its parent.
 class CProfiler : public CSingleton<CProfiler>
 {
 public:
@@ -20,35 +26,91 @@ public:
 	};
 
 	typedef std::vector<ZONE> ZoneArray;
-	typedef std::chrono::high_resolution_clock::time_point TimePoint;
+
+	enum
+	{
+		MAX_ZONES = 64,
+		MAX_ZONE_DEPTH = 32,
+		//Number of zone events kept for each thread when tracing is enabled
+		TRACE_EVENT_COUNT = 0x10000,
+	};
 
 	CProfiler();
 	virtual ~CProfiler();
 
 	ZoneHandle RegisterZone(const char*);
+	//Name of the calling thread in traces
+	void SetThreadName(const char*);
 
 	void CountCurrentZone();
 
 	void EnterZone(ZoneHandle);
 	void ExitZone();
 
+	//Time spent in each zone by all threads since the last reset, in nanoseconds
 	ZoneArray GetStats() const;
 	void Reset();
 
-	void SetWorkThread();
+	void SetTraceEnabled(bool);
+	//Writes the most recent zone events of all threads in the Chrome trace event format,
+	//which can be loaded in about:tracing or Perfetto
+	void WriteTrace(Framework::CStream&) const;
 
 private:
-	typedef std::stack<ZoneHandle> ZoneStack;
+	struct TRACE_EVENT
+	{
+		std::atomic<uint64> beginTicks;
+		std::atomic<uint64> endTicks;
+		std::atomic<uint32> zone;
+	};
+
+	struct THREAD_STATE
+	{
+		std::atomic<bool> inUse;
+		unsigned int id = 0;
+		std::string name;
+
+		//Only accessed by the owning thread
+		ZoneHandle zoneStack[MAX_ZONE_DEPTH];
+		uint64 zoneBeginTicks[MAX_ZONE_DEPTH];
+		uint32 zoneDepth = 0;
+		//Zones entered past the maximum depth aren't tracked
+		uint32 overflowDepth = 0;
+		uint64 currentTicks = 0;
+
+		//Written by the owning thread, read by any thread
+		std::atomic<uint64> zoneTicks[MAX_ZONES];
+		std::atomic<TRACE_EVENT*> traceEvents;
+		std::atomic<uint64> traceEventCount;
+
+		//Totals at the last reset, protected by the profiler's mutex
+		uint64 resetTicks[MAX_ZONES];
+		//Set when the events of an ended thread were written in a trace, protected by the profiler's mutex
+		bool traceExported = false;
+	};
+	typedef std::unique_ptr<THREAD_STATE> ThreadStatePtr;
+	typedef std::vector<ThreadStatePtr> ThreadStateArray;
+
+	friend class CProfilerThreadStateHolder;
+
+	static uint64 GetTicks();
+	double GetTicksPerNanosecond() const;
 
-	void AddTimeToZone(ZoneHandle, uint64);
+	THREAD_STATE& GetThreadState();
+	THREAD_STATE* AcquireThreadState();
+	void ReleaseThreadState(THREAD_STATE*);
+	void AddTicksToCurrentZone(THREAD_STATE&, uint64);
+	void AddTraceEvent(THREAD_STATE&, ZoneHandle, uint64, uint64);
 
-	ZoneArray m_zones;
-	ZoneStack m_zoneStack;
-	TimePoint m_currentTime;
+	//Protects zone names and the thread list, never taken while entering or exiting zones
+	mutable std::mutex m_mutex;
+	std::string m_zoneNames[MAX_ZONES];
+	std::atomic<uint32> m_zoneCount;
+	ThreadStateArray m_threadStates;
+	std::atomic<bool> m_traceEnabled;
 
-#ifdef _DEBUG
-	std::thread::id m_workThreadId;
-#endif
+	uint64 m_startTicks = 0;
+	std::chrono::steady_clock::time_point m_startTime;
 };
 
 class CProfilerZone
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../tools/PsfPlayer/Source/SoundHandler.h"
+
+//Accepts every sample block and throws it away, SPU emulation still runs as if sound was played
+class CSH_Null : public CSoundHandler
+{
+public:
+	static CSoundHandler* HandlerFactory()
+	{
+		return new CSH_Null();
+	}
+
+	void Reset() override
+	{
+	}
+
+	void Write(int16*, unsigned int, unsigned int) override
+	{
+	}
+
+	bool HasFreeBuffers() override
+	{
+		return true;
+	}
+
+	void RecycleBuffers() override
+	{
+	}
+};
@@ -0,0 +1,121 @@
+#include "TraceBlock.h"
+#include "MipsJitter.h"
+#include "offsetof_def.h"
+
+CTraceBlock::CTraceBlock(CMIPS& context, const RangeArray& ranges, bool loop)
+    : CBasicBlock(context, ranges[0].begin, ranges[0].end)
+    , m_ranges(ranges)
+    , m_loop(loop)
+{
+	m_trace = true;
+}
+
+const CTraceBlock::RangeArray& CTraceBlock::GetRanges() const
+{
+	return m_ranges;
+}
+
+bool CTraceBlock::IsLoop() const
+{
+	return m_loop;
+}
+
+TRACE_PROFILE* CTraceBlock::GetTraceProfile() const
+{
+	return m_traceProfile;
+}
+
+void CTraceBlock::SetTraceProfile(TRACE_PROFILE* traceProfile)
+{
+	m_traceProfile = traceProfile;
+}
+
+void CTraceBlock::CompileRange(CMipsJitter* jitter)
+{
+	CompileProlog(jitter);
+
+	auto headLabel = jitter->CreateLabel();
+	jitter->MarkLabel(headLabel);
+	CompileSegment(jitter, 0, headLabel);
+}
+
+void CTraceBlock::CompileSegment(CMipsJitter* jitter, unsigned int segmentIndex, Jitter::CJitter::LABEL headLabel)
+{
+	const auto& range = m_ranges[segmentIndex];
+	for(uint32 address = range.begin; address <= range.end; address += 4)
+	{
+		m_context.m_pArch->CompileInstruction(
+		    address,
+		    jitter,
+		    &m_context);
+		//Sanity check
+		assert(jitter->IsStackEmpty());
+	}
+
+	jitter->MarkFinalBlockLabel();
+	CompileSegmentEpilog(jitter, range);
+
+	bool isLastSegment = (segmentIndex + 1) == m_ranges.size();
+	if(isLastSegment && !m_loop) return;
+
+	uint32 nextAddress = isLastSegment ? m_ranges[0].begin : m_ranges[segmentIndex + 1].begin;
+
+	//Side exit if anything happened or if we're not going where the trace goes
+	jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+	jitter->PushCst(0);
+	jitter->BeginIf(Jitter::CONDITION_EQ);
+	{
+		jitter->PushRel(offsetof(CMIPS, m_State.nPC));
+		jitter->PushCst(nextAddress);
+		jitter->BeginIf(Jitter::CONDITION_EQ);
+		{
+			if(isLastSegment)
+			{
+				jitter->Goto(headLabel);
+			}
+			else
+			{
+				CompileSegment(jitter, segmentIndex + 1, headLabel);
+			}
+		}
+		jitter->EndIf();
+	}
+	jitter->EndIf();
+}
+
+void CTraceBlock::CompileSegmentEpilog(CMipsJitter* jitter, const RANGE& range)
+{
+	//Same as CBasicBlock's epilog, but control is always given back to the caller
+	jitter->PushRel(offsetof(CMIPS, m_State.cycleQuota));
+	jitter->PushCst(((range.end - range.begin) / 4) + 1);
+	jitter->Sub();
+	jitter->PullRel(offsetof(CMIPS, m_State.cycleQuota));
+
+	jitter->PushRel(offsetof(CMIPS, m_State.cycleQuota));
+	jitter->PushCst(0);
+	jitter->BeginIf(Jitter::CONDITION_LE);
+	{
+		jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+		jitter->PushCst(MIPS_EXECUTION_STATUS_QUOTADONE);
+		jitter->Or();
+		jitter->PullRel(offsetof(CMIPS, m_State.nHasException));
+	}
+	jitter->EndIf();
+
+	jitter->PushCst(MIPS_INVALID_PC);
+	jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+	jitter->BeginIf(Jitter::CONDITION_NE);
+	{
+		jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+
+		jitter->PushCst(MIPS_INVALID_PC);
+		jitter->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+	}
+	jitter->Else();
+	{
+		jitter->PushCst(range.end + 4);
+		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+	}
+	jitter->EndIf();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include "BasicBlock.h"
+
+struct TRACE_PROFILE;
+
+//Block made of a chain of basic blocks that are frequently executed one after the other.
+//Execution leaves the trace as soon as control flow doesn't follow the chain. If the last
+//block of the chain goes back to the first one, the trace loops without leaving generated code.
+class CTraceBlock : public CBasicBlock
+{
+public:
+	struct RANGE
+	{
+		uint32 begin;
+		uint32 end;
+	};
+	typedef std::vector<RANGE> RangeArray;
+
+	CTraceBlock(CMIPS&, const RangeArray&, bool);
+	virtual ~CTraceBlock() = default;
+
+	const RangeArray& GetRanges() const;
+	bool IsLoop() const;
+
+	//Profile is owned by the executor and outlives the trace
+	TRACE_PROFILE* GetTraceProfile() const;
+	void SetTraceProfile(TRACE_PROFILE*);
+
+protected:
+	void CompileRange(CMipsJitter*) override;
+
+private:
+	void CompileSegment(CMipsJitter*, unsigned int, Jitter::CJitter::LABEL);
+	void CompileSegmentEpilog(CMipsJitter*, const RANGE&);
+
+	RangeArray m_ranges;
+	bool m_loop = false;
+	TRACE_PROFILE* m_traceProfile = nullptr;
+};
+
+//Execution statistics of a trace, kept across the trace being removed and formed again
+struct TRACE_PROFILE
+{
+	enum
+	{
+		MAX_EXIT_COUNT = 8,
+	};
+
+	struct EXIT
+	{
+		uint32 address = MIPS_INVALID_PC;
+		uint64 count = 0;
+	};
+
+	CTraceBlock::RangeArray ranges;
+	bool loop = false;
+	uint32 formCount = 0;
+	uint64 entryCount = 0;
+	EXIT exits[MAX_EXIT_COUNT];
+	//Exits that didn't fit in the exit array
+	uint64 otherExitCount = 0;
+
+	void RecordExit(uint32 address)
+	{
+		for(auto& exit : exits)
+		{
+			if(exit.address == address)
+			{
+				exit.count++;
+				return;
+			}
+			if(exit.address == MIPS_INVALID_PC)
+			{
+				exit.address = address;
+				exit.count = 1;
+				return;
+			}
+		}
+		otherExitCount++;
+	}
+};
@@ -216,6 +216,19 @@ bool CDMAC::IsDMA4Started() const
 	return (m_D4.m_CHCR.nSTR != 0) && (m_D_ENABLE == 0);
 }
 
+bool CDMAC::IsAnyChannelStarted() const
+{
+	return (m_D0.m_CHCR.nSTR != 0) ||
+	       (m_D1.m_CHCR.nSTR != 0) ||
+	       (m_D2.m_CHCR.nSTR != 0) ||
+	       ((m_D3_CHCR & CHCR_STR) != 0) ||
+	       (m_D4.m_CHCR.nSTR != 0) ||
+	       ((m_D5_CHCR & CHCR_STR) != 0) ||
+	       ((m_D6_CHCR & CHCR_STR) != 0) ||
+	       (m_D8.m_CHCR.nSTR != 0) ||
+	       (m_D9.m_CHCR.nSTR != 0);
+}
+
 uint64 CDMAC::FetchDMATag(uint32 nAddress)
 {
 	if(nAddress & 0x80000000)
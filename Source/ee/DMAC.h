@@ -118,6 +118,7 @@ public:
 	void ResumeDMA4();
 	void ResumeDMA8();
 	bool IsDMA4Started() const;
+	bool IsAnyChannelStarted() const;
 	static bool IsEndSrcTagId(uint32);
 
 private:
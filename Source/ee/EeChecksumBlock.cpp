@@ -0,0 +1,31 @@
+#include <cstring>
+#include "EeChecksumBlock.h"
+#include "EeExecutor.h"
+#include "../MipsJitter.h"
+
+CEeChecksumBlock::CEeChecksumBlock(CMIPS& context, uint32 begin, uint32 end, const uint8* ram)
+    : CBasicBlock(context, begin, end)
+    , m_code(ram + begin)
+    , m_codeCopy(m_code, m_code + (end - begin + 4))
+{
+}
+
+bool CEeChecksumBlock::IsCodeModified() const
+{
+	return memcmp(m_code, m_codeCopy.data(), m_codeCopy.size()) != 0;
+}
+
+void CEeChecksumBlock::CompileRange(CMipsJitter* jitter)
+{
+	jitter->PushCtx();
+	jitter->Call(reinterpret_cast<void*>(&CEeExecutor::IsBlockCodeModified), 1, Jitter::CJitter::RETURN_VALUE_32);
+
+	jitter->PushCst(0);
+	jitter->BeginIf(Jitter::CONDITION_NE);
+	{
+		jitter->JumpTo(reinterpret_cast<void*>(&CEeExecutor::HandleModifiedBlock));
+	}
+	jitter->EndIf();
+
+	CBasicBlock::CompileRange(jitter);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include "../BasicBlock.h"
+
+//Block living on a page that isn't write protected. Code is compared with what it was
+//compiled from every time the block is entered and the block is discarded if it changed.
+class CEeChecksumBlock : public CBasicBlock
+{
+public:
+	CEeChecksumBlock(CMIPS&, uint32, uint32, const uint8*);
+	virtual ~CEeChecksumBlock() = default;
+
+	bool IsCodeModified() const;
+
+protected:
+	void CompileRange(CMipsJitter*) override;
+
+private:
+	const uint8* m_code = nullptr;
+	std::vector<uint8> m_codeCopy;
+};
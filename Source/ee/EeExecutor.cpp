@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cstdio>
 #include "EeExecutor.h"
+#include "EeChecksumBlock.h"
 #include "../Ps2Const.h"
 #include "AlignedAlloc.h"
 
@@ -37,6 +40,7 @@ CEeExecutor::CEeExecutor(CMIPS& context, uint8* ram)
     , m_ram(ram)
 {
 	m_pageSize = framework_getpagesize();
+	m_pageStats.resize(PS2::EE_RAM_SIZE / m_pageSize);
 }
 
 void CEeExecutor::AddExceptionHandler()
@@ -77,6 +81,27 @@ void CEeExecutor::AddExceptionHandler()
 #endif
 }
 
+void CEeExecutor::AttachExceptionHandlerToThread()
+{
+	assert(g_eeExecutor == this);
+
+#ifdef DISABLE_PROTECTION
+	return;
+#endif
+
+#if defined(__APPLE__)
+	//Exception ports are per thread, other platforms use process wide handlers
+	kern_return_t result = mach_port_insert_right(mach_task_self(), m_port, m_port, MACH_MSG_TYPE_MAKE_SEND);
+	assert(result == KERN_SUCCESS);
+
+	result = thread_set_exception_ports(mach_thread_self(), EXC_MASK_BAD_ACCESS, m_port, EXCEPTION_STATE | MACH_EXCEPTION_CODES, STATE_FLAVOR);
+	assert(result == KERN_SUCCESS);
+
+	result = mach_port_mod_refs(mach_task_self(), m_port, MACH_PORT_RIGHT_SEND, -1);
+	assert(result == KERN_SUCCESS);
+#endif
+}
+
 void CEeExecutor::RemoveExceptionHandler()
 {
 #ifndef DISABLE_PROTECTION
@@ -93,10 +118,37 @@ void CEeExecutor::RemoveExceptionHandler()
 	g_eeExecutor = nullptr;
 }
 
+int CEeExecutor::Execute(int cycles)
+{
+	while(1)
+	{
+		cycles = CGenericMipsExecutor::Execute(cycles);
+		if(m_modifiedBlockAddress == MIPS_INVALID_PC) break;
+		//A block noticed that its code changed, get rid of it and resume execution
+		auto block = FindBlockStartingAt(m_modifiedBlockAddress);
+		assert(!block->IsEmpty());
+		m_modifiedBlockAddress = MIPS_INVALID_PC;
+		CGenericMipsExecutor::ClearActiveBlocksInRange(block->GetBeginAddress(), block->GetEndAddress(), false);
+		if(m_context.m_State.nHasException) break;
+	}
+	if(m_context.m_State.nHasException == MIPS_EXCEPTION_IDLE)
+	{
+		auto idleLoopIterator = m_idleLoops.find(m_context.m_State.nPC & m_addressMask);
+		if(idleLoopIterator != std::end(m_idleLoops))
+		{
+			idleLoopIterator->second.idleCount++;
+		}
+	}
+	return cycles;
+}
+
 void CEeExecutor::Reset()
 {
 	SetMemoryProtected(m_ram, PS2::EE_RAM_SIZE, false);
 	CGenericMipsExecutor::Reset();
+	m_pageStats.assign(m_pageStats.size(), PAGE_STATS());
+	m_modifiedBlockAddress = MIPS_INVALID_PC;
+	m_idleLoops.clear();
 }
 
 void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end, bool executing)
@@ -108,22 +160,385 @@ void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end, bool execut
 
 BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end)
 {
+	BasicBlockPtr result;
+
 	//Kernel area is below 0x100000 and isn't protected. Some games will write code in there
 	//but it is safe to assume that it won't change (code writes some data just besides itself
 	//so it keeps generating exceptions, making the game slower)
 	if(start >= 0x100000 && start < PS2::EE_RAM_SIZE)
 	{
-		SetMemoryProtected(m_ram + start, end - start + 4, true);
+		//Pages that keep faulting are left unprotected, blocks living there check their own code instead
+		if(((end + 4) <= PS2::EE_RAM_SIZE) && HasChecksumPages(start, end))
+		{
+			result = std::make_shared<CEeChecksumBlock>(context, start, end, m_ram);
+		}
+		else
+		{
+			SetMemoryProtected(m_ram + start, end - start + 4, true);
+		}
+	}
+
+	if(m_idleLoopDetectionEnabled && IsIdleLoop(context, start, end))
+	{
+		if(!result)
+		{
+			result = std::make_shared<CBasicBlock>(context, start, end);
+		}
+		result->SetIdleLoop(true);
+		m_idleLoops[start].end = end;
 	}
+
+	if(result)
+	{
+		//Generated code differs from regular blocks, don't go through the block cache
+		std::lock_guard<std::mutex> compileLock(m_compileMutex);
+		result->Compile(nullptr, &m_codeArena);
+		return result;
+	}
+
 	return CGenericMipsExecutor::BlockFactory(context, start, end);
 }
 
+void CEeExecutor::SetIdleLoopDetectionEnabled(bool enabled)
+{
+	m_idleLoopDetectionEnabled = enabled;
+}
+
+void CEeExecutor::DumpPageFaultStats() const
+{
+	std::vector<uint32> pages;
+	for(uint32 i = 0; i < m_pageStats.size(); i++)
+	{
+		if(m_pageStats[i].faultCount == 0) continue;
+		pages.push_back(i);
+	}
+	std::sort(pages.begin(), pages.end(),
+	          [this](uint32 page1, uint32 page2) { return m_pageStats[page1].faultCount > m_pageStats[page2].faultCount; });
+
+	printf("Page Fault Statistics\r\n");
+	printf("---------------------\r\n");
+
+	for(auto page : pages)
+	{
+		const auto& pageStats = m_pageStats[page];
+		printf("Page: 0x%08X, Faults: %d, Checksum: %d, Modified Blocks: %d.\r\n",
+		       static_cast<uint32>(page * m_pageSize),
+		       pageStats.faultCount,
+		       pageStats.checksumEnabled ? 1 : 0,
+		       pageStats.modifiedBlockCount);
+	}
+}
+
+void CEeExecutor::DumpIdleLoops(const char* executableName) const
+{
+	typedef std::pair<uint32, const IDLE_LOOP*> IdleLoopItem;
+	std::vector<IdleLoopItem> idleLoops;
+	for(const auto& idleLoopPair : m_idleLoops)
+	{
+		idleLoops.push_back(std::make_pair(idleLoopPair.first, &idleLoopPair.second));
+	}
+	std::sort(idleLoops.begin(), idleLoops.end(),
+	          [](const IdleLoopItem& item1, const IdleLoopItem& item2) { return item1.second->idleCount > item2.second->idleCount; });
+
+	printf("Idle Loops\r\n");
+	printf("----------\r\n");
+	printf("Executable: %s\r\n", executableName);
+
+	for(const auto& idleLoopItem : idleLoops)
+	{
+		printf("Loop: 0x%08X - 0x%08X, Idle Exits: %llu.\r\n",
+		       idleLoopItem.first, idleLoopItem.second->end,
+		       static_cast<unsigned long long>(idleLoopItem.second->idleCount));
+	}
+}
+
+uint32 CEeExecutor::IsBlockCodeModified(CMIPS* context)
+{
+	auto executor = static_cast<CEeExecutor*>(context->m_executor.get());
+	auto block = executor->FindBlockStartingAt(context->m_State.nPC & executor->m_addressMask);
+	assert(dynamic_cast<CEeChecksumBlock*>(block));
+	return static_cast<CEeChecksumBlock*>(block)->IsCodeModified();
+}
+
+void CEeExecutor::HandleModifiedBlock(CMIPS* context)
+{
+	auto executor = static_cast<CEeExecutor*>(context->m_executor.get());
+	uint32 address = context->m_State.nPC & executor->m_addressMask;
+	executor->m_modifiedBlockAddress = address;
+	executor->m_pageStats[address / executor->m_pageSize].modifiedBlockCount++;
+	//Block can't be discarded while we're running it, leave the dispatcher and let Execute handle it
+	assert(context->m_State.nHasException == MIPS_EXCEPTION_NONE);
+	context->m_State.nHasException = MIPS_EXECUTION_STATUS_QUOTADONE;
+}
+
+bool CEeExecutor::CanTraceBlock(CBasicBlock* block) const
+{
+	//Traces don't check their code on entry and don't report idle loops
+	return (dynamic_cast<CEeChecksumBlock*>(block) == nullptr) && !block->IsIdleLoop();
+}
+
+//Gets the registers read and written by an instruction allowed in an idle loop. Anything that
+//can have side effects (stores, coprocessor operations, exceptions, jumps) isn't allowed.
+static bool GetIdleLoopInstructionRegisters(uint32 opcode, uint32& sources, uint32& destinations)
+{
+	uint32 rs = (opcode >> 21) & 0x1F;
+	uint32 rt = (opcode >> 16) & 0x1F;
+	uint32 rd = (opcode >> 11) & 0x1F;
+	sources = 0;
+	destinations = 0;
+	switch(opcode >> 26)
+	{
+	case 0x00:
+		switch(opcode & 0x3F)
+		{
+		case 0x00: //SLL
+		case 0x02: //SRL
+		case 0x03: //SRA
+		case 0x38: //DSLL
+		case 0x3A: //DSRL
+		case 0x3B: //DSRA
+		case 0x3C: //DSLL32
+		case 0x3E: //DSRL32
+		case 0x3F: //DSRA32
+			sources = (1 << rt);
+			destinations = (1 << rd);
+			break;
+		case 0x04: //SLLV
+		case 0x06: //SRLV
+		case 0x07: //SRAV
+		case 0x14: //DSLLV
+		case 0x16: //DSRLV
+		case 0x17: //DSRAV
+		case 0x21: //ADDU
+		case 0x23: //SUBU
+		case 0x24: //AND
+		case 0x25: //OR
+		case 0x26: //XOR
+		case 0x27: //NOR
+		case 0x2A: //SLT
+		case 0x2B: //SLTU
+		case 0x2D: //DADDU
+		case 0x2F: //DSUBU
+			sources = (1 << rs) | (1 << rt);
+			destinations = (1 << rd);
+			break;
+		default:
+			return false;
+		}
+		break;
+	case 0x09: //ADDIU
+	case 0x0A: //SLTI
+	case 0x0B: //SLTIU
+	case 0x0C: //ANDI
+	case 0x0D: //ORI
+	case 0x0E: //XORI
+	case 0x19: //DADDIU
+	case 0x1E: //LQ
+	case 0x20: //LB
+	case 0x21: //LH
+	case 0x23: //LW
+	case 0x24: //LBU
+	case 0x25: //LHU
+	case 0x27: //LWU
+	case 0x37: //LD
+		sources = (1 << rs);
+		destinations = (1 << rt);
+		break;
+	case 0x1A: //LDL
+	case 0x1B: //LDR
+	case 0x22: //LWL
+	case 0x26: //LWR
+		sources = (1 << rs) | (1 << rt);
+		destinations = (1 << rt);
+		break;
+	case 0x0F: //LUI
+		destinations = (1 << rt);
+		break;
+	default:
+		return false;
+	}
+	//R0 is never modified
+	sources &= ~1;
+	destinations &= ~1;
+	return true;
+}
+
+//Gets the target and the registers read by a conditional branch, returns false for other instructions
+static bool GetIdleLoopBranch(uint32 address, uint32 opcode, uint32& target, uint32& sources)
+{
+	uint32 rs = (opcode >> 21) & 0x1F;
+	uint32 rt = (opcode >> 16) & 0x1F;
+	switch(opcode >> 26)
+	{
+	case 0x01:
+		switch(rt)
+		{
+		case 0x00: //BLTZ
+		case 0x01: //BGEZ
+		case 0x02: //BLTZL
+		case 0x03: //BGEZL
+			sources = (1 << rs);
+			break;
+		default:
+			return false;
+		}
+		break;
+	case 0x04: //BEQ
+	case 0x05: //BNE
+	case 0x14: //BEQL
+	case 0x15: //BNEL
+		sources = (1 << rs) | (1 << rt);
+		break;
+	case 0x06: //BLEZ
+	case 0x07: //BGTZ
+	case 0x16: //BLEZL
+	case 0x17: //BGTZL
+		sources = (1 << rs);
+		break;
+	default:
+		return false;
+	}
+	sources &= ~1;
+	target = address + 4 + (static_cast<int16>(opcode & 0xFFFF) * 4);
+	return true;
+}
+
+//Gets the number of bytes read by a load instruction, 0 if the instruction isn't a load
+static uint32 GetIdleLoopLoadSize(uint32 opcode)
+{
+	switch(opcode >> 26)
+	{
+	case 0x20: //LB
+	case 0x24: //LBU
+		return 1;
+	case 0x21: //LH
+	case 0x25: //LHU
+		return 2;
+	case 0x22: //LWL
+	case 0x23: //LW
+	case 0x26: //LWR
+	case 0x27: //LWU
+		return 4;
+	case 0x1A: //LDL
+	case 0x1B: //LDR
+	case 0x37: //LD
+		return 8;
+	case 0x1E: //LQ
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+//Reading I/O registers (VIF/GIF/IPU FIFOs, SIF, etc.) can have side effects, only RAM and
+//scratchpad reads can be skipped
+static bool IsIdleLoopLoadAddressSafe(CMIPS& context, uint32 address, uint32 size)
+{
+	if(!context.m_pAddrTranslator) return false;
+	uint32 physBegin = context.m_pAddrTranslator(&context, address);
+	uint32 physEnd = context.m_pAddrTranslator(&context, address + size - 1);
+	if(physEnd < physBegin) return false;
+	if(physEnd < PS2::EE_RAM_SIZE) return true;
+	if((physBegin >= PS2::EE_SPR_ADDR) && (physEnd < (PS2::EE_SPR_ADDR + PS2::EE_SPR_SIZE))) return true;
+	return false;
+}
+
+//Idle loops are made of loads and computations followed by a branch to their beginning. Values
+//they compare can only change if something else (an interrupt handler, DMA, etc.) writes memory.
+//Registers written by the loop must be set before being read in the same iteration, otherwise the
+//loop computes something (a delay loop counting down for instance) and will end on its own.
+//Loads must provably read RAM or scratchpad: either relative to GP/SP or from an address built
+//with LUI earlier in the iteration.
+bool CEeExecutor::IsIdleLoop(CMIPS& context, uint32 start, uint32 end)
+{
+	//Loop needs at least a branch and its delay slot
+	if(end < (start + 4)) return false;
+	if(((end - start) / 4 + 1) > MAX_IDLE_LOOP_SIZE) return false;
+
+	uint32 branchAddress = end - 4;
+	uint32 branchTarget = 0;
+	uint32 branchSources = 0;
+	if(!GetIdleLoopBranch(branchAddress, context.m_pMemoryMap->GetInstruction(branchAddress), branchTarget, branchSources))
+	{
+		return false;
+	}
+	if(branchTarget != start) return false;
+
+	//Registers read by each instruction in execution order: body, branch and delay slot
+	uint32 sources[MAX_IDLE_LOOP_SIZE] = {};
+	uint32 destinations[MAX_IDLE_LOOP_SIZE] = {};
+	uint32 instructionCount = 0;
+	uint32 writtenRegisters = 0;
+	//Registers holding a value set by LUI in the current iteration
+	uint32 constantRegisters = 0;
+	uint32 constantValues[32] = {};
+	for(uint32 address = start; address <= end; address += 4)
+	{
+		auto& instructionSources = sources[instructionCount];
+		auto& instructionDestinations = destinations[instructionCount];
+		instructionCount++;
+		if(address == branchAddress)
+		{
+			instructionSources = branchSources;
+			continue;
+		}
+		uint32 opcode = context.m_pMemoryMap->GetInstruction(address);
+		if(!GetIdleLoopInstructionRegisters(opcode, instructionSources, instructionDestinations))
+		{
+			return false;
+		}
+		if(uint32 loadSize = GetIdleLoopLoadSize(opcode))
+		{
+			uint32 base = (opcode >> 21) & 0x1F;
+			if((base != CMIPS::GP) && (base != CMIPS::SP))
+			{
+				if((constantRegisters & (1 << base)) == 0) return false;
+				uint32 loadAddress = constantValues[base] + static_cast<int16>(opcode & 0xFFFF);
+				if(!IsIdleLoopLoadAddressSafe(context, loadAddress, loadSize)) return false;
+			}
+		}
+		constantRegisters &= ~instructionDestinations;
+		if((opcode >> 26) == 0x0F) //LUI
+		{
+			uint32 rt = (opcode >> 16) & 0x1F;
+			constantRegisters |= instructionDestinations;
+			constantValues[rt] = (opcode & 0xFFFF) << 16;
+		}
+		writtenRegisters |= instructionDestinations;
+	}
+
+	uint32 definedRegisters = 0;
+	for(uint32 i = 0; i < instructionCount; i++)
+	{
+		if((sources[i] & writtenRegisters & ~definedRegisters) != 0) return false;
+		definedRegisters |= destinations[i];
+	}
+
+	return true;
+}
+
+bool CEeExecutor::HasChecksumPages(uint32 start, uint32 end) const
+{
+	for(uint32 page = start / m_pageSize; page <= (end / m_pageSize); page++)
+	{
+		if(m_pageStats[page].checksumEnabled) return true;
+	}
+	return false;
+}
+
 bool CEeExecutor::HandleAccessFault(intptr_t ptr)
 {
 	ptrdiff_t addr = reinterpret_cast<uint8*>(ptr) - m_ram;
 	if(addr >= 0 && addr < PS2::EE_RAM_SIZE)
 	{
 		addr &= ~(m_pageSize - 1);
+		auto& pageStats = m_pageStats[addr / m_pageSize];
+		pageStats.faultCount++;
+		if(pageStats.faultCount >= PAGE_FAULT_THRESHOLD)
+		{
+			//Page probably holds data next to code, stop protecting it
+			pageStats.checksumEnabled = true;
+		}
 		ClearActiveBlocksInRange(addr, addr + m_pageSize, true);
 		return true;
 	}
@@ -9,6 +9,8 @@
 #include <signal.h>
 #endif
 
+#include <map>
+#include <vector>
 #include "../GenericMipsExecutor.h"
 
 class CEeExecutor : public CGenericMipsExecutor<BlockLookupTwoWay>
@@ -19,16 +21,62 @@ public:
 
 	void AddExceptionHandler();
 	void RemoveExceptionHandler();
+	//Needed for other threads that write to EE RAM while the EE is stopped
+	void AttachExceptionHandlerToThread();
 
+	int Execute(int) override;
 	void Reset() override;
 	void ClearActiveBlocksInRange(uint32, uint32, bool) override;
 
 	BasicBlockPtr BlockFactory(CMIPS&, uint32, uint32) override;
 
+	//When enabled, blocks that spin without side effects report that the CPU is idle
+	void SetIdleLoopDetectionEnabled(bool);
+
+	void DumpPageFaultStats() const;
+	void DumpIdleLoops(const char*) const;
+
+	//Called by code of blocks living on pages that aren't protected
+	static uint32 IsBlockCodeModified(CMIPS*);
+	static void HandleModifiedBlock(CMIPS*);
+
+protected:
+	bool CanTraceBlock(CBasicBlock*) const override;
+
 private:
+	enum
+	{
+		//Pages that fault this many times stop being protected
+		PAGE_FAULT_THRESHOLD = 8,
+		//Longest loop (in instructions) considered by idle loop detection
+		MAX_IDLE_LOOP_SIZE = 16,
+	};
+
+	struct PAGE_STATS
+	{
+		uint32 faultCount = 0;
+		uint32 modifiedBlockCount = 0;
+		bool checksumEnabled = false;
+	};
+	typedef std::vector<PAGE_STATS> PageStatsArray;
+
+	struct IDLE_LOOP
+	{
+		uint32 end = 0;
+		//Number of times execution stopped because the loop was taken
+		uint64 idleCount = 0;
+	};
+	typedef std::map<uint32, IDLE_LOOP> IdleLoopMap;
+
 	uint8* m_ram = nullptr;
 	size_t m_pageSize = 0;
+	PageStatsArray m_pageStats;
+	uint32 m_modifiedBlockAddress = MIPS_INVALID_PC;
+	bool m_idleLoopDetectionEnabled = false;
+	IdleLoopMap m_idleLoops;
 
+	static bool IsIdleLoop(CMIPS&, uint32, uint32);
+	bool HasChecksumPages(uint32, uint32) const;
 	bool HandleAccessFault(intptr_t);
 	void SetMemoryProtected(void*, size_t, bool);
 
@@ -67,24 +67,28 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 		//Read map
 		m_EE.m_pMemoryMap->InsertReadMap(0x00000000, 0x01FFFFFF, m_ram, 0x00);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::EE_SPR_ADDR, PS2::EE_SPR_ADDR + PS2::EE_SPR_SIZE - 1, m_spr, 0x01);
-		m_EE.m_pMemoryMap->InsertReadMap(0x10000000, 0x10FFFFFF, std::bind(&CSubSystem::IOPortReadHandler, this, PLACEHOLDER_1), 0x02);
+		m_EE.m_pMemoryMap->InsertReadMap(0x10000000, 0x10FFFFFF, &CMemoryMap::ReadHandlerProxy<CSubSystem, &CSubSystem::IOPortReadHandler>, this, 0x02);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM0ADDR, PS2::MICROMEM0ADDR + PS2::MICROMEM0SIZE - 1, m_microMem0, 0x03);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM0ADDR, PS2::VUMEM0ADDR + PS2::VUMEM0SIZE - 1, m_vuMem0, 0x04);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM1ADDR, PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1, m_microMem1, 0x05);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM1ADDR, PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1, m_vuMem1, 0x06);
-		m_EE.m_pMemoryMap->InsertReadMap(0x12000000, 0x12FFFFFF, std::bind(&CSubSystem::IOPortReadHandler, this, PLACEHOLDER_1), 0x07);
+		m_EE.m_pMemoryMap->InsertReadMap(0x12000000, 0x12FFFFFF, &CMemoryMap::ReadHandlerProxy<CSubSystem, &CSubSystem::IOPortReadHandler>, this, 0x07);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1C000000, 0x1C001000, m_fakeIopRam, 0x08);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1FC00000, 0x1FFFFFFF, m_bios, 0x09);
 
 		//Write map
 		m_EE.m_pMemoryMap->InsertWriteMap(0x00000000, 0x01FFFFFF, m_ram, 0x00);
 		m_EE.m_pMemoryMap->InsertWriteMap(PS2::EE_SPR_ADDR, PS2::EE_SPR_ADDR + PS2::EE_SPR_SIZE - 1, m_spr, 0x01);
-		m_EE.m_pMemoryMap->InsertWriteMap(0x10000000, 0x10FFFFFF, std::bind(&CSubSystem::IOPortWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x02);
-		m_EE.m_pMemoryMap->InsertWriteMap(PS2::MICROMEM0ADDR, PS2::MICROMEM0ADDR + PS2::MICROMEM0SIZE - 1, std::bind(&CSubSystem::Vu0MicroMemWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x03);
+		m_EE.m_pMemoryMap->InsertWriteMap(0x10000000, 0x10FFFFFF, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::IOPortWriteHandler>, this, 0x02);
+		m_EE.m_pMemoryMap->InsertWriteMap(PS2::MICROMEM0ADDR, PS2::MICROMEM0ADDR + PS2::MICROMEM0SIZE - 1, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu0MicroMemWriteHandler>, this, 0x03);
 		m_EE.m_pMemoryMap->InsertWriteMap(PS2::VUMEM0ADDR, PS2::VUMEM0ADDR + PS2::VUMEM0SIZE - 1, m_vuMem0, 0x04);
-		m_EE.m_pMemoryMap->InsertWriteMap(PS2::MICROMEM1ADDR, PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1, std::bind(&CSubSystem::Vu1MicroMemWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x05);
+		m_EE.m_pMemoryMap->InsertWriteMap(PS2::MICROMEM1ADDR, PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu1MicroMemWriteHandler>, this, 0x05);
 		m_EE.m_pMemoryMap->InsertWriteMap(PS2::VUMEM1ADDR, PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1, m_vuMem1, 0x06);
-		m_EE.m_pMemoryMap->InsertWriteMap(0x12000000, 0x12FFFFFF, std::bind(&CSubSystem::IOPortWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x07);
+		m_EE.m_pMemoryMap->InsertWriteMap(0x12000000, 0x12FFFFFF, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::IOPortWriteHandler>, this, 0x07);
+
+		//VU1 microprograms might be running on another thread
+		m_EE.m_pMemoryMap->SetMemoryAccessHandler(PS2::MICROMEM1ADDR, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu1MemoryAccessHandler>, this);
+		m_EE.m_pMemoryMap->SetMemoryAccessHandler(PS2::VUMEM1ADDR, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu1MemoryAccessHandler>, this);
 
 		//Instruction map
 		m_EE.m_pMemoryMap->InsertInstructionMap(0x00000000, 0x01FFFFFF, m_ram, 0x00);
@@ -106,13 +110,13 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 		m_VU0.m_pMemoryMap->InsertReadMap(0x00001000, 0x00001FFF, m_vuMem0, 0x02);
 		m_VU0.m_pMemoryMap->InsertReadMap(0x00002000, 0x00002FFF, m_vuMem0, 0x03);
 		m_VU0.m_pMemoryMap->InsertReadMap(0x00003000, 0x00003FFF, m_vuMem0, 0x04);
-		m_VU0.m_pMemoryMap->InsertReadMap(0x00004000, 0x00008FFF, std::bind(&CSubSystem::Vu0IoPortReadHandler, this, PLACEHOLDER_1), 0x05);
+		m_VU0.m_pMemoryMap->InsertReadMap(0x00004000, 0x00008FFF, &CMemoryMap::ReadHandlerProxy<CSubSystem, &CSubSystem::Vu0IoPortReadHandler>, this, 0x05);
 
 		m_VU0.m_pMemoryMap->InsertWriteMap(0x00000000, 0x00000FFF, m_vuMem0, 0x01);
 		m_VU0.m_pMemoryMap->InsertWriteMap(0x00001000, 0x00001FFF, m_vuMem0, 0x02);
 		m_VU0.m_pMemoryMap->InsertWriteMap(0x00002000, 0x00002FFF, m_vuMem0, 0x03);
 		m_VU0.m_pMemoryMap->InsertWriteMap(0x00003000, 0x00003FFF, m_vuMem0, 0x04);
-		m_VU0.m_pMemoryMap->InsertWriteMap(0x00004000, 0x00008FFF, std::bind(&CSubSystem::Vu0IoPortWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x05);
+		m_VU0.m_pMemoryMap->InsertWriteMap(0x00004000, 0x00008FFF, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu0IoPortWriteHandler>, this, 0x05);
 
 		m_VU0.m_pMemoryMap->InsertInstructionMap(0x00000000, 0x00000FFF, m_microMem0, 0x00);
 
@@ -125,10 +129,10 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 		m_VU1.m_executor = std::make_unique<CVuExecutor>(m_VU1, PS2::MICROMEM1SIZE);
 
 		m_VU1.m_pMemoryMap->InsertReadMap(0x00000000, 0x00003FFF, m_vuMem1, 0x00);
-		m_VU1.m_pMemoryMap->InsertReadMap(0x00008000, 0x00008FFF, std::bind(&CSubSystem::Vu1IoPortReadHandler, this, PLACEHOLDER_1), 0x01);
+		m_VU1.m_pMemoryMap->InsertReadMap(0x00008000, 0x00008FFF, &CMemoryMap::ReadHandlerProxy<CSubSystem, &CSubSystem::Vu1IoPortReadHandler>, this, 0x01);
 
 		m_VU1.m_pMemoryMap->InsertWriteMap(0x00000000, 0x00003FFF, m_vuMem1, 0x00);
-		m_VU1.m_pMemoryMap->InsertWriteMap(0x00008000, 0x00008FFF, std::bind(&CSubSystem::Vu1IoPortWriteHandler, this, PLACEHOLDER_1, PLACEHOLDER_2), 0x01);
+		m_VU1.m_pMemoryMap->InsertWriteMap(0x00008000, 0x00008FFF, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::Vu1IoPortWriteHandler>, this, 0x01);
 
 		m_VU1.m_pMemoryMap->InsertInstructionMap(0x00000000, 0x00003FFF, m_microMem1, 0x01);
 
@@ -142,7 +146,7 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_VIF0, std::bind(&CVif::ReceiveDMA, &m_vpu0->GetVif(), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_VIF1, std::bind(&CVif::ReceiveDMA, &m_vpu1->GetVif(), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
-	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_GIF, std::bind(&CGIF::ReceiveDMA, &m_gif, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
+	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_GIF, std::bind(&CSubSystem::ReceiveGifDma, this, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_TO_IPU, std::bind(&CIPU::ReceiveDMA4, &m_ipu, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_4, m_ram));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_SIF0, std::bind(&CSIF::ReceiveDMA5, &m_sif, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
 	m_dmac.SetChannelTransferFunction(CDMAC::CHANNEL_ID_SIF1, std::bind(&CSIF::ReceiveDMA6, &m_sif, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3, PLACEHOLDER_4));
@@ -179,8 +183,70 @@ void CSubSystem::SetVpu1(std::shared_ptr<CVpu> newVpu1)
 	m_vpu1 = newVpu1;
 }
 
+void CSubSystem::SetAsyncCompileEnabled(bool enabled)
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->SetAsyncCompileEnabled(enabled);
+}
+
+void CSubSystem::SetBlockCache(CJitBlockCache* blockCache)
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->SetBlockCache(blockCache);
+}
+
+void CSubSystem::SetHotTraceEnabled(bool enabled)
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->SetHotTraceEnabled(enabled);
+}
+
+void CSubSystem::SetIdleLoopDetectionEnabled(bool enabled)
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->SetIdleLoopDetectionEnabled(enabled);
+}
+
+void CSubSystem::DumpTraceProfile() const
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->DumpTraceProfile();
+}
+
+void CSubSystem::DumpPageFaultStats() const
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->DumpPageFaultStats();
+}
+
+void CSubSystem::DumpIdleLoops() const
+{
+	static_cast<CEeExecutor*>(m_EE.m_executor.get())->DumpIdleLoops(m_os->GetExecutableName());
+}
+
+CCodeArena::STATS CSubSystem::GetEeCodeArenaStats() const
+{
+	return static_cast<CEeExecutor*>(m_EE.m_executor.get())->GetCodeArenaStats();
+}
+
+CCodeArena::STATS CSubSystem::GetVuCodeArenaStats(unsigned int vuNumber) const
+{
+	assert(vuNumber < 2);
+	const auto& vu = (vuNumber == 0) ? m_VU0 : m_VU1;
+	return static_cast<CVuExecutor*>(vu.m_executor.get())->GetCodeArenaStats();
+}
+
+CJitBlockCache& CSubSystem::GetVuMicroprogramCache(unsigned int vuNumber)
+{
+	assert(vuNumber < 2);
+	auto& vu = (vuNumber == 0) ? m_VU0 : m_VU1;
+	return static_cast<CVuExecutor*>(vu.m_executor.get())->GetMicroprogramCache();
+}
+
+CVuExecutor::MICROPROGRAM_CACHE_STATS CSubSystem::GetVuMicroprogramCacheStats(unsigned int vuNumber) const
+{
+	assert(vuNumber < 2);
+	const auto& vu = (vuNumber == 0) ? m_VU0 : m_VU1;
+	return static_cast<CVuExecutor*>(vu.m_executor.get())->GetMicroprogramCacheStats();
+}
+
 void CSubSystem::Reset()
 {
+	m_vpu1->WaitForMicroProgram();
 	m_os->Release();
 	m_EE.m_executor->Reset();
 
@@ -331,6 +397,23 @@ void CSubSystem::CountTicks(int ticks)
 	CheckPendingInterrupts();
 }
 
+uint64 CSubSystem::GetTicksUntilNextEvent() const
+{
+	//Work in progress is only moved forward by CountTicks, which is called once per idle stretch
+	if(
+	    m_EE.m_State.nHasException ||
+	    m_intc.IsInterruptPending() ||
+	    m_vpu0->IsVuRunning() ||
+	    m_vpu1->IsVuRunning() ||
+	    m_dmac.IsAnyChannelStarted() ||
+	    m_ipu.WillExecuteCommand() ||
+	    m_sif.HasPendingPackets())
+	{
+		return 0;
+	}
+	return m_timer.GetTicksUntilNextEvent();
+}
+
 void CSubSystem::NotifyVBlankStart()
 {
 	m_timer.NotifyVBlankStart();
@@ -351,6 +434,8 @@ void CSubSystem::NotifyVBlankEnd()
 
 void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 {
+	m_vpu1->WaitForMicroProgram();
+
 	archive.InsertFile(new CMemoryStateFile(STATE_EE, &m_EE.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU0, &m_VU0.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU1, &m_VU1.m_State, sizeof(MIPSSTATE)));
@@ -372,6 +457,7 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 
 void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 {
+	m_vpu1->WaitForMicroProgram();
 	m_EE.m_executor->Reset();
 
 	archive.BeginReadFile(STATE_EE)->Read(&m_EE.m_State, sizeof(MIPSSTATE));
@@ -414,6 +500,7 @@ uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
 	}
 	else if(nAddress >= CGIF::REGS_START && nAddress < CGIF::REGS_END)
 	{
+		m_vpu1->WaitForMicroProgram();
 		nReturn = m_gif.GetRegister(nAddress);
 	}
 	else if(nAddress >= CVif::REGS0_START && nAddress < CVif::REGS0_END)
@@ -440,6 +527,7 @@ uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
 	{
 		if(m_gs != NULL)
 		{
+			m_vpu1->WaitForMicroProgram();
 			nReturn = m_gs->ReadPrivRegister(nAddress);
 		}
 	}
@@ -476,6 +564,7 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	}
 	else if(nAddress >= CGIF::REGS_START && nAddress < CGIF::REGS_END)
 	{
+		m_vpu1->WaitForMicroProgram();
 		m_gif.SetRegister(nAddress, nData);
 	}
 	else if(nAddress >= CVif::REGS0_START && nAddress < CVif::REGS0_END)
@@ -484,6 +573,7 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	}
 	else if(nAddress >= CVif::REGS1_START && nAddress < CVif::REGS1_END)
 	{
+		m_vpu1->WaitForMicroProgram();
 		m_vpu1->GetVif().SetRegister(nAddress, nData);
 	}
 	else if(nAddress >= CVif::VIF0_FIFO_START && nAddress < CVif::VIF0_FIFO_END)
@@ -511,6 +601,7 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	else if(nAddress == 0x1000F180)
 	{
 		//stdout data
+		m_sif.SyncIop();
 		m_iopBios.GetIoman()->Write(Iop::CIoman::FID_STDOUT, 1, &nData);
 	}
 	else if(nAddress >= 0x1000F520 && nAddress <= 0x1000F59C)
@@ -529,6 +620,7 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	{
 		if(m_gs != NULL)
 		{
+			m_vpu1->WaitForMicroProgram();
 			m_gs->WritePrivRegister(nAddress, nData);
 		}
 	}
@@ -585,11 +677,18 @@ uint32 CSubSystem::Vu0IoPortWriteHandler(uint32 address, uint32 value)
 
 uint32 CSubSystem::Vu1MicroMemWriteHandler(uint32 address, uint32 value)
 {
+	m_vpu1->WaitForMicroProgram();
 	*reinterpret_cast<uint32*>(m_microMem1 + (address - PS2::MICROMEM1ADDR)) = value;
 	m_vpu1->InvalidateMicroProgram();
 	return 0;
 }
 
+uint32 CSubSystem::Vu1MemoryAccessHandler(uint32, uint32)
+{
+	m_vpu1->WaitForMicroProgram();
+	return 0;
+}
+
 uint32 CSubSystem::Vu1IoPortReadHandler(uint32 address)
 {
 	uint32 result = 0xCCCCCCCC;
@@ -637,6 +736,13 @@ void CSubSystem::CopyVuState(CMIPS& dst, const CMIPS& src)
 	}
 }
 
+uint32 CSubSystem::ReceiveGifDma(uint32 address, uint32 qwc, uint32 direction, bool tagIncluded)
+{
+	//Packets kicked by VU1 must reach the GIF before PATH3 ones
+	m_vpu1->WaitForMicroProgram();
+	return m_gif.ReceiveDMA(address, qwc, direction, tagIncluded);
+}
+
 void CSubSystem::ExecuteIpu()
 {
 	m_dmac.ResumeDMA4();
@@ -16,6 +16,9 @@
 #include "COP_VU.h"
 #include "PS2OS.h"
 #include "../gs/GSHandler.h"
+#include "../JitBlockCache.h"
+#include "VuExecutor.h"
+#include "../CodeArena.h"
 
 #include "signal/Signal.h"
 
@@ -31,6 +34,8 @@ namespace Ee
 		int ExecuteCpu(int);
 		bool IsCpuIdle() const;
 		void CountTicks(int);
+		//Ticks the CPU can stay idle without missing a device event, 0 if devices have work in progress
+		uint64 GetTicksUntilNextEvent() const;
 
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
@@ -41,6 +46,19 @@ namespace Ee
 		void SetVpu0(std::shared_ptr<CVpu>);
 		void SetVpu1(std::shared_ptr<CVpu>);
 
+		void SetAsyncCompileEnabled(bool);
+		void SetBlockCache(CJitBlockCache*);
+		void SetHotTraceEnabled(bool);
+		void SetIdleLoopDetectionEnabled(bool);
+		void DumpTraceProfile() const;
+		void DumpPageFaultStats() const;
+		void DumpIdleLoops() const;
+
+		CCodeArena::STATS GetEeCodeArenaStats() const;
+		CCodeArena::STATS GetVuCodeArenaStats(unsigned int) const;
+		CJitBlockCache& GetVuMicroprogramCache(unsigned int);
+		CVuExecutor::MICROPROGRAM_CACHE_STATS GetVuMicroprogramCacheStats(unsigned int) const;
+
 		uint8* m_ram = nullptr;
 		uint8* m_bios = nullptr;
 		uint8* m_spr = nullptr;
@@ -92,12 +110,15 @@ namespace Ee
 		uint32 Vu0IoPortWriteHandler(uint32, uint32);
 
 		uint32 Vu1MicroMemWriteHandler(uint32, uint32);
+		uint32 Vu1MemoryAccessHandler(uint32, uint32);
 
 		uint32 Vu1IoPortReadHandler(uint32);
 		uint32 Vu1IoPortWriteHandler(uint32, uint32);
 
 		void CopyVuState(CMIPS&, const CMIPS&);
 
+		uint32 ReceiveGifDma(uint32, uint32, uint32, bool);
+
 		void ExecuteIpu();
 
 		void CheckPendingInterrupts();
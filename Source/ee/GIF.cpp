@@ -388,6 +388,34 @@ uint32 CGIF::ProcessMultiplePackets(const uint8* memory, uint32 address, uint32
 	return address - start;
 }
 
+uint32 CGIF::GetPacketSize(const uint8* memory, uint32 address, uint32 end)
+{
+	uint32 start = address;
+	while(address < end)
+	{
+		auto tag = *reinterpret_cast<const TAG*>(&memory[address]);
+		address += 0x10;
+		uint32 regs = (tag.nreg == 0) ? 0x10 : tag.nreg;
+		switch(tag.cmd)
+		{
+		case 0x00:
+			//PACKED
+			address += tag.loops * regs * 0x10;
+			break;
+		case 0x01:
+			//REGLIST, aligned on qword boundary
+			address += ((tag.loops * regs * 0x08) + 0x0F) & ~0x0F;
+			break;
+		default:
+			//IMAGE
+			address += tag.loops * 0x10;
+			break;
+		}
+		if(tag.eop) break;
+	}
+	return std::min(address, end) - start;
+}
+
 uint32 CGIF::ReceiveDMA(uint32 address, uint32 qwc, uint32 unused, bool tagIncluded)
 {
 	uint32 size = qwc * 0x10;
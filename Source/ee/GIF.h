@@ -49,6 +49,9 @@ public:
 	uint32 ProcessSinglePacket(const uint8*, uint32, uint32, const CGsPacketMetadata&);
 	uint32 ProcessMultiplePackets(const uint8*, uint32, uint32, const CGsPacketMetadata&);
 
+	//Returns the size of the packet starting at a given address, up to and including the EOP tag's data
+	static uint32 GetPacketSize(const uint8*, uint32, uint32);
+
 	uint32 GetRegister(uint32);
 	void SetRegister(uint32, uint32);
 
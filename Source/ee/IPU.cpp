@@ -17,9 +17,8 @@
 #include "mpeg2/CodedBlockPatternTable.h"
 #include "mpeg2/QuantiserScaleTable.h"
 #include "mpeg2/InverseScanTable.h"
-#include "idct/TrivialC.h"
-#include "idct/IEEE1180.h"
 #include "../Log.h"
+#include "IpuKernels.h"
 #include "DMAC.h"
 #include "INTC.h"
 
@@ -419,6 +418,7 @@ void CIPU::DequantiseBlock(int16* pBlock, uint8 nMBI, uint8 nQSC, bool isLinearQ
 		nQuantScale = (int16)CQuantiserScaleTable::m_nTable1[nQSC];
 	}
 
+	const auto& kernels = CIpuKernels::GetKernels();
 	if(nMBI == 1)
 	{
 		int16 nIntraDcMult = 0;
@@ -436,77 +436,11 @@ void CIPU::DequantiseBlock(int16* pBlock, uint8 nMBI, uint8 nQSC, bool isLinearQ
 			break;
 		}
 
-		pBlock[0] = nIntraDcMult * pBlock[0];
-
-		for(unsigned int i = 1; i < 64; i++)
-		{
-			int16 nSign = 0;
-
-			if(pBlock[i] == 0)
-			{
-				nSign = 0;
-			}
-			else
-			{
-				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
-			}
-
-			pBlock[i] = (pBlock[i] * static_cast<int16>(intraIq[i]) * nQuantScale * 2) / 32;
-
-			if(nSign != 0)
-			{
-				if((pBlock[i] & 1) == 0)
-				{
-					pBlock[i] = (pBlock[i] - nSign) | 1;
-				}
-			}
-		}
+		kernels.dequantiseIntraBlock(pBlock, intraIq, nQuantScale, nIntraDcMult);
 	}
 	else
 	{
-		for(unsigned int i = 0; i < 64; i++)
-		{
-			int16 nSign = 0;
-
-			if(pBlock[i] == 0)
-			{
-				nSign = 0;
-			}
-			else
-			{
-				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
-			}
-
-			pBlock[i] = (((pBlock[i] * 2) + nSign) * static_cast<int16>(nonIntraIq[i]) * nQuantScale) / 32;
-
-			if(nSign != 0)
-			{
-				if((pBlock[i] & 1) == 0)
-				{
-					pBlock[i] = (pBlock[i] - nSign) | 1;
-				}
-			}
-		}
-	}
-
-	//Saturate
-	int16 nSum = 0;
-
-	for(unsigned int i = 0; i < 64; i++)
-	{
-		if(pBlock[i] > 2047)
-		{
-			pBlock[i] = 2047;
-		}
-		if(pBlock[i] < -2048)
-		{
-			pBlock[i] = -2048;
-		}
-		nSum += pBlock[i];
-	}
-
-	if(nSum & 1)
-	{
+		kernels.dequantiseNonIntraBlock(pBlock, nonIntraIq, nQuantScale, 0);
 	}
 }
 
@@ -952,7 +886,7 @@ bool CIPU::CIDECCommand::Execute()
 		break;
 		case STATE_READMBTYPE:
 		{
-			if(FilterSymbolError(CMacroblockTypeITable::GetInstance()->TryGetSymbol(m_IN_FIFO, m_mbType)) != CVLCTable::DECODE_STATUS_SUCCESS)
+			if(FilterSymbolError(CVLCLookupTable::GetInstance<CMacroblockTypeITable>().TryGetSymbol(m_IN_FIFO, m_mbType)) != CVLCTable::DECODE_STATUS_SUCCESS)
 			{
 				return false;
 			}
@@ -1081,7 +1015,7 @@ bool CIPU::CIDECCommand::Execute()
 		case STATE_READMBINCREMENT:
 		{
 			uint32 mbIncrement = 0;
-			if(CMacroblockAddressIncrementTable::GetInstance()->TryGetSymbol(m_IN_FIFO, mbIncrement) != CVLCTable::DECODE_STATUS_SUCCESS)
+			if(CVLCLookupTable::GetInstance<CMacroblockAddressIncrementTable>().TryGetSymbol(m_IN_FIFO, mbIncrement) != CVLCTable::DECODE_STATUS_SUCCESS)
 			{
 				return false;
 			}
@@ -1180,7 +1114,7 @@ bool CIPU::CBDECCommand::Execute()
 			if(!m_command.mbi)
 			{
 				//Not an Intra Macroblock, so we need to fetch the pattern code
-				m_codedBlockPattern = static_cast<uint8>(CCodedBlockPatternTable::GetInstance()->GetSymbol(m_IN_FIFO));
+				m_codedBlockPattern = static_cast<uint8>(CVLCLookupTable::GetInstance<CCodedBlockPatternTable>().GetSymbol(m_IN_FIFO));
 			}
 			else
 			{
@@ -1260,7 +1194,7 @@ bool CIPU::CBDECCommand::Execute()
 
 			memcpy(blockTemp, blockInfo.block, sizeof(int16) * 0x40);
 
-			IDCT::CIEEE1180::GetInstance()->Transform(blockTemp, blockInfo.block);
+			CIpuKernels::GetKernels().idct(blockTemp, blockInfo.block);
 
 			m_state = STATE_DECODEBLOCK_GOTONEXT;
 		}
@@ -1325,6 +1259,7 @@ CIPU::CBDECCommand_ReadDct::CBDECCommand_ReadDct()
     : m_state(STATE_INIT)
     , m_IN_FIFO(NULL)
     , m_coeffTable(NULL)
+    , m_coeffLookupTable(NULL)
     , m_block(NULL)
     , m_dcPredictor(NULL)
     , m_dcDiff(0)
@@ -1347,16 +1282,19 @@ void CIPU::CBDECCommand_ReadDct::Initialize(CINFIFO* fifo, int16* block, unsigne
 	m_isMpeg1CoeffVLCTable = isMpeg1CoeffVLCTable;
 	m_isMpeg2 = isMpeg2;
 	m_coeffTable = NULL;
+	m_coeffLookupTable = NULL;
 	m_blockIndex = 0;
 	m_dcDiff = 0;
 
 	if(m_mbi && !m_isMpeg1CoeffVLCTable)
 	{
 		m_coeffTable = &CDctCoefficientTable1::GetInstance();
+		m_coeffLookupTable = &CDctCoefficientLookupTable::GetTable1Instance();
 	}
 	else
 	{
 		m_coeffTable = &CDctCoefficientTable0::GetInstance();
+		m_coeffLookupTable = &CDctCoefficientLookupTable::GetTable0Instance();
 	}
 }
 
@@ -1401,6 +1339,14 @@ bool CIPU::CBDECCommand_ReadDct::Execute()
 		break;
 		case STATE_CHECKEOB:
 		{
+			if(ReadCoefficientsFromLookup())
+			{
+#ifdef _DECODE_LOGGING
+				CLog::GetInstance().Print(DECODE_LOG_NAME, "\r\n");
+#endif
+				return true;
+			}
+			//Symbol couldn't be resolved from the lookup table, go through the generic decoder
 			bool isEob = false;
 			if(m_coeffTable->TryIsEndOfBlock(m_IN_FIFO, isEob) != CVLCTable::DECODE_STATUS_SUCCESS)
 			{
@@ -1465,6 +1411,50 @@ bool CIPU::CBDECCommand_ReadDct::Execute()
 	}
 }
 
+//Decodes as many symbols as possible from a single window of the input FIFO, returns true
+//if the end of block was reached. Stops on the first symbol that needs the generic decoder.
+bool CIPU::CBDECCommand_ReadDct::ReadCoefficientsFromLookup()
+{
+	static const unsigned int windowSize = 32;
+
+	uint32 window = 0;
+	if(!m_IN_FIFO->TryPeekBits_MSBF(windowSize, window))
+	{
+		return false;
+	}
+
+	unsigned int usedBits = 0;
+	while((usedBits + CDctCoefficientLookupTable::LOOKUP_BITS) <= windowSize)
+	{
+		uint32 bits = window << usedBits;
+		const auto& entry = (m_blockIndex == 0) ? m_coeffLookupTable->GetFirstEntry(bits) : m_coeffLookupTable->GetEntry(bits);
+		if(entry.length == 0)
+		{
+			break;
+		}
+		usedBits += entry.length;
+		if(entry.run == CDctCoefficientLookupTable::RUN_ENDOFBLOCK)
+		{
+			m_IN_FIFO->Advance(static_cast<uint8>(usedBits));
+			return true;
+		}
+		m_blockIndex += entry.run;
+		if(m_blockIndex >= 0x40)
+		{
+			m_IN_FIFO->Advance(static_cast<uint8>(usedBits));
+			throw CVLCTable::CVLCTableException();
+		}
+		m_block[m_blockIndex] = entry.level;
+#ifdef _DECODE_LOGGING
+		CLog::GetInstance().Print(DECODE_LOG_NAME, "[%d]: %d ", m_blockIndex, entry.level);
+#endif
+		m_blockIndex++;
+	}
+
+	m_IN_FIFO->Advance(static_cast<uint8>(usedBits));
+	return false;
+}
+
 /////////////////////////////////////////////
 //BDEC ReadDcDiff subcommand implementation
 /////////////////////////////////////////////
@@ -1498,14 +1488,14 @@ bool CIPU::CBDECCommand_ReadDcDiff::Execute()
 			switch(m_channelId)
 			{
 			case 0:
-				if(CDcSizeLuminanceTable::GetInstance()->TryGetSymbol(m_IN_FIFO, dcSize) != CVLCTable::DECODE_STATUS_SUCCESS)
+				if(CVLCLookupTable::GetInstance<CDcSizeLuminanceTable>().TryGetSymbol(m_IN_FIFO, dcSize) != CVLCTable::DECODE_STATUS_SUCCESS)
 				{
 					return false;
 				}
 				break;
 			case 1:
 			case 2:
-				if(CDcSizeChrominanceTable::GetInstance()->TryGetSymbol(m_IN_FIFO, dcSize) != CVLCTable::DECODE_STATUS_SUCCESS)
+				if(CVLCLookupTable::GetInstance<CDcSizeChrominanceTable>().TryGetSymbol(m_IN_FIFO, dcSize) != CVLCTable::DECODE_STATUS_SUCCESS)
 				{
 					return false;
 				}
@@ -1574,7 +1564,7 @@ void CIPU::CVDECCommand::Initialize(CINFIFO* fifo, uint32 commandCode, uint32 pi
 	{
 	case 0:
 		//Macroblock Address Increment
-		m_table = CMacroblockAddressIncrementTable::GetInstance();
+		m_table = &CVLCLookupTable::GetInstance<CMacroblockAddressIncrementTable>();
 		break;
 	case 1:
 		//Macroblock Type
@@ -1582,15 +1572,15 @@ void CIPU::CVDECCommand::Initialize(CINFIFO* fifo, uint32 commandCode, uint32 pi
 		{
 		case 1:
 			//I Picture
-			m_table = CMacroblockTypeITable::GetInstance();
+			m_table = &CVLCLookupTable::GetInstance<CMacroblockTypeITable>();
 			break;
 		case 2:
 			//P Picture
-			m_table = CMacroblockTypePTable::GetInstance();
+			m_table = &CVLCLookupTable::GetInstance<CMacroblockTypePTable>();
 			break;
 		case 3:
 			//B Picture
-			m_table = CMacroblockTypeBTable::GetInstance();
+			m_table = &CVLCLookupTable::GetInstance<CMacroblockTypeBTable>();
 			break;
 		default:
 			assert(0);
@@ -1599,10 +1589,10 @@ void CIPU::CVDECCommand::Initialize(CINFIFO* fifo, uint32 commandCode, uint32 pi
 		}
 		break;
 	case 2:
-		m_table = CMotionCodeTable::GetInstance();
+		m_table = &CVLCLookupTable::GetInstance<CMotionCodeTable>();
 		break;
 	case 3:
-		m_table = CDmVectorTable::GetInstance();
+		m_table = &CVLCLookupTable::GetInstance<CDmVectorTable>();
 		break;
 	default:
 		assert(0);
@@ -1632,22 +1622,23 @@ bool CIPU::CVDECCommand::Execute()
 		case STATE_DONE:
 #ifdef _DECODE_LOGGING
 			const char* tableName = "unknown";
-			if(m_table == CMacroblockAddressIncrementTable::GetInstance())
+			auto table = m_table->GetTable();
+			if(table == CMacroblockAddressIncrementTable::GetInstance())
 			{
 				tableName = "mb increment";
 			}
 			else if(
-			    (m_table == CMacroblockTypeITable::GetInstance()) ||
-			    (m_table == CMacroblockTypePTable::GetInstance()) ||
-			    (m_table == CMacroblockTypeBTable::GetInstance()))
+			    (table == CMacroblockTypeITable::GetInstance()) ||
+			    (table == CMacroblockTypePTable::GetInstance()) ||
+			    (table == CMacroblockTypeBTable::GetInstance()))
 			{
 				tableName = "mb type";
 			}
-			else if(m_table == CMotionCodeTable::GetInstance())
+			else if(table == CMotionCodeTable::GetInstance())
 			{
 				tableName = "motion code";
 			}
-			else if(m_table == CDmVectorTable::GetInstance())
+			else if(table == CDmVectorTable::GetInstance())
 			{
 				tableName = "dm vector";
 			}
@@ -1769,11 +1760,6 @@ bool CIPU::CSETVQCommand::Execute()
 //CSC command implementation
 /////////////////////////////////////////////
 
-CIPU::CCSCCommand::CCSCCommand()
-{
-	GenerateCbCrMap();
-}
-
 void CIPU::CCSCCommand::Initialize(CINFIFO* input, COUTFIFO* output, uint32 commandCode, uint16 TH0, uint16 TH1)
 {
 	m_command <<= commandCode;
@@ -1829,79 +1815,20 @@ bool CIPU::CCSCCommand::Execute()
 		break;
 		case STATE_CONVERTBLOCK:
 		{
-			uint32 nPixel[0x100];
-
-			uint8* pY = m_block;
-			uint8* nBlockCb = m_block + 0x100;
-			uint8* nBlockCr = m_block + 0x140;
-
-			uint32* pPixel = nPixel;
-			unsigned int* pCbCrMap = m_nCbCrMap;
-
-			uint32 alphaTh0 = (m_TH0 & 0xFF) | ((m_TH0 & 0xFF) << 8) | ((m_TH0 & 0xFF) << 16);
-			uint32 alphaTh1 = (m_TH1 & 0xFF) | ((m_TH1 & 0xFF) << 8) | ((m_TH1 & 0xFF) << 16);
-
-			for(unsigned int i = 0; i < 16; i++)
+			const auto& kernels = CIpuKernels::GetKernels();
+			if(m_command.ofm)
 			{
-				for(unsigned int j = 0; j < 16; j++)
-				{
-					float nY = pY[j];
-					float nCb = nBlockCb[pCbCrMap[j]];
-					float nCr = nBlockCr[pCbCrMap[j]];
-
-					float nR = nY + 1.402f * (nCr - 128);
-					float nG = nY - 0.34414f * (nCb - 128) - 0.71414f * (nCr - 128);
-					float nB = nY + 1.772f * (nCb - 128);
-
-					if(nR < 0)
-					{
-						nR = 0;
-					}
-					if(nR > 255)
-					{
-						nR = 255;
-					}
-					if(nG < 0)
-					{
-						nG = 0;
-					}
-					if(nG > 255)
-					{
-						nG = 255;
-					}
-					if(nB < 0)
-					{
-						nB = 0;
-					}
-					if(nB > 255)
-					{
-						nB = 255;
-					}
-
-					uint8 a = 0;
-					uint32 rgb = (static_cast<uint8>(nB) << 16) | (static_cast<uint8>(nG) << 8) | (static_cast<uint8>(nR) << 0);
-					if(rgb < alphaTh0)
-					{
-						a = 0;
-					}
-					else if(rgb < alphaTh1)
-					{
-						a = 0x40;
-					}
-					else
-					{
-						a = 0x80;
-					}
-
-					pPixel[j] = (a << 24) | rgb;
-				}
-
-				pY += 0x10;
-				pCbCrMap += 0x10;
-				pPixel += 0x10;
+				uint16 pixels[CIpuKernels::MACROBLOCK_PIXELS];
+				auto convertRgb16 = m_command.dte ? kernels.convertRgb16Dithered : kernels.convertRgb16;
+				convertRgb16(pixels, m_block, m_TH0, m_TH1);
+				m_OUT_FIFO->Write(pixels, sizeof(pixels));
+			}
+			else
+			{
+				uint32 pixels[CIpuKernels::MACROBLOCK_PIXELS];
+				kernels.convertRgb32(pixels, m_block, m_TH0, m_TH1);
+				m_OUT_FIFO->Write(pixels, sizeof(pixels));
 			}
-
-			m_OUT_FIFO->Write(nPixel, sizeof(uint32) * 0x100);
 
 			m_mbCount--;
 			m_state = STATE_FLUSHBLOCK;
@@ -1924,24 +1851,6 @@ bool CIPU::CCSCCommand::Execute()
 	}
 }
 
-void CIPU::CCSCCommand::GenerateCbCrMap()
-{
-	unsigned int* pCbCrMap = m_nCbCrMap;
-	for(unsigned int i = 0; i < 0x40; i += 0x8)
-	{
-		for(unsigned int j = 0; j < 0x10; j += 2)
-		{
-			pCbCrMap[j + 0x00] = (j / 2) + i;
-			pCbCrMap[j + 0x01] = (j / 2) + i;
-
-			pCbCrMap[j + 0x10] = (j / 2) + i;
-			pCbCrMap[j + 0x11] = (j / 2) + i;
-		}
-
-		pCbCrMap += 0x20;
-	}
-}
-
 /////////////////////////////////////////////
 //SETTH command implementation
 /////////////////////////////////////////////
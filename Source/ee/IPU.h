@@ -7,6 +7,8 @@
 #include "mpeg2/VLCTable.h"
 #include "mpeg2/DctCoefficientTable.h"
 #include "../MailBox.h"
+#include "IPU_VLCLookupTable.h"
+#include "IpuKernels.h"
 #include "Convertible.h"
 
 class CINTC;
@@ -314,6 +316,8 @@ private:
 			STATE_SKIPEOB
 		};
 
+		bool ReadCoefficientsFromLookup();
+
 		CINFIFO* m_IN_FIFO;
 		STATE m_state;
 		int16* m_block;
@@ -323,6 +327,7 @@ private:
 		bool m_isMpeg2;
 		unsigned int m_blockIndex;
 		MPEG2::CDctCoefficientTable* m_coeffTable;
+		const IPU::CDctCoefficientLookupTable* m_coeffLookupTable;
 		int16* m_dcPredictor;
 		int16 m_dcDiff;
 		CBDECCommand_ReadDcDiff m_readDcDiffCommand;
@@ -396,7 +401,7 @@ private:
 		uint32* m_result;
 		CINFIFO* m_IN_FIFO;
 		STATE m_state;
-		MPEG2::CVLCTable* m_table;
+		const IPU::CVLCLookupTable* m_table;
 	};
 
 	//0x04 ------------------------------------------------------------
@@ -458,11 +463,9 @@ private:
 	public:
 		enum
 		{
-			BLOCK_SIZE = 0x180,
+			BLOCK_SIZE = CIpuKernels::MACROBLOCK_SIZE,
 		};
 
-		CCSCCommand();
-
 		void Initialize(CINFIFO*, COUTFIFO*, uint32, uint16, uint16);
 		bool Execute() override;
 
@@ -476,8 +479,6 @@ private:
 			STATE_DONE,
 		};
 
-		void GenerateCbCrMap();
-
 		STATE m_state = STATE_DONE;
 		CMD_CSC m_command = make_convertible<CMD_CSC>(0);
 
@@ -489,8 +490,6 @@ private:
 		unsigned int m_currentIndex = 0;
 		unsigned int m_mbCount = 0;
 
-		unsigned int m_nCbCrMap[0x100];
-
 		uint8 m_block[BLOCK_SIZE];
 	};
 
@@ -0,0 +1,215 @@
+#include <cassert>
+#include "IPU_VLCLookupTable.h"
+#include "mpeg2/DctCoefficientTable0.h"
+#include "mpeg2/DctCoefficientTable1.h"
+
+using namespace IPU;
+using namespace MPEG2;
+
+//Bit stream made of a single lookup index, used to run the generic decoders when building the tables.
+//Decoders that need bits past the index fail like they would with an incomplete stream.
+class CLookupIndexBitStream : public Framework::CBitStream
+{
+public:
+	CLookupIndexBitStream(uint32 index, uint8 size)
+	    : m_index(index)
+	    , m_size(size)
+	{
+	}
+
+	void Advance(uint8 bits) override
+	{
+		if((m_position + bits) > m_size)
+		{
+			throw CBitStreamException();
+		}
+		m_position += bits;
+	}
+
+	uint8 GetBitIndex() const override
+	{
+		return m_position;
+	}
+
+	bool TryPeekBits_LSBF(uint8, uint32&) override
+	{
+		//Not used by the decoders
+		return false;
+	}
+
+	bool TryPeekBits_MSBF(uint8 size, uint32& result) override
+	{
+		assert(size != 0);
+		if((m_position + size) > m_size)
+		{
+			return false;
+		}
+		uint32 mask = ~0U >> (32 - size);
+		result = (m_index >> (m_size - m_position - size)) & mask;
+		return true;
+	}
+
+private:
+	uint32 m_index = 0;
+	uint8 m_size = 0;
+	uint8 m_position = 0;
+};
+
+/////////////////////////////////////////////
+//CVLCLookupTable
+/////////////////////////////////////////////
+
+CVLCLookupTable::CVLCLookupTable(CVLCTable* table)
+    : m_table(table)
+    , m_entries(1 << LOOKUP_BITS)
+{
+	for(uint32 index = 0; index < m_entries.size(); index++)
+	{
+		CLookupIndexBitStream stream(index, LOOKUP_BITS);
+		uint32 value = 0;
+		try
+		{
+			if(m_table->TryGetSymbol(&stream, value) != CVLCTable::DECODE_STATUS_SUCCESS)
+			{
+				continue;
+			}
+		}
+		catch(const Framework::CBitStream::CBitStreamException&)
+		{
+			continue;
+		}
+		catch(const CVLCTable::CVLCTableException&)
+		{
+			continue;
+		}
+		auto& entry = m_entries[index];
+		entry.value = value;
+		entry.length = stream.GetBitIndex();
+		assert(entry.length != 0);
+	}
+}
+
+CVLCTable* CVLCLookupTable::GetTable() const
+{
+	return m_table;
+}
+
+bool CVLCLookupTable::TryLookupSymbol(Framework::CBitStream* stream, uint32& result) const
+{
+	uint32 index = 0;
+	if(!stream->TryPeekBits_MSBF(LOOKUP_BITS, index))
+	{
+		return false;
+	}
+	const auto& entry = m_entries[index];
+	if(entry.length == 0)
+	{
+		return false;
+	}
+	stream->Advance(entry.length);
+	result = entry.value;
+	return true;
+}
+
+CVLCTable::DECODE_STATUS CVLCLookupTable::TryGetSymbol(Framework::CBitStream* stream, uint32& result) const
+{
+	if(TryLookupSymbol(stream, result))
+	{
+		return CVLCTable::DECODE_STATUS_SUCCESS;
+	}
+	return m_table->TryGetSymbol(stream, result);
+}
+
+uint32 CVLCLookupTable::GetSymbol(Framework::CBitStream* stream) const
+{
+	uint32 result = 0;
+	if(TryLookupSymbol(stream, result))
+	{
+		return result;
+	}
+	return m_table->GetSymbol(stream);
+}
+
+/////////////////////////////////////////////
+//CDctCoefficientLookupTable
+/////////////////////////////////////////////
+
+template <typename DecodeFunction>
+static CDctCoefficientLookupTable::ENTRY MakeDctEntry(uint32 index, const DecodeFunction& decode)
+{
+	CDctCoefficientLookupTable::ENTRY entry;
+	CLookupIndexBitStream stream(index, CDctCoefficientLookupTable::LOOKUP_BITS);
+	RUNLEVELPAIR runLevelPair;
+	try
+	{
+		if(decode(stream, runLevelPair) != CVLCTable::DECODE_STATUS_SUCCESS)
+		{
+			return entry;
+		}
+	}
+	catch(const Framework::CBitStream::CBitStreamException&)
+	{
+		return entry;
+	}
+	catch(const CVLCTable::CVLCTableException&)
+	{
+		return entry;
+	}
+	assert(runLevelPair.run < CDctCoefficientLookupTable::RUN_ENDOFBLOCK);
+	entry.run = static_cast<uint8>(runLevelPair.run);
+	entry.level = static_cast<int16>(runLevelPair.level);
+	entry.length = stream.GetBitIndex();
+	assert(entry.length != 0);
+	return entry;
+}
+
+CDctCoefficientLookupTable::CDctCoefficientLookupTable(CDctCoefficientTable& table)
+{
+	//Escape codes are longer than the lookup index, the MPEG2 flag (which only changes
+	//the format of escaped levels) doesn't change the content of the tables
+	const bool isMpeg2 = true;
+	for(uint32 index = 0; index < (1 << LOOKUP_BITS); index++)
+	{
+		//Decoding always starts by checking for an end of block, even for the first coefficient
+		bool isEob = false;
+		CLookupIndexBitStream eobStream(index, LOOKUP_BITS);
+		if(table.TryIsEndOfBlock(&eobStream, isEob) != CVLCTable::DECODE_STATUS_SUCCESS)
+		{
+			continue;
+		}
+
+		if(isEob)
+		{
+			if(table.TrySkipEndOfBlock(&eobStream) == CVLCTable::DECODE_STATUS_SUCCESS)
+			{
+				auto& entry = m_entries[index];
+				entry.run = RUN_ENDOFBLOCK;
+				entry.length = eobStream.GetBitIndex();
+			}
+		}
+		else
+		{
+			m_entries[index] = MakeDctEntry(index,
+			                                [&](CLookupIndexBitStream& stream, RUNLEVELPAIR& runLevelPair) {
+				                                return table.TryGetRunLevelPair(&stream, &runLevelPair, isMpeg2);
+			                                });
+		}
+
+		m_firstEntries[index] = MakeDctEntry(index,
+		                                     [&](CLookupIndexBitStream& stream, RUNLEVELPAIR& runLevelPair) {
+			                                     return table.TryGetRunLevelPairDc(&stream, &runLevelPair, isMpeg2);
+		                                     });
+	}
+}
+
+const CDctCoefficientLookupTable& CDctCoefficientLookupTable::GetTable0Instance()
+{
+	static const CDctCoefficientLookupTable instance(CDctCoefficientTable0::GetInstance());
+	return instance;
+}
+
+const CDctCoefficientLookupTable& CDctCoefficientLookupTable::GetTable1Instance()
+{
+	static const CDctCoefficientLookupTable instance(CDctCoefficientTable1::GetInstance());
+	return instance;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include "mpeg2/VLCTable.h"
+#include "mpeg2/DctCoefficientTable.h"
+
+namespace IPU
+{
+	//Resolves the symbols of a VLC table with a single probe of a table indexed by the next LOOKUP_BITS bits
+	//of the stream. Entries are built by running the table's own decoder on every possible index, symbols that
+	//need more bits or that are invalid are left to the table.
+	class CVLCLookupTable
+	{
+	public:
+		enum LOOKUP_BITS
+		{
+			LOOKUP_BITS = 9,
+		};
+
+		CVLCLookupTable(MPEG2::CVLCTable*);
+
+		template <typename TableType>
+		static const CVLCLookupTable& GetInstance()
+		{
+			static const CVLCLookupTable instance(TableType::GetInstance());
+			return instance;
+		}
+
+		MPEG2::CVLCTable* GetTable() const;
+
+		MPEG2::CVLCTable::DECODE_STATUS TryGetSymbol(Framework::CBitStream*, uint32&) const;
+		uint32 GetSymbol(Framework::CBitStream*) const;
+
+	private:
+		struct ENTRY
+		{
+			uint32 value = 0;
+			//0 if the symbol can't be resolved with the lookup
+			uint8 length = 0;
+		};
+
+		bool TryLookupSymbol(Framework::CBitStream*, uint32&) const;
+
+		MPEG2::CVLCTable* m_table = nullptr;
+		std::vector<ENTRY> m_entries;
+	};
+
+	//Resolves DCT coefficient run/level pairs and end of block codes. Entries are indexed by MSB aligned
+	//bits, which allows decoding every symbol that fits in a window of the stream without going back to it.
+	class CDctCoefficientLookupTable
+	{
+	public:
+		enum LOOKUP_BITS
+		{
+			LOOKUP_BITS = 10,
+		};
+
+		enum
+		{
+			RUN_ENDOFBLOCK = 0xFF,
+		};
+
+		struct ENTRY
+		{
+			int16 level = 0;
+			uint8 run = 0;
+			//0 if the symbol can't be resolved with the lookup (long codes, escape codes or invalid codes)
+			uint8 length = 0;
+		};
+
+		CDctCoefficientLookupTable(MPEG2::CDctCoefficientTable&);
+
+		static const CDctCoefficientLookupTable& GetTable0Instance();
+		static const CDctCoefficientLookupTable& GetTable1Instance();
+
+		//Entry for symbols following the first one of the block, can be an end of block
+		const ENTRY& GetEntry(uint32 bits) const
+		{
+			return m_entries[bits >> (32 - LOOKUP_BITS)];
+		}
+
+		//Entry for the first coefficient of a non intra block
+		const ENTRY& GetFirstEntry(uint32 bits) const
+		{
+			return m_firstEntries[bits >> (32 - LOOKUP_BITS)];
+		}
+
+	private:
+		ENTRY m_entries[1 << LOOKUP_BITS];
+		ENTRY m_firstEntries[1 << LOOKUP_BITS];
+	};
+}
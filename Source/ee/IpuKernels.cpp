@@ -0,0 +1,672 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include "IpuKernels.h"
+#include "idct/IEEE1180.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAS_SSE2) || defined(HAS_NEON)
+#define HAS_SIMD
+#endif
+
+//The inverse DCT works on doubles, only available with NEON on 64-bits ARM
+#if defined(HAS_SSE2) || (defined(HAS_NEON) && (defined(__aarch64__) || defined(_M_ARM64)))
+#define HAS_SIMD_IDCT
+#endif
+
+#define COEFFICIENT_MIN (-2048)
+#define COEFFICIENT_MAX (2047)
+#define SAMPLE_MIN (-256)
+#define SAMPLE_MAX (255)
+
+#ifdef HAS_SIMD_IDCT
+
+#define IDCT_PI (3.14159265358979323846)
+
+//c[u][x] = (C(u) / 2) * cos(((2x + 1) * u * pi) / 16) as defined by IEEE 1180. Framework's
+//CIEEE1180 doesn't expose its table, this is built with the exact same expression.
+struct IDCT_COEFFICIENTS
+{
+	IDCT_COEFFICIENTS()
+	{
+		for(unsigned int u = 0; u < 8; u++)
+		{
+			double scale = (u == 0) ? sqrt(0.125) : 0.5;
+			for(unsigned int x = 0; x < 8; x++)
+			{
+				values[u][x] = scale * cos((IDCT_PI / 8.0) * u * (x + 0.5));
+			}
+		}
+	}
+
+	alignas(16) double values[8][8];
+};
+
+static const IDCT_COEFFICIENTS g_idctCoefficients;
+
+#endif
+
+//Added to components before truncating them to 5 bits, rows are repeated to cover 8 pixels
+alignas(16) static const int16 g_ditherMatrix[4][8] =
+    {
+        {-4, 0, -3, 1, -4, 0, -3, 1},
+        {2, -2, 3, -1, 2, -2, 3, -1},
+        {-3, 1, -4, 0, -3, 1, -4, 0},
+        {3, -1, 2, -2, 3, -1, 2, -2},
+};
+
+alignas(16) static const int16 g_noDither[8] = {};
+
+//Alpha thresholds are compared against whole BGR values
+static uint32 ExpandAlphaThreshold(uint32 threshold)
+{
+	threshold &= 0xFF;
+	return threshold | (threshold << 8) | (threshold << 16);
+}
+
+static int16 SaturateCoefficient(int16 value)
+{
+	value = std::max<int16>(value, COEFFICIENT_MIN);
+	value = std::min<int16>(value, COEFFICIENT_MAX);
+	return value;
+}
+
+//////////////////////////////////////////////
+//Scalar kernels
+
+static int16 GetCoefficientSign(int16 value)
+{
+	if(value == 0) return 0;
+	return (value > 0) ? 1 : -1;
+}
+
+//Mismatch control: non-zero coefficients are made odd
+static int16 ApplyMismatchControl(int16 value, int16 sign)
+{
+	if((sign != 0) && ((value & 1) == 0))
+	{
+		value = static_cast<int16>((value - sign) | 1);
+	}
+	return value;
+}
+
+static void DequantiseIntraBlockScalar(int16* block, const uint8* iqMatrix, int32 quantScale, int32 intraDcMult)
+{
+	block[0] = SaturateCoefficient(static_cast<int16>(intraDcMult * block[0]));
+	for(unsigned int i = 1; i < CIpuKernels::BLOCK_SIZE; i++)
+	{
+		int16 sign = GetCoefficientSign(block[i]);
+		int16 value = static_cast<int16>((block[i] * iqMatrix[i] * quantScale * 2) / 32);
+		block[i] = SaturateCoefficient(ApplyMismatchControl(value, sign));
+	}
+}
+
+static void DequantiseNonIntraBlockScalar(int16* block, const uint8* iqMatrix, int32 quantScale, int32)
+{
+	for(unsigned int i = 0; i < CIpuKernels::BLOCK_SIZE; i++)
+	{
+		int16 sign = GetCoefficientSign(block[i]);
+		int16 value = static_cast<int16>((((block[i] * 2) + sign) * iqMatrix[i] * quantScale) / 32);
+		block[i] = SaturateCoefficient(ApplyMismatchControl(value, sign));
+	}
+}
+
+//Framework's reference transform, same as what was used before the kernels were introduced
+static void IdctScalar(const int16* src, int16* dst)
+{
+	int16 block[CIpuKernels::BLOCK_SIZE];
+	memcpy(block, src, sizeof(block));
+	IDCT::CIEEE1180::GetInstance()->Transform(block, dst);
+}
+
+static void ConvertRgb32Scalar(uint32* dst, const uint8* block, uint32 th0, uint32 th1)
+{
+	const uint8* blockY = block;
+	const uint8* blockCb = block + 0x100;
+	const uint8* blockCr = block + 0x140;
+
+	uint32 alphaTh0 = ExpandAlphaThreshold(th0);
+	uint32 alphaTh1 = ExpandAlphaThreshold(th1);
+
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		for(unsigned int j = 0; j < 16; j++)
+		{
+			unsigned int chromaIndex = ((i / 2) * 8) + (j / 2);
+			float y = blockY[(i * 16) + j];
+			float cb = blockCb[chromaIndex];
+			float cr = blockCr[chromaIndex];
+
+			float r = y + 1.402f * (cr - 128);
+			float g = y - 0.34414f * (cb - 128) - 0.71414f * (cr - 128);
+			float b = y + 1.772f * (cb - 128);
+
+			r = std::min<float>(std::max<float>(r, 0), 255);
+			g = std::min<float>(std::max<float>(g, 0), 255);
+			b = std::min<float>(std::max<float>(b, 0), 255);
+
+			uint32 rgb = (static_cast<uint8>(b) << 16) | (static_cast<uint8>(g) << 8) | (static_cast<uint8>(r) << 0);
+			uint32 a = 0x80;
+			if(rgb < alphaTh0)
+			{
+				a = 0;
+			}
+			else if(rgb < alphaTh1)
+			{
+				a = 0x40;
+			}
+
+			dst[(i * 16) + j] = (a << 24) | rgb;
+		}
+	}
+}
+
+//Semi-transparent pixels get their alpha bit set
+static uint16 PackRgb16(uint32 pixel, int32 dither)
+{
+	int32 r = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >> 0) & 0xFF) + dither, 0), 255) >> 3;
+	int32 g = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >> 8) & 0xFF) + dither, 0), 255) >> 3;
+	int32 b = std::min<int32>(std::max<int32>(static_cast<int32>((pixel >> 16) & 0xFF) + dither, 0), 255) >> 3;
+	uint32 a = ((pixel >> 24) == 0x40) ? 1 : 0;
+	return static_cast<uint16>((r << 0) | (g << 5) | (b << 10) | (a << 15));
+}
+
+template <bool Dither>
+static void ConvertRgb16Scalar(uint16* dst, const uint8* block, uint32 th0, uint32 th1)
+{
+	uint32 pixels[CIpuKernels::MACROBLOCK_PIXELS];
+	ConvertRgb32Scalar(pixels, block, th0, th1);
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		const int16* dither = Dither ? g_ditherMatrix[i & 3] : g_noDither;
+		for(unsigned int j = 0; j < 16; j++)
+		{
+			dst[(i * 16) + j] = PackRgb16(pixels[(i * 16) + j], dither[j & 7]);
+		}
+	}
+}
+
+//////////////////////////////////////////////
+//SIMD kernels
+
+#ifdef HAS_SIMD
+
+//Small set of operations used by the kernels, implemented for every supported instruction set
+#if defined(HAS_SSE2)
+
+//Division by a power of 2 rounding towards zero
+template <int Shift>
+static inline __m128i DivideTruncate(__m128i value)
+{
+	__m128i bias = _mm_and_si128(_mm_srai_epi32(value, 31), _mm_set1_epi32((1 << Shift) - 1));
+	return _mm_srai_epi32(_mm_add_epi32(value, bias), Shift);
+}
+
+//Dequantises 8 coefficients, products with the weights (quantiser matrix * quantiser scale) are done on 32 bits
+template <bool IsIntra>
+static inline void DequantiseGroup(int16* coeffs, const uint8* iqMatrix, int32 quantScale)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coeffs));
+	__m128i weights = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(iqMatrix)), zero);
+	weights = _mm_mullo_epi16(weights, _mm_set1_epi16(static_cast<int16>(quantScale)));
+	__m128i sign = _mm_sub_epi16(_mm_cmpgt_epi16(zero, value), _mm_cmpgt_epi16(value, zero));
+
+	__m128i productLo = _mm_mullo_epi16(value, weights);
+	__m128i productHi = _mm_mulhi_epi16(value, weights);
+	__m128i product0 = _mm_unpacklo_epi16(productLo, productHi);
+	__m128i product1 = _mm_unpackhi_epi16(productLo, productHi);
+
+	__m128i result0, result1;
+	if(IsIntra)
+	{
+		//(value * weight * 2) / 32
+		result0 = DivideTruncate<4>(product0);
+		result1 = DivideTruncate<4>(product1);
+	}
+	else
+	{
+		//(((value * 2) + sign) * weight) / 32
+		__m128i signWeight = _mm_mullo_epi16(sign, weights);
+		__m128i signWeight0 = _mm_srai_epi32(_mm_unpacklo_epi16(signWeight, signWeight), 16);
+		__m128i signWeight1 = _mm_srai_epi32(_mm_unpackhi_epi16(signWeight, signWeight), 16);
+		result0 = DivideTruncate<5>(_mm_add_epi32(_mm_slli_epi32(product0, 1), signWeight0));
+		result1 = DivideTruncate<5>(_mm_add_epi32(_mm_slli_epi32(product1, 1), signWeight1));
+	}
+
+	//Results are truncated to 16 bits before mismatch control and saturation, like the scalar version
+	result0 = _mm_srai_epi32(_mm_slli_epi32(result0, 16), 16);
+	result1 = _mm_srai_epi32(_mm_slli_epi32(result1, 16), 16);
+	__m128i result = _mm_packs_epi32(result0, result1);
+
+	__m128i one = _mm_set1_epi16(1);
+	__m128i isEven = _mm_cmpeq_epi16(_mm_and_si128(result, one), zero);
+	__m128i mustAdjust = _mm_andnot_si128(_mm_cmpeq_epi16(sign, zero), isEven);
+	__m128i adjusted = _mm_or_si128(_mm_sub_epi16(result, sign), one);
+	result = _mm_or_si128(_mm_and_si128(mustAdjust, adjusted), _mm_andnot_si128(mustAdjust, result));
+
+	result = _mm_max_epi16(result, _mm_set1_epi16(COEFFICIENT_MIN));
+	result = _mm_min_epi16(result, _mm_set1_epi16(COEFFICIENT_MAX));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(coeffs), result);
+}
+
+typedef __m128d DoublePair;
+
+static inline DoublePair LoadDoublePair(const double* values)
+{
+	return _mm_load_pd(values);
+}
+
+static inline DoublePair BroadcastDouble(double value)
+{
+	return _mm_set1_pd(value);
+}
+
+static inline DoublePair MultiplyAdd(DoublePair sum, DoublePair value0, DoublePair value1)
+{
+	return _mm_add_pd(sum, _mm_mul_pd(value0, value1));
+}
+
+static inline bool IsRowZero(const int16* row)
+{
+	__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+	return _mm_movemask_epi8(_mm_cmpeq_epi16(value, _mm_setzero_si128())) == 0xFFFF;
+}
+
+//Truncation rounds towards zero, negative values with a fractional part need to be decremented
+static inline __m128i Floor(__m128d value)
+{
+	__m128i truncated = _mm_cvttpd_epi32(value);
+	__m128d isGreater = _mm_cmpgt_pd(_mm_cvtepi32_pd(truncated), value);
+	__m128i correction = _mm_shuffle_epi32(_mm_castpd_si128(isGreater), _MM_SHUFFLE(3, 3, 2, 0));
+	return _mm_add_epi32(truncated, correction);
+}
+
+//Stores floor(sum + 0.5) of 8 sums, saturated to the range of samples
+static inline void StoreRoundedRow(int16* dst, const DoublePair* sums)
+{
+	__m128d half = _mm_set1_pd(0.5);
+	__m128i values0 = _mm_unpacklo_epi64(Floor(_mm_add_pd(sums[0], half)), Floor(_mm_add_pd(sums[1], half)));
+	__m128i values1 = _mm_unpacklo_epi64(Floor(_mm_add_pd(sums[2], half)), Floor(_mm_add_pd(sums[3], half)));
+	__m128i result = _mm_packs_epi32(values0, values1);
+	result = _mm_max_epi16(result, _mm_set1_epi16(SAMPLE_MIN));
+	result = _mm_min_epi16(result, _mm_set1_epi16(SAMPLE_MAX));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+}
+
+//Converts 4 pixels from their samples
+static inline __m128i ConvertPixelGroup(__m128i y, __m128i cb, __m128i cr, __m128i alphaTh0, __m128i alphaTh1)
+{
+	__m128 yValue = _mm_cvtepi32_ps(y);
+	__m128 cbValue = _mm_sub_ps(_mm_cvtepi32_ps(cb), _mm_set1_ps(128));
+	__m128 crValue = _mm_sub_ps(_mm_cvtepi32_ps(cr), _mm_set1_ps(128));
+
+	__m128 r = _mm_add_ps(yValue, _mm_mul_ps(_mm_set1_ps(1.402f), crValue));
+	__m128 g = _mm_sub_ps(_mm_sub_ps(yValue, _mm_mul_ps(_mm_set1_ps(0.34414f), cbValue)), _mm_mul_ps(_mm_set1_ps(0.71414f), crValue));
+	__m128 b = _mm_add_ps(yValue, _mm_mul_ps(_mm_set1_ps(1.772f), cbValue));
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 max = _mm_set1_ps(255);
+	__m128i rgb = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(r, zero), max));
+	rgb = _mm_or_si128(rgb, _mm_slli_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(g, zero), max)), 8));
+	rgb = _mm_or_si128(rgb, _mm_slli_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(b, zero), max)), 16));
+
+	__m128i belowTh0 = _mm_cmplt_epi32(rgb, alphaTh0);
+	__m128i belowTh1 = _mm_cmplt_epi32(rgb, alphaTh1);
+	__m128i alpha = _mm_or_si128(_mm_and_si128(belowTh1, _mm_set1_epi32(0x40 << 24)), _mm_andnot_si128(belowTh1, _mm_set1_epi32(static_cast<int32>(0x80000000))));
+	alpha = _mm_andnot_si128(belowTh0, alpha);
+	return _mm_or_si128(rgb, alpha);
+}
+
+//Converts a row of 16 pixels, chroma samples are shared by 2 pixels
+static inline void ConvertRow(uint32* dst, const uint8* rowY, const uint8* rowCb, const uint8* rowCr, uint32 alphaTh0, uint32 alphaTh1)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i th0 = _mm_set1_epi32(alphaTh0);
+	__m128i th1 = _mm_set1_epi32(alphaTh1);
+	__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowY));
+	__m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowCb));
+	__m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowCr));
+	cb = _mm_unpacklo_epi8(cb, cb);
+	cr = _mm_unpacklo_epi8(cr, cr);
+
+	__m128i y16[2] = {_mm_unpacklo_epi8(y, zero), _mm_unpackhi_epi8(y, zero)};
+	__m128i cb16[2] = {_mm_unpacklo_epi8(cb, zero), _mm_unpackhi_epi8(cb, zero)};
+	__m128i cr16[2] = {_mm_unpacklo_epi8(cr, zero), _mm_unpackhi_epi8(cr, zero)};
+	auto output = reinterpret_cast<__m128i*>(dst);
+	for(unsigned int i = 0; i < 2; i++)
+	{
+		_mm_storeu_si128(output + (i * 2) + 0, ConvertPixelGroup(
+		                                           _mm_unpacklo_epi16(y16[i], zero), _mm_unpacklo_epi16(cb16[i], zero), _mm_unpacklo_epi16(cr16[i], zero), th0, th1));
+		_mm_storeu_si128(output + (i * 2) + 1, ConvertPixelGroup(
+		                                           _mm_unpackhi_epi16(y16[i], zero), _mm_unpackhi_epi16(cb16[i], zero), _mm_unpackhi_epi16(cr16[i], zero), th0, th1));
+	}
+}
+
+//Packs 8 RGBA32 pixels to RGBA16
+static inline void PackRgb16Group(uint16* dst, const uint32* src, const int16* dither)
+{
+	__m128i pixels0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 0));
+	__m128i pixels1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4));
+	__m128i mask = _mm_set1_epi32(0xFF);
+	__m128i r = _mm_packs_epi32(_mm_and_si128(pixels0, mask), _mm_and_si128(pixels1, mask));
+	__m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(pixels0, 8), mask), _mm_and_si128(_mm_srli_epi32(pixels1, 8), mask));
+	__m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(pixels0, 16), mask), _mm_and_si128(_mm_srli_epi32(pixels1, 16), mask));
+	__m128i a = _mm_packs_epi32(_mm_srli_epi32(pixels0, 24), _mm_srli_epi32(pixels1, 24));
+
+	__m128i ditherValue = _mm_load_si128(reinterpret_cast<const __m128i*>(dither));
+	__m128i zero = _mm_setzero_si128();
+	__m128i max = _mm_set1_epi16(255);
+	r = _mm_srli_epi16(_mm_min_epi16(_mm_max_epi16(_mm_add_epi16(r, ditherValue), zero), max), 3);
+	g = _mm_srli_epi16(_mm_min_epi16(_mm_max_epi16(_mm_add_epi16(g, ditherValue), zero), max), 3);
+	b = _mm_srli_epi16(_mm_min_epi16(_mm_max_epi16(_mm_add_epi16(b, ditherValue), zero), max), 3);
+	a = _mm_and_si128(_mm_cmpeq_epi16(a, _mm_set1_epi16(0x40)), _mm_set1_epi16(static_cast<int16>(0x8000)));
+
+	__m128i result = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi16(g, 5)), _mm_or_si128(_mm_slli_epi16(b, 10), a));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+}
+
+#elif defined(HAS_NEON)
+
+template <int Shift>
+static inline int32x4_t DivideTruncate(int32x4_t value)
+{
+	int32x4_t bias = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(value, 31)), 32 - Shift));
+	return vshrq_n_s32(vaddq_s32(value, bias), Shift);
+}
+
+template <bool IsIntra>
+static inline void DequantiseGroup(int16* coeffs, const uint8* iqMatrix, int32 quantScale)
+{
+	int16x8_t zero = vdupq_n_s16(0);
+	int16x8_t value = vld1q_s16(coeffs);
+	int16x8_t weights = vreinterpretq_s16_u16(vmulq_n_u16(vmovl_u8(vld1_u8(iqMatrix)), static_cast<uint16>(quantScale)));
+	int16x8_t sign = vsubq_s16(vreinterpretq_s16_u16(vcltq_s16(value, zero)), vreinterpretq_s16_u16(vcgtq_s16(value, zero)));
+
+	int32x4_t product0 = vmull_s16(vget_low_s16(value), vget_low_s16(weights));
+	int32x4_t product1 = vmull_s16(vget_high_s16(value), vget_high_s16(weights));
+
+	int32x4_t result0, result1;
+	if(IsIntra)
+	{
+		result0 = DivideTruncate<4>(product0);
+		result1 = DivideTruncate<4>(product1);
+	}
+	else
+	{
+		int16x8_t signWeight = vmulq_s16(sign, weights);
+		result0 = DivideTruncate<5>(vaddq_s32(vshlq_n_s32(product0, 1), vmovl_s16(vget_low_s16(signWeight))));
+		result1 = DivideTruncate<5>(vaddq_s32(vshlq_n_s32(product1, 1), vmovl_s16(vget_high_s16(signWeight))));
+	}
+
+	int16x8_t result = vcombine_s16(vmovn_s32(result0), vmovn_s32(result1));
+
+	int16x8_t one = vdupq_n_s16(1);
+	uint16x8_t mustAdjust = vandq_u16(vceqq_s16(vandq_s16(result, one), zero), vmvnq_u16(vceqq_s16(sign, zero)));
+	result = vbslq_s16(mustAdjust, vorrq_s16(vsubq_s16(result, sign), one), result);
+
+	result = vmaxq_s16(result, vdupq_n_s16(COEFFICIENT_MIN));
+	result = vminq_s16(result, vdupq_n_s16(COEFFICIENT_MAX));
+	vst1q_s16(coeffs, result);
+}
+
+#ifdef HAS_SIMD_IDCT
+
+typedef float64x2_t DoublePair;
+
+static inline DoublePair LoadDoublePair(const double* values)
+{
+	return vld1q_f64(values);
+}
+
+static inline DoublePair BroadcastDouble(double value)
+{
+	return vdupq_n_f64(value);
+}
+
+static inline DoublePair MultiplyAdd(DoublePair sum, DoublePair value0, DoublePair value1)
+{
+	return vaddq_f64(sum, vmulq_f64(value0, value1));
+}
+
+static inline bool IsRowZero(const int16* row)
+{
+	return vmaxvq_u16(vreinterpretq_u16_s16(vld1q_s16(row))) == 0;
+}
+
+static inline int32x2_t Floor(float64x2_t value)
+{
+	return vmovn_s64(vcvtmq_s64_f64(value));
+}
+
+static inline void StoreRoundedRow(int16* dst, const DoublePair* sums)
+{
+	float64x2_t half = vdupq_n_f64(0.5);
+	int32x4_t values0 = vcombine_s32(Floor(vaddq_f64(sums[0], half)), Floor(vaddq_f64(sums[1], half)));
+	int32x4_t values1 = vcombine_s32(Floor(vaddq_f64(sums[2], half)), Floor(vaddq_f64(sums[3], half)));
+	int16x8_t result = vcombine_s16(vqmovn_s32(values0), vqmovn_s32(values1));
+	result = vmaxq_s16(result, vdupq_n_s16(SAMPLE_MIN));
+	result = vminq_s16(result, vdupq_n_s16(SAMPLE_MAX));
+	vst1q_s16(dst, result);
+}
+
+#endif
+
+static inline uint32x4_t ConvertPixelGroup(uint32x4_t y, uint32x4_t cb, uint32x4_t cr, uint32x4_t alphaTh0, uint32x4_t alphaTh1)
+{
+	float32x4_t yValue = vcvtq_f32_u32(y);
+	float32x4_t cbValue = vsubq_f32(vcvtq_f32_u32(cb), vdupq_n_f32(128));
+	float32x4_t crValue = vsubq_f32(vcvtq_f32_u32(cr), vdupq_n_f32(128));
+
+	float32x4_t r = vaddq_f32(yValue, vmulq_n_f32(crValue, 1.402f));
+	float32x4_t g = vsubq_f32(vsubq_f32(yValue, vmulq_n_f32(cbValue, 0.34414f)), vmulq_n_f32(crValue, 0.71414f));
+	float32x4_t b = vaddq_f32(yValue, vmulq_n_f32(cbValue, 1.772f));
+
+	float32x4_t zero = vdupq_n_f32(0);
+	float32x4_t max = vdupq_n_f32(255);
+	uint32x4_t rgb = vcvtq_u32_f32(vminq_f32(vmaxq_f32(r, zero), max));
+	rgb = vorrq_u32(rgb, vshlq_n_u32(vcvtq_u32_f32(vminq_f32(vmaxq_f32(g, zero), max)), 8));
+	rgb = vorrq_u32(rgb, vshlq_n_u32(vcvtq_u32_f32(vminq_f32(vmaxq_f32(b, zero), max)), 16));
+
+	uint32x4_t alpha = vbslq_u32(vcltq_u32(rgb, alphaTh1), vdupq_n_u32(0x40 << 24), vdupq_n_u32(0x80 << 24));
+	alpha = vbicq_u32(alpha, vcltq_u32(rgb, alphaTh0));
+	return vorrq_u32(rgb, alpha);
+}
+
+static inline void ConvertRow(uint32* dst, const uint8* rowY, const uint8* rowCb, const uint8* rowCr, uint32 alphaTh0, uint32 alphaTh1)
+{
+	uint32x4_t th0 = vdupq_n_u32(alphaTh0);
+	uint32x4_t th1 = vdupq_n_u32(alphaTh1);
+	uint8x16_t y = vld1q_u8(rowY);
+	uint8x8x2_t cb = vzip_u8(vld1_u8(rowCb), vld1_u8(rowCb));
+	uint8x8x2_t cr = vzip_u8(vld1_u8(rowCr), vld1_u8(rowCr));
+
+	uint16x8_t y16[2] = {vmovl_u8(vget_low_u8(y)), vmovl_u8(vget_high_u8(y))};
+	uint16x8_t cb16[2] = {vmovl_u8(cb.val[0]), vmovl_u8(cb.val[1])};
+	uint16x8_t cr16[2] = {vmovl_u8(cr.val[0]), vmovl_u8(cr.val[1])};
+	for(unsigned int i = 0; i < 2; i++)
+	{
+		vst1q_u32(dst + (i * 8) + 0, ConvertPixelGroup(
+		                                 vmovl_u16(vget_low_u16(y16[i])), vmovl_u16(vget_low_u16(cb16[i])), vmovl_u16(vget_low_u16(cr16[i])), th0, th1));
+		vst1q_u32(dst + (i * 8) + 4, ConvertPixelGroup(
+		                                 vmovl_u16(vget_high_u16(y16[i])), vmovl_u16(vget_high_u16(cb16[i])), vmovl_u16(vget_high_u16(cr16[i])), th0, th1));
+	}
+}
+
+static inline void PackRgb16Group(uint16* dst, const uint32* src, const int16* dither)
+{
+	uint32x4_t pixels0 = vld1q_u32(src + 0);
+	uint32x4_t pixels1 = vld1q_u32(src + 4);
+	uint32x4_t mask = vdupq_n_u32(0xFF);
+	int16x8_t r = vreinterpretq_s16_u16(vcombine_u16(vmovn_u32(vandq_u32(pixels0, mask)), vmovn_u32(vandq_u32(pixels1, mask))));
+	int16x8_t g = vreinterpretq_s16_u16(vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(pixels0, 8), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(pixels1, 8), mask))));
+	int16x8_t b = vreinterpretq_s16_u16(vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(pixels0, 16), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(pixels1, 16), mask))));
+	uint16x8_t a = vcombine_u16(vmovn_u32(vshrq_n_u32(pixels0, 24)), vmovn_u32(vshrq_n_u32(pixels1, 24)));
+
+	int16x8_t ditherValue = vld1q_s16(dither);
+	int16x8_t zero = vdupq_n_s16(0);
+	int16x8_t max = vdupq_n_s16(255);
+	uint16x8_t r5 = vshrq_n_u16(vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(vaddq_s16(r, ditherValue), zero), max)), 3);
+	uint16x8_t g5 = vshrq_n_u16(vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(vaddq_s16(g, ditherValue), zero), max)), 3);
+	uint16x8_t b5 = vshrq_n_u16(vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(vaddq_s16(b, ditherValue), zero), max)), 3);
+	uint16x8_t alphaBit = vandq_u16(vceqq_u16(a, vdupq_n_u16(0x40)), vdupq_n_u16(0x8000));
+
+	uint16x8_t result = vorrq_u16(vorrq_u16(r5, vshlq_n_u16(g5, 5)), vorrq_u16(vshlq_n_u16(b5, 10), alphaBit));
+	vst1q_u16(dst, result);
+}
+
+#endif
+
+template <bool IsIntra>
+static void DequantiseBlockSimd(int16* block, const uint8* iqMatrix, int32 quantScale, int32 intraDcMult)
+{
+	int16 dc = block[0];
+	for(unsigned int i = 0; i < CIpuKernels::BLOCK_SIZE; i += 8)
+	{
+		DequantiseGroup<IsIntra>(block + i, iqMatrix + i, quantScale);
+	}
+	if(IsIntra)
+	{
+		block[0] = SaturateCoefficient(static_cast<int16>(intraDcMult * dc));
+	}
+}
+
+#ifdef HAS_SIMD_IDCT
+
+//Same computations as the scalar version, done on 2 columns at once. Coefficients and rows that are
+//zero don't change the sums and are skipped, which keeps results identical.
+static void IdctSimd(const int16* src, int16* dst)
+{
+	const auto& c = g_idctCoefficients.values;
+	DoublePair temp[8][4];
+	bool isRowUsed[8];
+	for(unsigned int v = 0; v < 8; v++)
+	{
+		const int16* row = src + (v * 8);
+		isRowUsed[v] = !IsRowZero(row);
+		if(!isRowUsed[v]) continue;
+		DoublePair sums[4] = {BroadcastDouble(0), BroadcastDouble(0), BroadcastDouble(0), BroadcastDouble(0)};
+		for(unsigned int u = 0; u < 8; u++)
+		{
+			if(row[u] == 0) continue;
+			DoublePair value = BroadcastDouble(row[u]);
+			for(unsigned int k = 0; k < 4; k++)
+			{
+				sums[k] = MultiplyAdd(sums[k], LoadDoublePair(c[u] + (k * 2)), value);
+			}
+		}
+		for(unsigned int k = 0; k < 4; k++)
+		{
+			temp[v][k] = sums[k];
+		}
+	}
+	for(unsigned int y = 0; y < 8; y++)
+	{
+		DoublePair sums[4] = {BroadcastDouble(0), BroadcastDouble(0), BroadcastDouble(0), BroadcastDouble(0)};
+		for(unsigned int v = 0; v < 8; v++)
+		{
+			if(!isRowUsed[v]) continue;
+			DoublePair coefficient = BroadcastDouble(c[v][y]);
+			for(unsigned int k = 0; k < 4; k++)
+			{
+				sums[k] = MultiplyAdd(sums[k], coefficient, temp[v][k]);
+			}
+		}
+		StoreRoundedRow(dst + (y * 8), sums);
+	}
+}
+
+#endif
+
+static void ConvertRgb32Simd(uint32* dst, const uint8* block, uint32 th0, uint32 th1)
+{
+	uint32 alphaTh0 = ExpandAlphaThreshold(th0);
+	uint32 alphaTh1 = ExpandAlphaThreshold(th1);
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		unsigned int chromaOffset = (i / 2) * 8;
+		ConvertRow(dst + (i * 16), block + (i * 16), block + 0x100 + chromaOffset, block + 0x140 + chromaOffset, alphaTh0, alphaTh1);
+	}
+}
+
+template <bool Dither>
+static void ConvertRgb16Simd(uint16* dst, const uint8* block, uint32 th0, uint32 th1)
+{
+	alignas(16) uint32 pixels[CIpuKernels::MACROBLOCK_PIXELS];
+	ConvertRgb32Simd(pixels, block, th0, th1);
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		const int16* dither = Dither ? g_ditherMatrix[i & 3] : g_noDither;
+		PackRgb16Group(dst + (i * 16) + 0, pixels + (i * 16) + 0, dither);
+		PackRgb16Group(dst + (i * 16) + 8, pixels + (i * 16) + 8, dither);
+	}
+}
+
+#endif
+
+//////////////////////////////////////////////
+//Kernel selection
+
+static CIpuKernels::KERNELS MakeScalarKernels()
+{
+	CIpuKernels::KERNELS kernels;
+	kernels.dequantiseIntraBlock = &DequantiseIntraBlockScalar;
+	kernels.dequantiseNonIntraBlock = &DequantiseNonIntraBlockScalar;
+	kernels.idct = &IdctScalar;
+	kernels.convertRgb32 = &ConvertRgb32Scalar;
+	kernels.convertRgb16 = &ConvertRgb16Scalar<false>;
+	kernels.convertRgb16Dithered = &ConvertRgb16Scalar<true>;
+	return kernels;
+}
+
+static CIpuKernels::KERNELS MakeSimdKernels()
+{
+#ifdef HAS_SIMD
+	CIpuKernels::KERNELS kernels;
+	kernels.dequantiseIntraBlock = &DequantiseBlockSimd<true>;
+	kernels.dequantiseNonIntraBlock = &DequantiseBlockSimd<false>;
+#ifdef HAS_SIMD_IDCT
+	kernels.idct = &IdctSimd;
+#else
+	kernels.idct = &IdctScalar;
+#endif
+	kernels.convertRgb32 = &ConvertRgb32Simd;
+	kernels.convertRgb16 = &ConvertRgb16Simd<false>;
+	kernels.convertRgb16Dithered = &ConvertRgb16Simd<true>;
+	return kernels;
+#else
+	return MakeScalarKernels();
+#endif
+}
+
+bool CIpuKernels::IsSimdSupported()
+{
+#ifdef HAS_SIMD
+	//SSE2 and NEON are part of the baseline of the architectures we build them for
+	return true;
+#else
+	return false;
+#endif
+}
+
+const CIpuKernels::KERNELS& CIpuKernels::GetKernels()
+{
+	static const KERNELS& kernels = GetKernels(IsSimdSupported() ? KERNEL_SET_SIMD : KERNEL_SET_SCALAR);
+	return kernels;
+}
+
+const CIpuKernels::KERNELS& CIpuKernels::GetKernels(KERNEL_SET kernelSet)
+{
+	static const KERNELS scalarKernels = MakeScalarKernels();
+	static const KERNELS simdKernels = MakeSimdKernels();
+	assert((kernelSet == KERNEL_SET_SCALAR) || (kernelSet == KERNEL_SET_SIMD));
+	return (kernelSet == KERNEL_SET_SIMD) ? simdKernels : scalarKernels;
+}
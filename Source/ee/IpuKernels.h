@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Types.h"
+
+//Macroblock processing kernels used by the IPU: dequantisation, inverse DCT and colour space conversion.
+//SIMD versions are used when available, scalar versions are kept as reference and both must produce the
+//exact same output. The scalar inverse DCT is Framework's IEEE 1180 transform, which is built without
+//our floating point flags: if the compiler fuses its multiply-adds, samples can be off by one.
+class CIpuKernels
+{
+public:
+	enum
+	{
+		BLOCK_SIZE = 0x40,
+		//Y (16x16), Cb (8x8) and Cr (8x8) samples
+		MACROBLOCK_SIZE = 0x180,
+		MACROBLOCK_PIXELS = 0x100,
+	};
+
+	//Arguments: block (in natural order), quantiser matrix, quantiser scale, DC multiplier (only used for intra blocks)
+	typedef void (*DequantiseFunction)(int16*, const uint8*, int32, int32);
+	//Arguments: source coefficients, destination samples
+	typedef void (*IdctFunction)(const int16*, int16*);
+	//Arguments: destination pixels (16x16), macroblock samples, TH0, TH1
+	typedef void (*ConvertRgb32Function)(uint32*, const uint8*, uint32, uint32);
+	typedef void (*ConvertRgb16Function)(uint16*, const uint8*, uint32, uint32);
+
+	enum KERNEL_SET
+	{
+		KERNEL_SET_SCALAR,
+		KERNEL_SET_SIMD,
+	};
+
+	struct KERNELS
+	{
+		DequantiseFunction dequantiseIntraBlock = nullptr;
+		DequantiseFunction dequantiseNonIntraBlock = nullptr;
+		IdctFunction idct = nullptr;
+		ConvertRgb32Function convertRgb32 = nullptr;
+		ConvertRgb16Function convertRgb16 = nullptr;
+		ConvertRgb16Function convertRgb16Dithered = nullptr;
+	};
+
+	static bool IsSimdSupported();
+
+	//Returns the best kernel set supported by the host
+	static const KERNELS& GetKernels();
+	static const KERNELS& GetKernels(KERNEL_SET);
+};
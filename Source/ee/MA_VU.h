@@ -214,6 +214,8 @@ private:
 		uint32 m_relativePipeTime = 0;
 		uint32 m_vuMemAddressMask;
 
+		uint32 GetBlockOffset() const;
+		void PushReturnAddress();
 		void SetBranchAddress(bool, int32);
 		static bool IsLOI(CMIPS*, uint32);
 
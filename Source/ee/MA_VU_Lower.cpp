@@ -58,13 +58,34 @@ void CMA_VU::CLower::SetRelativePipeTime(uint32 relativePipeTime)
 	m_relativePipeTime = relativePipeTime;
 }
 
+uint32 CMA_VU::CLower::GetBlockOffset() const
+{
+	//Relative pipe time is the instruction's index in the block
+	return m_relativePipeTime * 8;
+}
+
+void CMA_VU::CLower::PushReturnAddress()
+{
+	//VU blocks are position independent, nPC holds the address of the block
+	m_codeGen->PushRel(offsetof(CMIPS, m_State.nPC));
+	m_codeGen->PushCst(0x3FFF);
+	m_codeGen->And();
+	m_codeGen->PushCst(GetBlockOffset() + 0x10);
+	m_codeGen->Add();
+	m_codeGen->Srl(3);
+}
+
 void CMA_VU::CLower::SetBranchAddress(bool nCondition, int32 nOffset)
 {
 	m_codeGen->PushCst(0);
 	m_codeGen->BeginIf(nCondition ? Jitter::CONDITION_NE : Jitter::CONDITION_EQ);
 	{
 		const uint32 maxIAddr = 0x3FFF;
-		m_codeGen->PushCst((m_nAddress + nOffset + 4) & maxIAddr);
+		m_codeGen->PushRel(offsetof(CMIPS, m_State.nPC));
+		m_codeGen->PushCst(GetBlockOffset() + nOffset + 4);
+		m_codeGen->Add();
+		m_codeGen->PushCst(maxIAddr);
+		m_codeGen->And();
 		m_codeGen->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
 	}
 	m_codeGen->Else();
@@ -413,7 +434,7 @@ void CMA_VU::CLower::B()
 void CMA_VU::CLower::BAL()
 {
 	//Save PC
-	m_codeGen->PushCst((m_nAddress + 0x10) / 0x8);
+	PushReturnAddress();
 	m_codeGen->PullRel(offsetof(CMIPS, m_State.nCOP2VI[m_nIT]));
 
 	m_codeGen->PushCst(1);
@@ -442,7 +463,7 @@ void CMA_VU::CLower::JALR()
 	m_codeGen->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
 
 	//Save PC
-	m_codeGen->PushCst((m_nAddress + 0x10) / 0x8);
+	PushReturnAddress();
 	m_codeGen->PullRel(offsetof(CMIPS, m_State.nCOP2VI[m_nIT]));
 }
 
@@ -126,6 +126,7 @@ void CSIF::DeleteModules()
 
 uint32 CSIF::ReceiveDMA5(uint32 srcAddress, uint32 size, uint32 unused, bool isTagIncluded)
 {
+	SyncIop();
 	if(size > m_dmaBufferSize)
 	{
 		throw std::runtime_error("Packet too big.");
@@ -138,6 +139,8 @@ uint32 CSIF::ReceiveDMA6(uint32 nSrcAddr, uint32 nSize, uint32 nDstAddr, bool is
 {
 	assert(!isTagIncluded);
 
+	SyncIop();
+
 	//Humm, this is kinda odd, but it ors the address with 0x20000000
 	nSrcAddr &= (PS2::EE_RAM_SIZE - 1);
 
@@ -224,10 +227,17 @@ void CSIF::SendPacket(void* packet, uint32 size)
 	                     reinterpret_cast<uint8*>(&size) + 4);
 }
 
+bool CSIF::HasPendingPackets() const
+{
+	return !m_packetQueue.empty();
+}
+
 void CSIF::ProcessPackets()
 {
+	//Packet queue is only modified by the IOP while the EE is stopped
 	if(m_packetProcessed && !m_packetQueue.empty())
 	{
+		SyncIop();
 		assert(m_packetQueue.size() > 4);
 		uint32 size = *reinterpret_cast<uint32*>(&m_packetQueue[0]);
 		SendDMA(&m_packetQueue[4], size);
@@ -641,6 +651,19 @@ void CSIF::SetCustomCommandHandler(const CustomCommandHandler& customCommandHand
 	m_customCommandHandler = customCommandHandler;
 }
 
+void CSIF::SetIopSyncHandler(const SyncHandler& iopSyncHandler)
+{
+	m_iopSyncHandler = iopSyncHandler;
+}
+
+void CSIF::SyncIop()
+{
+	if(m_iopSyncHandler)
+	{
+		m_iopSyncHandler();
+	}
+}
+
 /////////////////////////////////////////////////////////
 //Get/Set Register
 /////////////////////////////////////////////////////////
@@ -15,6 +15,7 @@ class CSIF
 public:
 	typedef std::function<void(const std::string&)> ModuleResetHandler;
 	typedef std::function<void(uint32)> CustomCommandHandler;
+	typedef std::function<void()> SyncHandler;
 
 	CSIF(CDMAC&, uint8*, uint8*);
 	virtual ~CSIF() = default;
@@ -22,6 +23,7 @@ public:
 	void Reset();
 
 	void ProcessPackets();
+	bool HasPendingPackets() const;
 	void MarkPacketProcessed();
 
 	void RegisterModule(uint32, CSifModule*);
@@ -33,6 +35,10 @@ public:
 	void SetModuleResetHandler(const ModuleResetHandler&);
 	void SetCustomCommandHandler(const CustomCommandHandler&);
 
+	//Called by the EE before it touches IOP state
+	void SetIopSyncHandler(const SyncHandler&);
+	void SyncIop();
+
 	uint32 ReceiveDMA5(uint32, uint32, uint32, bool);
 	uint32 ReceiveDMA6(uint32, uint32, uint32, bool);
 
@@ -107,4 +113,5 @@ private:
 
 	ModuleResetHandler m_moduleResetHandler;
 	CustomCommandHandler m_customCommandHandler;
+	SyncHandler m_iopSyncHandler;
 };
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <stdio.h>
 #include "../Log.h"
@@ -30,23 +31,7 @@ void CTimer::Count(unsigned int ticks)
 		uint32 previousCount = timer.nCOUNT;
 		uint32 nextCount = timer.nCOUNT;
 
-		uint32 divider = 1;
-		//BUSCLOCK runs at half EE frequency
-		switch(timer.nMODE & MODE_CLOCK_SELECT)
-		{
-		case MODE_CLOCK_SELECT_BUSCLOCK:
-			divider = 1 * 2;
-			break;
-		case MODE_CLOCK_SELECT_BUSCLOCK16:
-			divider = 16 * 2;
-			break;
-		case MODE_CLOCK_SELECT_BUSCLOCK256:
-			divider = 256 * 2;
-			break;
-		case MODE_CLOCK_SELECT_EXTERNAL:
-			divider = 9437; // PAL
-			break;
-		}
+		uint32 divider = GetClockDivider(timer.nMODE);
 
 		//Compute increment
 		uint32 totalTicks = timer.clockRemain + ticks;
@@ -91,6 +76,43 @@ void CTimer::Count(unsigned int ticks)
 	}
 }
 
+uint32 CTimer::GetTicksUntilNextEvent() const
+{
+	uint32 result = ~0U;
+	for(unsigned int i = 0; i < MAX_TIMER; i++)
+	{
+		const auto& timer = m_timer[i];
+
+		if(!(timer.nMODE & MODE_COUNT_ENABLE)) continue;
+
+		//Same thresholds as the ones checked in Count
+		uint32 compare = (timer.nCOMP == 0) ? 0x10000 : timer.nCOMP;
+		uint32 nextEventCount = (timer.nCOUNT < compare) ? std::min<uint32>(compare, 0xFFFF) : 0xFFFF;
+		uint32 countRemain = (nextEventCount > timer.nCOUNT) ? (nextEventCount - timer.nCOUNT) : 1;
+		uint64 ticks = static_cast<uint64>(countRemain) * GetClockDivider(timer.nMODE);
+		ticks = (ticks > timer.clockRemain) ? (ticks - timer.clockRemain) : 1;
+		result = static_cast<uint32>(std::min<uint64>(result, ticks));
+	}
+	return result;
+}
+
+uint32 CTimer::GetClockDivider(uint32 mode)
+{
+	//BUSCLOCK runs at half EE frequency
+	switch(mode & MODE_CLOCK_SELECT)
+	{
+	default:
+	case MODE_CLOCK_SELECT_BUSCLOCK:
+		return 1 * 2;
+	case MODE_CLOCK_SELECT_BUSCLOCK16:
+		return 16 * 2;
+	case MODE_CLOCK_SELECT_BUSCLOCK256:
+		return 256 * 2;
+	case MODE_CLOCK_SELECT_EXTERNAL:
+		return 9437; // PAL
+	}
+}
+
 uint32 CTimer::GetRegister(uint32 nAddress)
 {
 	DisassembleGet(nAddress);
@@ -46,6 +46,8 @@ public:
 	void Reset();
 
 	void Count(unsigned int);
+	//Ticks before a counter reaches its compare value or overflows, ~0 if no counter is running
+	uint32 GetTicksUntilNextEvent() const;
 
 	uint32 GetRegister(uint32);
 	void SetRegister(uint32, uint32);
@@ -66,6 +68,7 @@ private:
 	void DisassembleSet(uint32, uint32);
 
 	void ProcessGateEdgeChange(uint32, uint32);
+	static uint32 GetClockDivider(uint32);
 
 	struct TIMER
 	{
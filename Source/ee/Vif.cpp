@@ -286,6 +286,11 @@ bool CVif::IsWaitingForProgramEnd() const
 	return (m_STAT.nVEW != 0);
 }
 
+void CVif::SetUnpackKernels(const CVifUnpackKernels::KERNELS* unpackKernels)
+{
+	m_unpackKernels = unpackKernels;
+}
+
 void CVif::ProcessFifoWrite(uint32 address, uint32 value)
 {
 	assert(m_fifoIndex != FIFO_SIZE);
@@ -601,6 +606,8 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 {
 	assert((nCommand.nCMD & 0x60) == 0x60);
 
+	m_vpu.WaitForMicroProgram();
+
 	const auto vuMem = m_vpu.GetVuMemory();
 	const auto vuMemSize = m_vpu.GetVuMemorySize();
 	bool usn = (m_CODE.nIMM & 0x4000) != 0;
@@ -636,101 +643,115 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	assert(nDstAddr < vuMemSize);
 	nDstAddr &= (vuMemSize - 1);
 
-	while(currentNum != 0)
+	//Unmasked writes in normal or offset mode are converted in runs, other cases go element by element
+	CVifUnpackKernels::UnpackFunction unpackRun = nullptr;
+	if(m_unpackKernels && (cl >= wl) && (!useMask || (m_MASK == 0)) && (m_MODE != MODE_DIFFERENCE))
 	{
-		bool mustWrite = false;
-		uint128 writeValue;
-		memset(&writeValue, 0, sizeof(writeValue));
+		unpackRun = m_unpackKernels->unpack[nCommand.nCMD & 0x0F][usn ? 1 : 0][(m_MODE == MODE_OFFSET) ? 1 : 0];
+	}
 
-		if(cl >= wl)
+	if(unpackRun)
+	{
+		currentNum = Unpack_Runs(stream, nCommand.nCMD & 0x0F, unpackRun, nDstAddr, currentNum, cl, wl);
+	}
+	else
+	{
+		while(currentNum != 0)
 		{
-			if(m_readTick < wl)
+			bool mustWrite = false;
+			uint128 writeValue;
+			memset(&writeValue, 0, sizeof(writeValue));
+
+			if(cl >= wl)
 			{
-				bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
-				if(!success) break;
-				mustWrite = true;
+				if(m_readTick < wl)
+				{
+					bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
+					if(!success) break;
+					mustWrite = true;
+				}
 			}
-		}
-		else
-		{
-			if(m_writeTick < cl)
+			else
 			{
-				bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
-				if(!success) break;
-			}
-
-			mustWrite = true;
-		}
+				if(m_writeTick < cl)
+				{
+					bool success = Unpack_ReadValue(nCommand, stream, writeValue, usn);
+					if(!success) break;
+				}
 
-		if(mustWrite)
-		{
-			auto dst = reinterpret_cast<uint128*>(vuMem + nDstAddr);
+				mustWrite = true;
+			}
 
-			for(unsigned int i = 0; i < 4; i++)
+			if(mustWrite)
 			{
-				uint32 maskOp = useMask ? GetMaskOp(i, m_writeTick) : MASK_DATA;
+				auto dst = reinterpret_cast<uint128*>(vuMem + nDstAddr);
 
-				if(maskOp == MASK_DATA)
+				for(unsigned int i = 0; i < 4; i++)
 				{
-					if(m_MODE == MODE_OFFSET)
+					uint32 maskOp = useMask ? GetMaskOp(i, m_writeTick) : MASK_DATA;
+
+					if(maskOp == MASK_DATA)
 					{
-						writeValue.nV[i] += m_R[i];
+						if(m_MODE == MODE_OFFSET)
+						{
+							writeValue.nV[i] += m_R[i];
+						}
+						else if(m_MODE == MODE_DIFFERENCE)
+						{
+							writeValue.nV[i] += m_R[i];
+							m_R[i] = writeValue.nV[i];
+						}
+
+						dst->nV[i] = writeValue.nV[i];
 					}
-					else if(m_MODE == MODE_DIFFERENCE)
+					else if(maskOp == MASK_ROW)
 					{
-						writeValue.nV[i] += m_R[i];
-						m_R[i] = writeValue.nV[i];
+						dst->nV[i] = m_R[i];
+					}
+					else if(maskOp == MASK_COL)
+					{
+						int index = (m_writeTick > 3) ? 3 : m_writeTick;
+						dst->nV[i] = m_C[index];
+					}
+					else if(maskOp == MASK_MASK)
+					{
+						//Don't write anything
+					}
+					else
+					{
+						assert(0);
 					}
-
-					dst->nV[i] = writeValue.nV[i];
-				}
-				else if(maskOp == MASK_ROW)
-				{
-					dst->nV[i] = m_R[i];
-				}
-				else if(maskOp == MASK_COL)
-				{
-					int index = (m_writeTick > 3) ? 3 : m_writeTick;
-					dst->nV[i] = m_C[index];
-				}
-				else if(maskOp == MASK_MASK)
-				{
-					//Don't write anything
-				}
-				else
-				{
-					assert(0);
 				}
-			}
 
-			currentNum--;
-		}
-
-		if(cl >= wl)
-		{
-			m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
-			m_readTick = std::min<uint32>(m_readTick + 1, cl);
+				currentNum--;
+			}
 
-			if(m_readTick == cl)
+			if(cl >= wl)
 			{
-				m_writeTick = 0;
-				m_readTick = 0;
-			}
-		}
-		else
-		{
-			m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
-			m_readTick = std::min<uint32>(m_readTick + 1, cl);
+				m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
+				m_readTick = std::min<uint32>(m_readTick + 1, cl);
 
-			if(m_writeTick == wl)
+				if(m_readTick == cl)
+				{
+					m_writeTick = 0;
+					m_readTick = 0;
+				}
+			}
+			else
 			{
-				m_writeTick = 0;
-				m_readTick = 0;
+				m_writeTick = std::min<uint32>(m_writeTick + 1, wl);
+				m_readTick = std::min<uint32>(m_readTick + 1, cl);
+
+				if(m_writeTick == wl)
+				{
+					m_writeTick = 0;
+					m_readTick = 0;
+				}
 			}
-		}
 
-		nDstAddr += 0x10;
-		nDstAddr &= (vuMemSize - 1);
+			nDstAddr += 0x10;
+			nDstAddr &= (vuMemSize - 1);
+		}
 	}
 
 	if(currentNum != 0)
@@ -746,6 +767,58 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	m_NUM = static_cast<uint8>(currentNum);
 }
 
+uint32 CVif::Unpack_Runs(StreamType& stream, uint32 format, CVifUnpackKernels::UnpackFunction unpackRun, uint32 nDstAddr, uint32 currentNum, uint32 cl, uint32 wl)
+{
+	assert(cl >= wl);
+
+	const auto vuMem = m_vpu.GetVuMemory();
+	const auto vuMemSize = m_vpu.GetVuMemorySize();
+	uint32 elementSize = CVifUnpackKernels::GetElementSize(format);
+	assert(elementSize != 0);
+
+	alignas(16) uint8 elements[(UNPACK_RUN_SIZE * 0x10) + CVifUnpackKernels::SOURCE_PADDING];
+
+	while(currentNum != 0)
+	{
+		if(m_readTick >= wl)
+		{
+			//Skip the remaining qwords of the cycle, nothing is read from the stream
+			nDstAddr += (cl - m_readTick) * 0x10;
+			nDstAddr &= (vuMemSize - 1);
+			m_writeTick = 0;
+			m_readTick = 0;
+			continue;
+		}
+
+		//A run stops at the end of the write cycle (unless nothing is skipped), of the available data or of VU memory
+		uint32 runSize = (cl == wl) ? currentNum : std::min<uint32>(currentNum, wl - m_readTick);
+		runSize = std::min<uint32>(runSize, stream.GetAvailableReadBytes() / elementSize);
+		runSize = std::min<uint32>(runSize, (vuMemSize - nDstAddr) / 0x10);
+		runSize = std::min<uint32>(runSize, UNPACK_RUN_SIZE);
+		if(runSize == 0) break;
+
+		stream.Read(elements, runSize * elementSize);
+		unpackRun(reinterpret_cast<uint128*>(vuMem + nDstAddr), elements, runSize, m_R);
+
+		currentNum -= runSize;
+		if(cl == wl)
+		{
+			m_readTick = (m_readTick + runSize) % cl;
+			m_writeTick = m_readTick;
+		}
+		else
+		{
+			m_writeTick += runSize;
+			m_readTick += runSize;
+		}
+
+		nDstAddr += runSize * 0x10;
+		nDstAddr &= (vuMemSize - 1);
+	}
+
+	return currentNum;
+}
+
 bool CVif::Unpack_ReadValue(const CODE& nCommand, StreamType& stream, uint128& writeValue, bool usn)
 {
 	bool success = false;
@@ -947,6 +1020,8 @@ void CVif::StartMicroProgram(uint32 address)
 	}
 
 	assert(!m_STAT.nVEW);
+	//TOP and ITOP must not change until the previous microprogram is completely done
+	m_vpu.WaitForMicroProgram();
 	PrepareMicroProgram();
 	m_vpu.ExecuteMicroProgram(address);
 }
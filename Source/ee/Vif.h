@@ -4,6 +4,7 @@
 #include "Convertible.h"
 #include "../uint128.h"
 #include "../Profiler.h"
+#include "VifUnpackKernels.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
 
@@ -69,6 +70,9 @@ public:
 
 	bool IsWaitingForProgramEnd() const;
 
+	//Kernels used to unpack runs of elements, nullptr forces the element by element path
+	void SetUnpackKernels(const CVifUnpackKernels::KERNELS*);
+
 protected:
 	enum
 	{
@@ -91,6 +95,11 @@ protected:
 		FIFO_SIZE = 0x100
 	};
 
+	enum
+	{
+		UNPACK_RUN_SIZE = 0x40
+	};
+
 	class CFifoStream
 	{
 	public:
@@ -195,6 +204,7 @@ protected:
 	void Cmd_STCOL(StreamType&, CODE);
 	void Cmd_STMASK(StreamType&, CODE);
 
+	uint32 Unpack_Runs(StreamType&, uint32, CVifUnpackKernels::UnpackFunction, uint32, uint32, uint32, uint32);
 	bool Unpack_ReadValue(const CODE&, StreamType&, uint128&, bool);
 	bool Unpack_S32(StreamType&, uint128&);
 	bool Unpack_S16(StreamType&, uint128&, bool);
@@ -223,6 +233,7 @@ protected:
 	uint8* m_ram = nullptr;
 	uint8* m_spr = nullptr;
 	CFifoStream m_stream;
+	const CVifUnpackKernels::KERNELS* m_unpackKernels = &CVifUnpackKernels::GetKernels();
 
 	uint8 m_fifoBuffer[FIFO_SIZE];
 	uint32 m_fifoIndex = 0;
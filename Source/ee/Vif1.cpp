@@ -81,6 +81,7 @@ uint32 CVif1::ReceiveDMA(uint32 address, uint32 qwc, uint32 direction, bool tagI
 			address &= (PS2::EE_RAM_SIZE - 1);
 			assert((address + size) <= PS2::EE_RAM_SIZE);
 		}
+		m_vpu.WaitForMicroProgram();
 		auto gs = m_gif.GetGsHandler();
 		gs->ReadImageData(source + address, size);
 		return qwc;
@@ -110,6 +111,7 @@ void CVif1::ExecuteCommand(StreamType& stream, CODE nCommand)
 		break;
 	case 0x06:
 		//MSKPATH3
+		m_vpu.WaitForMicroProgram();
 		m_gif.SetPath3Masked((nCommand.nIMM & 0x8000) != 0);
 		break;
 	case 0x11:
@@ -158,6 +160,9 @@ void CVif1::Cmd_DIRECT(StreamType& stream, CODE nCommand)
 	nSize = std::min<uint32>(m_CODE.nIMM * 0x10, nSize);
 	assert((nSize & 0x0F) == 0);
 
+	//Packets kicked by VU1 must reach the GIF before PATH2 ones
+	m_vpu.WaitForMicroProgram();
+
 	if(nSize != 0)
 	{
 		auto packet = stream.GetDirectPointer();
@@ -0,0 +1,434 @@
+#include <cassert>
+#include <cstring>
+#include "VifUnpackKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAS_SSE2) || defined(HAS_NEON)
+#define HAS_SIMD
+#endif
+
+//Format is made of the vl (component size) and vn (component count) fields of the UNPACK command
+template <uint32 Format>
+struct FORMAT
+{
+	enum
+	{
+		IS_V45 = (Format == 0x0F),
+		COMPONENT_SIZE = 4 >> (Format & 0x03),
+		COMPONENT_COUNT = (Format >> 2) + 1,
+		ELEMENT_SIZE = IS_V45 ? 2 : (COMPONENT_SIZE * COMPONENT_COUNT),
+	};
+};
+
+static inline uint32 ReadWord(const uint8* src)
+{
+	uint32 value = 0;
+	memcpy(&value, src, sizeof(uint32));
+	return value;
+}
+
+//////////////////////////////////////////////
+//Scalar kernels
+
+template <uint32 ComponentSize, bool ZeroExtend>
+static inline uint32 ReadComponent(const uint8* src)
+{
+	switch(ComponentSize)
+	{
+	default:
+		assert(false);
+	case 4:
+		return ReadWord(src);
+	case 2:
+	{
+		uint16 value = 0;
+		memcpy(&value, src, sizeof(uint16));
+		return ZeroExtend ? value : static_cast<uint32>(static_cast<int16>(value));
+	}
+	case 1:
+		return ZeroExtend ? src[0] : static_cast<uint32>(static_cast<int8>(src[0]));
+	}
+}
+
+template <uint32 Format, bool ZeroExtend>
+static inline void ReadElement(uint128& result, const uint8* src)
+{
+	typedef FORMAT<Format> ElementFormat;
+	if(ElementFormat::IS_V45)
+	{
+		uint16 color = 0;
+		memcpy(&color, src, sizeof(uint16));
+		result.nV0 = ((color >> 0) & 0x1F) << 3;
+		result.nV1 = ((color >> 5) & 0x1F) << 3;
+		result.nV2 = ((color >> 10) & 0x1F) << 3;
+		result.nV3 = ((color >> 15) & 0x01) << 7;
+	}
+	else if(ElementFormat::COMPONENT_COUNT == 1)
+	{
+		uint32 value = ReadComponent<ElementFormat::COMPONENT_SIZE, ZeroExtend>(src);
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			result.nV[i] = value;
+		}
+	}
+	else
+	{
+		//Components that are not part of the element are cleared
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			result.nV[i] = (i < ElementFormat::COMPONENT_COUNT) ? ReadComponent<ElementFormat::COMPONENT_SIZE, ZeroExtend>(src + (i * ElementFormat::COMPONENT_SIZE)) : 0;
+		}
+	}
+}
+
+template <uint32 Format, bool ZeroExtend, bool Offset>
+static void UnpackScalar(uint128* dst, const uint8* src, uint32 count, const uint32* row)
+{
+	for(uint32 i = 0; i < count; i++)
+	{
+		uint128 value;
+		ReadElement<Format, ZeroExtend>(value, src);
+		if(Offset)
+		{
+			for(unsigned int j = 0; j < 4; j++)
+			{
+				value.nV[j] += row[j];
+			}
+		}
+		dst[i] = value;
+		src += FORMAT<Format>::ELEMENT_SIZE;
+	}
+}
+
+//////////////////////////////////////////////
+//SIMD kernels
+
+#ifdef HAS_SIMD
+
+//Small set of operations used by the kernels, implemented for every supported instruction set
+#if defined(HAS_SSE2)
+
+typedef __m128i Vector;
+
+static inline Vector Load(const uint8* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline Vector LoadHalf(const uint8* src)
+{
+	return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline Vector LoadWord(const uint8* src)
+{
+	return _mm_cvtsi32_si128(ReadWord(src));
+}
+
+static inline void Store(uint128* dst, Vector value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+static inline Vector Add(Vector value0, Vector value1)
+{
+	return _mm_add_epi32(value0, value1);
+}
+
+static inline Vector And(Vector value0, Vector value1)
+{
+	return _mm_and_si128(value0, value1);
+}
+
+static inline Vector Broadcast(uint32 value)
+{
+	return _mm_set1_epi32(value);
+}
+
+static inline Vector MakeVector(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	return _mm_setr_epi32(x, y, z, w);
+}
+
+//Extends the 4 lower 16 bits values to 32 bits
+template <bool ZeroExtend>
+static inline Vector Extend16(Vector value)
+{
+	if(ZeroExtend)
+	{
+		return _mm_unpacklo_epi16(value, _mm_setzero_si128());
+	}
+	else
+	{
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+	}
+}
+
+//Extends the 4 lower 8 bits values to 32 bits
+template <bool ZeroExtend>
+static inline Vector Extend8(Vector value)
+{
+	if(ZeroExtend)
+	{
+		__m128i zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(value, zero), zero);
+	}
+	else
+	{
+		value = _mm_unpacklo_epi8(value, value);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 24);
+	}
+}
+
+static inline Vector ExpandV45(uint16 color)
+{
+	//Every field is isolated in the low half of a 32 bits lane and moved in place with
+	//a multiplication (red, left shift) or the high half of a multiplication (others, right shift)
+	__m128i fields = _mm_and_si128(_mm_set1_epi32(color), _mm_setr_epi32(0x1F, 0x3E0, 0x7C00, 0x8000));
+	__m128i red = _mm_mullo_epi16(fields, _mm_setr_epi32(1 << 3, 0, 0, 0));
+	__m128i others = _mm_mulhi_epu16(fields, _mm_setr_epi32(0, 1 << 14, 1 << 9, 1 << 8));
+	return _mm_or_si128(red, others);
+}
+
+#elif defined(HAS_NEON)
+
+typedef uint32x4_t Vector;
+
+static inline Vector Load(const uint8* src)
+{
+	return vreinterpretq_u32_u8(vld1q_u8(src));
+}
+
+static inline Vector LoadHalf(const uint8* src)
+{
+	return vreinterpretq_u32_u8(vcombine_u8(vld1_u8(src), vdup_n_u8(0)));
+}
+
+static inline Vector LoadWord(const uint8* src)
+{
+	return vsetq_lane_u32(ReadWord(src), vdupq_n_u32(0), 0);
+}
+
+static inline void Store(uint128* dst, Vector value)
+{
+	vst1q_u8(reinterpret_cast<uint8*>(dst), vreinterpretq_u8_u32(value));
+}
+
+static inline Vector Add(Vector value0, Vector value1)
+{
+	return vaddq_u32(value0, value1);
+}
+
+static inline Vector And(Vector value0, Vector value1)
+{
+	return vandq_u32(value0, value1);
+}
+
+static inline Vector Broadcast(uint32 value)
+{
+	return vdupq_n_u32(value);
+}
+
+static inline Vector MakeVector(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	const uint32 values[4] = {x, y, z, w};
+	return vld1q_u32(values);
+}
+
+template <bool ZeroExtend>
+static inline Vector Extend16(Vector value)
+{
+	if(ZeroExtend)
+	{
+		return vmovl_u16(vget_low_u16(vreinterpretq_u16_u32(value)));
+	}
+	else
+	{
+		return vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(vreinterpretq_s16_u32(value))));
+	}
+}
+
+template <bool ZeroExtend>
+static inline Vector Extend8(Vector value)
+{
+	if(ZeroExtend)
+	{
+		return vmovl_u16(vget_low_u16(vmovl_u8(vget_low_u8(vreinterpretq_u8_u32(value)))));
+	}
+	else
+	{
+		return vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(vmovl_s8(vget_low_s8(vreinterpretq_s8_u32(value))))));
+	}
+}
+
+static inline Vector ExpandV45(uint16 color)
+{
+	static const int32 shifts[4] = {3, -2, -7, -8};
+	uint32x4_t fields = vandq_u32(vdupq_n_u32(color), MakeVector(0x1F, 0x3E0, 0x7C00, 0x8000));
+	return vshlq_u32(fields, vld1q_s32(shifts));
+}
+
+#endif
+
+template <uint32 Format, bool ZeroExtend>
+static inline Vector LoadElement(const uint8* src)
+{
+	switch(Format)
+	{
+	default:
+		assert(false);
+	case 0x00:
+		//S-32
+		return Broadcast(ReadWord(src));
+	case 0x04:
+		//V2-32
+		return LoadHalf(src);
+	case 0x08:
+		//V3-32
+		return And(Load(src), MakeVector(~0U, ~0U, ~0U, 0));
+	case 0x0C:
+		//V4-32
+		return Load(src);
+	case 0x05:
+		//V2-16
+		return Extend16<ZeroExtend>(LoadWord(src));
+	case 0x09:
+		//V3-16
+		return And(Extend16<ZeroExtend>(LoadHalf(src)), MakeVector(~0U, ~0U, ~0U, 0));
+	case 0x0D:
+		//V4-16
+		return Extend16<ZeroExtend>(LoadHalf(src));
+	case 0x0E:
+		//V4-8
+		return Extend8<ZeroExtend>(LoadWord(src));
+	case 0x0F:
+	{
+		//V4-5
+		uint16 color = 0;
+		memcpy(&color, src, sizeof(uint16));
+		return ExpandV45(color);
+	}
+	}
+}
+
+template <uint32 Format, bool ZeroExtend, bool Offset>
+static void UnpackSimd(uint128* dst, const uint8* src, uint32 count, const uint32* row)
+{
+	Vector rowValue = Offset ? MakeVector(row[0], row[1], row[2], row[3]) : Broadcast(0);
+	for(uint32 i = 0; i < count; i++)
+	{
+		Vector value = LoadElement<Format, ZeroExtend>(src);
+		if(Offset)
+		{
+			value = Add(value, rowValue);
+		}
+		Store(dst + i, value);
+		src += FORMAT<Format>::ELEMENT_SIZE;
+	}
+}
+
+#endif
+
+//////////////////////////////////////////////
+//Kernel selection
+
+template <uint32 Format>
+static void SetScalarKernels(CVifUnpackKernels::KERNELS& kernels)
+{
+	kernels.unpack[Format][0][0] = &UnpackScalar<Format, false, false>;
+	kernels.unpack[Format][0][1] = &UnpackScalar<Format, false, true>;
+	kernels.unpack[Format][1][0] = &UnpackScalar<Format, true, false>;
+	kernels.unpack[Format][1][1] = &UnpackScalar<Format, true, true>;
+}
+
+#ifdef HAS_SIMD
+template <uint32 Format>
+static void SetSimdKernels(CVifUnpackKernels::KERNELS& kernels)
+{
+	kernels.unpack[Format][0][0] = &UnpackSimd<Format, false, false>;
+	kernels.unpack[Format][0][1] = &UnpackSimd<Format, false, true>;
+	kernels.unpack[Format][1][0] = &UnpackSimd<Format, true, false>;
+	kernels.unpack[Format][1][1] = &UnpackSimd<Format, true, true>;
+}
+#endif
+
+static CVifUnpackKernels::KERNELS MakeScalarKernels()
+{
+	CVifUnpackKernels::KERNELS kernels;
+	SetScalarKernels<0x00>(kernels);
+	SetScalarKernels<0x01>(kernels);
+	SetScalarKernels<0x02>(kernels);
+	SetScalarKernels<0x04>(kernels);
+	SetScalarKernels<0x05>(kernels);
+	SetScalarKernels<0x06>(kernels);
+	SetScalarKernels<0x08>(kernels);
+	SetScalarKernels<0x09>(kernels);
+	SetScalarKernels<0x0A>(kernels);
+	SetScalarKernels<0x0C>(kernels);
+	SetScalarKernels<0x0D>(kernels);
+	SetScalarKernels<0x0E>(kernels);
+	SetScalarKernels<0x0F>(kernels);
+	return kernels;
+}
+
+static CVifUnpackKernels::KERNELS MakeSimdKernels()
+{
+	auto kernels = MakeScalarKernels();
+#ifdef HAS_SIMD
+	//S-16, S-8, V2-8 and V3-8 are rare enough to stay with the scalar versions
+	SetSimdKernels<0x00>(kernels);
+	SetSimdKernels<0x04>(kernels);
+	SetSimdKernels<0x05>(kernels);
+	SetSimdKernels<0x08>(kernels);
+	SetSimdKernels<0x09>(kernels);
+	SetSimdKernels<0x0C>(kernels);
+	SetSimdKernels<0x0D>(kernels);
+	SetSimdKernels<0x0E>(kernels);
+	SetSimdKernels<0x0F>(kernels);
+#endif
+	return kernels;
+}
+
+uint32 CVifUnpackKernels::GetElementSize(uint32 format)
+{
+	static const uint32 elementSizes[FORMAT_COUNT] =
+	    {
+	        FORMAT<0x00>::ELEMENT_SIZE, FORMAT<0x01>::ELEMENT_SIZE, FORMAT<0x02>::ELEMENT_SIZE, 0,
+	        FORMAT<0x04>::ELEMENT_SIZE, FORMAT<0x05>::ELEMENT_SIZE, FORMAT<0x06>::ELEMENT_SIZE, 0,
+	        FORMAT<0x08>::ELEMENT_SIZE, FORMAT<0x09>::ELEMENT_SIZE, FORMAT<0x0A>::ELEMENT_SIZE, 0,
+	        FORMAT<0x0C>::ELEMENT_SIZE, FORMAT<0x0D>::ELEMENT_SIZE, FORMAT<0x0E>::ELEMENT_SIZE, FORMAT<0x0F>::ELEMENT_SIZE,
+	    };
+	assert(format < FORMAT_COUNT);
+	return elementSizes[format];
+}
+
+bool CVifUnpackKernels::IsSimdSupported()
+{
+#ifdef HAS_SIMD
+	//SSE2 and NEON are part of the baseline of the architectures we build them for
+	return true;
+#else
+	return false;
+#endif
+}
+
+const CVifUnpackKernels::KERNELS& CVifUnpackKernels::GetKernels()
+{
+	static const KERNELS& kernels = GetKernels(IsSimdSupported() ? KERNEL_SET_SIMD : KERNEL_SET_SCALAR);
+	return kernels;
+}
+
+const CVifUnpackKernels::KERNELS& CVifUnpackKernels::GetKernels(KERNEL_SET kernelSet)
+{
+	static const KERNELS scalarKernels = MakeScalarKernels();
+	static const KERNELS simdKernels = MakeSimdKernels();
+	assert((kernelSet == KERNEL_SET_SCALAR) || (kernelSet == KERNEL_SET_SIMD));
+	return (kernelSet == KERNEL_SET_SIMD) ? simdKernels : scalarKernels;
+}
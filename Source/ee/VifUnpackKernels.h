@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Types.h"
+#include "../uint128.h"
+
+//Converts runs of VIF UNPACK elements to VU memory qwords. Kernels handle unmasked writes in normal
+//or offset mode, other cases go through the element by element path of CVif. SIMD versions are used
+//when available, scalar versions are kept as reference.
+class CVifUnpackKernels
+{
+public:
+	enum
+	{
+		//Lower 4 bits of the UNPACK command (vn and vl fields)
+		FORMAT_COUNT = 0x10,
+		//Kernels can read up to this amount of bytes past the last element
+		SOURCE_PADDING = 0x10,
+	};
+
+	//Arguments: destination (one qword per element), source elements, element count, row registers (added in offset mode)
+	typedef void (*UnpackFunction)(uint128*, const uint8*, uint32, const uint32*);
+
+	enum KERNEL_SET
+	{
+		KERNEL_SET_SCALAR,
+		KERNEL_SET_SIMD,
+	};
+
+	struct KERNELS
+	{
+		//Indexed by format, zero extension (USN) and offset mode. Invalid formats have no kernel.
+		UnpackFunction unpack[FORMAT_COUNT][2][2] = {};
+	};
+
+	//Returns the size of an element in bytes, 0 for invalid formats
+	static uint32 GetElementSize(uint32);
+
+	static bool IsSimdSupported();
+
+	//Returns the best kernel set supported by the host
+	static const KERNELS& GetKernels();
+	static const KERNELS& GetKernels(KERNEL_SET);
+};
@@ -1,3 +1,4 @@
+#include <cfenv>
 #include "make_unique.h"
 #include "../Log.h"
 #include "../states/RegisterStateFile.h"
@@ -10,6 +11,9 @@
 
 #define LOG_NAME ("ee_vpu")
 
+#define MICROPROGRAM_QUOTA (5000)
+#define MICROPROGRAM_QUOTA_COUNT (100)
+
 CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, CINTC& intc, uint8* ram, uint8* spr)
     : m_number(number)
     , m_vif((number == 0) ? std::make_unique<CVif>(0, *this, intc, ram, spr) : std::make_unique<CVif1>(1, *this, gif, intc, ram, spr))
@@ -19,6 +23,7 @@ CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, CINTC& intc,
     , m_ctx(vpuInit.context)
     , m_gif(gif)
     , m_vuProfilerZone(CProfiler::GetInstance().RegisterZone("VU"))
+    , m_running(false)
 #ifdef DEBUGGER_INCLUDED
     , m_microMemMiniState(new uint8[(number == 0) ? PS2::MICROMEM0SIZE : PS2::MICROMEM1SIZE])
     , m_vuMemMiniState(new uint8[(number == 0) ? PS2::VUMEM0SIZE : PS2::VUMEM1SIZE])
@@ -40,10 +45,18 @@ void CVpu::Execute(int32 quota)
 {
 	if(!m_running) return;
 
+	//Microprogram is being run by the VU thread
+	if(m_thread && m_thread->IsSliceRunning()) return;
+
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_vuProfilerZone);
 #endif
 
+	ExecuteCpu(quota);
+}
+
+void CVpu::ExecuteCpu(int32 quota)
+{
 	m_ctx->m_executor->Execute(quota);
 	if(m_ctx->m_State.nHasException)
 	{
@@ -92,6 +105,7 @@ uint32 CVpu::GetVuItopMiniState() const
 
 void CVpu::Reset()
 {
+	WaitForMicroProgram();
 	m_running = false;
 	m_ctx->m_executor->Reset();
 	m_vif->Reset();
@@ -99,11 +113,13 @@ void CVpu::Reset()
 
 void CVpu::SaveState(Framework::CZipArchiveWriter& archive)
 {
+	WaitForMicroProgram();
 	m_vif->SaveState(archive);
 }
 
 void CVpu::LoadState(Framework::CZipArchiveReader& archive)
 {
+	WaitForMicroProgram();
 	m_vif->LoadState(archive);
 }
 
@@ -141,6 +157,9 @@ void CVpu::ExecuteMicroProgram(uint32 nAddress)
 {
 	CLog::GetInstance().Print(LOG_NAME, "Starting microprogram execution at 0x%08X.\r\n", nAddress);
 
+	//Previous microprogram might still be wrapping up on the VU thread
+	WaitForMicroProgram();
+
 	m_ctx->m_State.nPC = nAddress;
 	m_ctx->m_State.pipeTime = 0;
 	m_ctx->m_State.nHasException = 0;
@@ -151,15 +170,35 @@ void CVpu::ExecuteMicroProgram(uint32 nAddress)
 
 	assert(!m_running);
 	m_running = true;
-	for(unsigned int i = 0; i < 100; i++)
+	if(m_thread)
 	{
-		Execute(5000);
+		m_thread->BeginSlice();
+		return;
+	}
+	for(unsigned int i = 0; i < MICROPROGRAM_QUOTA_COUNT; i++)
+	{
+		Execute(MICROPROGRAM_QUOTA);
+		if(!m_running) break;
+	}
+}
+
+//Might be called from the VU thread
+void CVpu::RunMicroProgram()
+{
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_vuProfilerZone);
+#endif
+
+	for(unsigned int i = 0; i < MICROPROGRAM_QUOTA_COUNT; i++)
+	{
+		ExecuteCpu(MICROPROGRAM_QUOTA);
 		if(!m_running) break;
 	}
 }
 
 void CVpu::InvalidateMicroProgram()
 {
+	WaitForMicroProgram();
 	m_ctx->m_executor->ClearActiveBlocksInRange(0, (m_number == 0) ? PS2::MICROMEM0SIZE : PS2::MICROMEM1SIZE, false);
 }
 
@@ -181,9 +220,78 @@ void CVpu::ProcessXgKick(uint32 address)
 	memcpy(metadata.microMem1, GetMicroMemoryMiniState(), PS2::MICROMEM1SIZE);
 #endif
 
-	m_gif.ProcessSinglePacket(GetVuMemory(), address, PS2::VUMEM1SIZE, metadata);
+	if(m_thread && m_thread->IsSliceRunning())
+	{
+		//GIF belongs to the EE, keep a copy of the packet since the microprogram can overwrite it
+		XGKICK xgKick;
+		xgKick.offset = static_cast<uint32>(m_xgKickBuffer.size());
+		xgKick.size = CGIF::GetPacketSize(GetVuMemory(), address, PS2::VUMEM1SIZE);
+		xgKick.metadata = metadata;
+		m_xgKickBuffer.insert(m_xgKickBuffer.end(), GetVuMemory() + address, GetVuMemory() + address + xgKick.size);
+		m_pendingXgKicks.push_back(std::move(xgKick));
+	}
+	else
+	{
+		m_gif.ProcessSinglePacket(GetVuMemory(), address, PS2::VUMEM1SIZE, metadata);
+	}
 
 #ifdef DEBUGGER_INCLUDED
 	SaveMiniState();
 #endif
 }
+
+void CVpu::SetThreadMode(CCoprocessorThread::MODE mode)
+{
+	assert(m_number == 1);
+	WaitForMicroProgram();
+	if(mode == CCoprocessorThread::MODE_SERIAL)
+	{
+		m_thread.reset();
+		return;
+	}
+	if(!m_thread)
+	{
+		m_thread = std::make_unique<CCoprocessorThread>(std::bind(&CVpu::RunMicroProgram, this),
+		                                               []() {
+			                                               fesetround(FE_TOWARDZERO);
+			                                               CProfiler::GetInstance().SetThreadName("VU1");
+		                                               });
+	}
+	m_thread->SetMode(mode);
+}
+
+void CVpu::WaitForMicroProgram()
+{
+	if(!m_thread) return;
+	m_thread->SyncFromEe();
+	FlushXgKicks();
+}
+
+//Called at the end of EE time slices, doesn't count as a sync
+void CVpu::FinishMicroProgram()
+{
+	if(!m_thread) return;
+	m_thread->EndSlice();
+	FlushXgKicks();
+}
+
+CCoprocessorThread::STATS CVpu::GetThreadStats() const
+{
+	return m_thread ? m_thread->GetStats() : CCoprocessorThread::STATS();
+}
+
+void CVpu::ResetThreadStats()
+{
+	if(!m_thread) return;
+	m_thread->ResetStats();
+}
+
+void CVpu::FlushXgKicks()
+{
+	for(const auto& xgKick : m_pendingXgKicks)
+	{
+		m_gif.ProcessSinglePacket(m_xgKickBuffer.data(), xgKick.offset, xgKick.offset + xgKick.size, xgKick.metadata);
+	}
+	m_pendingXgKicks.clear();
+	m_xgKickBuffer.clear();
+}
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "Types.h"
 #include "../MIPS.h"
 #include "../Profiler.h"
+#include "../CoprocessorThread.h"
+#include "../FrameDump.h"
 #include "Convertible.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
@@ -57,6 +62,14 @@ public:
 
 	void ProcessXgKick(uint32);
 
+	//Microprograms can be run on a separate thread (VU1 only). The EE must call WaitForMicroProgram
+	//before touching VU memory, VU registers or anything a microprogram can send data to (GIF, GS).
+	void SetThreadMode(CCoprocessorThread::MODE);
+	void WaitForMicroProgram();
+	void FinishMicroProgram();
+	CCoprocessorThread::STATS GetThreadStats() const;
+	void ResetThreadStats();
+
 #ifdef DEBUGGER_INCLUDED
 	void SaveMiniState();
 	const MIPSSTATE& GetVuMiniState() const;
@@ -68,6 +81,19 @@ public:
 
 protected:
 	typedef std::unique_ptr<CVif> VifPtr;
+	typedef std::unique_ptr<CCoprocessorThread> ThreadPtr;
+
+	struct XGKICK
+	{
+		uint32 offset = 0;
+		uint32 size = 0;
+		CGsPacketMetadata metadata;
+	};
+	typedef std::vector<XGKICK> XgKickArray;
+
+	void ExecuteCpu(int32);
+	void RunMicroProgram();
+	void FlushXgKicks();
 
 	uint8* m_microMem = nullptr;
 	uint8* m_vuMem = nullptr;
@@ -85,7 +111,12 @@ protected:
 #endif
 
 	unsigned int m_number = 0;
-	bool m_running = false;
+	std::atomic<bool> m_running;
+
+	//Packets kicked by a microprogram running on the VU thread, sent to the GIF by the EE
+	ThreadPtr m_thread;
+	std::vector<uint8> m_xgKickBuffer;
+	XgKickArray m_pendingXgKicks;
 
 	CProfiler::ZoneHandle m_vuProfilerZone = 0;
 };
@@ -1,3 +1,4 @@
+#include <zlib.h>
 #include "VuBasicBlock.h"
 #include "MA_VU.h"
 #include "offsetof_def.h"
@@ -7,6 +8,26 @@
 CVuBasicBlock::CVuBasicBlock(CMIPS& context, uint32 begin, uint32 end)
     : CBasicBlock(context, begin, end)
 {
+	//Allows code to be reused when the same microprogram is uploaded somewhere else
+	m_positionIndependent = true;
+}
+
+AOT_BLOCK_KEY CVuBasicBlock::GetBlockKey() const
+{
+	assert(!IsEmpty());
+	//Integer branch delay handling of short blocks looks at the instruction preceding the block
+	uint32 keyBegin = ((m_end - m_begin) < 0x14) ? (m_begin - 8) : m_begin;
+	uint32 keySize = ((m_end - keyBegin) / 4) + 1;
+	std::vector<uint32> keyData(keySize);
+	for(uint32 i = 0; i < keySize; i++)
+	{
+		keyData[i] = m_context.m_pMemoryMap->GetInstruction(keyBegin + (i * 4));
+	}
+	AOT_BLOCK_KEY key = {};
+	key.crc = crc32(0, reinterpret_cast<Bytef*>(keyData.data()), keySize * 4);
+	key.begin = 0;
+	key.end = m_end - m_begin;
+	return key;
 }
 
 void CVuBasicBlock::CompileRange(CMipsJitter* jitter)
@@ -8,6 +8,8 @@ public:
 	CVuBasicBlock(CMIPS&, uint32, uint32);
 	virtual ~CVuBasicBlock() = default;
 
+	AOT_BLOCK_KEY GetBlockKey() const override;
+
 protected:
 	void CompileRange(CMipsJitter*) override;
 
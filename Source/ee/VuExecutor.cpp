@@ -13,6 +13,21 @@ void CVuExecutor::Reset()
 	CGenericMipsExecutor::Reset();
 }
 
+CJitBlockCache& CVuExecutor::GetMicroprogramCache()
+{
+	return m_microprogramCache;
+}
+
+CVuExecutor::MICROPROGRAM_CACHE_STATS CVuExecutor::GetMicroprogramCacheStats() const
+{
+	auto codeStats = m_microprogramCache.GetStats();
+	MICROPROGRAM_CACHE_STATS result;
+	result.blockHits = m_blockHits;
+	result.codeHits = codeStats.hits;
+	result.codeMisses = codeStats.misses;
+	return result;
+}
+
 BasicBlockPtr CVuExecutor::BlockFactory(CMIPS& context, uint32 begin, uint32 end)
 {
 	uint32 blockSize = ((end - begin) + 4) / 4;
@@ -44,13 +59,15 @@ BasicBlockPtr CVuExecutor::BlockFactory(CMIPS& context, uint32 begin, uint32 end
 		{
 			if(basicBlock->GetEndAddress() == end)
 			{
+				m_blockHits++;
 				return basicBlock;
 			}
 		}
 	}
 
+	//Code is position independent, it can be fetched from blocks compiled at other addresses
 	auto result = std::make_shared<CVuBasicBlock>(context, begin, end);
-	result->Compile();
+	result->Compile(&m_microprogramCache, &m_codeArena);
 	m_cachedBlocks.insert(std::make_pair(checksum, result));
 	return result;
 }
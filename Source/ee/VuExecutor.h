@@ -2,15 +2,29 @@
 
 #include <unordered_map>
 #include "../GenericMipsExecutor.h"
+#include "../JitBlockCache.h"
 
 class CVuExecutor : public CGenericMipsExecutor<BlockLookupOneWay>
 {
 public:
+	struct MICROPROGRAM_CACHE_STATS
+	{
+		//Block found at the same address since the last reset
+		uint32 blockHits = 0;
+		//Code found in the microprogram cache, possibly compiled at another address
+		uint32 codeHits = 0;
+		uint32 codeMisses = 0;
+	};
+
 	CVuExecutor(CMIPS&, uint32);
 	virtual ~CVuExecutor() = default;
 
 	void Reset() override;
 
+	//Holds code of compiled blocks by content, survives resets
+	CJitBlockCache& GetMicroprogramCache();
+	MICROPROGRAM_CACHE_STATS GetMicroprogramCacheStats() const;
+
 protected:
 	typedef std::unordered_multimap<uint32, BasicBlockPtr> CachedBlockMap;
 
@@ -18,4 +32,6 @@ protected:
 	void PartitionFunction(uint32) override;
 
 	CachedBlockMap m_cachedBlocks;
+	CJitBlockCache m_microprogramCache;
+	uint32 m_blockHits = 0;
 };
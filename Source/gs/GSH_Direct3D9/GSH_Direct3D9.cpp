@@ -46,14 +46,14 @@ CGSH_Direct3D9::CGSH_Direct3D9(Framework::Win32::CWindow* outputWindow)
 Framework::CBitmap CGSH_Direct3D9::GetFramebuffer(uint64 frameReg)
 {
 	Framework::CBitmap result;
-	m_mailBox.SendCall([&]() { result = GetFramebufferImpl(frameReg); }, true);
+	SendGSCall([&]() { result = GetFramebufferImpl(frameReg); }, true);
 	return result;
 }
 
 Framework::CBitmap CGSH_Direct3D9::GetTexture(uint64 tex0Reg, uint32 maxMip, uint64 miptbp1Reg, uint64 miptbp2Reg, uint32 mipLevel)
 {
 	Framework::CBitmap result;
-	m_mailBox.SendCall([&]() { result = GetTextureImpl(tex0Reg, maxMip, miptbp1Reg, miptbp2Reg, mipLevel); }, true);
+	SendGSCall([&]() { result = GetTextureImpl(tex0Reg, maxMip, miptbp1Reg, miptbp2Reg, mipLevel); }, true);
 	return result;
 }
 
@@ -421,15 +421,6 @@ void CGSH_Direct3D9::PresentBackbuffer()
 	}
 }
 
-unsigned int CGSH_Direct3D9::GetCurrentReadCircuit()
-{
-	//assert((m_nPMODE & 0x3) != 0x03);
-	if(m_nPMODE & 0x1) return 0;
-	if(m_nPMODE & 0x2) return 1;
-	//Getting here is bad
-	return 0;
-}
-
 void CGSH_Direct3D9::FlipImpl()
 {
 	DrawActiveFramebuffer();
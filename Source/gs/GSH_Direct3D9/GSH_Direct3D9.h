@@ -168,7 +168,6 @@ private:
 	D3DPRESENT_PARAMETERS CreatePresentParams();
 	void DrawActiveFramebuffer();
 	void PresentBackbuffer();
-	unsigned int GetCurrentReadCircuit();
 
 	FramebufferPtr FindFramebuffer(uint64) const;
 	Framework::CBitmap GetFramebufferImpl(uint64);
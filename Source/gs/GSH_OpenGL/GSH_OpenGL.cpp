@@ -292,7 +292,7 @@ void CGSH_OpenGL::FlipImpl()
 void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive)
 {
 	CGSHandler::LoadState(archive);
-	m_mailBox.SendCall(
+	SendGSCall(
 	    [this]() {
 		    m_textureCache.InvalidateRange(0, RAMSIZE);
 	    });
@@ -517,40 +517,6 @@ void CGSH_OpenGL::MakeLinearZOrtho(float* matrix, float left, float right, float
 	matrix[15] = 1;
 }
 
-unsigned int CGSH_OpenGL::GetCurrentReadCircuit()
-{
-	uint32 rcMode = m_nPMODE & 0x03;
-	switch(rcMode)
-	{
-	default:
-	case 0:
-		//No read circuit enabled?
-		return 0;
-	case 1:
-		return 0;
-	case 2:
-		return 1;
-	case 3:
-	{
-		//Both are enabled... See if we can find out which one is good
-		//This happens in Capcom Classics Collection Vol. 2
-		std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
-		bool fb1Null = (m_nDISPFB1.value.q == 0);
-		bool fb2Null = (m_nDISPFB2.value.q == 0);
-		if(!fb1Null && fb2Null)
-		{
-			return 0;
-		}
-		if(fb1Null && !fb2Null)
-		{
-			return 1;
-		}
-		return 0;
-	}
-	break;
-	}
-}
-
 /////////////////////////////////////////////////////////////
 // Context Unpacking
 /////////////////////////////////////////////////////////////
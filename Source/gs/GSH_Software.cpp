@@ -0,0 +1,623 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include "../AppConfig.h"
+#include "../Log.h"
+#include "GsPixelFormats.h"
+#include "GSH_Software.h"
+
+#define LOG_NAME ("gs_software")
+
+CGSH_Software::CGSH_Software()
+{
+	RegisterPreferences();
+	m_primitiveMode <<= static_cast<uint64>(0);
+	m_rasterizer = std::make_unique<CGsRasterizer>(m_pRAM);
+}
+
+CGSH_Software::~CGSH_Software()
+{
+}
+
+void CGSH_Software::RegisterPreferences()
+{
+	CGSHandler::RegisterPreferences();
+	//0 lets the handler pick a count depending on the number of cores
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_CGSH_SOFTWARE_WORKERCOUNT, 0);
+}
+
+void CGSH_Software::SaveState(Framework::CZipArchiveWriter& archive)
+{
+	SendGSCall(
+	    [this]() {
+		    m_rasterizer->Flush();
+	    },
+	    true);
+	CGSHandler::SaveState(archive);
+}
+
+void CGSH_Software::LoadState(Framework::CZipArchiveReader& archive)
+{
+	//Pending primitives were meant for the memory we're about to replace
+	SendGSCall(
+	    [this]() {
+		    m_rasterizer->Clear();
+		    m_clutDirty = true;
+	    },
+	    true);
+	CGSHandler::LoadState(archive);
+}
+
+void CGSH_Software::InitializeImpl()
+{
+	LoadPreferences();
+}
+
+void CGSH_Software::ReleaseImpl()
+{
+	m_rasterizer->Flush();
+	m_rasterizer->SetWorkerCount(0);
+}
+
+void CGSH_Software::ResetImpl()
+{
+	m_rasterizer->Clear();
+	m_vtxCount = 0;
+	m_primitiveType = PRIM_INVALID;
+	m_clutDirty = true;
+	m_screen = Framework::CBitmap();
+}
+
+void CGSH_Software::NotifyPreferencesChangedImpl()
+{
+	LoadPreferences();
+	CGSHandler::NotifyPreferencesChangedImpl();
+}
+
+void CGSH_Software::LoadPreferences()
+{
+	int workerCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_CGSH_SOFTWARE_WORKERCOUNT);
+	if(workerCount <= 0)
+	{
+		//GS thread rasterizes along with the workers, leave some room for the other emulation threads
+		workerCount = std::min<int>(std::thread::hardware_concurrency() / 2, MAX_DEFAULT_WORKER_COUNT);
+	}
+	m_rasterizer->SetWorkerCount(workerCount);
+}
+
+void CGSH_Software::FlipImpl()
+{
+	m_rasterizer->Flush();
+	UpdateScreen();
+	CGSHandler::FlipImpl();
+}
+
+void CGSH_Software::WriteRegisterImpl(uint8 registerId, uint64 data)
+{
+	//Memory is accessed directly by transfers and CLUT loads, primitives drawn before must be there
+	switch(registerId)
+	{
+	case GS_REG_TRXDIR:
+		m_rasterizer->Flush();
+		break;
+	case GS_REG_TEX0_1:
+	case GS_REG_TEX0_2:
+	{
+		auto tex0 = make_convertible<TEX0>(data);
+		if(m_rasterizer->IsRangeWritten(tex0.GetCLUTPtr(), CLUTSIZE))
+		{
+			m_rasterizer->Flush();
+		}
+	}
+	break;
+	case GS_REG_TEX2_1:
+	case GS_REG_TEX2_2:
+	{
+		auto tex2 = make_convertible<TEX2>(data);
+		if(m_rasterizer->IsRangeWritten(tex2.GetCLUTPtr(), CLUTSIZE))
+		{
+			m_rasterizer->Flush();
+		}
+	}
+	break;
+	}
+
+	CGSHandler::WriteRegisterImpl(registerId, data);
+
+	switch(registerId)
+	{
+	case GS_REG_PRIM:
+		m_primitiveType = static_cast<unsigned int>(data & 0x07);
+		switch(m_primitiveType)
+		{
+		case PRIM_POINT:
+			m_vtxCount = 1;
+			break;
+		case PRIM_LINE:
+		case PRIM_LINESTRIP:
+			m_vtxCount = 2;
+			break;
+		case PRIM_TRIANGLE:
+		case PRIM_TRIANGLESTRIP:
+		case PRIM_TRIANGLEFAN:
+			m_vtxCount = 3;
+			break;
+		case PRIM_SPRITE:
+			m_vtxCount = 2;
+			break;
+		}
+		break;
+
+	case GS_REG_XYZ2:
+	case GS_REG_XYZ3:
+	case GS_REG_XYZF2:
+	case GS_REG_XYZF3:
+		VertexKick(registerId, data);
+		break;
+	}
+}
+
+void CGSH_Software::VertexKick(uint8 registerId, uint64 value)
+{
+	if(m_vtxCount == 0) return;
+
+	bool drawingKick = (registerId == GS_REG_XYZ2) || (registerId == GS_REG_XYZF2);
+	bool fog = (registerId == GS_REG_XYZF2) || (registerId == GS_REG_XYZF3);
+
+	if(!m_drawEnabled) drawingKick = false;
+
+	auto& vertex = m_vtxBuffer[m_vtxCount - 1];
+	vertex.nPosition = fog ? (value & 0x00FFFFFFFFFFFFFFULL) : value;
+	vertex.nRGBAQ = m_nReg[GS_REG_RGBAQ];
+	vertex.nUV = m_nReg[GS_REG_UV];
+	vertex.nST = m_nReg[GS_REG_ST];
+	vertex.nFog = static_cast<uint8>(fog ? (value >> 56) : (m_nReg[GS_REG_FOG] >> 56));
+
+	m_vtxCount--;
+
+	if(m_vtxCount == 0)
+	{
+		if((m_nReg[GS_REG_PRMODECONT] & 1) != 0)
+		{
+			m_primitiveMode <<= m_nReg[GS_REG_PRIM];
+		}
+		else
+		{
+			m_primitiveMode <<= m_nReg[GS_REG_PRMODE];
+		}
+
+		if(drawingKick)
+		{
+			DrawPrimitive();
+		}
+
+		switch(m_primitiveType)
+		{
+		case PRIM_POINT:
+			m_vtxCount = 1;
+			break;
+		case PRIM_LINE:
+			m_vtxCount = 2;
+			break;
+		case PRIM_LINESTRIP:
+			memcpy(&m_vtxBuffer[1], &m_vtxBuffer[0], sizeof(VERTEX));
+			m_vtxCount = 1;
+			break;
+		case PRIM_TRIANGLE:
+			m_vtxCount = 3;
+			break;
+		case PRIM_TRIANGLESTRIP:
+			memcpy(&m_vtxBuffer[2], &m_vtxBuffer[1], sizeof(VERTEX));
+			memcpy(&m_vtxBuffer[1], &m_vtxBuffer[0], sizeof(VERTEX));
+			m_vtxCount = 1;
+			break;
+		case PRIM_TRIANGLEFAN:
+			memcpy(&m_vtxBuffer[1], &m_vtxBuffer[0], sizeof(VERTEX));
+			m_vtxCount = 1;
+			break;
+		case PRIM_SPRITE:
+			m_vtxCount = 2;
+			break;
+		}
+	}
+}
+
+void CGSH_Software::DrawPrimitive()
+{
+	auto state = MakeRasterizerState();
+	const uint32* clut = nullptr;
+	if(state.textureEnabled && CGsPixelFormats::IsPsmIDTEX(state.texturePsm))
+	{
+		clut = GetClut(make_convertible<TEX0>(m_nReg[GS_REG_TEX0_1 + m_primitiveMode.nContext]));
+	}
+	m_rasterizer->SetState(state, clut);
+
+	switch(m_primitiveType)
+	{
+	case PRIM_POINT:
+		m_rasterizer->DrawPoint(MakeRasterizerVertex(m_vtxBuffer[0]));
+		break;
+	case PRIM_LINE:
+	case PRIM_LINESTRIP:
+		m_rasterizer->DrawLine(MakeRasterizerVertex(m_vtxBuffer[1]), MakeRasterizerVertex(m_vtxBuffer[0]));
+		break;
+	case PRIM_TRIANGLE:
+	case PRIM_TRIANGLESTRIP:
+	case PRIM_TRIANGLEFAN:
+		m_rasterizer->DrawTriangle(MakeRasterizerVertex(m_vtxBuffer[2]), MakeRasterizerVertex(m_vtxBuffer[1]), MakeRasterizerVertex(m_vtxBuffer[0]));
+		break;
+	case PRIM_SPRITE:
+		m_rasterizer->DrawSprite(MakeRasterizerVertex(m_vtxBuffer[1]), MakeRasterizerVertex(m_vtxBuffer[0]));
+		break;
+	}
+}
+
+CGsRasterizer::STATE CGSH_Software::MakeRasterizerState()
+{
+	unsigned int context = m_primitiveMode.nContext;
+	auto frame = make_convertible<FRAME>(m_nReg[GS_REG_FRAME_1 + context]);
+	auto zbuf = make_convertible<ZBUF>(m_nReg[GS_REG_ZBUF_1 + context]);
+	auto scissor = make_convertible<SCISSOR>(m_nReg[GS_REG_SCISSOR_1 + context]);
+	auto test = make_convertible<TEST>(m_nReg[GS_REG_TEST_1 + context]);
+	auto alpha = make_convertible<ALPHA>(m_nReg[GS_REG_ALPHA_1 + context]);
+	auto tex0 = make_convertible<TEX0>(m_nReg[GS_REG_TEX0_1 + context]);
+	auto tex1 = make_convertible<TEX1>(m_nReg[GS_REG_TEX1_1 + context]);
+	auto clamp = make_convertible<CLAMP>(m_nReg[GS_REG_CLAMP_1 + context]);
+	auto texA = make_convertible<TEXA>(m_nReg[GS_REG_TEXA]);
+
+	CGsRasterizer::STATE state;
+
+	state.frameBufPtr = frame.GetBasePtr();
+	state.frameBufWidth = frame.nWidth;
+	state.framePsm = frame.nPsm;
+	state.frameMask = frame.nMask;
+
+	state.zbufPtr = zbuf.GetBasePtr();
+	state.zbufPsm = zbuf.nPsm | 0x30;
+	state.zbufMask = zbuf.nMask;
+
+	state.scissorX0 = scissor.scax0;
+	state.scissorY0 = scissor.scay0;
+	state.scissorX1 = scissor.scax1;
+	state.scissorY1 = scissor.scay1;
+
+	state.alphaTestEnabled = test.nAlphaEnabled;
+	state.alphaTestMethod = test.nAlphaMethod;
+	state.alphaTestRef = test.nAlphaRef;
+	state.alphaTestFail = test.nAlphaFail;
+	state.destAlphaTestEnabled = test.nDestAlphaEnabled;
+	state.destAlphaTestMode = test.nDestAlphaMode;
+	state.depthTestEnabled = test.nDepthEnabled;
+	state.depthTestMethod = test.nDepthMethod;
+
+	state.alphaBlendEnabled = m_primitiveMode.nAlpha;
+	state.alphaBlendA = alpha.nA;
+	state.alphaBlendB = alpha.nB;
+	state.alphaBlendC = alpha.nC;
+	state.alphaBlendD = alpha.nD;
+	state.alphaBlendFix = alpha.nFix;
+	state.pabe = m_nReg[GS_REG_PABE] & 1;
+	state.fba = m_nReg[GS_REG_FBA_1 + context] & 1;
+	state.colClamp = m_nReg[GS_REG_COLCLAMP] & 1;
+
+	state.gouraudShading = m_primitiveMode.nShading;
+	state.fogEnabled = m_primitiveMode.nFog;
+	state.fogColor = static_cast<uint32>(m_nReg[GS_REG_FOGCOL] & 0xFFFFFF);
+
+	state.textureEnabled = m_primitiveMode.nTexture;
+	if(state.textureEnabled)
+	{
+		//Only the base level is used, pick the filter that applies to it
+		bool useMinFilter = (tex1.nLODMethod == 1) && (tex1.GetK() > 0);
+		bool linearFilter = useMinFilter ? ((tex1.nMinFilter == MIN_FILTER_LINEAR) || (tex1.nMinFilter == MIN_FILTER_LINEAR_MIP_NEAREST) || (tex1.nMinFilter == MIN_FILTER_LINEAR_MIP_LINEAR))
+		                                 : (tex1.nMagFilter == MAG_FILTER_LINEAR);
+
+		state.textureUseUV = m_primitiveMode.nUseUV;
+		state.textureBufPtr = tex0.GetBufPtr();
+		state.textureBufWidth = tex0.nBufWidth;
+		state.texturePsm = tex0.nPsm;
+		state.textureWidth = std::min<uint32>(tex0.GetWidth(), 1024);
+		state.textureHeight = std::min<uint32>(tex0.GetHeight(), 1024);
+		state.textureHasAlpha = tex0.nColorComp;
+		state.textureFunction = tex0.nFunction;
+		state.textureLinearFilter = linearFilter;
+		state.textureWrapModeU = clamp.nWMS;
+		state.textureWrapModeV = clamp.nWMT;
+		state.textureMinU = clamp.GetMinU();
+		state.textureMaxU = clamp.GetMaxU();
+		state.textureMinV = clamp.GetMinV();
+		state.textureMaxV = clamp.GetMaxV();
+		state.textureAlpha0 = texA.nTA0;
+		state.textureAlpha1 = texA.nTA1;
+		state.textureAlphaExpand = texA.nAEM;
+	}
+
+	return state;
+}
+
+CGsRasterizer::VERTEX CGSH_Software::MakeRasterizerVertex(const VERTEX& source)
+{
+	auto xyz = make_convertible<XYZ>(source.nPosition);
+	auto rgbaq = make_convertible<RGBAQ>(source.nRGBAQ);
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + m_primitiveMode.nContext]);
+
+	CGsRasterizer::VERTEX vertex;
+	vertex.x = static_cast<int32>(xyz.nX) - static_cast<int32>(offset.nOffsetX);
+	vertex.y = static_cast<int32>(xyz.nY) - static_cast<int32>(offset.nOffsetY);
+	vertex.z = xyz.nZ;
+	vertex.r = rgbaq.nR;
+	vertex.g = rgbaq.nG;
+	vertex.b = rgbaq.nB;
+	vertex.a = rgbaq.nA;
+	vertex.fog = source.nFog;
+	if(m_primitiveMode.nUseUV)
+	{
+		auto uv = make_convertible<UV>(source.nUV);
+		vertex.s = uv.GetU();
+		vertex.t = uv.GetV();
+		vertex.q = 1;
+	}
+	else
+	{
+		auto st = make_convertible<ST>(source.nST);
+		vertex.s = st.nS;
+		vertex.t = st.nT;
+		vertex.q = rgbaq.nQ;
+	}
+	return vertex;
+}
+
+const uint32* CGSH_Software::GetClut(const TEX0& tex0)
+{
+	//Only rebuild the linear CLUT when the CLUT buffer or the way it's interpreted changes
+	uint64 clutTex0 = static_cast<uint64>(CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm)) | (static_cast<uint64>(tex0.nCPSM) << 8) | (static_cast<uint64>(tex0.nCSA) << 16);
+	uint64 clutTexA = m_nReg[GS_REG_TEXA];
+	if(!m_clutDirty && (clutTex0 == m_clutTex0) && (clutTexA == m_clutTexA))
+	{
+		return m_clut.data();
+	}
+
+	MakeLinearCLUT(tex0, m_clut);
+
+	//Alpha of 16-bit and 24-bit colors comes from TEXA
+	auto texA = make_convertible<TEXA>(clutTexA);
+	bool clut16 = (tex0.nCPSM == PSMCT16) || (tex0.nCPSM == PSMCT16S);
+	bool clut24 = (tex0.nCPSM == PSMCT24);
+	if(clut16 || clut24)
+	{
+		for(auto& color : m_clut)
+		{
+			uint32 rgb = color & 0xFFFFFF;
+			uint32 alpha = (texA.nAEM && (rgb == 0)) ? 0 : texA.nTA0;
+			if(clut16 && (color & 0xFF000000))
+			{
+				alpha = texA.nTA1;
+			}
+			color = rgb | (alpha << 24);
+		}
+	}
+
+	m_clutDirty = false;
+	m_clutTex0 = clutTex0;
+	m_clutTexA = clutTexA;
+	return m_clut.data();
+}
+
+void CGSH_Software::ProcessHostToLocalTransfer()
+{
+}
+
+void CGSH_Software::ProcessLocalToHostTransfer()
+{
+}
+
+void CGSH_Software::ProcessLocalToLocalTransfer()
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	if(bltBuf.nSrcPsm != bltBuf.nDstPsm)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Local to local transfer between different formats (0x%02X, 0x%02X), converting as 0x%02X.\r\n",
+		                         bltBuf.nSrcPsm, bltBuf.nDstPsm, bltBuf.nDstPsm);
+	}
+
+	typedef CGsPixelFormats::STORAGEPSMCT32 STORAGEPSMCT32;
+	switch(bltBuf.nDstPsm)
+	{
+	case PSMCT32:
+		TransferLocalToLocal<STORAGEPSMCT32>(0xFFFFFFFF);
+		break;
+	case PSMCT24:
+		TransferLocalToLocal<STORAGEPSMCT32>(0x00FFFFFF);
+		break;
+	case PSMCT16:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT16>(0xFFFF);
+		break;
+	case PSMCT16S:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT16S>(0xFFFF);
+		break;
+	case PSMT8:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMT8>(0xFF);
+		break;
+	case PSMT4:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMT4>(0x0F);
+		break;
+	case PSMT8H:
+		TransferLocalToLocal<STORAGEPSMCT32>(0xFF000000);
+		break;
+	case PSMT4HL:
+		TransferLocalToLocal<STORAGEPSMCT32>(0x0F000000);
+		break;
+	case PSMT4HH:
+		TransferLocalToLocal<STORAGEPSMCT32>(0xF0000000);
+		break;
+	case PSMZ32:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMZ32>(0xFFFFFFFF);
+		break;
+	case PSMZ24:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMZ32>(0x00FFFFFF);
+		break;
+	case PSMZ16:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMZ16>(0xFFFF);
+		break;
+	case PSMZ16S:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMZ16S>(0xFFFF);
+		break;
+	default:
+		CLog::GetInstance().Warn(LOG_NAME, "Unsupported local to local transfer format (0x%02X).\r\n", bltBuf.nDstPsm);
+		break;
+	}
+}
+
+template <typename Storage>
+void CGSH_Software::TransferLocalToLocal(uint32 writeMask)
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+
+	CGsPixelFormats::CPixelIndexor<Storage> srcIndexor(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth);
+	CGsPixelFormats::CPixelIndexor<Storage> dstIndexor(m_pRAM, bltBuf.GetDstPtr(), bltBuf.nDstWidth);
+	auto mask = static_cast<typename Storage::Unit>(writeMask);
+
+	//Source is completely read first since both areas can overlap
+	std::vector<typename Storage::Unit> pixels(trxReg.nRRW * trxReg.nRRH);
+	auto pixel = pixels.begin();
+	for(uint32 y = 0; y < trxReg.nRRH; y++)
+	{
+		for(uint32 x = 0; x < trxReg.nRRW; x++)
+		{
+			*(pixel++) = srcIndexor.GetPixel((trxPos.nSSAX + x) % 2048, (trxPos.nSSAY + y) % 2048);
+		}
+	}
+
+	pixel = pixels.begin();
+	for(uint32 y = 0; y < trxReg.nRRH; y++)
+	{
+		for(uint32 x = 0; x < trxReg.nRRW; x++)
+		{
+			uint32 dstX = (trxPos.nDSAX + x) % 2048;
+			uint32 dstY = (trxPos.nDSAY + y) % 2048;
+			auto dstPixel = dstIndexor.GetPixel(dstX, dstY);
+			dstIndexor.SetPixel(dstX, dstY, (dstPixel & ~mask) | (*(pixel++) & mask));
+		}
+	}
+}
+
+void CGSH_Software::ProcessClutTransfer(uint32, uint32)
+{
+	m_clutDirty = true;
+}
+
+void CGSH_Software::ReadFramebuffer(uint32 width, uint32 height, void* buffer)
+{
+	//BGR rows from bottom to top, 4-byte aligned like glReadPixels does by default
+	uint32 pitch = ((width * 3) + 3) & ~3;
+	auto dst = reinterpret_cast<uint8*>(buffer);
+	if(m_screen.IsEmpty())
+	{
+		memset(dst, 0, pitch * height);
+		return;
+	}
+
+	uint32 screenWidth = m_screen.GetWidth();
+	uint32 screenHeight = m_screen.GetHeight();
+	for(uint32 y = 0; y < height; y++)
+	{
+		uint32 srcY = ((height - 1 - y) * screenHeight) / height;
+		auto srcRow = reinterpret_cast<const uint32*>(m_screen.GetPixels() + (srcY * m_screen.GetPitch()));
+		auto dstRow = dst + (y * pitch);
+		for(uint32 x = 0; x < width; x++)
+		{
+			uint32 color = srcRow[(x * screenWidth) / width];
+			dstRow[(x * 3) + 0] = static_cast<uint8>(color >> 16);
+			dstRow[(x * 3) + 1] = static_cast<uint8>(color >> 8);
+			dstRow[(x * 3) + 2] = static_cast<uint8>(color >> 0);
+		}
+	}
+}
+
+Framework::CBitmap CGSH_Software::GetScreenshot()
+{
+	return m_screen;
+}
+
+void CGSH_Software::UpdateScreen()
+{
+	DISPLAY d;
+	DISPFB fb;
+	{
+		std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
+		unsigned int readCircuit = GetCurrentReadCircuit();
+		switch(readCircuit)
+		{
+		case 0:
+			d <<= m_nDISPLAY1.value.q;
+			fb <<= m_nDISPFB1.value.q;
+			break;
+		case 1:
+			d <<= m_nDISPLAY2.value.q;
+			fb <<= m_nDISPFB2.value.q;
+			break;
+		}
+	}
+
+	unsigned int dispWidth = (d.nW + 1) / (d.nMagX + 1);
+	unsigned int dispHeight = (d.nH + 1);
+
+	bool halfHeight = GetCrtIsInterlaced() && GetCrtIsFrameMode();
+	if(halfHeight) dispHeight /= 2;
+
+	if((dispWidth == 0) || (dispHeight == 0) || (fb.nBufWidth == 0))
+	{
+		m_screen = Framework::CBitmap();
+		return;
+	}
+
+	m_screen = Framework::CBitmap(dispWidth, dispHeight, 32);
+	for(unsigned int y = 0; y < dispHeight; y++)
+	{
+		auto dstRow = reinterpret_cast<uint32*>(m_screen.GetPixels() + (y * m_screen.GetPitch()));
+		uint32 srcY = (fb.nY + y) % 2048;
+		for(unsigned int x = 0; x < dispWidth; x++)
+		{
+			uint32 srcX = (fb.nX + x) % 2048;
+			uint32 color = 0;
+			switch(fb.nPSM)
+			{
+			case PSMCT32:
+			case PSMCT24:
+			default:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+				color = indexor.GetPixel(srcX, srcY);
+			}
+			break;
+			case PSMCT16:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+				color = RGBA16ToRGBA32(indexor.GetPixel(srcX, srcY));
+			}
+			break;
+			case PSMCT16S:
+			{
+				CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, fb.GetBufPtr(), fb.nBufWidth);
+				color = RGBA16ToRGBA32(indexor.GetPixel(srcX, srcY));
+			}
+			break;
+			}
+			//Screen is opaque, alpha is only used for blending with the other circuit
+			dstRow[x] = color | 0xFF000000;
+		}
+	}
+}
+
+CGSHandler::FactoryFunction CGSH_Software::GetFactoryFunction()
+{
+	return std::bind(&CGSH_Software::GSHandlerFactory);
+}
+
+CGSHandler* CGSH_Software::GSHandlerFactory()
+{
+	return new CGSH_Software();
+}
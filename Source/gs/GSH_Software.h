@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include "GSHandler.h"
+#include "GsRasterizer.h"
+#include "bitmap/Bitmap.h"
+
+#define PREF_CGSH_SOFTWARE_WORKERCOUNT "renderer.software.workercount"
+
+//Renders everything on the CPU, directly in GS memory. Doesn't need any graphics API, which makes it
+//usable on headless machines and gives the same output on every machine.
+class CGSH_Software : public CGSHandler
+{
+public:
+	CGSH_Software();
+	virtual ~CGSH_Software();
+
+	static void RegisterPreferences();
+
+	void SaveState(Framework::CZipArchiveWriter&) override;
+	void LoadState(Framework::CZipArchiveReader&) override;
+
+	void ProcessHostToLocalTransfer() override;
+	void ProcessLocalToHostTransfer() override;
+	void ProcessLocalToLocalTransfer() override;
+	void ProcessClutTransfer(uint32, uint32) override;
+	void ReadFramebuffer(uint32, uint32, void*) override;
+
+	Framework::CBitmap GetScreenshot() override;
+
+	static FactoryFunction GetFactoryFunction();
+
+private:
+	struct VERTEX
+	{
+		uint64 nPosition;
+		uint64 nRGBAQ;
+		uint64 nUV;
+		uint64 nST;
+		uint8 nFog;
+	};
+
+	enum
+	{
+		MAX_DEFAULT_WORKER_COUNT = 8,
+	};
+
+	void InitializeImpl() override;
+	void ReleaseImpl() override;
+	void ResetImpl() override;
+	void NotifyPreferencesChangedImpl() override;
+	void FlipImpl() override;
+	void WriteRegisterImpl(uint8, uint64) override;
+
+	void LoadPreferences();
+	void VertexKick(uint8, uint64);
+	void DrawPrimitive();
+
+	CGsRasterizer::STATE MakeRasterizerState();
+	CGsRasterizer::VERTEX MakeRasterizerVertex(const VERTEX&);
+	const uint32* GetClut(const TEX0&);
+
+	template <typename Storage>
+	void TransferLocalToLocal(uint32);
+
+	void UpdateScreen();
+
+	static CGSHandler* GSHandlerFactory();
+
+	std::unique_ptr<CGsRasterizer> m_rasterizer;
+
+	VERTEX m_vtxBuffer[3];
+	unsigned int m_vtxCount = 0;
+	unsigned int m_primitiveType = PRIM_INVALID;
+	PRMODE m_primitiveMode;
+
+	std::array<uint32, CGsRasterizer::CLUT_ENTRY_COUNT> m_clut;
+	bool m_clutDirty = true;
+	uint64 m_clutTex0 = 0;
+	uint64 m_clutTexA = 0;
+
+	Framework::CBitmap m_screen;
+};
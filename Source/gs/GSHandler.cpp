@@ -9,6 +9,7 @@
 #include "../ee/INTC.h"
 #include "GSHandler.h"
 #include "GsPixelFormats.h"
+#include "GsTransferKernels.h"
 #include "string_format.h"
 
 //Shadow Hearts 2 looks for this specific value
@@ -54,13 +55,14 @@
 
 #define LOG_NAME ("gs")
 
-struct MASSIVEWRITE_INFO
-{
+//Number of commands pushed before the GS thread is woken up
+#define COMMAND_FLUSH_BATCH_SIZE (0x100)
+
 #ifdef DEBUGGER_INCLUDED
-	CGsPacketMetadata metadata;
+#define PACKET_METADATA_SIZE ((sizeof(CGsPacketMetadata) + CGsCommandRing::DATA_ALIGNMENT - 1) & ~(CGsCommandRing::DATA_ALIGNMENT - 1))
+#else
+#define PACKET_METADATA_SIZE (0)
 #endif
-	CGSHandler::RegisterWriteList writes;
-};
 
 CGSHandler::CGSHandler()
     : m_threadDone(false)
@@ -72,6 +74,8 @@ CGSHandler::CGSHandler()
 {
 	RegisterPreferences();
 
+	m_gsProfilerZone = CProfiler::GetInstance().RegisterZone("GS");
+
 	m_presentationParams.mode = static_cast<PRESENTATION_MODE>(CAppConfig::GetInstance().GetPreferenceInteger(PREF_CGSHANDLER_PRESENTATION_MODE));
 	m_presentationParams.windowWidth = 512;
 	m_presentationParams.windowHeight = 384;
@@ -105,7 +109,7 @@ CGSHandler::CGSHandler()
 
 CGSHandler::~CGSHandler()
 {
-	m_mailBox.SendCall([this]() { m_threadDone = true; });
+	SendGSCall([this]() { m_threadDone = true; });
 	if(m_thread.joinable())
 		m_thread.join();
 	delete[] m_pRAM;
@@ -119,7 +123,7 @@ void CGSHandler::RegisterPreferences()
 
 void CGSHandler::NotifyPreferencesChanged()
 {
-	m_mailBox.SendCall([this]() { NotifyPreferencesChangedImpl(); });
+	SendGSCall([this]() { NotifyPreferencesChangedImpl(); });
 }
 
 void CGSHandler::SetIntc(CINTC* intc)
@@ -130,7 +134,7 @@ void CGSHandler::SetIntc(CINTC* intc)
 void CGSHandler::Reset()
 {
 	ResetBase();
-	m_mailBox.SendCall(std::bind(&CGSHandler::ResetImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::ResetImpl, this), true);
 }
 
 void CGSHandler::ResetBase()
@@ -375,22 +379,24 @@ void CGSHandler::WritePrivRegister(uint32 nAddress, uint32 nData)
 
 void CGSHandler::Initialize()
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::InitializeImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::InitializeImpl, this), true);
 }
 
 void CGSHandler::Release()
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::ReleaseImpl, this), true);
+	SendGSCall(std::bind(&CGSHandler::ReleaseImpl, this), true);
 }
 
 void CGSHandler::Flip(bool showOnly)
 {
 	if(!showOnly)
 	{
-		m_mailBox.FlushCalls();
-		m_mailBox.SendCall(std::bind(&CGSHandler::MarkNewFrame, this));
+		SendGSCall([]() {}, true);
+		CGsCommandRing::COMMAND command = {};
+		command.type = CGsCommandRing::COMMAND_MARK_NEW_FRAME;
+		PushCommand(command);
 	}
-	m_mailBox.SendCall(std::bind(&CGSHandler::FlipImpl, this), true, true);
+	SendGSCall(std::bind(&CGSHandler::FlipImpl, this), true, true);
 }
 
 void CGSHandler::FlipImpl()
@@ -429,7 +435,11 @@ void CGSHandler::SetSMODE2(uint64 value)
 
 void CGSHandler::WriteRegister(uint8 registerId, uint64 value)
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::WriteRegisterImpl, this, registerId, value));
+	CGsCommandRing::COMMAND command = {};
+	command.type = CGsCommandRing::COMMAND_WRITE_REGISTER;
+	command.param = registerId;
+	command.value = value;
+	PushCommand(command);
 }
 
 void CGSHandler::FeedImageData(const void* data, uint32 length)
@@ -438,18 +448,32 @@ void CGSHandler::FeedImageData(const void* data, uint32 length)
 
 	//Allocate 0x10 more bytes to allow transfer handlers
 	//to read beyond the actual length of the buffer (ie.: PSMCT24)
+	uint32 dataSize = length + 0x10;
 
-	std::vector<uint8> imageData(length + 0x10);
-	memcpy(imageData.data(), data, length);
-	m_mailBox.SendCall(
-	    [this, imageData = std::move(imageData), length]() {
-		    FeedImageDataImpl(imageData.data(), length);
-	    });
+	if(dataSize > CGsCommandRing::MAX_DATA_SIZE)
+	{
+		std::vector<uint8> imageData(dataSize);
+		memcpy(imageData.data(), data, length);
+		SendGSCall(
+		    [this, imageData = std::move(imageData), length]() {
+			    FeedImageDataImpl(imageData.data(), length);
+		    });
+		return;
+	}
+
+	CGsCommandRing::COMMAND command = {};
+	command.type = CGsCommandRing::COMMAND_FEED_IMAGE_DATA;
+	command.param = length;
+	command.dataSize = dataSize;
+	auto imageData = AllocateCommandData(dataSize, command.dataPosition);
+	memcpy(imageData, data, length);
+	memset(imageData + length, 0, dataSize - length);
+	PushCommand(command);
 }
 
 void CGSHandler::ReadImageData(void* data, uint32 length)
 {
-	m_mailBox.SendCall([this, data, length]() { ReadImageDataImpl(data, length); }, true);
+	SendGSCall([this, data, length]() { ReadImageDataImpl(data, length); }, true);
 }
 
 void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const CGsPacketMetadata* metadata)
@@ -488,23 +512,38 @@ void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const
 
 	m_transferCount++;
 
-	MASSIVEWRITE_INFO massiveWrite;
-	massiveWrite.writes = std::move(registerWrites);
+	uint32 writeCount = static_cast<uint32>(registerWrites.size());
+	uint32 dataSize = PACKET_METADATA_SIZE + (writeCount * sizeof(RegisterWrite));
+
+	if(dataSize > CGsCommandRing::MAX_DATA_SIZE)
+	{
+		//Too big to fit in the ring, would never be able to allocate space for it
+		auto packetMetadata = (metadata != nullptr) ? *metadata : CGsPacketMetadata();
+		SendGSCall(
+		    [this, registerWrites = std::move(registerWrites), packetMetadata]() {
+			    WriteRegisterMassivelyImpl(registerWrites.data(), static_cast<uint32>(registerWrites.size()), &packetMetadata);
+		    });
+		return;
+	}
+
+	CGsCommandRing::COMMAND command = {};
+	command.type = CGsCommandRing::COMMAND_WRITE_REGISTER_MASSIVELY;
+	command.param = writeCount;
+	command.dataSize = dataSize;
+	auto commandData = AllocateCommandData(dataSize, command.dataPosition);
 #ifdef DEBUGGER_INCLUDED
 	if(metadata != nullptr)
 	{
-		memcpy(&massiveWrite.metadata, metadata, sizeof(CGsPacketMetadata));
+		memcpy(commandData, metadata, sizeof(CGsPacketMetadata));
 	}
 	else
 	{
-		massiveWrite.metadata = CGsPacketMetadata();
+		auto emptyMetadata = CGsPacketMetadata();
+		memcpy(commandData, &emptyMetadata, sizeof(CGsPacketMetadata));
 	}
 #endif
-
-	m_mailBox.SendCall(
-	    [this, massiveWrite = std::move(massiveWrite)]() {
-		    WriteRegisterMassivelyImpl(massiveWrite);
-	    });
+	memcpy(commandData + PACKET_METADATA_SIZE, registerWrites.data(), writeCount * sizeof(RegisterWrite));
+	PushCommand(command);
 }
 
 void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
@@ -610,17 +649,18 @@ void CGSHandler::ReadImageDataImpl(void* ptr, uint32 size)
 	((this)->*(m_transferReadHandlers[bltBuf.nSrcPsm]))(ptr, size);
 }
 
-void CGSHandler::WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO& massiveWrite)
+void CGSHandler::WriteRegisterMassivelyImpl(const RegisterWrite* writes, uint32 writeCount, const CGsPacketMetadata* metadata)
 {
 #ifdef DEBUGGER_INCLUDED
 	if(m_frameDump)
 	{
-		m_frameDump->AddRegisterPacket(massiveWrite.writes.data(), massiveWrite.writes.size(), &massiveWrite.metadata);
+		m_frameDump->AddRegisterPacket(writes, writeCount, metadata);
 	}
 #endif
 
-	for(const auto& write : massiveWrite.writes)
+	for(uint32 i = 0; i < writeCount; i++)
 	{
+		const auto& write = writes[i];
 		WriteRegisterImpl(write.first, write.second);
 	}
 
@@ -716,7 +756,9 @@ bool CGSHandler::TransferWriteHandlerGeneric(const void* pData, uint32 nLength)
 
 	auto pSrc = reinterpret_cast<const typename Storage::Unit*>(pData);
 
-	for(unsigned int i = 0; i < nLength; i++)
+	uint32 blockPixelCount = TransferWriteBlocks<Storage>(pData, nLength, nDirty);
+
+	for(unsigned int i = blockPixelCount; i < nLength; i++)
 	{
 		uint32 nX = (m_trxCtx.nRRX + trxPos.nDSAX) % 2048;
 		uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
@@ -782,7 +824,10 @@ bool CGSHandler::TransferWriteHandlerPSMT4(const void* pData, uint32 nLength)
 
 	auto pSrc = reinterpret_cast<const uint8*>(pData);
 
-	for(unsigned int i = 0; i < nLength; i++)
+	//Block rows are always made of an even number of pixels
+	uint32 blockPixelCount = TransferWriteBlocks<CGsPixelFormats::STORAGEPSMT4>(pData, nLength * 2, dirty);
+
+	for(unsigned int i = blockPixelCount / 2; i < nLength; i++)
 	{
 		uint8 nPixel[2];
 
@@ -912,7 +957,8 @@ void CGSHandler::TransferReadHandlerGeneric(void* buffer, uint32 length)
 	auto typedBuffer = reinterpret_cast<typename Storage::Unit*>(buffer);
 
 	CGsPixelFormats::CPixelIndexor<Storage> indexor(m_pRAM, trxBuf.GetSrcPtr(), trxBuf.nSrcWidth);
-	for(uint32 i = 0; i < typedLength; i++)
+	uint32 blockPixelCount = TransferReadBlocks<Storage>(buffer, typedLength);
+	for(uint32 i = blockPixelCount; i < typedLength; i++)
 	{
 		uint32 x = (m_trxCtx.nRRX + trxPos.nSSAX) % 2048;
 		uint32 y = (m_trxCtx.nRRY + trxPos.nSSAY) % 2048;
@@ -927,6 +973,85 @@ void CGSHandler::TransferReadHandlerGeneric(void* buffer, uint32 length)
 	}
 }
 
+template <typename Storage>
+uint32 CGSHandler::TransferWriteBlocks(const void* data, uint32 pixelCount, bool& dirty)
+{
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	auto trxBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+
+	uint32 width = trxReg.nRRW;
+	uint32 dstX = trxPos.nDSAX;
+
+	//Only handle transfers that start at the beginning of a row and that are aligned on blocks
+	if(m_trxCtx.nRRX != 0) return 0;
+	if((width == 0) || ((width % Storage::BLOCKWIDTH) != 0)) return 0;
+	if(((dstX % Storage::BLOCKWIDTH) != 0) || ((dstX + width) > 2048)) return 0;
+
+	auto writeBlock = CGsTransferKernels::GetWriteBlockFunction<Storage>(CGsTransferKernels::GetKernels());
+	uint32 srcStride = (width * CGsTransferKernels::GetPixelBits<Storage>()) / 8;
+	uint32 blockRowPixelCount = width * Storage::BLOCKHEIGHT;
+	auto src = reinterpret_cast<const uint8*>(data);
+
+	uint32 processedPixelCount = 0;
+	while((pixelCount - processedPixelCount) >= blockRowPixelCount)
+	{
+		uint32 dstY = m_trxCtx.nRRY + trxPos.nDSAY;
+		if(((dstY % Storage::BLOCKHEIGHT) != 0) || ((dstY + Storage::BLOCKHEIGHT) > 2048)) break;
+
+		for(uint32 x = 0; x < width; x += Storage::BLOCKWIDTH)
+		{
+			auto block = CGsTransferKernels::GetBlockAddress<Storage>(m_pRAM, trxBuf.GetDstPtr(), trxBuf.nDstWidth, dstX + x, dstY);
+			dirty |= writeBlock(block, src + ((x * CGsTransferKernels::GetPixelBits<Storage>()) / 8), srcStride);
+		}
+
+		src += srcStride * Storage::BLOCKHEIGHT;
+		processedPixelCount += blockRowPixelCount;
+		m_trxCtx.nRRY += Storage::BLOCKHEIGHT;
+	}
+
+	return processedPixelCount;
+}
+
+template <typename Storage>
+uint32 CGSHandler::TransferReadBlocks(void* buffer, uint32 pixelCount)
+{
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	auto trxBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+
+	uint32 width = trxReg.nRRW;
+	uint32 srcX = trxPos.nSSAX;
+
+	if(m_trxCtx.nRRX != 0) return 0;
+	if((width == 0) || ((width % Storage::BLOCKWIDTH) != 0)) return 0;
+	if(((srcX % Storage::BLOCKWIDTH) != 0) || ((srcX + width) > 2048)) return 0;
+
+	auto readBlock = CGsTransferKernels::GetReadBlockFunction<Storage>(CGsTransferKernels::GetKernels());
+	uint32 dstStride = width * sizeof(typename Storage::Unit);
+	uint32 blockRowPixelCount = width * Storage::BLOCKHEIGHT;
+	auto dst = reinterpret_cast<uint8*>(buffer);
+
+	uint32 processedPixelCount = 0;
+	while((pixelCount - processedPixelCount) >= blockRowPixelCount)
+	{
+		uint32 srcY = m_trxCtx.nRRY + trxPos.nSSAY;
+		if(((srcY % Storage::BLOCKHEIGHT) != 0) || ((srcY + Storage::BLOCKHEIGHT) > 2048)) break;
+
+		for(uint32 x = 0; x < width; x += Storage::BLOCKWIDTH)
+		{
+			auto block = CGsTransferKernels::GetBlockAddress<Storage>(m_pRAM, trxBuf.GetSrcPtr(), trxBuf.nSrcWidth, srcX + x, srcY);
+			readBlock(dst + (x * sizeof(typename Storage::Unit)), dstStride, block);
+		}
+
+		dst += dstStride * Storage::BLOCKHEIGHT;
+		processedPixelCount += blockRowPixelCount;
+		m_trxCtx.nRRY += Storage::BLOCKHEIGHT;
+	}
+
+	return processedPixelCount;
+}
+
 void CGSHandler::SetCrt(bool nIsInterlaced, unsigned int nMode, bool nIsFrameMode)
 {
 	m_nCrtMode = nMode;
@@ -1306,13 +1431,47 @@ bool CGSHandler::IsCompatibleFramebufferPSM(unsigned int psmFb, unsigned int psm
 	}
 }
 
-void CGSHandler::MakeLinearCLUT(const TEX0& tex0, std::array<uint32, 256>& clut) const
+unsigned int CGSHandler::GetCurrentReadCircuit()
 {
-	static const auto RGBA16ToRGBA32 =
-	    [](uint16 color) {
-		    return ((color & 0x8000) ? 0xFF000000 : 0) | ((color & 0x7C00) << 9) | ((color & 0x03E0) << 6) | ((color & 0x001F) << 3);
-	    };
+	uint32 rcMode = m_nPMODE & 0x03;
+	switch(rcMode)
+	{
+	default:
+	case 0:
+		//No read circuit enabled?
+		return 0;
+	case 1:
+		return 0;
+	case 2:
+		return 1;
+	case 3:
+	{
+		//Both are enabled... See if we can find out which one is good
+		//This happens in Capcom Classics Collection Vol. 2
+		std::lock_guard<std::recursive_mutex> registerMutexLock(m_registerMutex);
+		bool fb1Null = (m_nDISPFB1.value.q == 0);
+		bool fb2Null = (m_nDISPFB2.value.q == 0);
+		if(!fb1Null && fb2Null)
+		{
+			return 0;
+		}
+		if(fb1Null && !fb2Null)
+		{
+			return 1;
+		}
+		return 0;
+	}
+	break;
+	}
+}
 
+uint32 CGSHandler::RGBA16ToRGBA32(uint16 color, uint8 alphaOne)
+{
+	return ((color & 0x8000) ? (static_cast<uint32>(alphaOne) << 24) : 0) | ((color & 0x7C00) << 9) | ((color & 0x03E0) << 6) | ((color & 0x001F) << 3);
+}
+
+void CGSHandler::MakeLinearCLUT(const TEX0& tex0, std::array<uint32, 256>& clut) const
+{
 	unsigned int entryCount = CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm) ? 16 : 256;
 
 	if(CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm))
@@ -1717,11 +1876,109 @@ void CGSHandler::WriteToDelayedRegister(uint32 address, uint32 value, DELAYED_RE
 	}
 }
 
+void CGSHandler::SendGSCall(const CMailBox::FunctionType& function, bool waitForCompletion, bool breakpoint)
+{
+	uint32 fence = m_commandRing.GetWritePosition();
+	m_mailBox.SendCall(
+	    [this, fence, function]() {
+		    ProcessCommands(fence);
+		    function();
+	    },
+	    waitForCompletion, breakpoint);
+}
+
+void CGSHandler::SendGSCall(CMailBox::FunctionType&& function)
+{
+	uint32 fence = m_commandRing.GetWritePosition();
+	m_mailBox.SendCall(
+	    [this, fence, function = std::move(function)]() {
+		    ProcessCommands(fence);
+		    function();
+	    });
+}
+
+void CGSHandler::PushCommand(const CGsCommandRing::COMMAND& command)
+{
+	if(!m_commandRing.HasCommandSpace())
+	{
+		FlushCommands();
+		while(!m_commandRing.HasCommandSpace())
+		{
+			std::this_thread::yield();
+		}
+	}
+	m_commandRing.Push(command);
+	m_unflushedCommandCount++;
+	if(m_unflushedCommandCount == COMMAND_FLUSH_BATCH_SIZE)
+	{
+		FlushCommands();
+	}
+}
+
+uint8* CGSHandler::AllocateCommandData(uint32 size, uint32& dataPosition)
+{
+	auto data = m_commandRing.AllocateData(size, dataPosition);
+	if(data) return data;
+	FlushCommands();
+	while(!(data = m_commandRing.AllocateData(size, dataPosition)))
+	{
+		std::this_thread::yield();
+	}
+	return data;
+}
+
+void CGSHandler::FlushCommands()
+{
+	//Wakes up the GS thread, commands are only processed through mailbox calls
+	m_unflushedCommandCount = 0;
+	uint32 fence = m_commandRing.GetWritePosition();
+	m_mailBox.SendCall([this, fence]() { ProcessCommands(fence); });
+}
+
+void CGSHandler::ProcessCommands(uint32 fence)
+{
+	while(m_commandRing.HasCommandBefore(fence))
+	{
+		const auto& command = m_commandRing.GetFrontCommand();
+		switch(command.type)
+		{
+		case CGsCommandRing::COMMAND_WRITE_REGISTER:
+			WriteRegisterImpl(static_cast<uint8>(command.param), command.value);
+			break;
+		case CGsCommandRing::COMMAND_WRITE_REGISTER_MASSIVELY:
+		{
+			auto data = m_commandRing.GetData(command.dataPosition);
+			const CGsPacketMetadata* metadata = nullptr;
+#ifdef DEBUGGER_INCLUDED
+			metadata = reinterpret_cast<const CGsPacketMetadata*>(data);
+#endif
+			auto writes = reinterpret_cast<const RegisterWrite*>(data + PACKET_METADATA_SIZE);
+			WriteRegisterMassivelyImpl(writes, command.param, metadata);
+		}
+		break;
+		case CGsCommandRing::COMMAND_FEED_IMAGE_DATA:
+			FeedImageDataImpl(m_commandRing.GetData(command.dataPosition), command.param);
+			break;
+		case CGsCommandRing::COMMAND_MARK_NEW_FRAME:
+			MarkNewFrame();
+			break;
+		default:
+			assert(false);
+			break;
+		}
+		m_commandRing.Pop();
+	}
+}
+
 void CGSHandler::ThreadProc()
 {
+	CProfiler::GetInstance().SetThreadName("GS");
 	while(!m_threadDone)
 	{
 		m_mailBox.WaitForCall();
+#ifdef PROFILE
+		CProfilerZone profilerZone(m_gsProfilerZone);
+#endif
 		while(m_mailBox.IsPending())
 		{
 			m_mailBox.ReceiveCall();
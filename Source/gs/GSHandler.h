@@ -11,14 +11,15 @@
 #include "Types.h"
 #include "Convertible.h"
 #include "../MailBox.h"
+#include "GsCommandRing.h"
 #include "../Integer64.h"
+#include "../Profiler.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
 
 class CFrameDump;
 class CGsPacketMetadata;
 class CINTC;
-struct MASSIVEWRITE_INFO;
 
 #define PREF_CGSHANDLER_PRESENTATION_MODE "renderer.presentationmode"
 
@@ -748,6 +749,9 @@ public:
 
 	void MakeLinearCLUT(const TEX0&, std::array<uint32, 256>&) const;
 
+	//alphaOne is the alpha value a texel with its A bit set expands to
+	static uint32 RGBA16ToRGBA32(uint16, uint8 alphaOne = 0xFF);
+
 	uint8* GetRam();
 	uint64* GetRegisters();
 
@@ -924,7 +928,18 @@ protected:
 	virtual void WriteRegisterImpl(uint8, uint64);
 	void FeedImageDataImpl(const uint8*, uint32);
 	void ReadImageDataImpl(void*, uint32);
-	void WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO&);
+	void WriteRegisterMassivelyImpl(const RegisterWrite*, uint32, const CGsPacketMetadata*);
+
+	//Calls sent through the mailbox are executed after all commands pushed before them
+	void SendGSCall(const CMailBox::FunctionType&, bool = false, bool = false);
+	void SendGSCall(CMailBox::FunctionType&&);
+
+	//Must only be called by the thread feeding the GS (producer of the command ring)
+	void PushCommand(const CGsCommandRing::COMMAND&);
+	uint8* AllocateCommandData(uint32, uint32&);
+	void FlushCommands();
+
+	void ProcessCommands(uint32);
 
 	void BeginTransfer();
 
@@ -944,6 +959,12 @@ protected:
 	template <typename Storage>
 	void TransferReadHandlerGeneric(void*, uint32);
 
+	//Transfer whole rows of blocks when possible, return the number of pixels processed
+	template <typename Storage>
+	uint32 TransferWriteBlocks(const void*, uint32, bool&);
+	template <typename Storage>
+	uint32 TransferReadBlocks(void*, uint32);
+
 	void SyncCLUT(const TEX0&);
 	template <typename Indexor>
 	bool ReadCLUT4_16(const TEX0&);
@@ -954,6 +975,8 @@ protected:
 
 	static bool IsCompatibleFramebufferPSM(unsigned int, unsigned int);
 
+	unsigned int GetCurrentReadCircuit();
+
 	bool m_loggingEnabled;
 
 	uint64 m_nPMODE;              //0x12000000
@@ -985,8 +1008,11 @@ protected:
 	std::recursive_mutex m_registerMutex;
 	std::atomic<int> m_transferCount;
 	CMailBox m_mailBox;
+	CGsCommandRing m_commandRing;
+	uint32 m_unflushedCommandCount = 0;
 	bool m_threadDone;
 	CFrameDump* m_frameDump;
 	bool m_drawEnabled = true;
 	CINTC* m_intc = nullptr;
+	CProfiler::ZoneHandle m_gsProfilerZone = 0;
 };
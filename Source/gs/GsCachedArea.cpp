@@ -89,6 +89,11 @@ CGsCachedArea::PageRect CGsCachedArea::GetDirtyPageRect() const
 	return PageRect{startX, startY, spanX, spanY};
 }
 
+uint32 CGsCachedArea::GetBufPtr() const
+{
+	return m_bufPtr;
+}
+
 uint32 CGsCachedArea::GetPageCount() const
 {
 	auto areaRect = GetAreaPageRect();
@@ -29,6 +29,7 @@ public:
 	PageRect GetAreaPageRect() const;
 	PageRect GetDirtyPageRect() const;
 
+	uint32 GetBufPtr() const;
 	uint32 GetPageCount() const;
 	uint32 GetSize() const;
 
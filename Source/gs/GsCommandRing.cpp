@@ -0,0 +1,88 @@
+#include <cassert>
+#include "GsCommandRing.h"
+
+static_assert((CGsCommandRing::COMMAND_RING_SIZE & (CGsCommandRing::COMMAND_RING_SIZE - 1)) == 0, "Command ring size must be a power of 2.");
+static_assert((CGsCommandRing::DATA_RING_SIZE & (CGsCommandRing::DATA_RING_SIZE - 1)) == 0, "Data ring size must be a power of 2.");
+
+CGsCommandRing::CGsCommandRing()
+    : m_commands(COMMAND_RING_SIZE)
+    , m_data(DATA_RING_SIZE)
+{
+}
+
+uint32 CGsCommandRing::GetWritePosition() const
+{
+	return m_writePosition.load(std::memory_order_acquire);
+}
+
+bool CGsCommandRing::HasCommandSpace() const
+{
+	uint32 writePosition = m_writePosition.load(std::memory_order_relaxed);
+	uint32 readPosition = m_readPosition.load(std::memory_order_acquire);
+	return (writePosition - readPosition) < COMMAND_RING_SIZE;
+}
+
+uint8* CGsCommandRing::AllocateData(uint32 size, uint32& dataPosition)
+{
+	assert(size <= MAX_DATA_SIZE);
+	size = (size + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+
+	//Data must be contiguous, skip what's left at the end of the ring if it doesn't fit there
+	uint32 offset = m_dataWritePosition & (DATA_RING_SIZE - 1);
+	uint32 padding = ((offset + size) > DATA_RING_SIZE) ? (DATA_RING_SIZE - offset) : 0;
+	uint32 usedSize = m_dataWritePosition - m_dataReadPosition.load(std::memory_order_acquire);
+	if((usedSize + padding + size) > DATA_RING_SIZE)
+	{
+		return nullptr;
+	}
+
+	m_dataWritePosition += padding;
+	dataPosition = m_dataWritePosition;
+	m_dataWritePosition += size;
+	return m_data.data() + (dataPosition & (DATA_RING_SIZE - 1));
+}
+
+void CGsCommandRing::Push(const COMMAND& command)
+{
+	assert(HasCommandSpace());
+	uint32 writePosition = m_writePosition.load(std::memory_order_relaxed);
+	m_commands[writePosition & (COMMAND_RING_SIZE - 1)] = command;
+	m_writePosition.store(writePosition + 1, std::memory_order_release);
+}
+
+bool CGsCommandRing::HasCommandBefore(uint32 position) const
+{
+	uint32 readPosition = m_readPosition.load(std::memory_order_relaxed);
+	assert(static_cast<int32>(GetWritePosition() - position) >= 0);
+	return static_cast<int32>(position - readPosition) > 0;
+}
+
+const CGsCommandRing::COMMAND& CGsCommandRing::GetFrontCommand() const
+{
+	uint32 readPosition = m_readPosition.load(std::memory_order_relaxed);
+	assert(readPosition != GetWritePosition());
+	return m_commands[readPosition & (COMMAND_RING_SIZE - 1)];
+}
+
+const uint8* CGsCommandRing::GetData(uint32 dataPosition) const
+{
+	return m_data.data() + (dataPosition & (DATA_RING_SIZE - 1));
+}
+
+void CGsCommandRing::Pop()
+{
+	const auto& command = GetFrontCommand();
+	if(command.dataSize != 0)
+	{
+		uint32 dataSize = (command.dataSize + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+		m_dataReadPosition.store(command.dataPosition + dataSize, std::memory_order_release);
+	}
+	uint32 readPosition = m_readPosition.load(std::memory_order_relaxed);
+	m_readPosition.store(readPosition + 1, std::memory_order_release);
+}
+
+void CGsCommandRing::Reset()
+{
+	m_readPosition.store(m_writePosition.load());
+	m_dataReadPosition.store(m_dataWritePosition);
+}
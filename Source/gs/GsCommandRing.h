@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "Types.h"
+
+//Single producer/single consumer queue of GS commands. Commands are plain structures stored in a
+//preallocated ring, payloads (image data, register lists) are stored in a separate data ring.
+//Positions keep increasing and wrap around at 2^32, they are masked when indexing the rings.
+class CGsCommandRing
+{
+public:
+	enum COMMAND_TYPE : uint32
+	{
+		COMMAND_WRITE_REGISTER,
+		COMMAND_WRITE_REGISTER_MASSIVELY,
+		COMMAND_FEED_IMAGE_DATA,
+		COMMAND_MARK_NEW_FRAME,
+	};
+
+	struct COMMAND
+	{
+		COMMAND_TYPE type;
+		uint32 param;
+		uint64 value;
+		uint32 dataPosition;
+		uint32 dataSize;
+	};
+
+	enum
+	{
+		COMMAND_RING_SIZE = 0x4000,
+		DATA_RING_SIZE = 0x400000,
+		DATA_ALIGNMENT = 0x10,
+		//Larger payloads must be sent some other way
+		MAX_DATA_SIZE = DATA_RING_SIZE / 4,
+	};
+
+	CGsCommandRing();
+
+	//Can be called from any thread
+	uint32 GetWritePosition() const;
+
+	//Producer side
+	bool HasCommandSpace() const;
+	//Returns nullptr if there's not enough space left in the data ring
+	uint8* AllocateData(uint32, uint32&);
+	void Push(const COMMAND&);
+
+	//Consumer side
+	bool HasCommandBefore(uint32) const;
+	const COMMAND& GetFrontCommand() const;
+	const uint8* GetData(uint32) const;
+	void Pop();
+
+	//Drops everything, producer must not be pushing commands
+	void Reset();
+
+private:
+	std::vector<COMMAND> m_commands;
+	std::vector<uint8> m_data;
+
+	std::atomic<uint32> m_writePosition = {0};
+	std::atomic<uint32> m_readPosition = {0};
+	//Only used by producer
+	uint32 m_dataWritePosition = 0;
+	std::atomic<uint32> m_dataReadPosition = {0};
+};
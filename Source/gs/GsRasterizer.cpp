@@ -0,0 +1,1944 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "GsRasterizer.h"
+#include "GSHandler.h"
+#include "GsPixelFormats.h"
+#include "string_format.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAS_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+//Division is only available on AArch64
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAS_SSE2) || defined(HAS_NEON)
+#define HAS_SIMD
+#endif
+
+typedef CGsPixelFormats::STORAGEPSMCT32 STORAGEPSMCT32;
+typedef CGsPixelFormats::STORAGEPSMCT16 STORAGEPSMCT16;
+typedef CGsPixelFormats::STORAGEPSMCT16S STORAGEPSMCT16S;
+typedef CGsPixelFormats::STORAGEPSMZ32 STORAGEPSMZ32;
+typedef CGsPixelFormats::STORAGEPSMZ16 STORAGEPSMZ16;
+typedef CGsPixelFormats::STORAGEPSMZ16S STORAGEPSMZ16S;
+typedef CGsPixelFormats::STORAGEPSMT8 STORAGEPSMT8;
+typedef CGsPixelFormats::STORAGEPSMT4 STORAGEPSMT4;
+
+//Texture coordinates (in texels) are clamped to this before being converted to integers
+#define MAX_TEXEL_COORDINATE (32768.0f)
+
+//Values of the GS register fields used by the state (see CGSHandler)
+enum
+{
+	DEPTH_TEST_NEVER,
+	DEPTH_TEST_ALWAYS,
+	DEPTH_TEST_GEQUAL,
+	DEPTH_TEST_GREATER,
+};
+
+enum
+{
+	ALPHA_TEST_NEVER,
+	ALPHA_TEST_ALWAYS,
+	ALPHA_TEST_LESS,
+	ALPHA_TEST_LEQUAL,
+	ALPHA_TEST_EQUAL,
+	ALPHA_TEST_GEQUAL,
+	ALPHA_TEST_GREATER,
+	ALPHA_TEST_NOTEQUAL,
+};
+
+enum
+{
+	ALPHA_TEST_FAIL_KEEP,
+	ALPHA_TEST_FAIL_FBONLY,
+	ALPHA_TEST_FAIL_ZBONLY,
+	ALPHA_TEST_FAIL_RGBONLY,
+};
+
+enum
+{
+	ALPHABLEND_ABD_CS,
+	ALPHABLEND_ABD_CD,
+	ALPHABLEND_ABD_ZERO,
+};
+
+enum
+{
+	ALPHABLEND_C_AS,
+	ALPHABLEND_C_AD,
+	ALPHABLEND_C_FIX,
+};
+
+enum
+{
+	TEX0_FUNCTION_MODULATE,
+	TEX0_FUNCTION_DECAL,
+	TEX0_FUNCTION_HIGHLIGHT,
+	TEX0_FUNCTION_HIGHLIGHT2,
+};
+
+enum
+{
+	CLAMP_MODE_REPEAT,
+	CLAMP_MODE_CLAMP,
+	CLAMP_MODE_REGION_CLAMP,
+	CLAMP_MODE_REGION_REPEAT,
+};
+
+//////////////////////////////////////////////
+//Span operations
+//Small set of operations used to shade spans, implemented for every supported instruction set.
+//Masks are 0 or -1 in every lane.
+
+struct SCALAR_OPS
+{
+	struct FloatVector
+	{
+		float v[4];
+	};
+
+	struct IntVector
+	{
+		int32 v[4];
+	};
+
+	static FloatVector LoadF(const float* src)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = src[i];
+		return result;
+	}
+
+	static FloatVector SplatF(float value)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = value;
+		return result;
+	}
+
+	static FloatVector AddF(const FloatVector& a, const FloatVector& b)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] + b.v[i];
+		return result;
+	}
+
+	static FloatVector MulF(const FloatVector& a, const FloatVector& b)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] * b.v[i];
+		return result;
+	}
+
+	static FloatVector DivF(const FloatVector& a, const FloatVector& b)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] / b.v[i];
+		return result;
+	}
+
+	//Same as the SSE instructions: second operand is returned if any is NaN
+	static FloatVector MinF(const FloatVector& a, const FloatVector& b)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = (a.v[i] < b.v[i]) ? a.v[i] : b.v[i];
+		return result;
+	}
+
+	static FloatVector MaxF(const FloatVector& a, const FloatVector& b)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = (a.v[i] > b.v[i]) ? a.v[i] : b.v[i];
+		return result;
+	}
+
+	static IntVector CmpGtF(const FloatVector& a, const FloatVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = (a.v[i] > b.v[i]) ? -1 : 0;
+		return result;
+	}
+
+	static IntVector TruncF(const FloatVector& a)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = static_cast<int32>(a.v[i]);
+		return result;
+	}
+
+	static FloatVector ToFloat(const IntVector& a)
+	{
+		FloatVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = static_cast<float>(a.v[i]);
+		return result;
+	}
+
+	static IntVector Load(const int32* src)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = src[i];
+		return result;
+	}
+
+	static void Store(int32* dst, const IntVector& a)
+	{
+		for(unsigned int i = 0; i < 4; i++) dst[i] = a.v[i];
+	}
+
+	static IntVector Splat(int32 value)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = value;
+		return result;
+	}
+
+	static IntVector Add(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] + b.v[i];
+		return result;
+	}
+
+	static IntVector Sub(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] - b.v[i];
+		return result;
+	}
+
+	//Operands must fit in 16 bits (signed)
+	static IntVector Mul16(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] * b.v[i];
+		return result;
+	}
+
+	static IntVector ShiftRightArithmetic(const IntVector& a, int count)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] >> count;
+		return result;
+	}
+
+	static IntVector ShiftRightLogical(const IntVector& a, int count)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = static_cast<int32>(static_cast<uint32>(a.v[i]) >> count);
+		return result;
+	}
+
+	static IntVector ShiftLeft(const IntVector& a, int count)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = static_cast<int32>(static_cast<uint32>(a.v[i]) << count);
+		return result;
+	}
+
+	static IntVector And(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] & b.v[i];
+		return result;
+	}
+
+	static IntVector Or(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] | b.v[i];
+		return result;
+	}
+
+	static IntVector Xor(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = a.v[i] ^ b.v[i];
+		return result;
+	}
+
+	static IntVector CmpGt(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = (a.v[i] > b.v[i]) ? -1 : 0;
+		return result;
+	}
+
+	static IntVector CmpEq(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = (a.v[i] == b.v[i]) ? -1 : 0;
+		return result;
+	}
+
+	static IntVector Select(const IntVector& mask, const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+		return result;
+	}
+
+	static IntVector Min(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = std::min(a.v[i], b.v[i]);
+		return result;
+	}
+
+	static IntVector Max(const IntVector& a, const IntVector& b)
+	{
+		IntVector result;
+		for(unsigned int i = 0; i < 4; i++) result.v[i] = std::max(a.v[i], b.v[i]);
+		return result;
+	}
+};
+
+#if defined(HAS_SSE2)
+
+struct SIMD_OPS
+{
+	typedef __m128 FloatVector;
+	typedef __m128i IntVector;
+
+	static FloatVector LoadF(const float* src)
+	{
+		return _mm_loadu_ps(src);
+	}
+
+	static FloatVector SplatF(float value)
+	{
+		return _mm_set1_ps(value);
+	}
+
+	static FloatVector AddF(FloatVector a, FloatVector b)
+	{
+		return _mm_add_ps(a, b);
+	}
+
+	static FloatVector MulF(FloatVector a, FloatVector b)
+	{
+		return _mm_mul_ps(a, b);
+	}
+
+	static FloatVector DivF(FloatVector a, FloatVector b)
+	{
+		return _mm_div_ps(a, b);
+	}
+
+	static FloatVector MinF(FloatVector a, FloatVector b)
+	{
+		return _mm_min_ps(a, b);
+	}
+
+	static FloatVector MaxF(FloatVector a, FloatVector b)
+	{
+		return _mm_max_ps(a, b);
+	}
+
+	static IntVector CmpGtF(FloatVector a, FloatVector b)
+	{
+		return _mm_castps_si128(_mm_cmpgt_ps(a, b));
+	}
+
+	static IntVector TruncF(FloatVector a)
+	{
+		return _mm_cvttps_epi32(a);
+	}
+
+	static FloatVector ToFloat(IntVector a)
+	{
+		return _mm_cvtepi32_ps(a);
+	}
+
+	static IntVector Load(const int32* src)
+	{
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	}
+
+	static void Store(int32* dst, IntVector a)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), a);
+	}
+
+	static IntVector Splat(int32 value)
+	{
+		return _mm_set1_epi32(value);
+	}
+
+	static IntVector Add(IntVector a, IntVector b)
+	{
+		return _mm_add_epi32(a, b);
+	}
+
+	static IntVector Sub(IntVector a, IntVector b)
+	{
+		return _mm_sub_epi32(a, b);
+	}
+
+	static IntVector Mul16(IntVector a, IntVector b)
+	{
+		//Upper halves are cleared, each lane is the product of its lower halves
+		auto lowMask = _mm_set1_epi32(0xFFFF);
+		return _mm_madd_epi16(_mm_and_si128(a, lowMask), _mm_and_si128(b, lowMask));
+	}
+
+	static IntVector ShiftRightArithmetic(IntVector a, int count)
+	{
+		return _mm_sra_epi32(a, _mm_cvtsi32_si128(count));
+	}
+
+	static IntVector ShiftRightLogical(IntVector a, int count)
+	{
+		return _mm_srl_epi32(a, _mm_cvtsi32_si128(count));
+	}
+
+	static IntVector ShiftLeft(IntVector a, int count)
+	{
+		return _mm_sll_epi32(a, _mm_cvtsi32_si128(count));
+	}
+
+	static IntVector And(IntVector a, IntVector b)
+	{
+		return _mm_and_si128(a, b);
+	}
+
+	static IntVector Or(IntVector a, IntVector b)
+	{
+		return _mm_or_si128(a, b);
+	}
+
+	static IntVector Xor(IntVector a, IntVector b)
+	{
+		return _mm_xor_si128(a, b);
+	}
+
+	static IntVector CmpGt(IntVector a, IntVector b)
+	{
+		return _mm_cmpgt_epi32(a, b);
+	}
+
+	static IntVector CmpEq(IntVector a, IntVector b)
+	{
+		return _mm_cmpeq_epi32(a, b);
+	}
+
+	static IntVector Select(IntVector mask, IntVector a, IntVector b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	static IntVector Min(IntVector a, IntVector b)
+	{
+		return Select(CmpGt(a, b), b, a);
+	}
+
+	static IntVector Max(IntVector a, IntVector b)
+	{
+		return Select(CmpGt(a, b), a, b);
+	}
+};
+
+#elif defined(HAS_NEON)
+
+struct SIMD_OPS
+{
+	typedef float32x4_t FloatVector;
+	typedef int32x4_t IntVector;
+
+	static FloatVector LoadF(const float* src)
+	{
+		return vld1q_f32(src);
+	}
+
+	static FloatVector SplatF(float value)
+	{
+		return vdupq_n_f32(value);
+	}
+
+	static FloatVector AddF(FloatVector a, FloatVector b)
+	{
+		return vaddq_f32(a, b);
+	}
+
+	static FloatVector MulF(FloatVector a, FloatVector b)
+	{
+		return vmulq_f32(a, b);
+	}
+
+	static FloatVector DivF(FloatVector a, FloatVector b)
+	{
+		return vdivq_f32(a, b);
+	}
+
+	//vminq/vmaxq propagate NaNs, select explicitly to behave like the scalar version
+	static FloatVector MinF(FloatVector a, FloatVector b)
+	{
+		return vbslq_f32(vcltq_f32(a, b), a, b);
+	}
+
+	static FloatVector MaxF(FloatVector a, FloatVector b)
+	{
+		return vbslq_f32(vcgtq_f32(a, b), a, b);
+	}
+
+	static IntVector CmpGtF(FloatVector a, FloatVector b)
+	{
+		return vreinterpretq_s32_u32(vcgtq_f32(a, b));
+	}
+
+	static IntVector TruncF(FloatVector a)
+	{
+		return vcvtq_s32_f32(a);
+	}
+
+	static FloatVector ToFloat(IntVector a)
+	{
+		return vcvtq_f32_s32(a);
+	}
+
+	static IntVector Load(const int32* src)
+	{
+		return vld1q_s32(src);
+	}
+
+	static void Store(int32* dst, IntVector a)
+	{
+		vst1q_s32(dst, a);
+	}
+
+	static IntVector Splat(int32 value)
+	{
+		return vdupq_n_s32(value);
+	}
+
+	static IntVector Add(IntVector a, IntVector b)
+	{
+		return vaddq_s32(a, b);
+	}
+
+	static IntVector Sub(IntVector a, IntVector b)
+	{
+		return vsubq_s32(a, b);
+	}
+
+	static IntVector Mul16(IntVector a, IntVector b)
+	{
+		return vmulq_s32(a, b);
+	}
+
+	static IntVector ShiftRightArithmetic(IntVector a, int count)
+	{
+		return vshlq_s32(a, vdupq_n_s32(-count));
+	}
+
+	static IntVector ShiftRightLogical(IntVector a, int count)
+	{
+		return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-count)));
+	}
+
+	static IntVector ShiftLeft(IntVector a, int count)
+	{
+		return vshlq_s32(a, vdupq_n_s32(count));
+	}
+
+	static IntVector And(IntVector a, IntVector b)
+	{
+		return vandq_s32(a, b);
+	}
+
+	static IntVector Or(IntVector a, IntVector b)
+	{
+		return vorrq_s32(a, b);
+	}
+
+	static IntVector Xor(IntVector a, IntVector b)
+	{
+		return veorq_s32(a, b);
+	}
+
+	static IntVector CmpGt(IntVector a, IntVector b)
+	{
+		return vreinterpretq_s32_u32(vcgtq_s32(a, b));
+	}
+
+	static IntVector CmpEq(IntVector a, IntVector b)
+	{
+		return vreinterpretq_s32_u32(vceqq_s32(a, b));
+	}
+
+	static IntVector Select(IntVector mask, IntVector a, IntVector b)
+	{
+		return vbslq_s32(vreinterpretq_u32_s32(mask), a, b);
+	}
+
+	static IntVector Min(IntVector a, IntVector b)
+	{
+		return vminq_s32(a, b);
+	}
+
+	static IntVector Max(IntVector a, IntVector b)
+	{
+		return vmaxq_s32(a, b);
+	}
+};
+
+#else
+
+typedef SCALAR_OPS SIMD_OPS;
+
+#endif
+
+//////////////////////////////////////////////
+//Vector helpers
+
+template <typename Ops>
+static typename Ops::IntVector FloorF(typename Ops::FloatVector value)
+{
+	//Truncation rounds negative values up, correct those
+	auto truncated = Ops::TruncF(value);
+	auto roundedUp = Ops::CmpGtF(Ops::ToFloat(truncated), value);
+	return Ops::Add(truncated, roundedUp);
+}
+
+template <typename Ops>
+static typename Ops::IntVector ColorToInt(typename Ops::FloatVector value)
+{
+	auto clamped = Ops::MinF(Ops::MaxF(value, Ops::SplatF(0)), Ops::SplatF(255));
+	return Ops::TruncF(clamped);
+}
+
+template <typename Ops>
+static typename Ops::IntVector TexelToFixed(typename Ops::FloatVector value)
+{
+	auto clamped = Ops::MinF(Ops::MaxF(value, Ops::SplatF(-MAX_TEXEL_COORDINATE)), Ops::SplatF(MAX_TEXEL_COORDINATE));
+	return FloorF<Ops>(Ops::MulF(clamped, Ops::SplatF(16)));
+}
+
+template <typename Ops>
+static typename Ops::IntVector Not(typename Ops::IntVector value)
+{
+	return Ops::Xor(value, Ops::Splat(-1));
+}
+
+template <typename Ops>
+static typename Ops::IntVector AlphaTest(uint32 method, typename Ops::IntVector alpha, uint32 ref)
+{
+	auto refVector = Ops::Splat(ref);
+	switch(method)
+	{
+	case ALPHA_TEST_NEVER:
+		return Ops::Splat(0);
+	default:
+	case ALPHA_TEST_ALWAYS:
+		return Ops::Splat(-1);
+	case ALPHA_TEST_LESS:
+		return Ops::CmpGt(refVector, alpha);
+	case ALPHA_TEST_LEQUAL:
+		return Not<Ops>(Ops::CmpGt(alpha, refVector));
+	case ALPHA_TEST_EQUAL:
+		return Ops::CmpEq(alpha, refVector);
+	case ALPHA_TEST_GEQUAL:
+		return Not<Ops>(Ops::CmpGt(refVector, alpha));
+	case ALPHA_TEST_GREATER:
+		return Ops::CmpGt(alpha, refVector);
+	case ALPHA_TEST_NOTEQUAL:
+		return Not<Ops>(Ops::CmpEq(alpha, refVector));
+	}
+}
+
+template <typename Ops>
+static typename Ops::IntVector SelectBlendColor(uint32 select, typename Ops::IntVector source, typename Ops::IntVector dest)
+{
+	switch(select)
+	{
+	case ALPHABLEND_ABD_CS:
+		return source;
+	case ALPHABLEND_ABD_CD:
+		return dest;
+	default:
+		return Ops::Splat(0);
+	}
+}
+
+template <typename Ops>
+static typename Ops::IntVector SelectBlendAlpha(uint32 select, typename Ops::IntVector source, typename Ops::IntVector dest, uint32 fix)
+{
+	switch(select)
+	{
+	case ALPHABLEND_C_AS:
+		return source;
+	case ALPHABLEND_C_AD:
+		return dest;
+	default:
+		return Ops::Splat(fix);
+	}
+}
+
+//////////////////////////////////////////////
+//Memory access
+
+static uint16 RGBA32ToRGBA16(uint32 color)
+{
+	return static_cast<uint16>(((color >> 16) & 0x8000) | ((color >> 9) & 0x7C00) | ((color >> 6) & 0x03E0) | ((color >> 3) & 0x001F));
+}
+
+template <typename Storage>
+static typename Storage::Unit* GetPixelAddress(uint8* ram, uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y)
+{
+	CGsPixelFormats::CPixelIndexor<Storage> indexor(ram, bufPtr, bufWidth);
+	return indexor.GetPixelAddress(x, y);
+}
+
+template <typename Storage>
+static void InitializeIndexor(uint8* ram)
+{
+	CGsPixelFormats::CPixelIndexor<Storage> indexor(ram, 0, 1);
+}
+
+template <typename Storage>
+static void WriteMaskedPixel(uint8* ram, uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y, typename Storage::Unit value, typename Storage::Unit mask)
+{
+	auto pixel = GetPixelAddress<Storage>(ram, bufPtr, bufWidth, x, y);
+	(*pixel) = ((*pixel) & mask) | (value & ~mask);
+}
+
+static bool IsPsmSupported(uint32 psm)
+{
+	switch(psm)
+	{
+	case CGSHandler::PSMCT32:
+	case CGSHandler::PSMCT24:
+	case CGSHandler::PSMCT16:
+	case CGSHandler::PSMCT16S:
+	case CGSHandler::PSMT8:
+	case CGSHandler::PSMT4:
+	case CGSHandler::PSMT8H:
+	case CGSHandler::PSMT4HL:
+	case CGSHandler::PSMT4HH:
+	case CGSHandler::PSMZ32:
+	case CGSHandler::PSMZ24:
+	case CGSHandler::PSMZ16:
+	case CGSHandler::PSMZ16S:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool IsPsm24Bits(uint32 psm)
+{
+	return (psm == CGSHandler::PSMCT24) || (psm == CGSHandler::PSMZ24);
+}
+
+//Returns a 32-bit color, alpha is 0x80 when the format doesn't have any
+static uint32 ReadColor(uint8* ram, const CGsRasterizer::STATE& state, uint32 x, uint32 y)
+{
+	uint32 ptr = state.frameBufPtr;
+	uint32 width = state.frameBufWidth;
+	switch(state.framePsm)
+	{
+	default:
+	case CGSHandler::PSMCT32:
+		return *GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y);
+	case CGSHandler::PSMCT24:
+		return (*GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y) & 0xFFFFFF) | 0x80000000;
+	case CGSHandler::PSMCT16:
+		return CGSHandler::RGBA16ToRGBA32(*GetPixelAddress<STORAGEPSMCT16>(ram, ptr, width, x, y), 0x80);
+	case CGSHandler::PSMCT16S:
+		return CGSHandler::RGBA16ToRGBA32(*GetPixelAddress<STORAGEPSMCT16S>(ram, ptr, width, x, y), 0x80);
+	case CGSHandler::PSMZ32:
+		return *GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y);
+	case CGSHandler::PSMZ24:
+		return (*GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y) & 0xFFFFFF) | 0x80000000;
+	case CGSHandler::PSMZ16:
+		return CGSHandler::RGBA16ToRGBA32(*GetPixelAddress<STORAGEPSMZ16>(ram, ptr, width, x, y), 0x80);
+	case CGSHandler::PSMZ16S:
+		return CGSHandler::RGBA16ToRGBA32(*GetPixelAddress<STORAGEPSMZ16S>(ram, ptr, width, x, y), 0x80);
+	}
+}
+
+//Bits set in the mask are kept
+static void WriteColor(uint8* ram, const CGsRasterizer::STATE& state, uint32 x, uint32 y, uint32 color, uint32 mask)
+{
+	uint32 ptr = state.frameBufPtr;
+	uint32 width = state.frameBufWidth;
+	switch(state.framePsm)
+	{
+	default:
+	case CGSHandler::PSMCT32:
+		WriteMaskedPixel<STORAGEPSMCT32>(ram, ptr, width, x, y, color, mask);
+		break;
+	case CGSHandler::PSMCT24:
+		WriteMaskedPixel<STORAGEPSMCT32>(ram, ptr, width, x, y, color, mask | 0xFF000000);
+		break;
+	case CGSHandler::PSMCT16:
+		WriteMaskedPixel<STORAGEPSMCT16>(ram, ptr, width, x, y, RGBA32ToRGBA16(color), RGBA32ToRGBA16(mask));
+		break;
+	case CGSHandler::PSMCT16S:
+		WriteMaskedPixel<STORAGEPSMCT16S>(ram, ptr, width, x, y, RGBA32ToRGBA16(color), RGBA32ToRGBA16(mask));
+		break;
+	case CGSHandler::PSMZ32:
+		WriteMaskedPixel<STORAGEPSMZ32>(ram, ptr, width, x, y, color, mask);
+		break;
+	case CGSHandler::PSMZ24:
+		WriteMaskedPixel<STORAGEPSMZ32>(ram, ptr, width, x, y, color, mask | 0xFF000000);
+		break;
+	case CGSHandler::PSMZ16:
+		WriteMaskedPixel<STORAGEPSMZ16>(ram, ptr, width, x, y, RGBA32ToRGBA16(color), RGBA32ToRGBA16(mask));
+		break;
+	case CGSHandler::PSMZ16S:
+		WriteMaskedPixel<STORAGEPSMZ16S>(ram, ptr, width, x, y, RGBA32ToRGBA16(color), RGBA32ToRGBA16(mask));
+		break;
+	}
+}
+
+static uint32 GetDepthMax(uint32 psm)
+{
+	switch(psm)
+	{
+	default:
+	case CGSHandler::PSMZ32:
+		return 0xFFFFFFFF;
+	case CGSHandler::PSMZ24:
+		return 0xFFFFFF;
+	case CGSHandler::PSMZ16:
+	case CGSHandler::PSMZ16S:
+		return 0xFFFF;
+	}
+}
+
+static uint32 ReadDepth(uint8* ram, const CGsRasterizer::STATE& state, uint32 x, uint32 y)
+{
+	uint32 ptr = state.zbufPtr;
+	uint32 width = state.frameBufWidth;
+	switch(state.zbufPsm)
+	{
+	default:
+	case CGSHandler::PSMZ32:
+		return *GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y);
+	case CGSHandler::PSMZ24:
+		return *GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y) & 0xFFFFFF;
+	case CGSHandler::PSMZ16:
+		return *GetPixelAddress<STORAGEPSMZ16>(ram, ptr, width, x, y);
+	case CGSHandler::PSMZ16S:
+		return *GetPixelAddress<STORAGEPSMZ16S>(ram, ptr, width, x, y);
+	}
+}
+
+static void WriteDepth(uint8* ram, const CGsRasterizer::STATE& state, uint32 x, uint32 y, uint32 depth)
+{
+	uint32 ptr = state.zbufPtr;
+	uint32 width = state.frameBufWidth;
+	switch(state.zbufPsm)
+	{
+	default:
+	case CGSHandler::PSMZ32:
+		WriteMaskedPixel<STORAGEPSMZ32>(ram, ptr, width, x, y, depth, 0);
+		break;
+	case CGSHandler::PSMZ24:
+		WriteMaskedPixel<STORAGEPSMZ32>(ram, ptr, width, x, y, depth, 0xFF000000);
+		break;
+	case CGSHandler::PSMZ16:
+		WriteMaskedPixel<STORAGEPSMZ16>(ram, ptr, width, x, y, static_cast<uint16>(depth), 0);
+		break;
+	case CGSHandler::PSMZ16S:
+		WriteMaskedPixel<STORAGEPSMZ16S>(ram, ptr, width, x, y, static_cast<uint16>(depth), 0);
+		break;
+	}
+}
+
+static uint32 InterpolateDepth(double start, double step, int32 offset, uint32 depthMax)
+{
+	double depth = start + (step * static_cast<double>(offset));
+	if(!(depth > 0)) return 0;
+	if(depth >= static_cast<double>(depthMax)) return depthMax;
+	return static_cast<uint32>(depth);
+}
+
+static bool DepthTest(uint32 method, uint32 depth, uint32 bufferDepth)
+{
+	switch(method)
+	{
+	case DEPTH_TEST_NEVER:
+		return false;
+	default:
+	case DEPTH_TEST_ALWAYS:
+		return true;
+	case DEPTH_TEST_GEQUAL:
+		return depth >= bufferDepth;
+	case DEPTH_TEST_GREATER:
+		return depth > bufferDepth;
+	}
+}
+
+//////////////////////////////////////////////
+//Texture sampling
+
+static uint32 WrapTexCoord(int32 coord, uint32 mode, uint32 size, uint32 minValue, uint32 maxValue)
+{
+	switch(mode)
+	{
+	default:
+	case CLAMP_MODE_REPEAT:
+		return coord & (size - 1);
+	case CLAMP_MODE_CLAMP:
+		return std::min<int32>(std::max<int32>(coord, 0), size - 1);
+	case CLAMP_MODE_REGION_CLAMP:
+		return std::max<int32>(std::min<int32>(coord, maxValue), minValue);
+	case CLAMP_MODE_REGION_REPEAT:
+		return (coord & minValue) | maxValue;
+	}
+}
+
+static uint32 ExpandAlpha24(uint32 color, const CGsRasterizer::STATE& state)
+{
+	color &= 0xFFFFFF;
+	uint32 alpha = (state.textureAlphaExpand && (color == 0)) ? 0 : state.textureAlpha0;
+	return color | (alpha << 24);
+}
+
+static uint32 ExpandAlpha16(uint16 color, const CGsRasterizer::STATE& state)
+{
+	uint32 alpha = (color & 0x8000) ? state.textureAlpha1 : ((state.textureAlphaExpand && ((color & 0x7FFF) == 0)) ? 0 : state.textureAlpha0);
+	return (CGSHandler::RGBA16ToRGBA32(color) & 0xFFFFFF) | (alpha << 24);
+}
+
+static uint32 ReadTexel(uint8* ram, const CGsRasterizer::STATE& state, const uint32* clut, int32 u, int32 v)
+{
+	uint32 x = WrapTexCoord(u, state.textureWrapModeU, state.textureWidth, state.textureMinU, state.textureMaxU) & 0x7FF;
+	uint32 y = WrapTexCoord(v, state.textureWrapModeV, state.textureHeight, state.textureMinV, state.textureMaxV) & 0x7FF;
+	uint32 ptr = state.textureBufPtr;
+	uint32 width = state.textureBufWidth;
+	switch(state.texturePsm)
+	{
+	case CGSHandler::PSMCT32:
+		return *GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y);
+	case CGSHandler::PSMCT24:
+		return ExpandAlpha24(*GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMCT16:
+		return ExpandAlpha16(*GetPixelAddress<STORAGEPSMCT16>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMCT16S:
+		return ExpandAlpha16(*GetPixelAddress<STORAGEPSMCT16S>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMZ32:
+		return *GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y);
+	case CGSHandler::PSMZ24:
+		return ExpandAlpha24(*GetPixelAddress<STORAGEPSMZ32>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMZ16:
+		return ExpandAlpha16(*GetPixelAddress<STORAGEPSMZ16>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMZ16S:
+		return ExpandAlpha16(*GetPixelAddress<STORAGEPSMZ16S>(ram, ptr, width, x, y), state);
+	case CGSHandler::PSMT8:
+		return clut[*GetPixelAddress<STORAGEPSMT8>(ram, ptr, width, x, y)];
+	case CGSHandler::PSMT4:
+	{
+		CGsPixelFormats::CPixelIndexorPSMT4 indexor(ram, ptr, width);
+		return clut[indexor.GetPixel(x, y)];
+	}
+	case CGSHandler::PSMT8H:
+		return clut[*GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y) >> 24];
+	case CGSHandler::PSMT4HL:
+		return clut[(*GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y) >> 24) & 0x0F];
+	case CGSHandler::PSMT4HH:
+		return clut[*GetPixelAddress<STORAGEPSMCT32>(ram, ptr, width, x, y) >> 28];
+	default:
+		return 0;
+	}
+}
+
+//Coordinates are in 1/16th of texel
+static uint32 SampleTexture(uint8* ram, const CGsRasterizer::STATE& state, const uint32* clut, int32 u, int32 v)
+{
+	if(!state.textureLinearFilter)
+	{
+		return ReadTexel(ram, state, clut, u >> 4, v >> 4);
+	}
+
+	u -= 8;
+	v -= 8;
+	int32 x = u >> 4;
+	int32 y = v >> 4;
+	uint32 fracU = u & 0x0F;
+	uint32 fracV = v & 0x0F;
+
+	uint32 texel00 = ReadTexel(ram, state, clut, x + 0, y + 0);
+	uint32 texel10 = ReadTexel(ram, state, clut, x + 1, y + 0);
+	uint32 texel01 = ReadTexel(ram, state, clut, x + 0, y + 1);
+	uint32 texel11 = ReadTexel(ram, state, clut, x + 1, y + 1);
+
+	uint32 result = 0;
+	for(unsigned int shift = 0; shift < 32; shift += 8)
+	{
+		uint32 c00 = (texel00 >> shift) & 0xFF;
+		uint32 c10 = (texel10 >> shift) & 0xFF;
+		uint32 c01 = (texel01 >> shift) & 0xFF;
+		uint32 c11 = (texel11 >> shift) & 0xFF;
+		uint32 top = (c00 * (16 - fracU)) + (c10 * fracU);
+		uint32 bottom = (c01 * (16 - fracU)) + (c11 * fracU);
+		uint32 value = ((top * (16 - fracV)) + (bottom * fracV)) >> 8;
+		result |= (value << shift);
+	}
+	return result;
+}
+
+//////////////////////////////////////////////
+//Primitive setup
+
+static int64 FloorDiv(int64 a, int64 b)
+{
+	assert(b > 0);
+	int64 result = a / b;
+	if((a % b) < 0) result--;
+	return result;
+}
+
+static int64 CeilDiv(int64 a, int64 b)
+{
+	return -FloorDiv(-a, b);
+}
+
+//Values are in the same order as the ATTRIBUTE enum
+static void GetVertexAttributes(const CGsRasterizer::VERTEX& vertex, double* attributes)
+{
+	attributes[0] = vertex.r;
+	attributes[1] = vertex.g;
+	attributes[2] = vertex.b;
+	attributes[3] = vertex.a;
+	attributes[4] = vertex.s;
+	attributes[5] = vertex.t;
+	attributes[6] = vertex.q;
+	attributes[7] = vertex.fog;
+}
+
+CGsRasterizer::CGsRasterizer(uint8* ram)
+    : m_ram(ram)
+    , m_nextTile(0)
+{
+	m_profilerZone = CProfiler::GetInstance().RegisterZone("GSRAST");
+	SetSpanSet(IsSimdSupported() ? SPAN_SET_SIMD : SPAN_SET_SCALAR);
+
+	//Page offset tables are built on first use, make sure workers never have to do it
+	InitializeIndexor<STORAGEPSMCT32>(ram);
+	InitializeIndexor<STORAGEPSMCT16>(ram);
+	InitializeIndexor<STORAGEPSMCT16S>(ram);
+	InitializeIndexor<STORAGEPSMZ32>(ram);
+	InitializeIndexor<STORAGEPSMZ16>(ram);
+	InitializeIndexor<STORAGEPSMZ16S>(ram);
+	InitializeIndexor<STORAGEPSMT8>(ram);
+	InitializeIndexor<STORAGEPSMT4>(ram);
+}
+
+CGsRasterizer::~CGsRasterizer()
+{
+	StopWorkers();
+}
+
+bool CGsRasterizer::IsSimdSupported()
+{
+#ifdef HAS_SIMD
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CGsRasterizer::SetSpanSet(SPAN_SET spanSet)
+{
+	assert((spanSet == SPAN_SET_SCALAR) || (spanSet == SPAN_SET_SIMD));
+	Flush();
+	m_shadeSpan = (spanSet == SPAN_SET_SIMD) ? &CGsRasterizer::ShadeSpan<SIMD_OPS> : &CGsRasterizer::ShadeSpan<SCALAR_OPS>;
+}
+
+void CGsRasterizer::SetWorkerCount(unsigned int workerCount)
+{
+	if(workerCount == m_workers.size()) return;
+	Flush();
+	StopWorkers();
+	StartWorkers(workerCount);
+}
+
+unsigned int CGsRasterizer::GetWorkerCount() const
+{
+	return static_cast<unsigned int>(m_workers.size());
+}
+
+void CGsRasterizer::SetState(const STATE& inputState, const uint32* clut)
+{
+	STATE state = inputState;
+	state.clutIndex = 0;
+
+	if(!m_primitives.empty())
+	{
+		const auto& batchState = m_states.back();
+		bool targetChanged =
+		    (state.frameBufPtr != batchState.frameBufPtr) ||
+		    (state.frameBufWidth != batchState.frameBufWidth) ||
+		    (state.framePsm != batchState.framePsm);
+		if(UsesDepthBuffer(state) && m_zbufUsed)
+		{
+			targetChanged |= (state.zbufPtr != batchState.zbufPtr) || (state.zbufPsm != batchState.zbufPsm);
+		}
+		bool textureRendered = false;
+		if(state.textureEnabled)
+		{
+			auto textureRange = GetBufferRange(state.textureBufPtr, state.textureBufWidth, state.texturePsm, state.textureHeight);
+			textureRendered = IsRangeWritten(textureRange.start, textureRange.end - textureRange.start);
+		}
+		if(targetChanged || textureRendered)
+		{
+			Flush();
+		}
+	}
+
+	if(state.textureEnabled && CGsPixelFormats::IsPsmIDTEX(state.texturePsm))
+	{
+		static const Clut emptyClut = {};
+		const uint32* clutData = clut ? clut : emptyClut.data();
+		if(m_cluts.empty() || (memcmp(m_cluts.back().data(), clutData, sizeof(Clut)) != 0))
+		{
+			m_cluts.emplace_back();
+			memcpy(m_cluts.back().data(), clutData, sizeof(Clut));
+		}
+		state.clutIndex = static_cast<uint32>(m_cluts.size() - 1);
+	}
+
+	if(m_states.empty() || (memcmp(&m_states.back(), &state, sizeof(STATE)) != 0))
+	{
+		m_states.push_back(state);
+	}
+	m_stateValid = true;
+}
+
+void CGsRasterizer::DrawPoint(const VERTEX& vertex)
+{
+	PRIMITIVE primitive = {};
+	primitive.type = PRIMITIVE_TYPE_POINT;
+	primitive.minX = primitive.maxX = static_cast<int32>(FloorDiv(vertex.x + 8, 16));
+	primitive.minY = primitive.maxY = static_cast<int32>(FloorDiv(vertex.y + 8, 16));
+	if(!ClipToScissor(primitive)) return;
+
+	double attributes[ATTRIBUTE_COUNT];
+	GetVertexAttributes(vertex, attributes);
+	primitive.originX = static_cast<float>(primitive.minX);
+	primitive.originY = static_cast<float>(primitive.minY);
+	for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		SetupPlane(primitive.attributes[i], static_cast<float>(attributes[i]), 0, 0);
+	}
+	primitive.z = vertex.z;
+	AddPrimitive(primitive);
+}
+
+void CGsRasterizer::DrawLine(const VERTEX& v0, const VERTEX& v1)
+{
+	int32 x0 = static_cast<int32>(FloorDiv(v0.x + 8, 16));
+	int32 y0 = static_cast<int32>(FloorDiv(v0.y + 8, 16));
+	int32 x1 = static_cast<int32>(FloorDiv(v1.x + 8, 16));
+	int32 y1 = static_cast<int32>(FloorDiv(v1.y + 8, 16));
+	int32 dx = x1 - x0;
+	int32 dy = y1 - y0;
+	bool xMajor = std::abs(dx) >= std::abs(dy);
+	int32 majorDelta = xMajor ? dx : dy;
+	int32 minorDelta = xMajor ? dy : dx;
+	int32 length = std::abs(majorDelta);
+	if(length == 0) return;
+
+	//Last pixel isn't drawn
+	PRIMITIVE primitive = {};
+	primitive.type = PRIMITIVE_TYPE_LINE;
+	primitive.lineX = x0;
+	primitive.lineY = y0;
+	primitive.lineXMajor = xMajor;
+	primitive.lineMajorStep = (majorDelta > 0) ? 1 : -1;
+	primitive.lineMinorStep = static_cast<int32>((static_cast<int64>(minorDelta) << 16) / length);
+	primitive.lineLength = length;
+
+	int32 endX = xMajor ? (x1 - primitive.lineMajorStep) : x1;
+	int32 endY = xMajor ? y1 : (y1 - primitive.lineMajorStep);
+	primitive.minX = std::min(x0, endX);
+	primitive.maxX = std::max(x0, endX);
+	primitive.minY = std::min(y0, endY);
+	primitive.maxY = std::max(y0, endY);
+	if(!ClipToScissor(primitive)) return;
+
+	const auto& state = m_states.back();
+	double attributes0[ATTRIBUTE_COUNT];
+	double attributes1[ATTRIBUTE_COUNT];
+	GetVertexAttributes(v0, attributes0);
+	GetVertexAttributes(v1, attributes1);
+	primitive.originX = static_cast<float>(x0);
+	primitive.originY = static_cast<float>(y0);
+	for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		bool flat = !state.gouraudShading && (i <= ATTRIBUTE_A);
+		double start = flat ? attributes1[i] : attributes0[i];
+		double slope = flat ? 0 : (attributes1[i] - attributes0[i]) / static_cast<double>(majorDelta);
+		SetupPlane(primitive.attributes[i], static_cast<float>(start), xMajor ? static_cast<float>(slope) : 0, xMajor ? 0 : static_cast<float>(slope));
+	}
+	double zSlope = (static_cast<double>(v1.z) - static_cast<double>(v0.z)) / static_cast<double>(majorDelta);
+	primitive.z = v0.z;
+	primitive.zdx = xMajor ? zSlope : 0;
+	primitive.zdy = xMajor ? 0 : zSlope;
+	AddPrimitive(primitive);
+}
+
+void CGsRasterizer::DrawTriangle(const VERTEX& v0, const VERTEX& v1, const VERTEX& v2)
+{
+	const VERTEX* vertices[3] = {&v0, &v1, &v2};
+	int64 area =
+	    (static_cast<int64>(v1.x - v0.x) * static_cast<int64>(v2.y - v0.y)) -
+	    (static_cast<int64>(v2.x - v0.x) * static_cast<int64>(v1.y - v0.y));
+	if(area == 0) return;
+	if(area < 0)
+	{
+		std::swap(vertices[1], vertices[2]);
+		area = -area;
+	}
+
+	PRIMITIVE primitive = {};
+	primitive.type = PRIMITIVE_TYPE_TRIANGLE;
+
+	for(unsigned int i = 0; i < EDGE_COUNT; i++)
+	{
+		const auto& a = *vertices[i];
+		const auto& b = *vertices[(i + 1) % 3];
+		int64 dx = b.x - a.x;
+		int64 dy = b.y - a.y;
+		auto& edge = primitive.edges[i];
+		edge.a = -dy;
+		edge.b = dx;
+		edge.c = (dy * a.x) - (dx * a.y);
+		//Pixels exactly on an edge are only covered if it's a top or a left edge
+		bool topLeft = (dy < 0) || ((dy == 0) && (dx > 0));
+		if(!topLeft) edge.c -= 1;
+	}
+
+	int32 minX = std::min(v0.x, std::min(v1.x, v2.x));
+	int32 minY = std::min(v0.y, std::min(v1.y, v2.y));
+	int32 maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	int32 maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	primitive.minX = static_cast<int32>(CeilDiv(minX, 16));
+	primitive.minY = static_cast<int32>(CeilDiv(minY, 16));
+	primitive.maxX = static_cast<int32>(FloorDiv(maxX, 16));
+	primitive.maxY = static_cast<int32>(FloorDiv(maxY, 16));
+	if(!ClipToScissor(primitive)) return;
+
+	const auto& state = m_states.back();
+	const auto& p0 = *vertices[0];
+	const auto& p1 = *vertices[1];
+	const auto& p2 = *vertices[2];
+	double x10 = static_cast<double>(p1.x - p0.x) / 16.0;
+	double y10 = static_cast<double>(p1.y - p0.y) / 16.0;
+	double x20 = static_cast<double>(p2.x - p0.x) / 16.0;
+	double y20 = static_cast<double>(p2.y - p0.y) / 16.0;
+	double determinant = static_cast<double>(area) / 256.0;
+
+	double attributes[3][ATTRIBUTE_COUNT];
+	double lastAttributes[ATTRIBUTE_COUNT];
+	GetVertexAttributes(p0, attributes[0]);
+	GetVertexAttributes(p1, attributes[1]);
+	GetVertexAttributes(p2, attributes[2]);
+	GetVertexAttributes(v2, lastAttributes);
+	primitive.originX = static_cast<float>(static_cast<double>(p0.x) / 16.0);
+	primitive.originY = static_cast<float>(static_cast<double>(p0.y) / 16.0);
+	for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		if(!state.gouraudShading && (i <= ATTRIBUTE_A))
+		{
+			//Flat shading uses the color of the last vertex
+			SetupPlane(primitive.attributes[i], static_cast<float>(lastAttributes[i]), 0, 0);
+			continue;
+		}
+		double d10 = attributes[1][i] - attributes[0][i];
+		double d20 = attributes[2][i] - attributes[0][i];
+		double dx = ((d10 * y20) - (d20 * y10)) / determinant;
+		double dy = ((d20 * x10) - (d10 * x20)) / determinant;
+		SetupPlane(primitive.attributes[i], static_cast<float>(attributes[0][i]), static_cast<float>(dx), static_cast<float>(dy));
+	}
+	{
+		double d10 = static_cast<double>(p1.z) - static_cast<double>(p0.z);
+		double d20 = static_cast<double>(p2.z) - static_cast<double>(p0.z);
+		primitive.z = p0.z;
+		primitive.zdx = ((d10 * y20) - (d20 * y10)) / determinant;
+		primitive.zdy = ((d20 * x10) - (d10 * x20)) / determinant;
+	}
+	AddPrimitive(primitive);
+}
+
+void CGsRasterizer::DrawSprite(const VERTEX& v0, const VERTEX& v1)
+{
+	//Texture coordinates follow their positions if the corners are swapped
+	int32 x0 = v0.x;
+	int32 x1 = v1.x;
+	int32 y0 = v0.y;
+	int32 y1 = v1.y;
+	float s0 = v0.s;
+	float s1 = v1.s;
+	float t0 = v0.t;
+	float t1 = v1.t;
+	if(x0 > x1)
+	{
+		std::swap(x0, x1);
+		std::swap(s0, s1);
+	}
+	if(y0 > y1)
+	{
+		std::swap(y0, y1);
+		std::swap(t0, t1);
+	}
+
+	PRIMITIVE primitive = {};
+	primitive.type = PRIMITIVE_TYPE_SPRITE;
+	primitive.minX = static_cast<int32>(CeilDiv(x0, 16));
+	primitive.minY = static_cast<int32>(CeilDiv(y0, 16));
+	primitive.maxX = static_cast<int32>(CeilDiv(x1, 16)) - 1;
+	primitive.maxY = static_cast<int32>(CeilDiv(y1, 16)) - 1;
+	if(!ClipToScissor(primitive)) return;
+
+	double width = static_cast<double>(x1 - x0) / 16.0;
+	double height = static_cast<double>(y1 - y0) / 16.0;
+	double attributes[ATTRIBUTE_COUNT];
+	GetVertexAttributes(v1, attributes);
+	primitive.originX = static_cast<float>(static_cast<double>(x0) / 16.0);
+	primitive.originY = static_cast<float>(static_cast<double>(y0) / 16.0);
+	for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		SetupPlane(primitive.attributes[i], static_cast<float>(attributes[i]), 0, 0);
+	}
+	SetupPlane(primitive.attributes[ATTRIBUTE_S], s0, static_cast<float>((static_cast<double>(s1) - s0) / width), 0);
+	SetupPlane(primitive.attributes[ATTRIBUTE_T], t0, 0, static_cast<float>((static_cast<double>(t1) - t0) / height));
+	primitive.z = v1.z;
+	AddPrimitive(primitive);
+}
+
+bool CGsRasterizer::IsEmpty() const
+{
+	return m_primitives.empty();
+}
+
+bool CGsRasterizer::IsRangeWritten(uint32 start, uint32 size) const
+{
+	if(m_primitives.empty()) return false;
+	MEMORY_RANGE range;
+	range.start = start;
+	range.end = start + size;
+	return RangesIntersect(range, m_frameRange) || (m_zbufUsed && RangesIntersect(range, m_zbufRange));
+}
+
+void CGsRasterizer::Flush()
+{
+	if(m_primitives.empty()) return;
+
+	if(m_serial)
+	{
+#ifdef PROFILE
+		CProfilerZone profilerZone(m_profilerZone);
+#endif
+		for(const auto& primitive : m_primitives)
+		{
+			RasterizePrimitive(primitive, primitive.minX, primitive.minY, primitive.maxX, primitive.maxY);
+		}
+	}
+	else if(m_workers.empty())
+	{
+		m_nextTile = 0;
+		RasterizeTiles();
+	}
+	else
+	{
+		m_nextTile = 0;
+		{
+			std::lock_guard<std::mutex> workerLock(m_workerMutex);
+			m_workGeneration++;
+			m_busyWorkerCount = static_cast<uint32>(m_workers.size());
+		}
+		m_workAvailable.notify_all();
+		//Help the workers instead of waiting
+		RasterizeTiles();
+		{
+			std::unique_lock<std::mutex> workerLock(m_workerMutex);
+			m_workDone.wait(workerLock, [this]() { return m_busyWorkerCount == 0; });
+		}
+	}
+
+	ResetBatch();
+}
+
+void CGsRasterizer::Clear()
+{
+	ResetBatch();
+	m_states.clear();
+	m_cluts.clear();
+	m_stateValid = false;
+}
+
+CGsRasterizer::MEMORY_RANGE CGsRasterizer::GetBufferRange(uint32 bufPtr, uint32 bufWidth, uint32 psm, uint32 height)
+{
+	MEMORY_RANGE range;
+	if(!IsPsmSupported(psm))
+	{
+		range.start = 0;
+		range.end = CGSHandler::RAMSIZE;
+		return range;
+	}
+	auto pageSize = CGsPixelFormats::GetPsmPageSize(psm);
+	uint32 pageCountX = std::max<uint32>(((bufWidth * 64) + pageSize.first - 1) / pageSize.first, 1);
+	uint32 pageCountY = (height + pageSize.second - 1) / pageSize.second;
+	range.start = bufPtr;
+	range.end = bufPtr + (pageCountX * pageCountY * CGsPixelFormats::PAGESIZE);
+	return range;
+}
+
+bool CGsRasterizer::RangesIntersect(const MEMORY_RANGE& range1, const MEMORY_RANGE& range2)
+{
+	return (range1.start < range2.end) && (range2.start < range1.end);
+}
+
+bool CGsRasterizer::UsesDepthBuffer(const STATE& state)
+{
+	//Depth buffer isn't read or written when the depth test is disabled
+	return state.depthTestEnabled != 0;
+}
+
+void CGsRasterizer::SetupPlane(PLANE& plane, float value, float dx, float dy)
+{
+	plane.value = value;
+	plane.dx = dx;
+	plane.dy = dy;
+	for(unsigned int i = 0; i < LANE_COUNT; i++)
+	{
+		plane.laneOffsets[i] = dx * static_cast<float>(i);
+	}
+	plane.step = dx * static_cast<float>(LANE_COUNT);
+}
+
+float CGsRasterizer::EvaluatePlane(const PLANE& plane, double x, double y)
+{
+	return static_cast<float>(static_cast<double>(plane.value) + (static_cast<double>(plane.dx) * x) + (static_cast<double>(plane.dy) * y));
+}
+
+bool CGsRasterizer::ClipToScissor(PRIMITIVE& primitive) const
+{
+	assert(m_stateValid);
+	const auto& state = m_states.back();
+	primitive.minX = std::max<int32>(primitive.minX, state.scissorX0);
+	primitive.minY = std::max<int32>(primitive.minY, state.scissorY0);
+	primitive.maxX = std::min<int32>(primitive.maxX, state.scissorX1);
+	primitive.maxY = std::min<int32>(primitive.maxY, state.scissorY1);
+	return (primitive.minX <= primitive.maxX) && (primitive.minY <= primitive.maxY);
+}
+
+void CGsRasterizer::AddPrimitive(PRIMITIVE& primitive)
+{
+	if(m_primitives.size() == MAX_PRIMITIVE_COUNT)
+	{
+		Flush();
+	}
+
+	const auto& state = m_states.back();
+	primitive.stateIndex = static_cast<uint32>(m_states.size() - 1);
+
+	bool constantColor = true;
+	for(unsigned int i = ATTRIBUTE_R; i <= ATTRIBUTE_A; i++)
+	{
+		constantColor &= (primitive.attributes[i].dx == 0) && (primitive.attributes[i].dy == 0);
+	}
+	bool constantDepth = (primitive.zdx == 0) && (primitive.zdy == 0);
+	primitive.solidFill =
+	    constantColor && !state.textureEnabled && !state.fogEnabled && !state.alphaBlendEnabled &&
+	    (!state.alphaTestEnabled || (state.alphaTestMethod == ALPHA_TEST_ALWAYS)) && !state.destAlphaTestEnabled &&
+	    (!state.depthTestEnabled || ((state.depthTestMethod == DEPTH_TEST_ALWAYS) && constantDepth));
+
+	//Keep track of the memory written by the batch
+	auto frameRange = GetBufferRange(state.frameBufPtr, state.frameBufWidth, state.framePsm, state.scissorY1 + 1);
+	if(m_frameRange.start == m_frameRange.end)
+	{
+		m_frameRange = frameRange;
+	}
+	else
+	{
+		m_frameRange.start = std::min(m_frameRange.start, frameRange.start);
+		m_frameRange.end = std::max(m_frameRange.end, frameRange.end);
+	}
+	if(UsesDepthBuffer(state))
+	{
+		m_zbufRange = GetBufferRange(state.zbufPtr, state.frameBufWidth, state.zbufPsm, 2048);
+		m_zbufUsed = true;
+	}
+
+	//Tiles are only independent if pixels of different tiles don't share memory and if the texture isn't rendered to
+	m_serial |= (state.scissorX1 >= (state.frameBufWidth * 64));
+	m_serial |= m_zbufUsed && RangesIntersect(m_frameRange, m_zbufRange);
+	if(state.textureEnabled)
+	{
+		auto textureRange = GetBufferRange(state.textureBufPtr, state.textureBufWidth, state.texturePsm, state.textureHeight);
+		m_serial |= RangesIntersect(textureRange, m_frameRange) || (m_zbufUsed && RangesIntersect(textureRange, m_zbufRange));
+	}
+
+	uint32 primitiveIndex = static_cast<uint32>(m_primitives.size());
+	m_primitives.push_back(primitive);
+
+	uint32 tileMinX = primitive.minX / TILE_WIDTH;
+	uint32 tileMinY = primitive.minY / TILE_HEIGHT;
+	uint32 tileMaxX = primitive.maxX / TILE_WIDTH;
+	uint32 tileMaxY = primitive.maxY / TILE_HEIGHT;
+	for(uint32 tileY = tileMinY; tileY <= tileMaxY; tileY++)
+	{
+		for(uint32 tileX = tileMinX; tileX <= tileMaxX; tileX++)
+		{
+			if((primitive.type == PRIMITIVE_TYPE_TRIANGLE) && !IsTileCovered(primitive, tileX, tileY)) continue;
+			uint32 tileIndex = tileX + (tileY * TILE_COUNT_X);
+			auto& bin = m_tileBins[tileIndex];
+			if(bin.empty())
+			{
+				m_activeTiles.push_back(tileIndex);
+			}
+			bin.push_back(primitiveIndex);
+		}
+	}
+}
+
+void CGsRasterizer::ResetBatch()
+{
+	for(auto tileIndex : m_activeTiles)
+	{
+		m_tileBins[tileIndex].clear();
+	}
+	m_activeTiles.clear();
+	m_primitives.clear();
+	m_frameRange = MEMORY_RANGE();
+	m_zbufRange = MEMORY_RANGE();
+	m_zbufUsed = false;
+	m_serial = false;
+
+	//Current state stays valid for the primitives that follow
+	if(!m_states.empty())
+	{
+		auto state = m_states.back();
+		if(!m_cluts.empty())
+		{
+			auto clut = m_cluts[state.clutIndex];
+			m_cluts.clear();
+			m_cluts.push_back(clut);
+			state.clutIndex = 0;
+		}
+		m_states.clear();
+		m_states.push_back(state);
+	}
+}
+
+bool CGsRasterizer::IsTileCovered(const PRIMITIVE& primitive, uint32 tileX, uint32 tileY) const
+{
+	int64 minX = static_cast<int64>(tileX * TILE_WIDTH) * 16;
+	int64 minY = static_cast<int64>(tileY * TILE_HEIGHT) * 16;
+	int64 maxX = static_cast<int64>((tileX + 1) * TILE_WIDTH - 1) * 16;
+	int64 maxY = static_cast<int64>((tileY + 1) * TILE_HEIGHT - 1) * 16;
+	for(const auto& edge : primitive.edges)
+	{
+		//Tile is outside if the corner that is the most inside of the edge is outside
+		int64 x = (edge.a > 0) ? maxX : minX;
+		int64 y = (edge.b > 0) ? maxY : minY;
+		if(((edge.a * x) + (edge.b * y) + edge.c) < 0) return false;
+	}
+	return true;
+}
+
+void CGsRasterizer::StartWorkers(unsigned int workerCount)
+{
+	assert(m_workers.empty());
+	uint32 generation = m_workGeneration;
+	for(unsigned int i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back(
+		    [this, i, generation]() {
+			    WorkerThreadProc(i, generation);
+		    });
+	}
+}
+
+void CGsRasterizer::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> workerLock(m_workerMutex);
+		m_workerTerminate = true;
+	}
+	m_workAvailable.notify_all();
+	for(auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_workerTerminate = false;
+}
+
+void CGsRasterizer::WorkerThreadProc(unsigned int workerIndex, uint32 generation)
+{
+	CProfiler::GetInstance().SetThreadName(string_format("GSRAST%d", workerIndex).c_str());
+
+	std::unique_lock<std::mutex> workerLock(m_workerMutex);
+	while(1)
+	{
+		m_workAvailable.wait(workerLock, [&]() { return m_workerTerminate || (m_workGeneration != generation); });
+		if(m_workerTerminate) break;
+		generation = m_workGeneration;
+		workerLock.unlock();
+		RasterizeTiles();
+		workerLock.lock();
+		m_busyWorkerCount--;
+		if(m_busyWorkerCount == 0)
+		{
+			m_workDone.notify_one();
+		}
+	}
+}
+
+void CGsRasterizer::RasterizeTiles()
+{
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_profilerZone);
+#endif
+
+	uint32 tileCount = static_cast<uint32>(m_activeTiles.size());
+	while(1)
+	{
+		uint32 index = m_nextTile++;
+		if(index >= tileCount) break;
+		uint32 tileIndex = m_activeTiles[index];
+		int32 tileMinX = (tileIndex % TILE_COUNT_X) * TILE_WIDTH;
+		int32 tileMinY = (tileIndex / TILE_COUNT_X) * TILE_HEIGHT;
+		int32 tileMaxX = tileMinX + TILE_WIDTH - 1;
+		int32 tileMaxY = tileMinY + TILE_HEIGHT - 1;
+		for(auto primitiveIndex : m_tileBins[tileIndex])
+		{
+			const auto& primitive = m_primitives[primitiveIndex];
+			RasterizePrimitive(primitive,
+			                   std::max(tileMinX, primitive.minX), std::max(tileMinY, primitive.minY),
+			                   std::min(tileMaxX, primitive.maxX), std::min(tileMaxY, primitive.maxY));
+		}
+	}
+}
+
+void CGsRasterizer::RasterizePrimitive(const PRIMITIVE& primitive, int32 minX, int32 minY, int32 maxX, int32 maxY)
+{
+	if((minX > maxX) || (minY > maxY)) return;
+
+	auto shadeSpan =
+	    [&](int32 y, int32 x0, int32 x1) {
+		    if(primitive.solidFill)
+		    {
+			    FillSpan(primitive, y, x0, x1);
+		    }
+		    else
+		    {
+			    (this->*m_shadeSpan)(primitive, y, x0, x1);
+		    }
+	    };
+
+	switch(primitive.type)
+	{
+	case PRIMITIVE_TYPE_POINT:
+	case PRIMITIVE_TYPE_SPRITE:
+		for(int32 y = minY; y <= maxY; y++)
+		{
+			shadeSpan(y, minX, maxX + 1);
+		}
+		break;
+	case PRIMITIVE_TYPE_LINE:
+		for(int32 i = 0; i < primitive.lineLength; i++)
+		{
+			int32 major = primitive.lineMajorStep * i;
+			int32 minor = static_cast<int32>(((static_cast<int64>(primitive.lineMinorStep) * i) + 0x8000) >> 16);
+			int32 x = primitive.lineX + (primitive.lineXMajor ? major : minor);
+			int32 y = primitive.lineY + (primitive.lineXMajor ? minor : major);
+			if((x < minX) || (x > maxX) || (y < minY) || (y > maxY)) continue;
+			shadeSpan(y, x, x + 1);
+		}
+		break;
+	case PRIMITIVE_TYPE_TRIANGLE:
+		for(int32 y = minY; y <= maxY; y++)
+		{
+			//Solve a * x + b * y + c >= 0 for every edge
+			int64 spanMinX = minX;
+			int64 spanMaxX = maxX;
+			for(const auto& edge : primitive.edges)
+			{
+				int64 a = edge.a * 16;
+				int64 b = (edge.b * y * 16) + edge.c;
+				if(a > 0)
+				{
+					spanMinX = std::max(spanMinX, CeilDiv(-b, a));
+				}
+				else if(a < 0)
+				{
+					spanMaxX = std::min(spanMaxX, FloorDiv(b, -a));
+				}
+				else if(b < 0)
+				{
+					spanMaxX = spanMinX - 1;
+				}
+			}
+			if(spanMinX > spanMaxX) continue;
+			shadeSpan(y, static_cast<int32>(spanMinX), static_cast<int32>(spanMaxX + 1));
+		}
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
+void CGsRasterizer::FillSpan(const PRIMITIVE& primitive, int32 y, int32 x0, int32 x1)
+{
+	const auto& state = m_states[primitive.stateIndex];
+	uint32 color = 0;
+	for(unsigned int i = ATTRIBUTE_R; i <= ATTRIBUTE_A; i++)
+	{
+		float value = std::min(std::max(primitive.attributes[i].value, 0.f), 255.f);
+		color |= static_cast<uint32>(value) << (i * 8);
+	}
+	if(state.fba) color |= 0x80000000;
+
+	bool writeDepth = UsesDepthBuffer(state) && !state.zbufMask;
+	uint32 depth = InterpolateDepth(primitive.z, 0, 0, GetDepthMax(state.zbufPsm));
+	for(int32 x = x0; x < x1; x++)
+	{
+		WriteColor(m_ram, state, x, y, color, state.frameMask);
+		if(writeDepth)
+		{
+			WriteDepth(m_ram, state, x, y, depth);
+		}
+	}
+}
+
+template <typename Ops>
+void CGsRasterizer::ShadeSpan(const PRIMITIVE& primitive, int32 y, int32 x0, int32 x1)
+{
+	typedef typename Ops::FloatVector FloatVector;
+	typedef typename Ops::IntVector IntVector;
+
+	const auto& state = m_states[primitive.stateIndex];
+	bool indexedTexture = state.textureEnabled && CGsPixelFormats::IsPsmIDTEX(state.texturePsm);
+	const uint32* clut = indexedTexture ? m_cluts[state.clutIndex].data() : nullptr;
+
+	double relX = static_cast<double>(x0) - primitive.originX;
+	double relY = static_cast<double>(y) - primitive.originY;
+	FloatVector attributes[ATTRIBUTE_COUNT];
+	FloatVector attributeSteps[ATTRIBUTE_COUNT];
+	for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		const auto& plane = primitive.attributes[i];
+		attributes[i] = Ops::AddF(Ops::SplatF(EvaluatePlane(plane, relX, relY)), Ops::LoadF(plane.laneOffsets));
+		attributeSteps[i] = Ops::SplatF(plane.step);
+	}
+
+	bool usesDepth = UsesDepthBuffer(state);
+	bool readDepth = usesDepth && ((state.depthTestMethod == DEPTH_TEST_GEQUAL) || (state.depthTestMethod == DEPTH_TEST_GREATER));
+	bool destAlphaTest = state.destAlphaTestEnabled && !IsPsm24Bits(state.framePsm);
+	bool readColor = state.alphaBlendEnabled || destAlphaTest;
+	uint32 depthMax = GetDepthMax(state.zbufPsm);
+	double depthStart = primitive.z + (primitive.zdx * relX) + (primitive.zdy * relY);
+
+	auto byteMask = Ops::Splat(0xFF);
+
+	for(int32 x = x0; x < x1; x += LANE_COUNT)
+	{
+		int32 laneCount = std::min<int32>(LANE_COUNT, x1 - x);
+		bool active[LANE_COUNT] = {};
+		uint32 depths[LANE_COUNT] = {};
+		int32 destColors[LANE_COUNT] = {};
+		bool anyActive = false;
+		for(int32 lane = 0; lane < laneCount; lane++)
+		{
+			uint32 pixelX = x + lane;
+			if(usesDepth)
+			{
+				depths[lane] = InterpolateDepth(depthStart, primitive.zdx, (x - x0) + lane, depthMax);
+				uint32 bufferDepth = readDepth ? ReadDepth(m_ram, state, pixelX, y) : 0;
+				if(!DepthTest(state.depthTestMethod, depths[lane], bufferDepth)) continue;
+			}
+			if(readColor)
+			{
+				uint32 destColor = ReadColor(m_ram, state, pixelX, y);
+				if(destAlphaTest && ((destColor >> 31) != state.destAlphaTestMode)) continue;
+				destColors[lane] = static_cast<int32>(destColor);
+			}
+			active[lane] = true;
+			anyActive = true;
+		}
+
+		if(anyActive)
+		{
+			auto r = ColorToInt<Ops>(attributes[ATTRIBUTE_R]);
+			auto g = ColorToInt<Ops>(attributes[ATTRIBUTE_G]);
+			auto b = ColorToInt<Ops>(attributes[ATTRIBUTE_B]);
+			auto a = ColorToInt<Ops>(attributes[ATTRIBUTE_A]);
+
+			if(state.textureEnabled)
+			{
+				auto s = attributes[ATTRIBUTE_S];
+				auto t = attributes[ATTRIBUTE_T];
+				if(!state.textureUseUV)
+				{
+					s = Ops::MulF(Ops::DivF(s, attributes[ATTRIBUTE_Q]), Ops::SplatF(static_cast<float>(state.textureWidth)));
+					t = Ops::MulF(Ops::DivF(t, attributes[ATTRIBUTE_Q]), Ops::SplatF(static_cast<float>(state.textureHeight)));
+				}
+				int32 u[LANE_COUNT];
+				int32 v[LANE_COUNT];
+				Ops::Store(u, TexelToFixed<Ops>(s));
+				Ops::Store(v, TexelToFixed<Ops>(t));
+				int32 texels[LANE_COUNT] = {};
+				for(int32 lane = 0; lane < laneCount; lane++)
+				{
+					if(!active[lane]) continue;
+					texels[lane] = static_cast<int32>(SampleTexture(m_ram, state, clut, u[lane], v[lane]));
+				}
+
+				auto texel = Ops::Load(texels);
+				auto tr = Ops::And(texel, byteMask);
+				auto tg = Ops::And(Ops::ShiftRightLogical(texel, 8), byteMask);
+				auto tb = Ops::And(Ops::ShiftRightLogical(texel, 16), byteMask);
+				auto ta = Ops::ShiftRightLogical(texel, 24);
+				switch(state.textureFunction)
+				{
+				case TEX0_FUNCTION_MODULATE:
+				case TEX0_FUNCTION_HIGHLIGHT:
+				case TEX0_FUNCTION_HIGHLIGHT2:
+				{
+					auto highlight = (state.textureFunction == TEX0_FUNCTION_MODULATE) ? Ops::Splat(0) : a;
+					r = Ops::Min(Ops::Add(Ops::ShiftRightArithmetic(Ops::Mul16(r, tr), 7), highlight), byteMask);
+					g = Ops::Min(Ops::Add(Ops::ShiftRightArithmetic(Ops::Mul16(g, tg), 7), highlight), byteMask);
+					b = Ops::Min(Ops::Add(Ops::ShiftRightArithmetic(Ops::Mul16(b, tb), 7), highlight), byteMask);
+					if(state.textureHasAlpha)
+					{
+						switch(state.textureFunction)
+						{
+						case TEX0_FUNCTION_MODULATE:
+							a = Ops::Min(Ops::ShiftRightArithmetic(Ops::Mul16(a, ta), 7), byteMask);
+							break;
+						case TEX0_FUNCTION_HIGHLIGHT:
+							a = Ops::Min(Ops::Add(ta, a), byteMask);
+							break;
+						default:
+							a = ta;
+							break;
+						}
+					}
+				}
+				break;
+				case TEX0_FUNCTION_DECAL:
+				default:
+					r = tr;
+					g = tg;
+					b = tb;
+					if(state.textureHasAlpha) a = ta;
+					break;
+				}
+			}
+
+			if(state.fogEnabled)
+			{
+				auto fog = ColorToInt<Ops>(attributes[ATTRIBUTE_FOG]);
+				auto inverseFog = Ops::Sub(byteMask, fog);
+				r = Ops::ShiftRightArithmetic(Ops::Add(Ops::Mul16(fog, r), Ops::Mul16(inverseFog, Ops::Splat((state.fogColor >> 0) & 0xFF))), 8);
+				g = Ops::ShiftRightArithmetic(Ops::Add(Ops::Mul16(fog, g), Ops::Mul16(inverseFog, Ops::Splat((state.fogColor >> 8) & 0xFF))), 8);
+				b = Ops::ShiftRightArithmetic(Ops::Add(Ops::Mul16(fog, b), Ops::Mul16(inverseFog, Ops::Splat((state.fogColor >> 16) & 0xFF))), 8);
+			}
+
+			auto alphaPass = state.alphaTestEnabled ? AlphaTest<Ops>(state.alphaTestMethod, a, state.alphaTestRef) : Ops::Splat(-1);
+
+			if(state.alphaBlendEnabled)
+			{
+				auto destColor = Ops::Load(destColors);
+				auto dr = Ops::And(destColor, byteMask);
+				auto dg = Ops::And(Ops::ShiftRightLogical(destColor, 8), byteMask);
+				auto db = Ops::And(Ops::ShiftRightLogical(destColor, 16), byteMask);
+				auto da = Ops::ShiftRightLogical(destColor, 24);
+				auto blendAlpha = SelectBlendAlpha<Ops>(state.alphaBlendC, a, da, state.alphaBlendFix);
+				IntVector blended[3];
+				IntVector sources[3] = {r, g, b};
+				IntVector dests[3] = {dr, dg, db};
+				for(unsigned int i = 0; i < 3; i++)
+				{
+					auto colorA = SelectBlendColor<Ops>(state.alphaBlendA, sources[i], dests[i]);
+					auto colorB = SelectBlendColor<Ops>(state.alphaBlendB, sources[i], dests[i]);
+					auto colorD = SelectBlendColor<Ops>(state.alphaBlendD, sources[i], dests[i]);
+					auto result = Ops::Add(Ops::ShiftRightArithmetic(Ops::Mul16(Ops::Sub(colorA, colorB), blendAlpha), 7), colorD);
+					if(state.colClamp)
+					{
+						result = Ops::Min(Ops::Max(result, Ops::Splat(0)), byteMask);
+					}
+					else
+					{
+						result = Ops::And(result, byteMask);
+					}
+					if(state.pabe)
+					{
+						//Only blend pixels with the MSB of alpha set
+						result = Ops::Select(Ops::CmpGt(a, Ops::Splat(0x7F)), result, sources[i]);
+					}
+					blended[i] = result;
+				}
+				r = blended[0];
+				g = blended[1];
+				b = blended[2];
+			}
+
+			if(state.fba)
+			{
+				a = Ops::Or(a, Ops::Splat(0x80));
+			}
+
+			auto color = Ops::Or(Ops::Or(r, Ops::ShiftLeft(g, 8)), Ops::Or(Ops::ShiftLeft(b, 16), Ops::ShiftLeft(a, 24)));
+			int32 colors[LANE_COUNT];
+			int32 alphaPasses[LANE_COUNT];
+			Ops::Store(colors, color);
+			Ops::Store(alphaPasses, alphaPass);
+
+			for(int32 lane = 0; lane < laneCount; lane++)
+			{
+				if(!active[lane]) continue;
+				uint32 pixelX = x + lane;
+				bool writeColor = true;
+				bool writeDepth = usesDepth && !state.zbufMask;
+				uint32 colorMask = state.frameMask;
+				if(!alphaPasses[lane])
+				{
+					switch(state.alphaTestFail)
+					{
+					case ALPHA_TEST_FAIL_KEEP:
+						writeColor = false;
+						writeDepth = false;
+						break;
+					case ALPHA_TEST_FAIL_FBONLY:
+						writeDepth = false;
+						break;
+					case ALPHA_TEST_FAIL_ZBONLY:
+						writeColor = false;
+						break;
+					case ALPHA_TEST_FAIL_RGBONLY:
+						writeDepth = false;
+						colorMask |= 0xFF000000;
+						break;
+					}
+				}
+				if(writeColor)
+				{
+					WriteColor(m_ram, state, pixelX, y, static_cast<uint32>(colors[lane]), colorMask);
+				}
+				if(writeDepth)
+				{
+					WriteDepth(m_ram, state, pixelX, y, depths[lane]);
+				}
+			}
+		}
+
+		for(unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+		{
+			attributes[i] = Ops::AddF(attributes[i], attributeSteps[i]);
+		}
+	}
+}
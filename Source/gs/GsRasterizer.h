@@ -0,0 +1,274 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Types.h"
+#include "../Profiler.h"
+
+//Software rasterizer working directly on GS memory. Primitives are set up and binned into screen tiles
+//when they are drawn, tiles are rasterized in parallel by a pool of workers when the batch is flushed.
+//Primitives of a batch share the same render target, a tile only touches memory that belongs to it.
+//Pixels of a span are shaded 4 at a time, with SIMD instructions when they are available. The scalar
+//version is kept as reference and gives the same results. Mipmapping and dithering aren't supported.
+class CGsRasterizer
+{
+public:
+	enum
+	{
+		TILE_WIDTH = 64,
+		TILE_HEIGHT = 32,
+		TILE_COUNT_X = 2048 / TILE_WIDTH,
+		TILE_COUNT_Y = 2048 / TILE_HEIGHT,
+		MAX_PRIMITIVE_COUNT = 0x4000,
+		CLUT_ENTRY_COUNT = 256,
+	};
+
+	enum SPAN_SET
+	{
+		SPAN_SET_SCALAR,
+		SPAN_SET_SIMD,
+	};
+
+	//Values are encoded like the fields of the GS registers they come from
+	struct STATE
+	{
+		uint32 frameBufPtr = 0;
+		uint32 frameBufWidth = 0;
+		uint32 framePsm = 0;
+		uint32 frameMask = 0;
+
+		uint32 zbufPtr = 0;
+		uint32 zbufPsm = 0;
+		uint32 zbufMask = 0;
+
+		uint32 scissorX0 = 0;
+		uint32 scissorY0 = 0;
+		uint32 scissorX1 = 0;
+		uint32 scissorY1 = 0;
+
+		uint32 alphaTestEnabled = 0;
+		uint32 alphaTestMethod = 0;
+		uint32 alphaTestRef = 0;
+		uint32 alphaTestFail = 0;
+		uint32 destAlphaTestEnabled = 0;
+		uint32 destAlphaTestMode = 0;
+		uint32 depthTestEnabled = 0;
+		uint32 depthTestMethod = 0;
+
+		uint32 alphaBlendEnabled = 0;
+		uint32 alphaBlendA = 0;
+		uint32 alphaBlendB = 0;
+		uint32 alphaBlendC = 0;
+		uint32 alphaBlendD = 0;
+		uint32 alphaBlendFix = 0;
+		uint32 pabe = 0;
+		uint32 fba = 0;
+		uint32 colClamp = 0;
+
+		uint32 gouraudShading = 0;
+		uint32 fogEnabled = 0;
+		uint32 fogColor = 0;
+
+		uint32 textureEnabled = 0;
+		uint32 textureUseUV = 0;
+		uint32 textureBufPtr = 0;
+		uint32 textureBufWidth = 0;
+		uint32 texturePsm = 0;
+		uint32 textureWidth = 0;
+		uint32 textureHeight = 0;
+		uint32 textureHasAlpha = 0;
+		uint32 textureFunction = 0;
+		uint32 textureLinearFilter = 0;
+		uint32 textureWrapModeU = 0;
+		uint32 textureWrapModeV = 0;
+		uint32 textureMinU = 0;
+		uint32 textureMaxU = 0;
+		uint32 textureMinV = 0;
+		uint32 textureMaxV = 0;
+		uint32 textureAlpha0 = 0;
+		uint32 textureAlpha1 = 0;
+		uint32 textureAlphaExpand = 0;
+
+		//Set by the rasterizer
+		uint32 clutIndex = 0;
+	};
+
+	struct VERTEX
+	{
+		//Window coordinates, 12.4 fixed point
+		int32 x = 0;
+		int32 y = 0;
+		uint32 z = 0;
+		uint8 r = 0;
+		uint8 g = 0;
+		uint8 b = 0;
+		uint8 a = 0;
+		//In texels when UV coordinates are used (q is 1 in that case)
+		float s = 0;
+		float t = 0;
+		float q = 1;
+		uint8 fog = 0;
+	};
+
+	CGsRasterizer(uint8*);
+	virtual ~CGsRasterizer();
+
+	CGsRasterizer(const CGsRasterizer&) = delete;
+	CGsRasterizer& operator=(const CGsRasterizer&) = delete;
+
+	static bool IsSimdSupported();
+	void SetSpanSet(SPAN_SET);
+
+	void SetWorkerCount(unsigned int);
+	unsigned int GetWorkerCount() const;
+
+	//Following primitives will use this state. CLUT (linear, 32-bit colors) is required for indexed textures.
+	//Batch is flushed first if the render target changes or if the texture is rendered to by the batch.
+	void SetState(const STATE&, const uint32* = nullptr);
+	void DrawPoint(const VERTEX&);
+	void DrawLine(const VERTEX&, const VERTEX&);
+	void DrawTriangle(const VERTEX&, const VERTEX&, const VERTEX&);
+	void DrawSprite(const VERTEX&, const VERTEX&);
+
+	bool IsEmpty() const;
+	//Tells if a memory range might be written by the primitives of the batch
+	bool IsRangeWritten(uint32, uint32) const;
+	void Flush();
+	void Clear();
+
+private:
+	enum ATTRIBUTE
+	{
+		ATTRIBUTE_R,
+		ATTRIBUTE_G,
+		ATTRIBUTE_B,
+		ATTRIBUTE_A,
+		ATTRIBUTE_S,
+		ATTRIBUTE_T,
+		ATTRIBUTE_Q,
+		ATTRIBUTE_FOG,
+		ATTRIBUTE_COUNT,
+	};
+
+	enum PRIMITIVE_TYPE
+	{
+		PRIMITIVE_TYPE_POINT,
+		PRIMITIVE_TYPE_LINE,
+		PRIMITIVE_TYPE_TRIANGLE,
+		PRIMITIVE_TYPE_SPRITE,
+	};
+
+	enum
+	{
+		LANE_COUNT = 4,
+		EDGE_COUNT = 3,
+	};
+
+	//Attribute values are obtained with value + dx * (x - originX) + dy * (y - originY). Lanes are
+	//stepped with additions only, this keeps SIMD and scalar results identical.
+	struct PLANE
+	{
+		float value;
+		float dx;
+		float dy;
+		float laneOffsets[LANE_COUNT];
+		float step;
+	};
+
+	struct EDGE
+	{
+		//Pixel is covered if a * x + b * y + c >= 0, coordinates in 1/16th of pixel
+		int64 a;
+		int64 b;
+		int64 c;
+	};
+
+	struct PRIMITIVE
+	{
+		uint32 type;
+		uint32 stateIndex;
+		//Covered pixels, inclusive and clipped to the scissor
+		int32 minX;
+		int32 minY;
+		int32 maxX;
+		int32 maxY;
+		float originX;
+		float originY;
+		PLANE attributes[ATTRIBUTE_COUNT];
+		double z;
+		double zdx;
+		double zdy;
+		EDGE edges[EDGE_COUNT];
+		//Lines: first pixel, steps on the major axis and on the minor axis (16.16 fixed point), pixel count
+		int32 lineX;
+		int32 lineY;
+		int32 lineMajorStep;
+		int32 lineMinorStep;
+		int32 lineLength;
+		uint32 lineXMajor;
+		//Constant color, no per-pixel operation other than the writes
+		uint32 solidFill;
+	};
+
+	struct MEMORY_RANGE
+	{
+		uint32 start = 0;
+		uint32 end = 0;
+	};
+
+	typedef std::vector<uint32> TileBin;
+	typedef std::array<uint32, CLUT_ENTRY_COUNT> Clut;
+	typedef void (CGsRasterizer::*ShadeSpanFunction)(const PRIMITIVE&, int32, int32, int32);
+
+	static MEMORY_RANGE GetBufferRange(uint32, uint32, uint32, uint32);
+	static bool RangesIntersect(const MEMORY_RANGE&, const MEMORY_RANGE&);
+	static bool UsesDepthBuffer(const STATE&);
+	static void SetupPlane(PLANE&, float, float, float);
+	static float EvaluatePlane(const PLANE&, double, double);
+
+	bool ClipToScissor(PRIMITIVE&) const;
+	void AddPrimitive(PRIMITIVE&);
+	void ResetBatch();
+	bool IsTileCovered(const PRIMITIVE&, uint32, uint32) const;
+
+	void StartWorkers(unsigned int);
+	void StopWorkers();
+	void WorkerThreadProc(unsigned int, uint32);
+	void RasterizeTiles();
+	void RasterizePrimitive(const PRIMITIVE&, int32, int32, int32, int32);
+
+	template <typename Ops>
+	void ShadeSpan(const PRIMITIVE&, int32, int32, int32);
+	void FillSpan(const PRIMITIVE&, int32, int32, int32);
+
+	uint8* m_ram = nullptr;
+	ShadeSpanFunction m_shadeSpan = nullptr;
+
+	//Batch
+	std::vector<STATE> m_states;
+	std::vector<Clut> m_cluts;
+	std::vector<PRIMITIVE> m_primitives;
+	TileBin m_tileBins[TILE_COUNT_X * TILE_COUNT_Y];
+	std::vector<uint32> m_activeTiles;
+	MEMORY_RANGE m_frameRange;
+	MEMORY_RANGE m_zbufRange;
+	bool m_zbufUsed = false;
+	//Rasterize primitives one after the other when tiles could write to each other's memory
+	bool m_serial = false;
+	bool m_stateValid = false;
+
+	//Workers
+	std::vector<std::thread> m_workers;
+	std::mutex m_workerMutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_workDone;
+	uint32 m_workGeneration = 0;
+	uint32 m_busyWorkerCount = 0;
+	bool m_workerTerminate = false;
+	std::atomic<uint32> m_nextTile;
+	CProfiler::ZoneHandle m_profilerZone = 0;
+};
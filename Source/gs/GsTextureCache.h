@@ -1,11 +1,17 @@
 #pragma once
 
-#include <list>
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include "GSHandler.h"
 #include "GsCachedArea.h"
+#include "GsPixelFormats.h"
 
 #define TEX0_CLUTINFO_MASK (~0xFFFFFFE000000000ULL)
 
+//Textures are looked up through an open addressing hash table keyed by masked TEX0 and are
+//kept in an intrusive LRU list. A page to texture index allows transfers to only invalidate
+//textures that overlap the GS pages that were written to.
 template <typename TextureHandleType>
 class CGsTextureCache
 {
@@ -26,6 +32,17 @@ public:
 
 		//Platform specific
 		TextureHandleType m_textureHandle;
+
+	private:
+		friend class CGsTextureCache;
+
+		//LRU list links
+		uint32 m_prev = 0;
+		uint32 m_next = 0;
+
+		//Range of GS pages covered by this texture
+		uint32 m_pageStart = 0;
+		uint32 m_pageEnd = 0;
 	};
 
 	enum
@@ -35,60 +52,262 @@ public:
 
 	CGsTextureCache()
 	{
-		for(unsigned int i = 0; i < MAX_TEXTURE_CACHE; i++)
+		m_hashTable.fill(EMPTY_SLOT);
+		for(auto& pageTextures : m_pageTextures)
+		{
+			pageTextures.fill(0);
+		}
+		for(uint32 i = 0; i < MAX_TEXTURE_CACHE; i++)
 		{
-			m_textureCache.push_back(std::make_shared<CTexture>());
+			m_textures[i].m_prev = (i + MAX_TEXTURE_CACHE - 1) % MAX_TEXTURE_CACHE;
+			m_textures[i].m_next = (i + 1) % MAX_TEXTURE_CACHE;
 		}
+		m_head = 0;
 	}
 
 	CTexture* Search(const CGSHandler::TEX0& tex0)
 	{
 		uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
 
-		for(auto textureIterator(m_textureCache.begin());
-		    textureIterator != m_textureCache.end(); textureIterator++)
-		{
-			auto texture = *textureIterator;
-			if(!texture->m_live) continue;
-			if(maskedTex0 != texture->m_tex0) continue;
-			m_textureCache.erase(textureIterator);
-			m_textureCache.push_front(texture);
-			return texture.get();
-		}
+		uint32 slot = FindSlot(maskedTex0);
+		if(slot == EMPTY_SLOT) return nullptr;
 
-		return nullptr;
+		uint32 textureIndex = m_hashTable[slot];
+		MoveToFront(textureIndex);
+		return &m_textures[textureIndex];
 	}
 
 	void Insert(const CGSHandler::TEX0& tex0, TextureHandleType textureHandle)
 	{
-		auto texture = *m_textureCache.rbegin();
-		texture->Reset();
+		uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
+
+		//Replace any texture already registered with the same key
+		uint32 existingSlot = FindSlot(maskedTex0);
+		if(existingSlot != EMPTY_SLOT)
+		{
+			uint32 existingIndex = m_hashTable[existingSlot];
+			Evict(existingIndex);
+			MoveToBack(existingIndex);
+		}
+
+		//Least recently used texture is at the back of the list
+		uint32 textureIndex = m_textures[m_head].m_prev;
+		Evict(textureIndex);
+
+		auto& texture = m_textures[textureIndex];
+		texture.Reset();
 
-		texture->m_cachedArea.SetArea(tex0.nPsm, tex0.GetBufPtr(), tex0.GetBufWidth(), tex0.GetHeight());
+		texture.m_cachedArea.SetArea(tex0.nPsm, tex0.GetBufPtr(), tex0.GetBufWidth(), tex0.GetHeight());
 
-		texture->m_tex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
-		texture->m_textureHandle = std::move(textureHandle);
-		texture->m_live = true;
+		texture.m_tex0 = maskedTex0;
+		texture.m_textureHandle = std::move(textureHandle);
+		texture.m_live = true;
 
-		m_textureCache.pop_back();
-		m_textureCache.push_front(texture);
+		AddToHashTable(textureIndex);
+		AddToPageIndex(textureIndex);
+		MoveToFront(textureIndex);
 	}
 
 	void InvalidateRange(uint32 start, uint32 size)
 	{
-		std::for_each(std::begin(m_textureCache), std::end(m_textureCache),
-		              [start, size](TexturePtr& texture) { if(texture->m_live) { texture->m_cachedArea.Invalidate(start, size); } });
+		uint32 pageStart = 0, pageEnd = 0;
+		GetPageRange(start, size, pageStart, pageEnd);
+
+		TextureBitSet textures = {};
+		for(uint32 pageIndex = pageStart; pageIndex < pageEnd; pageIndex++)
+		{
+			const auto& pageTextures = m_pageTextures[pageIndex];
+			for(uint32 i = 0; i < TEXTURE_BITSET_SIZE; i++)
+			{
+				textures[i] |= pageTextures[i];
+			}
+		}
+
+		for(uint32 i = 0; i < TEXTURE_BITSET_SIZE; i++)
+		{
+			auto textureBits = textures[i];
+			for(uint32 bitIndex = 0; textureBits != 0; bitIndex++, textureBits >>= 1)
+			{
+				if((textureBits & 1) == 0) continue;
+				auto& texture = m_textures[(i * 64) + bitIndex];
+				assert(texture.m_live);
+				texture.m_cachedArea.Invalidate(start, size);
+			}
+		}
 	}
 
 	void Flush()
 	{
-		std::for_each(std::begin(m_textureCache), std::end(m_textureCache),
-		              [](TexturePtr& texture) { texture->Reset(); });
+		for(auto& texture : m_textures)
+		{
+			texture.Reset();
+		}
+		m_hashTable.fill(EMPTY_SLOT);
+		for(auto& pageTextures : m_pageTextures)
+		{
+			pageTextures.fill(0);
+		}
 	}
 
 private:
-	typedef std::shared_ptr<CTexture> TexturePtr;
-	typedef std::list<TexturePtr> TextureList;
+	enum
+	{
+		HASH_TABLE_SIZE = MAX_TEXTURE_CACHE * 2,
+		EMPTY_SLOT = ~0U,
+		PAGE_COUNT = CGSHandler::RAMSIZE / CGsPixelFormats::PAGESIZE,
+		TEXTURE_BITSET_SIZE = MAX_TEXTURE_CACHE / 64,
+	};
+	static_assert((HASH_TABLE_SIZE & (HASH_TABLE_SIZE - 1)) == 0, "Hash table size must be a power of 2.");
+	static_assert((MAX_TEXTURE_CACHE % 64) == 0, "Texture count must be a multiple of 64.");
+
+	typedef std::array<uint64, TEXTURE_BITSET_SIZE> TextureBitSet;
+
+	//Addresses beyond the end of GS RAM are folded in the last page, which makes
+	//the page ranges of any two overlapping memory ranges overlap
+	static void GetPageRange(uint32 start, uint32 size, uint32& pageStart, uint32& pageEnd)
+	{
+		if(size == 0)
+		{
+			pageStart = pageEnd = 0;
+			return;
+		}
+		uint64 end = static_cast<uint64>(start) + size;
+		pageStart = std::min<uint32>(start / CGsPixelFormats::PAGESIZE, PAGE_COUNT - 1);
+		pageEnd = static_cast<uint32>(std::min<uint64>((end + CGsPixelFormats::PAGESIZE - 1) / CGsPixelFormats::PAGESIZE, PAGE_COUNT));
+		pageEnd = std::max<uint32>(pageEnd, pageStart + 1);
+	}
+
+	static uint32 GetHomeSlot(uint64 maskedTex0)
+	{
+		//Fibonacci hashing, keep the top bits
+		uint64 hash = maskedTex0 * 0x9E3779B97F4A7C15ULL;
+		return static_cast<uint32>(hash >> 32) & (HASH_TABLE_SIZE - 1);
+	}
+
+	uint32 FindSlot(uint64 maskedTex0) const
+	{
+		uint32 slot = GetHomeSlot(maskedTex0);
+		while(true)
+		{
+			uint32 textureIndex = m_hashTable[slot];
+			if(textureIndex == EMPTY_SLOT) return EMPTY_SLOT;
+			if(m_textures[textureIndex].m_tex0 == maskedTex0) return slot;
+			slot = (slot + 1) & (HASH_TABLE_SIZE - 1);
+		}
+	}
+
+	void AddToHashTable(uint32 textureIndex)
+	{
+		uint32 slot = GetHomeSlot(m_textures[textureIndex].m_tex0);
+		while(m_hashTable[slot] != EMPTY_SLOT)
+		{
+			slot = (slot + 1) & (HASH_TABLE_SIZE - 1);
+		}
+		m_hashTable[slot] = textureIndex;
+	}
+
+	void RemoveFromHashTable(uint32 textureIndex)
+	{
+		uint32 slot = GetHomeSlot(m_textures[textureIndex].m_tex0);
+		while(m_hashTable[slot] != textureIndex)
+		{
+			assert(m_hashTable[slot] != EMPTY_SLOT);
+			slot = (slot + 1) & (HASH_TABLE_SIZE - 1);
+		}
+		m_hashTable[slot] = EMPTY_SLOT;
+
+		//Shift following entries back to fill the hole, this avoids the need for tombstones
+		uint32 holeSlot = slot;
+		uint32 nextSlot = slot;
+		while(true)
+		{
+			nextSlot = (nextSlot + 1) & (HASH_TABLE_SIZE - 1);
+			uint32 nextIndex = m_hashTable[nextSlot];
+			if(nextIndex == EMPTY_SLOT) break;
+			uint32 homeSlot = GetHomeSlot(m_textures[nextIndex].m_tex0);
+			//Entry can be moved if its home slot isn't cyclically within (holeSlot, nextSlot]
+			uint32 homeDistance = (nextSlot - homeSlot) & (HASH_TABLE_SIZE - 1);
+			uint32 holeDistance = (nextSlot - holeSlot) & (HASH_TABLE_SIZE - 1);
+			if(homeDistance >= holeDistance)
+			{
+				m_hashTable[holeSlot] = nextIndex;
+				m_hashTable[nextSlot] = EMPTY_SLOT;
+				holeSlot = nextSlot;
+			}
+		}
+	}
+
+	void AddToPageIndex(uint32 textureIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		GetPageRange(texture.m_cachedArea.GetBufPtr(), texture.m_cachedArea.GetSize(), texture.m_pageStart, texture.m_pageEnd);
+		uint64 textureBit = 1ULL << (textureIndex % 64);
+		for(uint32 pageIndex = texture.m_pageStart; pageIndex < texture.m_pageEnd; pageIndex++)
+		{
+			m_pageTextures[pageIndex][textureIndex / 64] |= textureBit;
+		}
+	}
+
+	void RemoveFromPageIndex(uint32 textureIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		uint64 textureBit = 1ULL << (textureIndex % 64);
+		for(uint32 pageIndex = texture.m_pageStart; pageIndex < texture.m_pageEnd; pageIndex++)
+		{
+			m_pageTextures[pageIndex][textureIndex / 64] &= ~textureBit;
+		}
+		texture.m_pageStart = 0;
+		texture.m_pageEnd = 0;
+	}
+
+	void Evict(uint32 textureIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		if(!texture.m_live) return;
+		RemoveFromHashTable(textureIndex);
+		RemoveFromPageIndex(textureIndex);
+		texture.Reset();
+	}
+
+	void Unlink(uint32 textureIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		m_textures[texture.m_prev].m_next = texture.m_next;
+		m_textures[texture.m_next].m_prev = texture.m_prev;
+	}
+
+	void LinkBefore(uint32 textureIndex, uint32 nextIndex)
+	{
+		auto& texture = m_textures[textureIndex];
+		auto& nextTexture = m_textures[nextIndex];
+		texture.m_next = nextIndex;
+		texture.m_prev = nextTexture.m_prev;
+		m_textures[nextTexture.m_prev].m_next = textureIndex;
+		nextTexture.m_prev = textureIndex;
+	}
+
+	void MoveToFront(uint32 textureIndex)
+	{
+		if(textureIndex == m_head) return;
+		Unlink(textureIndex);
+		LinkBefore(textureIndex, m_head);
+		m_head = textureIndex;
+	}
+
+	void MoveToBack(uint32 textureIndex)
+	{
+		//List is circular, back is the element before head
+		if(textureIndex == m_head)
+		{
+			m_head = m_textures[m_head].m_next;
+			return;
+		}
+		Unlink(textureIndex);
+		LinkBefore(textureIndex, m_head);
+	}
 
-	TextureList m_textureCache;
+	std::array<CTexture, MAX_TEXTURE_CACHE> m_textures;
+	std::array<uint32, HASH_TABLE_SIZE> m_hashTable;
+	std::array<TextureBitSet, PAGE_COUNT> m_pageTextures;
+	uint32 m_head = 0;
 };
@@ -0,0 +1,531 @@
+#include <cassert>
+#include "GsTransferKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAS_SSE2) || defined(HAS_NEON)
+#define HAS_SIMD
+#endif
+
+typedef CGsPixelFormats::STORAGEPSMCT32 STORAGEPSMCT32;
+typedef CGsPixelFormats::STORAGEPSMCT16 STORAGEPSMCT16;
+typedef CGsPixelFormats::STORAGEPSMT8 STORAGEPSMT8;
+typedef CGsPixelFormats::STORAGEPSMT4 STORAGEPSMT4;
+
+//Every block is made of 4 columns
+#define COLUMN_COUNT (4)
+
+//////////////////////////////////////////////
+//Scalar kernels
+
+//Offset of every pixel of a block relative to the start of the block (in nibbles for PSMT4, in bytes otherwise)
+template <typename Storage>
+struct BLOCKOFFSETS
+{
+	BLOCKOFFSETS()
+	{
+		for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+		{
+			for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+			{
+				uint32 columnNum = y / Storage::COLUMNHEIGHT;
+				uint32 columnY = y % Storage::COLUMNHEIGHT;
+				offsets[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE) + sizeof(typename Storage::Unit) * Storage::m_nColumnSwizzleTable[columnY][x];
+			}
+		}
+	}
+
+	uint32 offsets[Storage::BLOCKHEIGHT][Storage::BLOCKWIDTH];
+};
+
+template <>
+BLOCKOFFSETS<STORAGEPSMT8>::BLOCKOFFSETS()
+{
+	typedef STORAGEPSMT8 Storage;
+	for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage::COLUMNHEIGHT;
+			uint32 columnY = y % Storage::COLUMNHEIGHT;
+			uint32 table = ((columnY & 0x02) >> 1) ^ (columnNum & 1);
+			uint32 byte = ((x & 0x08) >> 2) + ((columnY & 0x02) >> 1);
+			offsets[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE) + (Storage::m_nColumnWordTable[table][columnY & 1][x & 7] * 4) + byte;
+		}
+	}
+}
+
+template <>
+BLOCKOFFSETS<STORAGEPSMT4>::BLOCKOFFSETS()
+{
+	typedef STORAGEPSMT4 Storage;
+	for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage::COLUMNHEIGHT;
+			uint32 columnY = y % Storage::COLUMNHEIGHT;
+			uint32 table = ((columnY & 0x02) >> 1) ^ (columnNum & 1);
+			uint32 nibble = ((x & 0x18) >> 2) + ((columnY & 0x02) >> 1);
+			offsets[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE * 2) + (Storage::m_nColumnWordTable[table][columnY & 1][x & 7] * 8) + nibble;
+		}
+	}
+}
+
+template <typename Storage>
+static const BLOCKOFFSETS<Storage>& GetBlockOffsets()
+{
+	static const BLOCKOFFSETS<Storage> blockOffsets;
+	return blockOffsets;
+}
+
+template <typename Storage>
+static bool WriteBlockScalar(uint8* block, const uint8* src, uint32 srcStride)
+{
+	typedef typename Storage::Unit Unit;
+	const auto& blockOffsets = GetBlockOffsets<Storage>();
+	bool dirty = false;
+	for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+	{
+		auto srcRow = reinterpret_cast<const Unit*>(src + (y * srcStride));
+		for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+		{
+			auto pixel = reinterpret_cast<Unit*>(block + blockOffsets.offsets[y][x]);
+			if((*pixel) != srcRow[x])
+			{
+				(*pixel) = srcRow[x];
+				dirty = true;
+			}
+		}
+	}
+	return dirty;
+}
+
+template <>
+bool WriteBlockScalar<STORAGEPSMT4>(uint8* block, const uint8* src, uint32 srcStride)
+{
+	typedef STORAGEPSMT4 Storage;
+	const auto& blockOffsets = GetBlockOffsets<Storage>();
+	bool dirty = false;
+	for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+	{
+		auto srcRow = src + (y * srcStride);
+		for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+		{
+			uint8 srcPixel = (srcRow[x / 2] >> ((x & 1) * 4)) & 0x0F;
+			uint32 nibble = blockOffsets.offsets[y][x];
+			uint8& dstByte = block[nibble / 2];
+			uint32 shiftAmount = (nibble & 1) * 4;
+			if(((dstByte >> shiftAmount) & 0x0F) != srcPixel)
+			{
+				dstByte &= ~(0x0F << shiftAmount);
+				dstByte |= (srcPixel << shiftAmount);
+				dirty = true;
+			}
+		}
+	}
+	return dirty;
+}
+
+template <typename Storage>
+static void ReadBlockScalar(uint8* dst, uint32 dstStride, const uint8* block)
+{
+	typedef typename Storage::Unit Unit;
+	const auto& blockOffsets = GetBlockOffsets<Storage>();
+	for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+	{
+		auto dstRow = reinterpret_cast<Unit*>(dst + (y * dstStride));
+		for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+		{
+			dstRow[x] = *reinterpret_cast<const Unit*>(block + blockOffsets.offsets[y][x]);
+		}
+	}
+}
+
+//////////////////////////////////////////////
+//SIMD kernels
+
+#ifdef HAS_SIMD
+
+//Small set of operations used by the kernels, implemented for every supported instruction set
+#if defined(HAS_SSE2)
+
+typedef __m128i Vector;
+
+static inline Vector Load(const uint8* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline void Store(uint8* dst, Vector value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+// clang-format off
+static inline Vector InterleaveLo8(Vector a, Vector b) { return _mm_unpacklo_epi8(a, b); }
+static inline Vector InterleaveHi8(Vector a, Vector b) { return _mm_unpackhi_epi8(a, b); }
+static inline Vector InterleaveLo16(Vector a, Vector b) { return _mm_unpacklo_epi16(a, b); }
+static inline Vector InterleaveHi16(Vector a, Vector b) { return _mm_unpackhi_epi16(a, b); }
+static inline Vector InterleaveLo64(Vector a, Vector b) { return _mm_unpacklo_epi64(a, b); }
+static inline Vector InterleaveHi64(Vector a, Vector b) { return _mm_unpackhi_epi64(a, b); }
+static inline Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+static inline Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+static inline Vector Zero() { return _mm_setzero_si128(); }
+// clang-format on
+
+static inline Vector DeinterleaveEven8(Vector a, Vector b)
+{
+	auto mask = _mm_set1_epi16(0x00FF);
+	return _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+}
+
+static inline Vector DeinterleaveOdd8(Vector a, Vector b)
+{
+	return _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+static inline Vector DeinterleaveEven16(Vector a, Vector b)
+{
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+static inline Vector DeinterleaveOdd16(Vector a, Vector b)
+{
+	return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+//Swaps 32-bit elements inside every 64-bit element
+static inline Vector SwapWordPairs(Vector value)
+{
+	return _mm_shuffle_epi32(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline Vector LowNibbles(Vector value)
+{
+	return _mm_and_si128(value, _mm_set1_epi8(0x0F));
+}
+
+static inline Vector HighNibbles(Vector value)
+{
+	return _mm_and_si128(_mm_srli_epi16(value, 4), _mm_set1_epi8(0x0F));
+}
+
+//Both inputs must only contain values in the [0, 15] range
+static inline Vector CombineNibbles(Vector lo, Vector hi)
+{
+	return _mm_or_si128(lo, _mm_slli_epi16(hi, 4));
+}
+
+static inline bool IsZero(Vector value)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(value, _mm_setzero_si128())) == 0xFFFF;
+}
+
+#elif defined(HAS_NEON)
+
+typedef uint8x16_t Vector;
+
+static inline Vector Load(const uint8* src)
+{
+	return vld1q_u8(src);
+}
+
+static inline void Store(uint8* dst, Vector value)
+{
+	vst1q_u8(dst, value);
+}
+
+// clang-format off
+static inline Vector InterleaveLo8(Vector a, Vector b) { return vzipq_u8(a, b).val[0]; }
+static inline Vector InterleaveHi8(Vector a, Vector b) { return vzipq_u8(a, b).val[1]; }
+static inline Vector InterleaveLo16(Vector a, Vector b) { return vreinterpretq_u8_u16(vzipq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[0]); }
+static inline Vector InterleaveHi16(Vector a, Vector b) { return vreinterpretq_u8_u16(vzipq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[1]); }
+static inline Vector InterleaveLo64(Vector a, Vector b) { return vcombine_u8(vget_low_u8(a), vget_low_u8(b)); }
+static inline Vector InterleaveHi64(Vector a, Vector b) { return vcombine_u8(vget_high_u8(a), vget_high_u8(b)); }
+static inline Vector Or(Vector a, Vector b) { return vorrq_u8(a, b); }
+static inline Vector Xor(Vector a, Vector b) { return veorq_u8(a, b); }
+static inline Vector Zero() { return vdupq_n_u8(0); }
+static inline Vector DeinterleaveEven8(Vector a, Vector b) { return vuzpq_u8(a, b).val[0]; }
+static inline Vector DeinterleaveOdd8(Vector a, Vector b) { return vuzpq_u8(a, b).val[1]; }
+static inline Vector DeinterleaveEven16(Vector a, Vector b) { return vreinterpretq_u8_u16(vuzpq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[0]); }
+static inline Vector DeinterleaveOdd16(Vector a, Vector b) { return vreinterpretq_u8_u16(vuzpq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)).val[1]); }
+static inline Vector SwapWordPairs(Vector value) { return vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(value))); }
+static inline Vector LowNibbles(Vector value) { return vandq_u8(value, vdupq_n_u8(0x0F)); }
+static inline Vector HighNibbles(Vector value) { return vshrq_n_u8(value, 4); }
+static inline Vector CombineNibbles(Vector lo, Vector hi) { return vorrq_u8(lo, vshlq_n_u8(hi, 4)); }
+// clang-format on
+
+static inline bool IsZero(Vector value)
+{
+	auto value64 = vreinterpretq_u64_u8(value);
+	return (vgetq_lane_u64(value64, 0) | vgetq_lane_u64(value64, 1)) == 0;
+}
+
+#endif
+
+//Stores a column (64 bytes) and accumulates differences with its previous contents
+static inline void StoreColumn(uint8* column, const Vector (&values)[4], Vector& difference)
+{
+	for(uint32 i = 0; i < 4; i++)
+	{
+		auto address = column + (i * 0x10);
+		difference = Or(difference, Xor(Load(address), values[i]));
+		Store(address, values[i]);
+	}
+}
+
+static inline void LoadColumn(const uint8* column, Vector (&values)[4])
+{
+	for(uint32 i = 0; i < 4; i++)
+	{
+		values[i] = Load(column + (i * 0x10));
+	}
+}
+
+//PSMCT32 column is 8x2 pixels, pairs of pixels from both rows are alternated
+static bool WriteBlockPSMCT32Simd(uint8* block, const uint8* src, uint32 srcStride)
+{
+	auto difference = Zero();
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		auto row0 = src + (column * 2 * srcStride);
+		auto row1 = row0 + srcStride;
+		auto a0 = Load(row0), a1 = Load(row0 + 0x10);
+		auto b0 = Load(row1), b1 = Load(row1 + 0x10);
+		Vector values[4] =
+		    {
+		        InterleaveLo64(a0, b0),
+		        InterleaveHi64(a0, b0),
+		        InterleaveLo64(a1, b1),
+		        InterleaveHi64(a1, b1),
+		    };
+		StoreColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values, difference);
+	}
+	return !IsZero(difference);
+}
+
+static void ReadBlockPSMCT32Simd(uint8* dst, uint32 dstStride, const uint8* block)
+{
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		Vector values[4];
+		LoadColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values);
+		auto row0 = dst + (column * 2 * dstStride);
+		auto row1 = row0 + dstStride;
+		Store(row0, InterleaveLo64(values[0], values[1]));
+		Store(row0 + 0x10, InterleaveLo64(values[2], values[3]));
+		Store(row1, InterleaveHi64(values[0], values[1]));
+		Store(row1 + 0x10, InterleaveHi64(values[2], values[3]));
+	}
+}
+
+//PSMCT16 column is 16x2 pixels, pixels at x and x + 8 are paired, then pairs of pairs from both rows are alternated
+static bool WriteBlockPSMCT16Simd(uint8* block, const uint8* src, uint32 srcStride)
+{
+	auto difference = Zero();
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		auto row0 = src + (column * 2 * srcStride);
+		auto row1 = row0 + srcStride;
+		auto a = Load(row0), b = Load(row0 + 0x10);
+		auto c = Load(row1), d = Load(row1 + 0x10);
+		auto t0 = InterleaveLo16(a, b), t1 = InterleaveHi16(a, b);
+		auto u0 = InterleaveLo16(c, d), u1 = InterleaveHi16(c, d);
+		Vector values[4] =
+		    {
+		        InterleaveLo64(t0, u0),
+		        InterleaveHi64(t0, u0),
+		        InterleaveLo64(t1, u1),
+		        InterleaveHi64(t1, u1),
+		    };
+		StoreColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values, difference);
+	}
+	return !IsZero(difference);
+}
+
+//Interleaves two 16 byte rows into the 4 word layout used by PSMT8 and PSMT4 columns:
+//rowA's bytes land in the even positions of the words, rowB's in the odd ones
+static inline void InterleaveColumnRows8(Vector rowA, Vector rowB, Vector& lo, Vector& hi)
+{
+	auto p = InterleaveLo8(rowA, rowB);
+	auto q = InterleaveHi8(rowA, rowB);
+	lo = InterleaveLo16(p, q);
+	hi = InterleaveHi16(p, q);
+}
+
+static inline void DeinterleaveColumnRows8(Vector lo, Vector hi, Vector& rowA, Vector& rowB)
+{
+	auto p = DeinterleaveEven16(lo, hi);
+	auto q = DeinterleaveOdd16(lo, hi);
+	rowA = DeinterleaveEven8(p, q);
+	rowB = DeinterleaveOdd8(p, q);
+}
+
+//PSMT8 column is 16x4 pixels, every word holds 2 pixels from row 0 (or 1) and 2 pixels from row 2 (or 3).
+//Depending on the column, rows 0-1 or 2-3 are rotated by 4 pixels.
+static bool WriteBlockPSMT8Simd(uint8* block, const uint8* src, uint32 srcStride)
+{
+	auto difference = Zero();
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		auto rows = src + (column * 4 * srcStride);
+		Vector row[4] =
+		    {
+		        Load(rows),
+		        Load(rows + srcStride),
+		        Load(rows + (2 * srcStride)),
+		        Load(rows + (3 * srcStride)),
+		    };
+		uint32 rotatedRow = (column & 1) ? 0 : 2;
+		row[rotatedRow + 0] = SwapWordPairs(row[rotatedRow + 0]);
+		row[rotatedRow + 1] = SwapWordPairs(row[rotatedRow + 1]);
+
+		Vector evenLo, evenHi, oddLo, oddHi;
+		InterleaveColumnRows8(row[0], row[2], evenLo, evenHi);
+		InterleaveColumnRows8(row[1], row[3], oddLo, oddHi);
+		Vector values[4] =
+		    {
+		        InterleaveLo64(evenLo, oddLo),
+		        InterleaveHi64(evenLo, oddLo),
+		        InterleaveLo64(evenHi, oddHi),
+		        InterleaveHi64(evenHi, oddHi),
+		    };
+		StoreColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values, difference);
+	}
+	return !IsZero(difference);
+}
+
+static void ReadBlockPSMT8Simd(uint8* dst, uint32 dstStride, const uint8* block)
+{
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		Vector values[4];
+		LoadColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values);
+
+		Vector row[4];
+		DeinterleaveColumnRows8(InterleaveLo64(values[0], values[1]), InterleaveLo64(values[2], values[3]), row[0], row[2]);
+		DeinterleaveColumnRows8(InterleaveHi64(values[0], values[1]), InterleaveHi64(values[2], values[3]), row[1], row[3]);
+
+		uint32 rotatedRow = (column & 1) ? 0 : 2;
+		row[rotatedRow + 0] = SwapWordPairs(row[rotatedRow + 0]);
+		row[rotatedRow + 1] = SwapWordPairs(row[rotatedRow + 1]);
+
+		auto rows = dst + (column * 4 * dstStride);
+		for(uint32 i = 0; i < 4; i++)
+		{
+			Store(rows + (i * dstStride), row[i]);
+		}
+	}
+}
+
+//PSMT4 column is 32x4 pixels, it's laid out like a PSMT8 column where each byte holds pixels
+//from row 0 (or 1) in its low nibble and from row 2 (or 3) in its high nibble.
+static bool WriteBlockPSMT4Simd(uint8* block, const uint8* src, uint32 srcStride)
+{
+	auto difference = Zero();
+	for(uint32 column = 0; column < COLUMN_COUNT; column++)
+	{
+		auto rows = src + (column * 4 * srcStride);
+		//Expand every row to one byte per pixel, pixels 0-15 and pixels 16-31
+		Vector row[4][2];
+		for(uint32 i = 0; i < 4; i++)
+		{
+			auto packed = Load(rows + (i * srcStride));
+			auto lo = LowNibbles(packed);
+			auto hi = HighNibbles(packed);
+			row[i][0] = InterleaveLo8(lo, hi);
+			row[i][1] = InterleaveHi8(lo, hi);
+		}
+		uint32 rotatedRow = (column & 1) ? 0 : 2;
+		for(uint32 i = 0; i < 2; i++)
+		{
+			row[rotatedRow + 0][i] = SwapWordPairs(row[rotatedRow + 0][i]);
+			row[rotatedRow + 1][i] = SwapWordPairs(row[rotatedRow + 1][i]);
+		}
+
+		Vector evenLo, evenHi, oddLo, oddHi;
+		{
+			auto c0 = CombineNibbles(row[0][0], row[2][0]);
+			auto c1 = CombineNibbles(row[0][1], row[2][1]);
+			InterleaveColumnRows8(InterleaveLo64(c0, c1), InterleaveHi64(c0, c1), evenLo, evenHi);
+		}
+		{
+			auto c0 = CombineNibbles(row[1][0], row[3][0]);
+			auto c1 = CombineNibbles(row[1][1], row[3][1]);
+			InterleaveColumnRows8(InterleaveLo64(c0, c1), InterleaveHi64(c0, c1), oddLo, oddHi);
+		}
+		Vector values[4] =
+		    {
+		        InterleaveLo64(evenLo, oddLo),
+		        InterleaveHi64(evenLo, oddLo),
+		        InterleaveLo64(evenHi, oddHi),
+		        InterleaveHi64(evenHi, oddHi),
+		    };
+		StoreColumn(block + (column * CGsPixelFormats::COLUMNSIZE), values, difference);
+	}
+	return !IsZero(difference);
+}
+
+#endif
+
+//////////////////////////////////////////////
+//Kernel selection
+
+static CGsTransferKernels::KERNELS MakeScalarKernels()
+{
+	CGsTransferKernels::KERNELS kernels;
+	kernels.writeBlockPSMCT32 = &WriteBlockScalar<STORAGEPSMCT32>;
+	kernels.writeBlockPSMCT16 = &WriteBlockScalar<STORAGEPSMCT16>;
+	kernels.writeBlockPSMT8 = &WriteBlockScalar<STORAGEPSMT8>;
+	kernels.writeBlockPSMT4 = &WriteBlockScalar<STORAGEPSMT4>;
+	kernels.readBlockPSMCT32 = &ReadBlockScalar<STORAGEPSMCT32>;
+	kernels.readBlockPSMT8 = &ReadBlockScalar<STORAGEPSMT8>;
+	return kernels;
+}
+
+static CGsTransferKernels::KERNELS MakeSimdKernels()
+{
+#ifdef HAS_SIMD
+	CGsTransferKernels::KERNELS kernels;
+	kernels.writeBlockPSMCT32 = &WriteBlockPSMCT32Simd;
+	kernels.writeBlockPSMCT16 = &WriteBlockPSMCT16Simd;
+	kernels.writeBlockPSMT8 = &WriteBlockPSMT8Simd;
+	kernels.writeBlockPSMT4 = &WriteBlockPSMT4Simd;
+	kernels.readBlockPSMCT32 = &ReadBlockPSMCT32Simd;
+	kernels.readBlockPSMT8 = &ReadBlockPSMT8Simd;
+	return kernels;
+#else
+	return MakeScalarKernels();
+#endif
+}
+
+bool CGsTransferKernels::IsSimdSupported()
+{
+#ifdef HAS_SIMD
+	//SSE2 and NEON are part of the baseline of the architectures we build them for
+	return true;
+#else
+	return false;
+#endif
+}
+
+const CGsTransferKernels::KERNELS& CGsTransferKernels::GetKernels()
+{
+	static const KERNELS& kernels = GetKernels(IsSimdSupported() ? KERNEL_SET_SIMD : KERNEL_SET_SCALAR);
+	return kernels;
+}
+
+const CGsTransferKernels::KERNELS& CGsTransferKernels::GetKernels(KERNEL_SET kernelSet)
+{
+	static const KERNELS scalarKernels = MakeScalarKernels();
+	static const KERNELS simdKernels = MakeSimdKernels();
+	assert((kernelSet == KERNEL_SET_SCALAR) || (kernelSet == KERNEL_SET_SIMD));
+	return (kernelSet == KERNEL_SET_SIMD) ? simdKernels : scalarKernels;
+}
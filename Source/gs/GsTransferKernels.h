@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Types.h"
+#include "GsPixelFormats.h"
+
+//Block-at-a-time swizzling of host/local transfers. A block is the smallest rectangle of pixels
+//that is stored contiguously in GS memory (256 bytes). Kernels copy a whole block between a linear
+//buffer and GS memory. SIMD versions are used when available, scalar versions are kept as reference.
+class CGsTransferKernels
+{
+public:
+	//Arguments: block in GS memory, linear source, source stride in bytes. Returns true if block was modified.
+	typedef bool (*WriteBlockFunction)(uint8*, const uint8*, uint32);
+	//Arguments: linear destination, destination stride in bytes, block in GS memory.
+	typedef void (*ReadBlockFunction)(uint8*, uint32, const uint8*);
+
+	enum KERNEL_SET
+	{
+		KERNEL_SET_SCALAR,
+		KERNEL_SET_SIMD,
+	};
+
+	struct KERNELS
+	{
+		WriteBlockFunction writeBlockPSMCT32 = nullptr;
+		WriteBlockFunction writeBlockPSMCT16 = nullptr;
+		WriteBlockFunction writeBlockPSMT8 = nullptr;
+		WriteBlockFunction writeBlockPSMT4 = nullptr;
+		ReadBlockFunction readBlockPSMCT32 = nullptr;
+		ReadBlockFunction readBlockPSMT8 = nullptr;
+	};
+
+	static bool IsSimdSupported();
+
+	//Returns the best kernel set supported by the host
+	static const KERNELS& GetKernels();
+	static const KERNELS& GetKernels(KERNEL_SET);
+
+	template <typename Storage>
+	static WriteBlockFunction GetWriteBlockFunction(const KERNELS&);
+	template <typename Storage>
+	static ReadBlockFunction GetReadBlockFunction(const KERNELS&);
+
+	template <typename Storage>
+	static uint32 GetPixelBits()
+	{
+		return sizeof(typename Storage::Unit) * 8;
+	}
+
+	//Coordinates must be aligned on a block boundary
+	template <typename Storage>
+	static uint8* GetBlockAddress(uint8* ram, uint32 bufPtr, uint32 bufWidth, uint32 x, uint32 y)
+	{
+		uint32 pageNum = (x / Storage::PAGEWIDTH) + (y / Storage::PAGEHEIGHT) * (bufWidth * 64) / Storage::PAGEWIDTH;
+		x %= Storage::PAGEWIDTH;
+		y %= Storage::PAGEHEIGHT;
+		uint32 blockNum = Storage::m_nBlockSwizzleTable[y / Storage::BLOCKHEIGHT][x / Storage::BLOCKWIDTH];
+		uint32 address = (bufPtr + (pageNum * CGsPixelFormats::PAGESIZE) + (blockNum * CGsPixelFormats::BLOCKSIZE)) & (CGSHandler::RAMSIZE - 1);
+		return ram + address;
+	}
+};
+
+template <>
+inline uint32 CGsTransferKernels::GetPixelBits<CGsPixelFormats::STORAGEPSMT4>()
+{
+	return 4;
+}
+
+template <>
+inline CGsTransferKernels::WriteBlockFunction CGsTransferKernels::GetWriteBlockFunction<CGsPixelFormats::STORAGEPSMCT32>(const KERNELS& kernels)
+{
+	return kernels.writeBlockPSMCT32;
+}
+
+template <>
+inline CGsTransferKernels::WriteBlockFunction CGsTransferKernels::GetWriteBlockFunction<CGsPixelFormats::STORAGEPSMCT16>(const KERNELS& kernels)
+{
+	return kernels.writeBlockPSMCT16;
+}
+
+template <>
+inline CGsTransferKernels::WriteBlockFunction CGsTransferKernels::GetWriteBlockFunction<CGsPixelFormats::STORAGEPSMCT16S>(const KERNELS& kernels)
+{
+	//PSMCT16S only differs from PSMCT16 in the way blocks are arranged in a page
+	return kernels.writeBlockPSMCT16;
+}
+
+template <>
+inline CGsTransferKernels::WriteBlockFunction CGsTransferKernels::GetWriteBlockFunction<CGsPixelFormats::STORAGEPSMT8>(const KERNELS& kernels)
+{
+	return kernels.writeBlockPSMT8;
+}
+
+template <>
+inline CGsTransferKernels::WriteBlockFunction CGsTransferKernels::GetWriteBlockFunction<CGsPixelFormats::STORAGEPSMT4>(const KERNELS& kernels)
+{
+	return kernels.writeBlockPSMT4;
+}
+
+template <>
+inline CGsTransferKernels::ReadBlockFunction CGsTransferKernels::GetReadBlockFunction<CGsPixelFormats::STORAGEPSMCT32>(const KERNELS& kernels)
+{
+	return kernels.readBlockPSMCT32;
+}
+
+template <>
+inline CGsTransferKernels::ReadBlockFunction CGsTransferKernels::GetReadBlockFunction<CGsPixelFormats::STORAGEPSMT8>(const KERNELS& kernels)
+{
+	return kernels.readBlockPSMT8;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "string_format.h"
@@ -1656,6 +1657,21 @@ uint32 CIopBios::GetNextReadyThread()
 	return -1;
 }
 
+uint64 CIopBios::GetTicksUntilNextEvent()
+{
+	uint64 result = ~0ULL;
+	uint32 nextThreadId = ThreadLinkHead();
+	while(nextThreadId != 0)
+	{
+		THREAD* nextThread = m_threads[nextThreadId];
+		nextThreadId = nextThread->nextThreadId;
+		//Same condition as the one used by GetNextReadyThread
+		if(GetCurrentTime() > nextThread->nextActivateTime) return 0;
+		result = std::min<uint64>(result, nextThread->nextActivateTime - GetCurrentTime() + 1);
+	}
+	return result;
+}
+
 uint64 CIopBios::GetCurrentTime() const
 {
 	return CurrentTime();
@@ -172,6 +172,7 @@ public:
 	void LoadState(Framework::CZipArchiveReader&) override;
 
 	bool IsIdle() override;
+	uint64 GetTicksUntilNextEvent() override;
 
 	Iop::CSysmem* GetSysmem();
 	Iop::CIoman* GetIoman();
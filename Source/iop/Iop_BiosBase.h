@@ -23,6 +23,11 @@ namespace Iop
 		virtual void NotifyVBlankEnd() = 0;
 
 		virtual bool IsIdle() = 0;
+		//Ticks before a waiting thread becomes ready, 0 if unknown
+		virtual uint64 GetTicksUntilNextEvent()
+		{
+			return 0;
+		}
 
 		virtual void SaveState(Framework::CZipArchiveWriter&) = 0;
 		virtual void LoadState(Framework::CZipArchiveReader&) = 0;
@@ -36,6 +36,8 @@ namespace Iop
 		void SaveState(Framework::CZipArchiveWriter&);
 
 		void Update(unsigned int);
+		//Ticks before a counter reaches its target or wraps around
+		uint32 GetTicksUntilNextEvent() const;
 
 		uint32 ReadRegister(uint32);
 		uint32 WriteRegister(uint32, uint32);
@@ -107,6 +109,8 @@ namespace Iop
 		void DisassembleWrite(uint32, uint32);
 
 		static unsigned int GetCounterIdByAddress(uint32);
+		unsigned int GetClockRatio(unsigned int) const;
+		uint32 GetCounterMax(unsigned int) const;
 
 		COUNTER m_counter[MAX_COUNTERS];
 		Iop::CIntc& m_intc;
@@ -11,43 +11,56 @@ CSifManPs2::CSifManPs2(CSIF& sif, uint8* eeRam, uint8* iopRam)
 {
 }
 
+void CSifManPs2::SetEeSyncHandler(const SyncHandler& eeSyncHandler)
+{
+	m_eeSyncHandler = eeSyncHandler;
+}
+
 void CSifManPs2::RegisterModule(uint32 id, CSifModule* module)
 {
+	SyncEe();
 	m_sif.RegisterModule(id, module);
 }
 
 bool CSifManPs2::IsModuleRegistered(uint32 id)
 {
+	SyncEe();
 	return m_sif.IsModuleRegistered(id);
 }
 
 void CSifManPs2::UnregisterModule(uint32 id)
 {
+	SyncEe();
 	m_sif.UnregisterModule(id);
 }
 
 void CSifManPs2::SendPacket(void* packet, uint32 size)
 {
+	SyncEe();
 	m_sif.SendPacket(packet, size);
 }
 
 void CSifManPs2::SetDmaBuffer(uint32 bufferAddress, uint32 size)
 {
+	SyncEe();
 	m_sif.SetDmaBuffer(bufferAddress, size);
 }
 
 void CSifManPs2::SetCmdBuffer(uint32 bufferAddress, uint32 size)
 {
+	SyncEe();
 	m_sif.SetCmdBuffer(bufferAddress, size);
 }
 
 void CSifManPs2::SendCallReply(uint32 serverId, const void* returnData)
 {
+	SyncEe();
 	m_sif.SendCallReply(serverId, returnData);
 }
 
 void CSifManPs2::GetOtherData(uint32 dst, uint32 src, uint32 size)
 {
+	SyncEe();
 	uint8* srcPtr = m_eeRam + (src & (PS2::EE_RAM_SIZE - 1));
 	uint8* dstPtr = m_iopRam + dst;
 	memcpy(dstPtr, srcPtr, size);
@@ -55,16 +68,19 @@ void CSifManPs2::GetOtherData(uint32 dst, uint32 src, uint32 size)
 
 void CSifManPs2::SetModuleResetHandler(const ModuleResetHandler& moduleResetHandler)
 {
+	SyncEe();
 	m_sif.SetModuleResetHandler(moduleResetHandler);
 }
 
 void CSifManPs2::SetCustomCommandHandler(const CustomCommandHandler& customCommandHandler)
 {
+	SyncEe();
 	m_sif.SetCustomCommandHandler(customCommandHandler);
 }
 
 uint32 CSifManPs2::SifSetDma(uint32 structAddr, uint32 count)
 {
+	SyncEe();
 	CSifMan::SifSetDma(structAddr, count);
 
 	if(structAddr == 0)
@@ -83,7 +99,16 @@ uint32 CSifManPs2::SifSetDma(uint32 structAddr, uint32 count)
 	return count;
 }
 
-uint8* CSifManPs2::GetEeRam() const
+uint8* CSifManPs2::GetEeRam()
 {
+	SyncEe();
 	return m_eeRam;
 }
+
+void CSifManPs2::SyncEe()
+{
+	if(m_eeSyncHandler)
+	{
+		m_eeSyncHandler();
+	}
+}
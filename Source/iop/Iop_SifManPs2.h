@@ -8,9 +8,14 @@ namespace Iop
 	class CSifManPs2 : public CSifMan
 	{
 	public:
+		typedef std::function<void()> SyncHandler;
+
 		CSifManPs2(CSIF&, uint8*, uint8*);
 		virtual ~CSifManPs2() = default;
 
+		//Called by the IOP before it touches EE state
+		void SetEeSyncHandler(const SyncHandler&);
+
 		void RegisterModule(uint32, CSifModule*) override;
 		bool IsModuleRegistered(uint32) override;
 		void UnregisterModule(uint32) override;
@@ -24,11 +29,14 @@ namespace Iop
 
 		uint32 SifSetDma(uint32, uint32) override;
 
-		uint8* GetEeRam() const;
+		uint8* GetEeRam();
 
 	private:
+		void SyncEe();
+
 		CSIF& m_sif;
 		uint8* m_eeRam;
 		uint8* m_iopRam;
+		SyncHandler m_eeSyncHandler;
 	};
 }
@@ -197,6 +197,19 @@ void CSpuBase::Reset()
 	m_blockWritePtr = 0;
 }
 
+void CSpuBase::CopyState(const CSpuBase& src)
+{
+	assert(m_ramSize == src.m_ramSize);
+	assert(m_spuNumber == src.m_spuNumber);
+	auto ram = m_ram;
+	*this = src;
+	m_ram = ram;
+	for(auto& reader : m_reader)
+	{
+		reader.SetMemory(m_ram, m_ramSize);
+	}
+}
+
 void CSpuBase::LoadState(Framework::CZipArchiveReader& archive)
 {
 	auto path = string_format(STATE_PATH_FORMAT, m_spuNumber);
@@ -319,6 +332,15 @@ void CSpuBase::SetBaseSamplingRate(uint32 samplingRate)
 	m_baseSamplingRate = samplingRate;
 }
 
+void CSpuBase::SetKernelSet(CSpuKernels::KERNEL_SET kernelSet)
+{
+	m_kernels = &CSpuKernels::GetKernels(kernelSet);
+	for(auto& reader : m_reader)
+	{
+		reader.SetKernels(m_kernels);
+	}
+}
+
 bool CSpuBase::GetIrqPending() const
 {
 	return m_irqPending;
@@ -596,228 +618,295 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 {
 	bool updateReverb = m_reverbEnabled && (m_ctrl & CONTROL_REVERB) && (m_reverbWorkAddrStart < m_reverbWorkAddrEnd);
 	bool checkIrqs = (m_ctrl & CONTROL_IRQ) && (m_irqAddr != INVALID_ADDRESS);
+	//Without an output buffer, only the state visible to the IOP is updated (voices, envelopes, flags, irqs).
+	//Mixing and reverb processing are skipped, this is used when samples are mixed on another thread.
+	bool mixOutput = (samples != nullptr);
 
 	assert((sampleCount & 0x01) == 0);
 	//ticks are 44100Hz ticks
 	unsigned int ticks = sampleCount / 2;
-	memset(samples, 0, sizeof(int16) * sampleCount);
+	if(mixOutput)
+	{
+		memset(samples, 0, sizeof(int16) * sampleCount);
+	}
 
-	for(unsigned int j = 0; j < ticks; j++)
+	//Channels are rendered one after the other for a batch of ticks and then mixed with the kernels.
+	//Channels are still mixed in the same order for every tick, saturation gives the same result as
+	//mixing all channels tick by tick.
+	for(unsigned int batchStart = 0; batchStart < ticks; batchStart += MAX_BATCH_TICKS)
 	{
-		int16 reverbSample[2] = {0, 0};
+		unsigned int batchTicks = std::min<unsigned int>(ticks - batchStart, MAX_BATCH_TICKS);
+		int16* batchSamples = mixOutput ? (samples + (batchStart * 2)) : nullptr;
+		int16 reverbSamples[MAX_BATCH_TICKS * 2];
+		memset(reverbSamples, 0, sizeof(reverbSamples));
+
 		//Update channels
-		for(unsigned int i = 0; i < 24; i++)
+		for(unsigned int i = 0; i < MAX_CHANNEL; i++)
 		{
-			auto& channel(m_channel[i]);
-			if((channel.status == STOPPED) && !checkIrqs) continue;
-			auto& reader(m_reader[i]);
-			if(channel.status == KEY_ON)
+			int32 channelSamples[MAX_BATCH_TICKS];
+			int16 channelVolumes[MAX_BATCH_TICKS * 2];
+			if(!RenderChannel(i, channelSamples, channelVolumes, batchTicks, sampleRate, checkIrqs)) continue;
+			if(!mixOutput) continue;
+
+			bool mixReverb = updateReverb && (m_channelReverb.f & (1 << i));
+
+			//Samples go beyond 16 bits if the envelope underflows, those can't be mixed with the kernels
+			int16 mixSamples[MAX_BATCH_TICKS];
+			bool canUseKernels = true;
+			for(unsigned int j = 0; j < batchTicks; j++)
 			{
-				reader.SetParams(channel.address, channel.repeat);
-				reader.ClearEndFlag();
-				channel.status = ATTACK;
-				channel.adsrVolume = 0;
+				mixSamples[j] = static_cast<int16>(channelSamples[j]);
+				canUseKernels &= (mixSamples[j] == channelSamples[j]);
 			}
-			else
+
+			if(canUseKernels)
 			{
-				if(reader.IsDone())
+				m_kernels->mixSamples(batchSamples, mixSamples, channelVolumes, batchTicks);
+				if(mixReverb)
 				{
-					channel.status = STOPPED;
-					channel.adsrVolume = 0;
-					reader.ClearIsDone();
-					//No point in continuing if we don't need to check interrupts
-					if(!checkIrqs) continue;
+					m_kernels->mixSamples(reverbSamples, mixSamples, channelVolumes, batchTicks);
 				}
-				if(reader.DidChangeRepeat())
+			}
+			else
+			{
+				for(unsigned int j = 0; j < batchTicks; j++)
 				{
-					channel.repeat = reader.GetRepeat();
-					reader.ClearDidChangeRepeat();
+					MixSamples(channelSamples[j], channelVolumes[(j * 2) + 0], batchSamples + (j * 2) + 0);
+					MixSamples(channelSamples[j], channelVolumes[(j * 2) + 1], batchSamples + (j * 2) + 1);
+					if(mixReverb)
+					{
+						MixSamples(channelSamples[j], channelVolumes[(j * 2) + 0], reverbSamples + (j * 2) + 0);
+						MixSamples(channelSamples[j], channelVolumes[(j * 2) + 1], reverbSamples + (j * 2) + 1);
+					}
 				}
-				//Update repeat in case it has been changed externally (needed for FFX)
-				reader.SetRepeat(channel.repeat);
 			}
+		}
 
-			reader.SetIrqAddress(m_irqAddr);
-
-			int16 readSample = 0;
-			reader.SetPitch(m_baseSamplingRate, channel.pitch);
-			reader.GetSamples(&readSample, 1, sampleRate);
-			channel.current = reader.GetCurrent();
+		for(unsigned int j = 0; j < batchTicks; j++)
+		{
+			int16* tickSamples = mixOutput ? (batchSamples + (j * 2)) : nullptr;
 
-			if(checkIrqs && reader.GetIrqPending())
+			if(!m_blockReader.CanReadSamples() && (m_blockWritePtr == SOUND_INPUT_DATA_SIZE))
 			{
-				m_irqPending = true;
+				//We're ready to consume some data
+				m_blockReader.FillBlock(m_ram + m_soundInputDataAddr);
+				m_blockWritePtr = 0;
 			}
 
-			reader.ClearIrqPending();
-
-			//Mix samples
-			UpdateAdsr(channel);
-			int32 inputSample = static_cast<int32>(readSample);
-			//Mix adsrVolume
+			if(m_blockReader.CanReadSamples())
 			{
-				inputSample = (inputSample * static_cast<int32>(channel.adsrVolume >> 16)) / static_cast<int32>(MAX_ADSR_VOLUME >> 16);
-			}
+				int16 sampleL = 0;
+				int16 sampleR = 0;
+				m_blockReader.GetSamples(sampleL, sampleR, sampleRate);
 
-			channel.volumeLeftAbs = ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
-			channel.volumeRightAbs = ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+				if(mixOutput)
+				{
+					MixSamples(sampleL, 0x3FFF, tickSamples + 0);
+					MixSamples(sampleR, 0x3FFF, tickSamples + 1);
+				}
+			}
 
-			int32 adjustedLeftVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeLeftAbs >> 16) * m_volumeAdjust));
-			int32 adjustedRightVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeRightAbs >> 16) * m_volumeAdjust));
-			MixSamples(inputSample, adjustedLeftVolume, samples + 0);
-			MixSamples(inputSample, adjustedRightVolume, samples + 1);
-			//Mix in reverb if enabled for this channel
-			if(updateReverb && (m_channelReverb.f & (1 << i)))
+			//Update reverb
+			if(updateReverb)
 			{
-				MixSamples(inputSample, adjustedLeftVolume, reverbSample + 0);
-				MixSamples(inputSample, adjustedRightVolume, reverbSample + 1);
+				//Feed samples to FIR filter
+				if(mixOutput && (m_reverbTicks & 1))
+				{
+					//IIR_INPUT_A0 = buffer[IIR_SRC_A0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
+					//IIR_INPUT_A1 = buffer[IIR_SRC_A1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
+					//IIR_INPUT_B0 = buffer[IIR_SRC_B0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
+					//IIR_INPUT_B1 = buffer[IIR_SRC_B1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
+
+					float input_sample_l = static_cast<float>(reverbSamples[(j * 2) + 0]) * 0.5f;
+					float input_sample_r = static_cast<float>(reverbSamples[(j * 2) + 1]) * 0.5f;
+
+					float irr_coef = GetReverbCoef(IIR_COEF);
+					float in_coef_l = GetReverbCoef(IN_COEF_L);
+					float in_coef_r = GetReverbCoef(IN_COEF_R);
+
+					float iir_input_a0 = GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * irr_coef + input_sample_l * in_coef_l;
+					float iir_input_a1 = GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * irr_coef + input_sample_r * in_coef_r;
+					float iir_input_b0 = GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * irr_coef + input_sample_l * in_coef_l;
+					float iir_input_b1 = GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * irr_coef + input_sample_r * in_coef_r;
+
+					//IIR_A0 = IIR_INPUT_A0 * IIR_ALPHA + buffer[IIR_DEST_A0] * (1.0 - IIR_ALPHA);
+					//IIR_A1 = IIR_INPUT_A1 * IIR_ALPHA + buffer[IIR_DEST_A1] * (1.0 - IIR_ALPHA);
+					//IIR_B0 = IIR_INPUT_B0 * IIR_ALPHA + buffer[IIR_DEST_B0] * (1.0 - IIR_ALPHA);
+					//IIR_B1 = IIR_INPUT_B1 * IIR_ALPHA + buffer[IIR_DEST_B1] * (1.0 - IIR_ALPHA);
+
+					float iir_alpha = GetReverbCoef(IIR_ALPHA);
+
+					float iir_a0 = iir_input_a0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A0)) * (1.0f - iir_alpha);
+					float iir_a1 = iir_input_a1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A1)) * (1.0f - iir_alpha);
+					float iir_b0 = iir_input_b0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B0)) * (1.0f - iir_alpha);
+					float iir_b1 = iir_input_b1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B1)) * (1.0f - iir_alpha);
+
+					//buffer[IIR_DEST_A0 + 1sample] = IIR_A0;
+					//buffer[IIR_DEST_A1 + 1sample] = IIR_A1;
+					//buffer[IIR_DEST_B0 + 1sample] = IIR_B0;
+					//buffer[IIR_DEST_B1 + 1sample] = IIR_B1;
+
+					SetReverbSample(GetReverbOffset(IIR_DEST_A0) + 2, iir_a0);
+					SetReverbSample(GetReverbOffset(IIR_DEST_A1) + 2, iir_a1);
+					SetReverbSample(GetReverbOffset(IIR_DEST_B0) + 2, iir_b0);
+					SetReverbSample(GetReverbOffset(IIR_DEST_B1) + 2, iir_b1);
+
+					//ACC0 = buffer[ACC_SRC_A0] * ACC_COEF_A +
+					//	   buffer[ACC_SRC_B0] * ACC_COEF_B +
+					//	   buffer[ACC_SRC_C0] * ACC_COEF_C +
+					//	   buffer[ACC_SRC_D0] * ACC_COEF_D;
+					//ACC1 = buffer[ACC_SRC_A1] * ACC_COEF_A +
+					//	   buffer[ACC_SRC_B1] * ACC_COEF_B +
+					//	   buffer[ACC_SRC_C1] * ACC_COEF_C +
+					//	   buffer[ACC_SRC_D1] * ACC_COEF_D;
+
+					float acc_coef_a = GetReverbCoef(ACC_COEF_A);
+					float acc_coef_b = GetReverbCoef(ACC_COEF_B);
+					float acc_coef_c = GetReverbCoef(ACC_COEF_C);
+					float acc_coef_d = GetReverbCoef(ACC_COEF_D);
+
+					float acc0 =
+					    GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * acc_coef_a +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * acc_coef_b +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_C0)) * acc_coef_c +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_D0)) * acc_coef_d;
+
+					float acc1 =
+					    GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * acc_coef_a +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * acc_coef_b +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_C1)) * acc_coef_c +
+					    GetReverbSample(GetReverbOffset(ACC_SRC_D1)) * acc_coef_d;
+
+					//FB_A0 = buffer[MIX_DEST_A0 - FB_SRC_A];
+					//FB_A1 = buffer[MIX_DEST_A1 - FB_SRC_A];
+					//FB_B0 = buffer[MIX_DEST_B0 - FB_SRC_B];
+					//FB_B1 = buffer[MIX_DEST_B1 - FB_SRC_B];
+
+					float fb_a0 = GetReverbSample(GetReverbOffset(MIX_DEST_A0) - GetReverbOffset(FB_SRC_A));
+					float fb_a1 = GetReverbSample(GetReverbOffset(MIX_DEST_A1) - GetReverbOffset(FB_SRC_A));
+					float fb_b0 = GetReverbSample(GetReverbOffset(MIX_DEST_B0) - GetReverbOffset(FB_SRC_B));
+					float fb_b1 = GetReverbSample(GetReverbOffset(MIX_DEST_B1) - GetReverbOffset(FB_SRC_B));
+
+					//buffer[MIX_DEST_A0] = ACC0 - FB_A0 * FB_ALPHA;
+					//buffer[MIX_DEST_A1] = ACC1 - FB_A1 * FB_ALPHA;
+					//buffer[MIX_DEST_B0] = (FB_ALPHA * ACC0) - FB_A0 * (FB_ALPHA^0x8000) - FB_B0 * FB_X;
+					//buffer[MIX_DEST_B1] = (FB_ALPHA * ACC1) - FB_A1 * (FB_ALPHA^0x8000) - FB_B1 * FB_X;
+
+					float fb_alpha = GetReverbCoef(FB_ALPHA);
+					float fb_x = GetReverbCoef(FB_X);
+
+					SetReverbSample(GetReverbOffset(MIX_DEST_A0), acc0 - fb_a0 * fb_alpha);
+					SetReverbSample(GetReverbOffset(MIX_DEST_A1), acc1 - fb_a1 * fb_alpha);
+					SetReverbSample(GetReverbOffset(MIX_DEST_B0), (fb_alpha * acc0) - fb_a0 * -fb_alpha - fb_b0 * fb_x);
+					SetReverbSample(GetReverbOffset(MIX_DEST_B1), (fb_alpha * acc1) - fb_a1 * -fb_alpha - fb_b1 * fb_x);
+				}
+
+				if(m_reverbTicks & 1)
+				{
+					m_reverbCurrAddr += 2;
+					if(m_reverbCurrAddr >= m_reverbWorkAddrEnd)
+					{
+						m_reverbCurrAddr = m_reverbWorkAddrStart;
+					}
+				}
+
+				if(mixOutput && (m_reverbWorkAddrStart != 0))
+				{
+					float sampleL = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A0)) + GetReverbSample(GetReverbOffset(MIX_DEST_B0)));
+					float sampleR = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A1)) + GetReverbSample(GetReverbOffset(MIX_DEST_B1)));
+
+					{
+						int16* output = tickSamples + 0;
+						int32 resultSample = static_cast<int32>(sampleL) + static_cast<int32>(*output);
+						resultSample = std::max<int32>(resultSample, SHRT_MIN);
+						resultSample = std::min<int32>(resultSample, SHRT_MAX);
+						*output = static_cast<int16>(resultSample);
+					}
+
+					{
+						int16* output = tickSamples + 1;
+						int32 resultSample = static_cast<int32>(sampleR) + static_cast<int32>(*output);
+						resultSample = std::max<int32>(resultSample, SHRT_MIN);
+						resultSample = std::min<int32>(resultSample, SHRT_MAX);
+						*output = static_cast<int16>(resultSample);
+					}
+				}
+
+				m_reverbTicks++;
 			}
 		}
+	}
+}
 
-		if(!m_blockReader.CanReadSamples() && (m_blockWritePtr == SOUND_INPUT_DATA_SIZE))
-		{
-			//We're ready to consume some data
-			m_blockReader.FillBlock(m_ram + m_soundInputDataAddr);
-			m_blockWritePtr = 0;
-		}
+bool CSpuBase::RenderChannel(unsigned int channelIndex, int32* samples, int16* volumes, unsigned int tickCount, unsigned int sampleRate, bool checkIrqs)
+{
+	auto& channel(m_channel[channelIndex]);
+	if((channel.status == STOPPED) && !checkIrqs) return false;
+	auto& reader(m_reader[channelIndex]);
 
-		if(m_blockReader.CanReadSamples())
-		{
-			int16 sampleL = 0;
-			int16 sampleR = 0;
-			m_blockReader.GetSamples(sampleL, sampleR, sampleRate);
+	//Ticks where the channel doesn't play are mixed as silence
+	memset(samples, 0, sizeof(int32) * tickCount);
+	memset(volumes, 0, sizeof(int16) * tickCount * 2);
 
-			MixSamples(sampleL, 0x3FFF, samples + 0);
-			MixSamples(sampleR, 0x3FFF, samples + 1);
+	for(unsigned int j = 0; j < tickCount; j++)
+	{
+		if((channel.status == STOPPED) && !checkIrqs) break;
+		if(channel.status == KEY_ON)
+		{
+			reader.SetParams(channel.address, channel.repeat);
+			reader.ClearEndFlag();
+			channel.status = ATTACK;
+			channel.adsrVolume = 0;
 		}
-
-		//Update reverb
-		if(updateReverb)
+		else
 		{
-			//Feed samples to FIR filter
-			if(m_reverbTicks & 1)
+			if(reader.IsDone())
 			{
-				//IIR_INPUT_A0 = buffer[IIR_SRC_A0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
-				//IIR_INPUT_A1 = buffer[IIR_SRC_A1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
-				//IIR_INPUT_B0 = buffer[IIR_SRC_B0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
-				//IIR_INPUT_B1 = buffer[IIR_SRC_B1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
-
-				float input_sample_l = static_cast<float>(reverbSample[0]) * 0.5f;
-				float input_sample_r = static_cast<float>(reverbSample[1]) * 0.5f;
-
-				float irr_coef = GetReverbCoef(IIR_COEF);
-				float in_coef_l = GetReverbCoef(IN_COEF_L);
-				float in_coef_r = GetReverbCoef(IN_COEF_R);
-
-				float iir_input_a0 = GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_a1 = GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * irr_coef + input_sample_r * in_coef_r;
-				float iir_input_b0 = GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_b1 = GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * irr_coef + input_sample_r * in_coef_r;
-
-				//IIR_A0 = IIR_INPUT_A0 * IIR_ALPHA + buffer[IIR_DEST_A0] * (1.0 - IIR_ALPHA);
-				//IIR_A1 = IIR_INPUT_A1 * IIR_ALPHA + buffer[IIR_DEST_A1] * (1.0 - IIR_ALPHA);
-				//IIR_B0 = IIR_INPUT_B0 * IIR_ALPHA + buffer[IIR_DEST_B0] * (1.0 - IIR_ALPHA);
-				//IIR_B1 = IIR_INPUT_B1 * IIR_ALPHA + buffer[IIR_DEST_B1] * (1.0 - IIR_ALPHA);
-
-				float iir_alpha = GetReverbCoef(IIR_ALPHA);
-
-				float iir_a0 = iir_input_a0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A0)) * (1.0f - iir_alpha);
-				float iir_a1 = iir_input_a1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A1)) * (1.0f - iir_alpha);
-				float iir_b0 = iir_input_b0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B0)) * (1.0f - iir_alpha);
-				float iir_b1 = iir_input_b1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B1)) * (1.0f - iir_alpha);
-
-				//buffer[IIR_DEST_A0 + 1sample] = IIR_A0;
-				//buffer[IIR_DEST_A1 + 1sample] = IIR_A1;
-				//buffer[IIR_DEST_B0 + 1sample] = IIR_B0;
-				//buffer[IIR_DEST_B1 + 1sample] = IIR_B1;
-
-				SetReverbSample(GetReverbOffset(IIR_DEST_A0) + 2, iir_a0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_A1) + 2, iir_a1);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B0) + 2, iir_b0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B1) + 2, iir_b1);
-
-				//ACC0 = buffer[ACC_SRC_A0] * ACC_COEF_A +
-				//	   buffer[ACC_SRC_B0] * ACC_COEF_B +
-				//	   buffer[ACC_SRC_C0] * ACC_COEF_C +
-				//	   buffer[ACC_SRC_D0] * ACC_COEF_D;
-				//ACC1 = buffer[ACC_SRC_A1] * ACC_COEF_A +
-				//	   buffer[ACC_SRC_B1] * ACC_COEF_B +
-				//	   buffer[ACC_SRC_C1] * ACC_COEF_C +
-				//	   buffer[ACC_SRC_D1] * ACC_COEF_D;
-
-				float acc_coef_a = GetReverbCoef(ACC_COEF_A);
-				float acc_coef_b = GetReverbCoef(ACC_COEF_B);
-				float acc_coef_c = GetReverbCoef(ACC_COEF_C);
-				float acc_coef_d = GetReverbCoef(ACC_COEF_D);
-
-				float acc0 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C0)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D0)) * acc_coef_d;
-
-				float acc1 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C1)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D1)) * acc_coef_d;
-
-				//FB_A0 = buffer[MIX_DEST_A0 - FB_SRC_A];
-				//FB_A1 = buffer[MIX_DEST_A1 - FB_SRC_A];
-				//FB_B0 = buffer[MIX_DEST_B0 - FB_SRC_B];
-				//FB_B1 = buffer[MIX_DEST_B1 - FB_SRC_B];
-
-				float fb_a0 = GetReverbSample(GetReverbOffset(MIX_DEST_A0) - GetReverbOffset(FB_SRC_A));
-				float fb_a1 = GetReverbSample(GetReverbOffset(MIX_DEST_A1) - GetReverbOffset(FB_SRC_A));
-				float fb_b0 = GetReverbSample(GetReverbOffset(MIX_DEST_B0) - GetReverbOffset(FB_SRC_B));
-				float fb_b1 = GetReverbSample(GetReverbOffset(MIX_DEST_B1) - GetReverbOffset(FB_SRC_B));
-
-				//buffer[MIX_DEST_A0] = ACC0 - FB_A0 * FB_ALPHA;
-				//buffer[MIX_DEST_A1] = ACC1 - FB_A1 * FB_ALPHA;
-				//buffer[MIX_DEST_B0] = (FB_ALPHA * ACC0) - FB_A0 * (FB_ALPHA^0x8000) - FB_B0 * FB_X;
-				//buffer[MIX_DEST_B1] = (FB_ALPHA * ACC1) - FB_A1 * (FB_ALPHA^0x8000) - FB_B1 * FB_X;
-
-				float fb_alpha = GetReverbCoef(FB_ALPHA);
-				float fb_x = GetReverbCoef(FB_X);
-
-				SetReverbSample(GetReverbOffset(MIX_DEST_A0), acc0 - fb_a0 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_A1), acc1 - fb_a1 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B0), (fb_alpha * acc0) - fb_a0 * -fb_alpha - fb_b0 * fb_x);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B1), (fb_alpha * acc1) - fb_a1 * -fb_alpha - fb_b1 * fb_x);
-
-				m_reverbCurrAddr += 2;
-				if(m_reverbCurrAddr >= m_reverbWorkAddrEnd)
-				{
-					m_reverbCurrAddr = m_reverbWorkAddrStart;
-				}
+				channel.status = STOPPED;
+				channel.adsrVolume = 0;
+				reader.ClearIsDone();
+				//No point in continuing if we don't need to check interrupts
+				if(!checkIrqs) break;
 			}
-
-			if(m_reverbWorkAddrStart != 0)
+			if(reader.DidChangeRepeat())
 			{
-				float sampleL = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A0)) + GetReverbSample(GetReverbOffset(MIX_DEST_B0)));
-				float sampleR = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A1)) + GetReverbSample(GetReverbOffset(MIX_DEST_B1)));
+				channel.repeat = reader.GetRepeat();
+				reader.ClearDidChangeRepeat();
+			}
+			//Update repeat in case it has been changed externally (needed for FFX)
+			reader.SetRepeat(channel.repeat);
+		}
 
-				{
-					int16* output = samples + 0;
-					int32 resultSample = static_cast<int32>(sampleL) + static_cast<int32>(*output);
-					resultSample = std::max<int32>(resultSample, SHRT_MIN);
-					resultSample = std::min<int32>(resultSample, SHRT_MAX);
-					*output = static_cast<int16>(resultSample);
-				}
+		reader.SetIrqAddress(m_irqAddr);
 
-				{
-					int16* output = samples + 1;
-					int32 resultSample = static_cast<int32>(sampleR) + static_cast<int32>(*output);
-					resultSample = std::max<int32>(resultSample, SHRT_MIN);
-					resultSample = std::min<int32>(resultSample, SHRT_MAX);
-					*output = static_cast<int16>(resultSample);
-				}
-			}
+		int16 readSample = 0;
+		reader.SetPitch(m_baseSamplingRate, channel.pitch);
+		reader.GetSamples(&readSample, 1, sampleRate);
+		channel.current = reader.GetCurrent();
 
-			m_reverbTicks++;
+		if(checkIrqs && reader.GetIrqPending())
+		{
+			m_irqPending = true;
 		}
-		samples += 2;
+
+		reader.ClearIrqPending();
+
+		UpdateAdsr(channel);
+		int32 inputSample = static_cast<int32>(readSample);
+		//Mix adsrVolume
+		{
+			inputSample = (inputSample * static_cast<int32>(channel.adsrVolume >> 16)) / static_cast<int32>(MAX_ADSR_VOLUME >> 16);
+		}
+
+		channel.volumeLeftAbs = ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
+		channel.volumeRightAbs = ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+
+		samples[j] = inputSample;
+		volumes[(j * 2) + 0] = static_cast<int16>(std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeLeftAbs >> 16) * m_volumeAdjust)));
+		volumes[(j * 2) + 1] = static_cast<int16>(std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeRightAbs >> 16) * m_volumeAdjust)));
 	}
+
+	return true;
 }
 
 uint32 CSpuBase::GetAdsrDelta(unsigned int index) const
@@ -1002,6 +1091,11 @@ void CSpuBase::CSampleReader::SetMemory(uint8* ram, uint32 ramSize)
 	assert((ramSize & (ramSize - 1)) == 0);
 }
 
+void CSpuBase::CSampleReader::SetKernels(const CSpuKernels::KERNELS* kernels)
+{
+	m_kernels = kernels;
+}
+
 void CSpuBase::CSampleReader::LoadState(const CRegisterStateFile& registerFile, const std::string& channelPrefix)
 {
 	m_srcSampleIdx = registerFile.GetRegister32((channelPrefix + STATE_SAMPLEREADER_REGS_SRCSAMPLEIDX).c_str());
@@ -1110,8 +1204,6 @@ void CSpuBase::CSampleReader::AdvanceBuffer()
 
 void CSpuBase::CSampleReader::UnpackSamples(int16* dst)
 {
-	int32 workBuffer[BUFFER_SAMPLES];
-
 	uint8* nextSample = m_ram + m_nextSampleAddr;
 
 	if(m_nextSampleAddr == m_irqAddr)
@@ -1119,51 +1211,10 @@ void CSpuBase::CSampleReader::UnpackSamples(int16* dst)
 		m_irqPending = true;
 	}
 
-	//Read header
-	uint8 shiftFactor = nextSample[0] & 0xF;
-	uint8 predictNumber = nextSample[0] >> 4;
+	//Read header, shift factor and predictor are handled by the decoder
 	uint8 flags = nextSample[1];
-	assert(predictNumber < 5);
-
-	//Get intermediate values
-	{
-		unsigned int workBufferPtr = 0;
-		for(unsigned int i = 2; i < 16; i++)
-		{
-			uint8 sampleByte = nextSample[i];
-			int16 firstSample = ((sampleByte & 0x0F) << 12);
-			int16 secondSample = ((sampleByte & 0xF0) << 8);
-			firstSample >>= shiftFactor;
-			secondSample >>= shiftFactor;
-			workBuffer[workBufferPtr++] = firstSample;
-			workBuffer[workBufferPtr++] = secondSample;
-		}
-	}
 
-	//Generate PCM samples
-	{
-		static const int32 predictorTable[5][2] =
-		    {
-		        {0, 0},
-		        {60, 0},
-		        {115, -52},
-		        {98, -55},
-		        {122, -60},
-		    };
-
-		for(unsigned int i = 0; i < BUFFER_SAMPLES; i++)
-		{
-			int32 currentValue = workBuffer[i] * 64;
-			currentValue += (m_s1 * predictorTable[predictNumber][0]) / 64;
-			currentValue += (m_s2 * predictorTable[predictNumber][1]) / 64;
-			m_s2 = m_s1;
-			m_s1 = currentValue;
-			int32 result = (currentValue + 32) / 64;
-			result = std::max<int32>(result, SHRT_MIN);
-			result = std::min<int32>(result, SHRT_MAX);
-			dst[i] = static_cast<int16>(result);
-		}
-	}
+	m_kernels->decodeAdpcmBlock(dst, nextSample, m_s1, m_s2);
 
 	if(flags & 0x04)
 	{
@@ -5,6 +5,7 @@
 #include "Convertible.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
+#include "Iop_SpuKernels.h"
 
 class CRegisterStateFile;
 
@@ -157,6 +158,9 @@ namespace Iop
 
 		void Reset();
 
+		//Copies the state of another SPU, RAM contents aren't copied
+		void CopyState(const CSpuBase&);
+
 		void LoadState(Framework::CZipArchiveReader&);
 		void SaveState(Framework::CZipArchiveWriter&);
 
@@ -167,6 +171,9 @@ namespace Iop
 
 		void SetBaseSamplingRate(uint32);
 
+		//Selects the kernels used to decode and mix samples (used to compare kernel sets)
+		void SetKernelSet(CSpuKernels::KERNEL_SET);
+
 		bool GetIrqPending() const;
 		void ClearIrqPending();
 
@@ -235,6 +242,7 @@ namespace Iop
 
 			void Reset();
 			void SetMemory(uint8*, uint32);
+			void SetKernels(const CSpuKernels::KERNELS*);
 
 			void LoadState(const CRegisterStateFile&, const std::string&);
 			void SaveState(CRegisterStateFile*, const std::string&) const;
@@ -259,7 +267,7 @@ namespace Iop
 		private:
 			enum
 			{
-				BUFFER_SAMPLES = 28,
+				BUFFER_SAMPLES = CSpuKernels::ADPCM_BLOCK_SAMPLES,
 			};
 
 			void UnpackSamples(int16*);
@@ -268,6 +276,7 @@ namespace Iop
 
 			uint8* m_ram = nullptr;
 			uint32 m_ramSize = 0;
+			const CSpuKernels::KERNELS* m_kernels = &CSpuKernels::GetKernels();
 
 			uint32 m_srcSampleIdx;
 			unsigned int m_srcSamplingRate;
@@ -311,6 +320,13 @@ namespace Iop
 			MAX_ADSR_VOLUME = 0x7FFFFFFF,
 		};
 
+		enum
+		{
+			//Channels are rendered for this amount of ticks before being mixed
+			MAX_BATCH_TICKS = 64,
+		};
+
+		bool RenderChannel(unsigned int, int32*, int16*, unsigned int, unsigned int, bool);
 		void UpdateAdsr(CHANNEL&);
 		uint32 GetAdsrDelta(unsigned int) const;
 		float GetReverbSample(uint32) const;
@@ -346,6 +362,7 @@ namespace Iop
 		uint32 m_adsrLogTable[160];
 		bool m_reverbEnabled;
 		float m_volumeAdjust;
+		const CSpuKernels::KERNELS* m_kernels = &CSpuKernels::GetKernels();
 
 		CBlockSampleReader m_blockReader;
 		uint32 m_soundInputDataAddr = 0;
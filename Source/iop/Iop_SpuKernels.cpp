@@ -0,0 +1,278 @@
+#include <cassert>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include "Iop_SpuKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(HAS_SSE2) || defined(HAS_NEON)
+#define HAS_SIMD
+#endif
+
+using namespace Iop;
+
+//Nibbles are unpacked in groups of 8, the last group is only partially used
+#define ADPCM_WORK_SAMPLES (32)
+
+static const int32 g_adpcmPredictorTable[5][2] =
+    {
+        {0, 0},
+        {60, 0},
+        {115, -52},
+        {98, -55},
+        {122, -60},
+};
+
+//Every sample depends on the two previous ones, this part can't be vectorized
+static void ApplyAdpcmPredictor(int16* dst, const int16* workBuffer, unsigned int predictNumber, int32& s1, int32& s2)
+{
+	assert(predictNumber < 5);
+	for(unsigned int i = 0; i < CSpuKernels::ADPCM_BLOCK_SAMPLES; i++)
+	{
+		int32 currentValue = workBuffer[i] * 64;
+		currentValue += (s1 * g_adpcmPredictorTable[predictNumber][0]) / 64;
+		currentValue += (s2 * g_adpcmPredictorTable[predictNumber][1]) / 64;
+		s2 = s1;
+		s1 = currentValue;
+		int32 result = (currentValue + 32) / 64;
+		result = std::max<int32>(result, SHRT_MIN);
+		result = std::min<int32>(result, SHRT_MAX);
+		dst[i] = static_cast<int16>(result);
+	}
+}
+
+//////////////////////////////////////////////
+//Scalar kernels
+
+static void DecodeAdpcmBlockScalar(int16* dst, const uint8* block, int32& s1, int32& s2)
+{
+	uint8 shiftFactor = block[0] & 0xF;
+	uint8 predictNumber = block[0] >> 4;
+
+	int16 workBuffer[CSpuKernels::ADPCM_BLOCK_SAMPLES];
+	{
+		unsigned int workBufferPtr = 0;
+		for(unsigned int i = 2; i < CSpuKernels::ADPCM_BLOCK_SIZE; i++)
+		{
+			uint8 sampleByte = block[i];
+			int16 firstSample = ((sampleByte & 0x0F) << 12);
+			int16 secondSample = ((sampleByte & 0xF0) << 8);
+			firstSample >>= shiftFactor;
+			secondSample >>= shiftFactor;
+			workBuffer[workBufferPtr++] = firstSample;
+			workBuffer[workBufferPtr++] = secondSample;
+		}
+	}
+
+	ApplyAdpcmPredictor(dst, workBuffer, predictNumber, s1, s2);
+}
+
+static void MixSamplesScalar(int16* output, const int16* samples, const int16* volumes, unsigned int sampleCount)
+{
+	for(unsigned int i = 0; i < sampleCount * 2; i++)
+	{
+		int32 inputSample = (static_cast<int32>(samples[i / 2]) * static_cast<int32>(volumes[i])) / 0x7FFF;
+		int32 resultSample = inputSample + static_cast<int32>(output[i]);
+		resultSample = std::max<int32>(resultSample, SHRT_MIN);
+		resultSample = std::min<int32>(resultSample, SHRT_MAX);
+		output[i] = static_cast<int16>(resultSample);
+	}
+}
+
+//////////////////////////////////////////////
+//SIMD kernels
+
+#ifdef HAS_SIMD
+
+//Small set of operations used by the kernels, implemented for every supported instruction set
+#if defined(HAS_SSE2)
+
+//Expands the 28 nibbles of a block to 16 bits, shifted right arithmetically by the block's shift factor
+static inline void UnpackAdpcmNibbles(int16* workBuffer, const uint8* block, unsigned int shiftFactor)
+{
+	//Skip the header, the last 2 bytes become zeroes
+	__m128i bytes = _mm_srli_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), 2);
+	__m128i mask = _mm_set1_epi8(0x0F);
+	__m128i lowNibbles = _mm_and_si128(bytes, mask);
+	__m128i highNibbles = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+	//Nibbles are moved to the top of their byte, which becomes the high byte of a 16 bits value
+	__m128i nibbles0 = _mm_slli_epi16(_mm_unpacklo_epi8(lowNibbles, highNibbles), 4);
+	__m128i nibbles1 = _mm_slli_epi16(_mm_unpackhi_epi8(lowNibbles, highNibbles), 4);
+	__m128i zero = _mm_setzero_si128();
+	__m128i shift = _mm_cvtsi32_si128(shiftFactor);
+	auto output = reinterpret_cast<__m128i*>(workBuffer);
+	_mm_storeu_si128(output + 0, _mm_sra_epi16(_mm_unpacklo_epi8(zero, nibbles0), shift));
+	_mm_storeu_si128(output + 1, _mm_sra_epi16(_mm_unpackhi_epi8(zero, nibbles0), shift));
+	_mm_storeu_si128(output + 2, _mm_sra_epi16(_mm_unpacklo_epi8(zero, nibbles1), shift));
+	_mm_storeu_si128(output + 3, _mm_sra_epi16(_mm_unpackhi_epi8(zero, nibbles1), shift));
+}
+
+//Rounding of ((value * 64) + 32) / 64, which truncates towards zero: negative values are incremented
+static inline void RoundUnpredictedSamples(int16* samples)
+{
+	auto buffer = reinterpret_cast<__m128i*>(samples);
+	for(unsigned int i = 0; i < ADPCM_WORK_SAMPLES / 8; i++)
+	{
+		__m128i value = _mm_loadu_si128(buffer + i);
+		_mm_storeu_si128(buffer + i, _mm_sub_epi16(value, _mm_srai_epi16(value, 15)));
+	}
+}
+
+//Truncating division by 0x7FFF, valid for products of a 16 bits sample and a volume in [0, 0x7FFF].
+//For 0 <= x <= 0x8000 * 0x7FFF, x / 0x7FFF == (x + (x >> 15) + 1) >> 15, the sign is applied afterwards.
+static inline __m128i DivideProduct(__m128i value)
+{
+	__m128i sign = _mm_srai_epi32(value, 31);
+	__m128i magnitude = _mm_sub_epi32(_mm_xor_si128(value, sign), sign);
+	__m128i quotient = _mm_add_epi32(_mm_add_epi32(magnitude, _mm_srli_epi32(magnitude, 15)), _mm_set1_epi32(1));
+	quotient = _mm_srli_epi32(quotient, 15);
+	return _mm_sub_epi32(_mm_xor_si128(quotient, sign), sign);
+}
+
+//Mixes 4 mono samples in 4 stereo output samples
+static inline void MixSampleGroup(int16* output, const int16* samples, const int16* volumes)
+{
+	__m128i sample = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples));
+	sample = _mm_unpacklo_epi16(sample, sample);
+	__m128i volume = _mm_loadu_si128(reinterpret_cast<const __m128i*>(volumes));
+	__m128i productLo = _mm_mullo_epi16(sample, volume);
+	__m128i productHi = _mm_mulhi_epi16(sample, volume);
+	__m128i result0 = DivideProduct(_mm_unpacklo_epi16(productLo, productHi));
+	__m128i result1 = DivideProduct(_mm_unpackhi_epi16(productLo, productHi));
+	__m128i result = _mm_packs_epi32(result0, result1);
+	auto outputBuffer = reinterpret_cast<__m128i*>(output);
+	_mm_storeu_si128(outputBuffer, _mm_adds_epi16(_mm_loadu_si128(outputBuffer), result));
+}
+
+#elif defined(HAS_NEON)
+
+static inline void UnpackAdpcmNibbles(int16* workBuffer, const uint8* block, unsigned int shiftFactor)
+{
+	//Skip the header, the last 2 bytes become zeroes
+	uint8x16_t bytes = vextq_u8(vld1q_u8(block), vdupq_n_u8(0), 2);
+	uint8x16x2_t nibbles = vzipq_u8(vandq_u8(bytes, vdupq_n_u8(0x0F)), vshrq_n_u8(bytes, 4));
+	int16x8_t shift = vdupq_n_s16(-static_cast<int16>(shiftFactor));
+	vst1q_s16(workBuffer + 0, vshlq_s16(vreinterpretq_s16_u16(vshlq_n_u16(vmovl_u8(vget_low_u8(nibbles.val[0])), 12)), shift));
+	vst1q_s16(workBuffer + 8, vshlq_s16(vreinterpretq_s16_u16(vshlq_n_u16(vmovl_u8(vget_high_u8(nibbles.val[0])), 12)), shift));
+	vst1q_s16(workBuffer + 16, vshlq_s16(vreinterpretq_s16_u16(vshlq_n_u16(vmovl_u8(vget_low_u8(nibbles.val[1])), 12)), shift));
+	vst1q_s16(workBuffer + 24, vshlq_s16(vreinterpretq_s16_u16(vshlq_n_u16(vmovl_u8(vget_high_u8(nibbles.val[1])), 12)), shift));
+}
+
+static inline void RoundUnpredictedSamples(int16* samples)
+{
+	for(unsigned int i = 0; i < ADPCM_WORK_SAMPLES; i += 8)
+	{
+		int16x8_t value = vld1q_s16(samples + i);
+		vst1q_s16(samples + i, vsubq_s16(value, vshrq_n_s16(value, 15)));
+	}
+}
+
+static inline int32x4_t DivideProduct(int32x4_t value)
+{
+	int32x4_t sign = vshrq_n_s32(value, 31);
+	uint32x4_t magnitude = vreinterpretq_u32_s32(vabsq_s32(value));
+	uint32x4_t quotient = vaddq_u32(vaddq_u32(magnitude, vshrq_n_u32(magnitude, 15)), vdupq_n_u32(1));
+	int32x4_t result = vreinterpretq_s32_u32(vshrq_n_u32(quotient, 15));
+	return vsubq_s32(veorq_s32(result, sign), sign);
+}
+
+static inline void MixSampleGroup(int16* output, const int16* samples, const int16* volumes)
+{
+	int16x4_t sample = vld1_s16(samples);
+	int16x4x2_t samplePairs = vzip_s16(sample, sample);
+	int16x8_t volume = vld1q_s16(volumes);
+	int32x4_t result0 = DivideProduct(vmull_s16(samplePairs.val[0], vget_low_s16(volume)));
+	int32x4_t result1 = DivideProduct(vmull_s16(samplePairs.val[1], vget_high_s16(volume)));
+	int16x8_t result = vcombine_s16(vqmovn_s32(result0), vqmovn_s32(result1));
+	vst1q_s16(output, vqaddq_s16(vld1q_s16(output), result));
+}
+
+#endif
+
+static void DecodeAdpcmBlockSimd(int16* dst, const uint8* block, int32& s1, int32& s2)
+{
+	uint8 shiftFactor = block[0] & 0xF;
+	uint8 predictNumber = block[0] >> 4;
+
+	int16 workBuffer[ADPCM_WORK_SAMPLES];
+	UnpackAdpcmNibbles(workBuffer, block, shiftFactor);
+
+	if(predictNumber == 0)
+	{
+		//Without prediction, samples only depend on their nibble
+		s1 = workBuffer[CSpuKernels::ADPCM_BLOCK_SAMPLES - 1] * 64;
+		s2 = workBuffer[CSpuKernels::ADPCM_BLOCK_SAMPLES - 2] * 64;
+		RoundUnpredictedSamples(workBuffer);
+		memcpy(dst, workBuffer, sizeof(int16) * CSpuKernels::ADPCM_BLOCK_SAMPLES);
+	}
+	else
+	{
+		ApplyAdpcmPredictor(dst, workBuffer, predictNumber, s1, s2);
+	}
+}
+
+static void MixSamplesSimd(int16* output, const int16* samples, const int16* volumes, unsigned int sampleCount)
+{
+	unsigned int groupSampleCount = sampleCount & ~3;
+	for(unsigned int i = 0; i < groupSampleCount; i += 4)
+	{
+		MixSampleGroup(output + (i * 2), samples + i, volumes + (i * 2));
+	}
+	MixSamplesScalar(output + (groupSampleCount * 2), samples + groupSampleCount, volumes + (groupSampleCount * 2), sampleCount - groupSampleCount);
+}
+
+#endif
+
+//////////////////////////////////////////////
+//Kernel selection
+
+static CSpuKernels::KERNELS MakeScalarKernels()
+{
+	CSpuKernels::KERNELS kernels;
+	kernels.decodeAdpcmBlock = &DecodeAdpcmBlockScalar;
+	kernels.mixSamples = &MixSamplesScalar;
+	return kernels;
+}
+
+static CSpuKernels::KERNELS MakeSimdKernels()
+{
+#ifdef HAS_SIMD
+	CSpuKernels::KERNELS kernels;
+	kernels.decodeAdpcmBlock = &DecodeAdpcmBlockSimd;
+	kernels.mixSamples = &MixSamplesSimd;
+	return kernels;
+#else
+	return MakeScalarKernels();
+#endif
+}
+
+bool CSpuKernels::IsSimdSupported()
+{
+#ifdef HAS_SIMD
+	//SSE2 and NEON are part of the baseline of the architectures we build them for
+	return true;
+#else
+	return false;
+#endif
+}
+
+const CSpuKernels::KERNELS& CSpuKernels::GetKernels()
+{
+	static const KERNELS& kernels = GetKernels(IsSimdSupported() ? KERNEL_SET_SIMD : KERNEL_SET_SCALAR);
+	return kernels;
+}
+
+const CSpuKernels::KERNELS& CSpuKernels::GetKernels(KERNEL_SET kernelSet)
+{
+	static const KERNELS scalarKernels = MakeScalarKernels();
+	static const KERNELS simdKernels = MakeSimdKernels();
+	assert((kernelSet == KERNEL_SET_SCALAR) || (kernelSet == KERNEL_SET_SIMD));
+	return (kernelSet == KERNEL_SET_SIMD) ? simdKernels : scalarKernels;
+}
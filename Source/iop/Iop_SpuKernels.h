@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Iop
+{
+	//Sample processing kernels used by the SPU cores. SIMD versions are used when available,
+	//scalar versions are kept as reference and both must produce the exact same output.
+	class CSpuKernels
+	{
+	public:
+		enum
+		{
+			ADPCM_BLOCK_SIZE = 0x10,
+			ADPCM_BLOCK_SAMPLES = 28,
+		};
+
+		//Arguments: destination (ADPCM_BLOCK_SAMPLES samples), ADPCM block (header included), previous samples (s1, s2) of the predictor
+		typedef void (*DecodeAdpcmBlockFunction)(int16*, const uint8*, int32&, int32&);
+		//Arguments: interleaved stereo output, mono samples, interleaved stereo volumes (0 to 0x7FFF), sample count.
+		//Adds (sample * volume) / 0x7FFF to both output channels with saturation.
+		typedef void (*MixSamplesFunction)(int16*, const int16*, const int16*, unsigned int);
+
+		enum KERNEL_SET
+		{
+			KERNEL_SET_SCALAR,
+			KERNEL_SET_SIMD,
+		};
+
+		struct KERNELS
+		{
+			DecodeAdpcmBlockFunction decodeAdpcmBlock = nullptr;
+			MixSamplesFunction mixSamples = nullptr;
+		};
+
+		static bool IsSimdSupported();
+
+		//Returns the best kernel set supported by the host
+		static const KERNELS& GetKernels();
+		static const KERNELS& GetKernels(KERNEL_SET);
+	};
+}
@@ -0,0 +1,312 @@
+#include <cassert>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <chrono>
+#include "Iop_SpuMixer.h"
+
+using namespace Iop;
+
+CSpuMixer::CSpuMixer(CSpuBase& core0, CSpuBase& core1, const uint8* ram, uint32 ramSize)
+    : m_emuRam(ram)
+    , m_emuCore0(core0)
+    , m_emuCore1(core1)
+    , m_ram(ramSize)
+    , m_core0(m_ram.data(), ramSize, 0)
+    , m_core1(m_ram.data(), ramSize, 1)
+    , m_spu(m_core0)
+    , m_spu2(m_core0, m_core1)
+    , m_events(EVENT_RING_SIZE)
+    , m_data(DATA_RING_SIZE)
+    , m_samples(SAMPLE_RING_SIZE)
+    , m_profilerZone(CProfiler::GetInstance().RegisterZone("SPUMIX"))
+{
+	m_core0.Reset();
+	m_core1.Reset();
+	m_spu.Reset();
+	m_spu2.Reset();
+	Resync();
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+CSpuMixer::~CSpuMixer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminate = true;
+	}
+	m_eventCondition.notify_one();
+	m_thread.join();
+}
+
+void CSpuMixer::WriteSpuRegister(uint32 address, uint16 value)
+{
+	EVENT event = {};
+	event.type = EVENT_WRITE_SPU_REGISTER;
+	event.param0 = address;
+	event.param1 = value;
+	PushEvent(event);
+}
+
+void CSpuMixer::WriteSpu2Register(uint32 address, uint32 value)
+{
+	EVENT event = {};
+	event.type = EVENT_WRITE_SPU2_REGISTER;
+	event.param0 = address;
+	event.param1 = value;
+	PushEvent(event);
+}
+
+void CSpuMixer::ReceiveDma(unsigned int coreId, const uint8* buffer, uint32 blockSize, uint32 blockAmount)
+{
+	assert(coreId < 2);
+	assert((blockSize != 0) && (blockSize <= MAX_DATA_SIZE));
+	//Replaying the transfer with the amount of blocks accepted by the emulated core gives the same result
+	uint32 maxBlockAmount = MAX_DATA_SIZE / blockSize;
+	while(blockAmount != 0)
+	{
+		uint32 chunkBlockAmount = std::min(blockAmount, maxBlockAmount);
+		uint32 chunkSize = chunkBlockAmount * blockSize;
+
+		EVENT event = {};
+		event.type = EVENT_RECEIVE_DMA;
+		event.param0 = coreId;
+		event.param1 = blockSize;
+		event.param2 = chunkBlockAmount;
+		event.dataSize = chunkSize;
+		auto data = AllocateData(chunkSize, event.dataPosition);
+		memcpy(data, buffer, chunkSize);
+		PushEvent(event);
+
+		buffer += chunkSize;
+		blockAmount -= chunkBlockAmount;
+	}
+}
+
+void CSpuMixer::Render(unsigned int sampleCount, unsigned int sampleRate)
+{
+	assert(sampleCount <= MAX_RENDER_SIZE);
+	EVENT event = {};
+	event.type = EVENT_RENDER;
+	event.param0 = sampleCount;
+	event.param1 = sampleRate;
+	PushEvent(event);
+	m_sampleTime += sampleCount;
+	m_sampleRate = sampleRate;
+	NotifyMixer();
+}
+
+void CSpuMixer::Resync()
+{
+	WaitForIdle();
+	//Mixer thread is waiting for events, its state can be safely modified
+	memcpy(m_ram.data(), m_emuRam, m_ram.size());
+	m_core0.CopyState(m_emuCore0);
+	m_core1.CopyState(m_emuCore1);
+	m_mixedSampleTime = m_sampleTime;
+}
+
+unsigned int CSpuMixer::ReadSamples(int16* samples, unsigned int sampleCount)
+{
+	uint32 readPosition = m_sampleReadPosition.load(std::memory_order_relaxed);
+	uint32 writePosition = m_sampleWritePosition.load(std::memory_order_acquire);
+	uint32 availableCount = std::min<uint32>(writePosition - readPosition, sampleCount);
+
+	uint32 offset = readPosition & (SAMPLE_RING_SIZE - 1);
+	uint32 firstCount = std::min<uint32>(availableCount, SAMPLE_RING_SIZE - offset);
+	memcpy(samples, m_samples.data() + offset, sizeof(int16) * firstCount);
+	memcpy(samples + firstCount, m_samples.data(), sizeof(int16) * (availableCount - firstCount));
+	m_sampleReadPosition.store(readPosition + availableCount, std::memory_order_release);
+
+	if(availableCount < sampleCount)
+	{
+		m_stats.underrunCount++;
+	}
+
+	//Samples still in flight (in the ring or waiting to be mixed) after this read
+	m_readSampleTime += availableCount;
+	if(m_sampleRate != 0)
+	{
+		uint64 doneSampleTime = m_readSampleTime + m_droppedSampleCount.load(std::memory_order_relaxed);
+		uint64 pendingSampleCount = (m_sampleTime - std::min(doneSampleTime, m_sampleTime)) / 2;
+		uint64 latency = (pendingSampleCount * 1000000000ULL) / m_sampleRate;
+		m_stats.maxLatency = std::max(m_stats.maxLatency, latency);
+	}
+
+	return availableCount;
+}
+
+CSpuMixer::STATS CSpuMixer::GetStats() const
+{
+	auto stats = m_stats;
+	stats.mixTime = m_mixTime.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void CSpuMixer::ResetStats()
+{
+	m_stats = STATS();
+	m_mixTime.store(0, std::memory_order_relaxed);
+}
+
+void CSpuMixer::PushEvent(const EVENT& inputEvent)
+{
+	uint32 writePosition = m_eventWritePosition.load(std::memory_order_relaxed);
+	while((writePosition - m_eventReadPosition.load(std::memory_order_acquire)) == EVENT_RING_SIZE)
+	{
+		NotifyMixer();
+		std::this_thread::yield();
+	}
+	auto& event = m_events[writePosition & (EVENT_RING_SIZE - 1)];
+	event = inputEvent;
+	event.sampleTime = m_sampleTime;
+	m_eventWritePosition.store(writePosition + 1, std::memory_order_release);
+}
+
+uint8* CSpuMixer::AllocateData(uint32 size, uint32& dataPosition)
+{
+	assert(size <= MAX_DATA_SIZE);
+	size = (size + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+
+	//Data must be contiguous, skip what's left at the end of the ring if it doesn't fit there
+	uint32 offset = m_dataWritePosition & (DATA_RING_SIZE - 1);
+	uint32 padding = ((offset + size) > DATA_RING_SIZE) ? (DATA_RING_SIZE - offset) : 0;
+	while((m_dataWritePosition - m_dataReadPosition.load(std::memory_order_acquire) + padding + size) > DATA_RING_SIZE)
+	{
+		NotifyMixer();
+		std::this_thread::yield();
+	}
+
+	m_dataWritePosition += padding;
+	dataPosition = m_dataWritePosition;
+	m_dataWritePosition += size;
+	return m_data.data() + (dataPosition & (DATA_RING_SIZE - 1));
+}
+
+void CSpuMixer::NotifyMixer()
+{
+	//Taking the lock prevents the notification from being lost between the mixer's check and wait
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_eventCondition.notify_one();
+}
+
+void CSpuMixer::WaitForIdle()
+{
+	uint32 writePosition = m_eventWritePosition.load(std::memory_order_relaxed);
+	while(m_eventReadPosition.load(std::memory_order_acquire) != writePosition)
+	{
+		NotifyMixer();
+		std::this_thread::yield();
+	}
+}
+
+void CSpuMixer::ThreadProc()
+{
+	CProfiler::GetInstance().SetThreadName("SPU");
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_eventCondition.wait(lock,
+			                      [this]() {
+				                      return m_terminate ||
+				                             (m_eventReadPosition.load(std::memory_order_relaxed) != m_eventWritePosition.load(std::memory_order_acquire));
+			                      });
+			if(m_terminate) break;
+		}
+		ProcessEvents();
+	}
+}
+
+void CSpuMixer::ProcessEvents()
+{
+	uint32 writePosition = m_eventWritePosition.load(std::memory_order_acquire);
+	uint32 readPosition = m_eventReadPosition.load(std::memory_order_relaxed);
+	for(; readPosition != writePosition; readPosition++)
+	{
+		const auto& event = m_events[readPosition & (EVENT_RING_SIZE - 1)];
+		//Events must be replayed at the same point they occured in the emulation
+		assert(event.sampleTime == m_mixedSampleTime);
+		switch(event.type)
+		{
+		case EVENT_WRITE_SPU_REGISTER:
+			m_spu.WriteRegister(event.param0, static_cast<uint16>(event.param1));
+			break;
+		case EVENT_WRITE_SPU2_REGISTER:
+			m_spu2.WriteRegister(event.param0, event.param1);
+			break;
+		case EVENT_RECEIVE_DMA:
+		{
+			auto& core = (event.param0 == 0) ? m_core0 : m_core1;
+			auto data = m_data.data() + (event.dataPosition & (DATA_RING_SIZE - 1));
+			uint32 blockAmount = core.ReceiveDma(data, event.param1, event.param2);
+			assert(blockAmount == event.param2);
+			uint32 dataSize = (event.dataSize + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+			m_dataReadPosition.store(event.dataPosition + dataSize, std::memory_order_release);
+		}
+		break;
+		case EVENT_RENDER:
+			ProcessRender(event);
+			break;
+		default:
+			assert(false);
+			break;
+		}
+		m_eventReadPosition.store(readPosition + 1, std::memory_order_release);
+	}
+}
+
+void CSpuMixer::ProcessRender(const EVENT& event)
+{
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_profilerZone);
+#endif
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	unsigned int sampleCount = event.param0;
+	unsigned int sampleRate = event.param1;
+
+	int16 samples[MAX_RENDER_SIZE];
+	m_core0.Render(samples, sampleCount, sampleRate);
+
+	if(m_core1.IsEnabled())
+	{
+		int16 samplesSpu1[MAX_RENDER_SIZE];
+		m_core1.Render(samplesSpu1, sampleCount, sampleRate);
+
+		for(unsigned int i = 0; i < sampleCount; i++)
+		{
+			int32 resultSample = static_cast<int32>(samples[i]) + static_cast<int32>(samplesSpu1[i]);
+			resultSample = std::max<int32>(resultSample, SHRT_MIN);
+			resultSample = std::min<int32>(resultSample, SHRT_MAX);
+			samples[i] = static_cast<int16>(resultSample);
+		}
+	}
+
+	m_mixedSampleTime += sampleCount;
+	PushSamples(samples, sampleCount);
+
+	auto mixTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+	m_mixTime.fetch_add(mixTime.count(), std::memory_order_relaxed);
+}
+
+void CSpuMixer::PushSamples(const int16* samples, unsigned int sampleCount)
+{
+	uint32 writePosition = m_sampleWritePosition.load(std::memory_order_relaxed);
+	uint32 readPosition = m_sampleReadPosition.load(std::memory_order_acquire);
+	//Samples are dropped if nobody reads them, the mixer never waits for the consumer
+	if((writePosition - readPosition + sampleCount) > SAMPLE_RING_SIZE)
+	{
+		m_droppedSampleCount.fetch_add(sampleCount, std::memory_order_relaxed);
+		return;
+	}
+
+	uint32 offset = writePosition & (SAMPLE_RING_SIZE - 1);
+	uint32 firstCount = std::min<uint32>(sampleCount, SAMPLE_RING_SIZE - offset);
+	memcpy(m_samples.data() + offset, samples, sizeof(int16) * firstCount);
+	memcpy(m_samples.data(), samples + firstCount, sizeof(int16) * (sampleCount - firstCount));
+	m_sampleWritePosition.store(writePosition + sampleCount, std::memory_order_release);
+}
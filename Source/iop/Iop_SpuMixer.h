@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Types.h"
+#include "../Profiler.h"
+#include "Iop_SpuBase.h"
+#include "Iop_Spu.h"
+#include "Iop_Spu2.h"
+
+namespace Iop
+{
+	//Mixes SPU samples on a worker thread. The emulated SPU cores keep being rendered on the emulation
+	//side without an output buffer, which only updates the state the IOP can observe. Everything that
+	//changes SPU state (register writes, DMA transfers) is forwarded to the mixer as events stamped with
+	//the number of samples rendered so far. The mixer replays these events on its own copy of the SPU
+	//cores and RAM, which evolves exactly like the emulated one, and pushes the rendered samples in a
+	//lock-free ring drained when buffers are handed to the sound handler.
+	class CSpuMixer
+	{
+	public:
+		struct STATS
+		{
+			uint32 underrunCount = 0;
+			//Times are in nanoseconds
+			uint64 mixTime = 0;
+			//Largest delay between a sample being rendered by the emulation and being read from the ring
+			uint64 maxLatency = 0;
+		};
+
+		CSpuMixer(CSpuBase&, CSpuBase&, const uint8*, uint32);
+		virtual ~CSpuMixer();
+
+		CSpuMixer(const CSpuMixer&) = delete;
+		CSpuMixer& operator=(const CSpuMixer&) = delete;
+
+		//Producer side, must be called in emulation order
+		void WriteSpuRegister(uint32, uint16);
+		void WriteSpu2Register(uint32, uint32);
+		//Arguments: core, buffer, block size, amount of blocks accepted by the emulated core
+		void ReceiveDma(unsigned int, const uint8*, uint32, uint32);
+		//Arguments: sample count (stereo pairs * 2), sample rate
+		void Render(unsigned int, unsigned int);
+
+		//Waits for pending events and copies the state of the emulated SPU (after reset or state load)
+		void Resync();
+
+		//Consumer side, returns the amount of samples copied
+		unsigned int ReadSamples(int16*, unsigned int);
+
+		STATS GetStats() const;
+		void ResetStats();
+
+	private:
+		enum EVENT_TYPE : uint32
+		{
+			EVENT_WRITE_SPU_REGISTER,
+			EVENT_WRITE_SPU2_REGISTER,
+			EVENT_RECEIVE_DMA,
+			EVENT_RENDER,
+		};
+
+		struct EVENT
+		{
+			EVENT_TYPE type;
+			uint32 param0;
+			uint32 param1;
+			uint32 param2;
+			uint32 dataPosition;
+			uint32 dataSize;
+			//Amount of samples rendered by the emulation when the event occured
+			uint64 sampleTime;
+		};
+
+		enum
+		{
+			EVENT_RING_SIZE = 0x10000,
+			DATA_RING_SIZE = 0x100000,
+			DATA_ALIGNMENT = 0x10,
+			//Larger DMA transfers are split in several events
+			MAX_DATA_SIZE = DATA_RING_SIZE / 4,
+			SAMPLE_RING_SIZE = 0x20000,
+			MAX_RENDER_SIZE = 0x400,
+		};
+		static_assert((EVENT_RING_SIZE & (EVENT_RING_SIZE - 1)) == 0, "Event ring size must be a power of 2.");
+		static_assert((DATA_RING_SIZE & (DATA_RING_SIZE - 1)) == 0, "Data ring size must be a power of 2.");
+		static_assert((SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1)) == 0, "Sample ring size must be a power of 2.");
+
+		void PushEvent(const EVENT&);
+		uint8* AllocateData(uint32, uint32&);
+		void NotifyMixer();
+		void WaitForIdle();
+
+		void ThreadProc();
+		void ProcessEvents();
+		void ProcessRender(const EVENT&);
+		void PushSamples(const int16*, unsigned int);
+
+		const uint8* m_emuRam = nullptr;
+		CSpuBase& m_emuCore0;
+		CSpuBase& m_emuCore1;
+
+		//Owned by the mixer thread
+		std::vector<uint8> m_ram;
+		CSpuBase m_core0;
+		CSpuBase m_core1;
+		CSpu m_spu;
+		CSpu2 m_spu2;
+		uint64 m_mixedSampleTime = 0;
+
+		std::vector<EVENT> m_events;
+		std::atomic<uint32> m_eventWritePosition = {0};
+		std::atomic<uint32> m_eventReadPosition = {0};
+
+		std::vector<uint8> m_data;
+		//Only used by producer
+		uint32 m_dataWritePosition = 0;
+		std::atomic<uint32> m_dataReadPosition = {0};
+
+		std::vector<int16> m_samples;
+		std::atomic<uint32> m_sampleWritePosition = {0};
+		std::atomic<uint32> m_sampleReadPosition = {0};
+		std::atomic<uint64> m_droppedSampleCount = {0};
+
+		//Only used by producer
+		uint64 m_sampleTime = 0;
+		uint64 m_readSampleTime = 0;
+		unsigned int m_sampleRate = 0;
+
+		STATS m_stats;
+		std::atomic<uint64> m_mixTime = {0};
+		CProfiler::ZoneHandle m_profilerZone = 0;
+
+		std::thread m_thread;
+		bool m_terminate = false;
+		std::mutex m_mutex;
+		std::condition_variable m_eventCondition;
+	};
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "Iop_SubSystem.h"
 #include "IopBios.h"
 #include "GenericMipsExecutor.h"
@@ -17,6 +18,8 @@ using namespace PS2;
 #define STATE_SCRATCH ("iop_scratch")
 #define STATE_SPURAM ("iop_spuram")
 
+static const int g_dmaUpdateDelay = 10000;
+
 CSubSystem::CSubSystem(bool ps2Mode)
     : m_cpu(MEMORYMAP_ENDIAN_LSBF, true)
     , m_ram(new uint8[IOP_RAM_SIZE])
@@ -52,7 +55,7 @@ CSubSystem::CSubSystem(bool ps2Mode)
 	m_cpu.m_pMemoryMap->InsertReadMap((2 * IOP_RAM_SIZE), (2 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x03);
 	m_cpu.m_pMemoryMap->InsertReadMap((3 * IOP_RAM_SIZE), (3 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x04);
 	m_cpu.m_pMemoryMap->InsertReadMap(IOP_SCRATCH_ADDR, IOP_SCRATCH_ADDR + IOP_SCRATCH_SIZE - 1, m_scratchPad, 0x05);
-	m_cpu.m_pMemoryMap->InsertReadMap(HW_REG_BEGIN, HW_REG_END, std::bind(&CSubSystem::ReadIoRegister, this, std::placeholders::_1), 0x06);
+	m_cpu.m_pMemoryMap->InsertReadMap(HW_REG_BEGIN, HW_REG_END, &CMemoryMap::ReadHandlerProxy<CSubSystem, &CSubSystem::ReadIoRegister>, this, 0x06);
 
 	//Write memory map
 	m_cpu.m_pMemoryMap->InsertWriteMap((0 * IOP_RAM_SIZE), (0 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x01);
@@ -60,7 +63,7 @@ CSubSystem::CSubSystem(bool ps2Mode)
 	m_cpu.m_pMemoryMap->InsertWriteMap((2 * IOP_RAM_SIZE), (2 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x03);
 	m_cpu.m_pMemoryMap->InsertWriteMap((3 * IOP_RAM_SIZE), (3 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x04);
 	m_cpu.m_pMemoryMap->InsertWriteMap(IOP_SCRATCH_ADDR, IOP_SCRATCH_ADDR + IOP_SCRATCH_SIZE - 1, m_scratchPad, 0x05);
-	m_cpu.m_pMemoryMap->InsertWriteMap(HW_REG_BEGIN, HW_REG_END, std::bind(&CSubSystem::WriteIoRegister, this, std::placeholders::_1, std::placeholders::_2), 0x06);
+	m_cpu.m_pMemoryMap->InsertWriteMap(HW_REG_BEGIN, HW_REG_END, &CMemoryMap::WriteHandlerProxy<CSubSystem, &CSubSystem::WriteIoRegister>, this, 0x06);
 
 	//Instruction memory map
 	m_cpu.m_pMemoryMap->InsertInstructionMap((0 * IOP_RAM_SIZE), (0 * IOP_RAM_SIZE) + IOP_RAM_SIZE - 1, m_ram, 0x01);
@@ -72,8 +75,8 @@ CSubSystem::CSubSystem(bool ps2Mode)
 	m_cpu.m_pCOP[0] = &m_copScu;
 	m_cpu.m_pAddrTranslator = &CMIPS::TranslateAddress64;
 
-	m_dmac.SetReceiveFunction(4, std::bind(&CSpuBase::ReceiveDma, &m_spuCore0, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
-	m_dmac.SetReceiveFunction(8, std::bind(&CSpuBase::ReceiveDma, &m_spuCore1, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
+	m_dmac.SetReceiveFunction(4, std::bind(&CSubSystem::ReceiveSpuDma, this, 0, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
+	m_dmac.SetReceiveFunction(8, std::bind(&CSubSystem::ReceiveSpuDma, this, 1, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
 
 	SetupPageTable();
 }
@@ -132,6 +135,16 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 	m_bios->LoadState(archive);
 }
 
+CCodeArena::STATS CSubSystem::GetCodeArenaStats() const
+{
+	return static_cast<CGenericMipsExecutor<BlockLookupOneWay>*>(m_cpu.m_executor.get())->GetCodeArenaStats();
+}
+
+void CSubSystem::SetSpuMixer(CSpuMixer* spuMixer)
+{
+	m_spuMixer = spuMixer;
+}
+
 void CSubSystem::Reset()
 {
 	memset(m_ram, 0, IOP_RAM_SIZE);
@@ -231,6 +244,10 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 	else if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
 	{
 		m_spu.WriteRegister(address, static_cast<uint16>(value));
+		if(m_spuMixer)
+		{
+			m_spuMixer->WriteSpuRegister(address, static_cast<uint16>(value));
+		}
 	}
 	else if(address >= CDmac::DMAC_ZONE2_START && address <= CDmac::DMAC_ZONE2_END)
 	{
@@ -254,7 +271,12 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 #endif
 	else if(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END)
 	{
-		return m_spu2.WriteRegister(address, value);
+		uint32 result = m_spu2.WriteRegister(address, value);
+		if(m_spuMixer)
+		{
+			m_spuMixer->WriteSpu2Register(address, value);
+		}
+		return result;
 	}
 	else
 	{
@@ -272,6 +294,17 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 	return 0;
 }
 
+uint32 CSubSystem::ReceiveSpuDma(unsigned int coreId, uint8* buffer, uint32 blockSize, uint32 blockAmount)
+{
+	auto& spuCore = (coreId == 0) ? m_spuCore0 : m_spuCore1;
+	uint32 result = spuCore.ReceiveDma(buffer, blockSize, blockAmount);
+	if(m_spuMixer && (result != 0))
+	{
+		m_spuMixer->ReceiveDma(coreId, buffer, blockSize, result);
+	}
+	return result;
+}
+
 void CSubSystem::CheckPendingInterrupts()
 {
 	if(!m_cpu.m_State.nHasException)
@@ -288,9 +321,20 @@ bool CSubSystem::IsCpuIdle()
 	return m_bios->IsIdle();
 }
 
+uint64 CSubSystem::GetTicksUntilNextEvent()
+{
+	if(m_intc.HasPendingInterrupt())
+	{
+		return 0;
+	}
+	uint64 result = g_dmaUpdateDelay - m_dmaUpdateTicks;
+	result = std::min<uint64>(result, m_counters.GetTicksUntilNextEvent());
+	result = std::min<uint64>(result, m_bios->GetTicksUntilNextEvent());
+	return result;
+}
+
 void CSubSystem::CountTicks(int ticks)
 {
-	static const int g_dmaUpdateDelay = 10000;
 	m_counters.Update(ticks);
 	m_bios->CountTicks(ticks);
 	m_dmaUpdateTicks += ticks;
@@ -3,9 +3,11 @@
 #include "../MIPS.h"
 #include "../MA_MIPSIV.h"
 #include "../COP_SCU.h"
+#include "../CodeArena.h"
 #include "Iop_SpuBase.h"
 #include "Iop_Spu.h"
 #include "Iop_Spu2.h"
+#include "Iop_SpuMixer.h"
 #include "Iop_Sio2.h"
 #include "Iop_Dmac.h"
 #include "Iop_Intc.h"
@@ -26,6 +28,8 @@ namespace Iop
 		int ExecuteCpu(int);
 		bool IsCpuIdle();
 		void CountTicks(int);
+		//Ticks the CPU can stay idle without missing a device event
+		uint64 GetTicksUntilNextEvent();
 
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
@@ -33,6 +37,11 @@ namespace Iop
 		void SaveState(Framework::CZipArchiveWriter&);
 		void LoadState(Framework::CZipArchiveReader&);
 
+		CCodeArena::STATS GetCodeArenaStats() const;
+
+		//When set, SPU register writes and DMA transfers are forwarded to the mixer
+		void SetSpuMixer(CSpuMixer*);
+
 		uint8* m_ram;
 		uint8* m_scratchPad;
 		uint8* m_spuRam;
@@ -63,8 +72,11 @@ namespace Iop
 		uint32 ReadIoRegister(uint32);
 		uint32 WriteIoRegister(uint32, uint32);
 
+		uint32 ReceiveSpuDma(unsigned int, uint8*, uint32, uint32);
+
 		void CheckPendingInterrupts();
 
 		int m_dmaUpdateTicks;
+		CSpuMixer* m_spuMixer = nullptr;
 	};
 }
@@ -1,10 +1,13 @@
 #include "MemoryStateFile.h"
+#include "StateSnapshot.h"
 
 CMemoryStateFile::CMemoryStateFile(const char* name, const void* memory, size_t size)
     : CZipFile(name)
     , m_memory(memory)
     , m_size(size)
 {
+	//Memory needs to be copied right away if a snapshot is being captured
+	CStateSnapshot::CaptureMemory(name, m_memory, m_size);
 }
 
 void CMemoryStateFile::Write(Framework::CStream& stream)
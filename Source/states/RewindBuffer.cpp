@@ -0,0 +1,263 @@
+#include <cassert>
+#include <cstring>
+#include <list>
+#include "RewindBuffer.h"
+#include "MemoryStateFile.h"
+#include "MemStream.h"
+
+struct DELTA_RECORD_HEADER
+{
+	//Distance from the end of the previous record
+	uint32 skip;
+	uint32 length;
+};
+
+static uint64 LoadWord(const uint8* memory, size_t offset)
+{
+	uint64 result = 0;
+	memcpy(&result, memory + offset, sizeof(uint64));
+	return result;
+}
+
+static void WriteDeltaRecord(CStateSnapshot::Buffer& delta, size_t skip, const uint8* older, const uint8* newer, size_t length)
+{
+	DELTA_RECORD_HEADER header;
+	header.skip = static_cast<uint32>(skip);
+	header.length = static_cast<uint32>(length);
+	size_t offset = delta.size();
+	delta.resize(offset + sizeof(DELTA_RECORD_HEADER) + length);
+	memcpy(delta.data() + offset, &header, sizeof(DELTA_RECORD_HEADER));
+	auto dst = delta.data() + offset + sizeof(DELTA_RECORD_HEADER);
+	for(size_t i = 0; i < length; i++)
+	{
+		dst[i] = older[i] ^ newer[i];
+	}
+}
+
+CRewindBuffer::CRewindBuffer(size_t memoryBudget)
+    : m_memoryBudget(memoryBudget)
+{
+	m_snapshot.SetDetachThreshold(DETACH_THRESHOLD);
+}
+
+void CRewindBuffer::SetMemoryBudget(size_t memoryBudget)
+{
+	m_memoryBudget = memoryBudget;
+	TrimToBudget();
+}
+
+size_t CRewindBuffer::GetMemoryUsage() const
+{
+	return m_memoryUsage;
+}
+
+unsigned int CRewindBuffer::GetStateCount() const
+{
+	return static_cast<unsigned int>(m_states.size()) + (m_hasCurrentState ? 1 : 0);
+}
+
+void CRewindBuffer::Capture(const SaveFunction& saveFunction)
+{
+	m_snapshot.Capture(saveFunction);
+
+	Buffer archive;
+	{
+		Framework::CMemStream archiveStream;
+		m_snapshot.Write(archiveStream);
+		auto archiveData = archiveStream.GetBuffer();
+		archive.assign(archiveData, archiveData + archiveStream.GetSize());
+	}
+
+	const auto& detachedNames = m_snapshot.GetDetachedNames();
+
+	//Differences can only be made if the memory layout didn't change since the last capture
+	bool layoutMatches = m_hasCurrentState && (detachedNames.size() == m_currentMemory.size());
+	for(const auto& name : detachedNames)
+	{
+		if(!layoutMatches) break;
+		auto memoryIterator = m_currentMemory.find(name);
+		layoutMatches = (memoryIterator != std::end(m_currentMemory)) &&
+		                (memoryIterator->second.size() == m_snapshot.GetDetachedMemory(name).size());
+	}
+
+	if(layoutMatches)
+	{
+		STATE state;
+		state.archive = std::move(m_currentArchive);
+		for(const auto& name : detachedNames)
+		{
+			EncodeDelta(m_deltaBuffer, m_currentMemory[name], m_snapshot.GetDetachedMemory(name));
+			state.memoryDeltas[name].assign(std::begin(m_deltaBuffer), std::end(m_deltaBuffer));
+		}
+		m_memoryUsage += GetStateSize(state);
+		m_states.push_back(std::move(state));
+	}
+	else
+	{
+		Clear();
+	}
+
+	//Exchange buffers with the snapshot to avoid copying memory, the snapshot will reuse ours on the next capture
+	m_currentArchive = std::move(archive);
+	for(const auto& name : detachedNames)
+	{
+		std::swap(m_currentMemory[name], m_snapshot.GetDetachedMemory(name));
+	}
+	m_hasCurrentState = true;
+
+	TrimToBudget();
+}
+
+bool CRewindBuffer::Rewind(const LoadFunction& loadFunction)
+{
+	if(!m_hasCurrentState)
+	{
+		return false;
+	}
+
+	{
+		Framework::CMemStream archiveStream;
+		archiveStream.Write(m_currentArchive.data(), m_currentArchive.size());
+		archiveStream.Seek(0, Framework::STREAM_SEEK_SET);
+		Framework::CZipArchiveReader archive(archiveStream);
+
+		//Put the detached memory back in a complete archive
+		std::list<Buffer> contents;
+		Framework::CZipArchiveWriter completeArchive;
+		for(const auto& fileHeaderPair : archive.GetFileHeaders())
+		{
+			const auto& name = fileHeaderPair.first;
+			auto memoryIterator = m_currentMemory.find(name);
+			if(memoryIterator != std::end(m_currentMemory))
+			{
+				const auto& memory = memoryIterator->second;
+				completeArchive.InsertFile(new CMemoryStateFile(name.c_str(), memory.data(), memory.size()));
+				continue;
+			}
+			contents.emplace_back(fileHeaderPair.second.uncompressedSize);
+			auto& content = contents.back();
+			archive.BeginReadFile(name.c_str())->Read(content.data(), content.size());
+			completeArchive.InsertFile(new CMemoryStateFile(name.c_str(), content.data(), content.size()));
+		}
+
+		Framework::CMemStream completeArchiveStream;
+		completeArchive.Write(completeArchiveStream);
+		completeArchiveStream.Seek(0, Framework::STREAM_SEEK_SET);
+		Framework::CZipArchiveReader completeArchiveReader(completeArchiveStream);
+		loadFunction(completeArchiveReader);
+	}
+
+	if(m_states.empty())
+	{
+		m_hasCurrentState = false;
+		m_currentArchive.clear();
+		m_currentMemory.clear();
+		return true;
+	}
+
+	//Previous state becomes the most recent one
+	auto& state = m_states.back();
+	m_currentArchive = std::move(state.archive);
+	for(const auto& memoryDeltaPair : state.memoryDeltas)
+	{
+		ApplyDelta(m_currentMemory[memoryDeltaPair.first], memoryDeltaPair.second);
+	}
+	m_memoryUsage -= GetStateSize(state);
+	m_states.pop_back();
+
+	return true;
+}
+
+void CRewindBuffer::Clear()
+{
+	m_states.clear();
+	m_memoryUsage = 0;
+	m_hasCurrentState = false;
+	m_currentArchive.clear();
+	m_currentMemory.clear();
+}
+
+size_t CRewindBuffer::GetStateSize(const STATE& state)
+{
+	size_t size = state.archive.size();
+	for(const auto& memoryDeltaPair : state.memoryDeltas)
+	{
+		size += memoryDeltaPair.second.size();
+	}
+	return size;
+}
+
+void CRewindBuffer::TrimToBudget()
+{
+	while(!m_states.empty() && (m_memoryUsage > m_memoryBudget))
+	{
+		m_memoryUsage -= GetStateSize(m_states.front());
+		m_states.pop_front();
+	}
+}
+
+void CRewindBuffer::EncodeDelta(Buffer& delta, const Buffer& olderBuffer, const Buffer& newerBuffer)
+{
+	assert(olderBuffer.size() == newerBuffer.size());
+	auto older = olderBuffer.data();
+	auto newer = newerBuffer.data();
+	size_t size = olderBuffer.size();
+	size_t alignedSize = size & ~(sizeof(uint64) - 1);
+	size_t previousRecordEnd = 0;
+	size_t position = 0;
+
+	delta.clear();
+	while(position < alignedSize)
+	{
+		if(LoadWord(older, position) == LoadWord(newer, position))
+		{
+			position += sizeof(uint64);
+			continue;
+		}
+
+		//Extend the record until enough identical words are found to make a new record worthwhile
+		size_t recordStart = position;
+		size_t recordEnd = position + sizeof(uint64);
+		position = recordEnd;
+		while((position < alignedSize) && ((position - recordEnd) < (RECORD_MIN_GAP * sizeof(uint64))))
+		{
+			if(LoadWord(older, position) != LoadWord(newer, position))
+			{
+				recordEnd = position + sizeof(uint64);
+			}
+			position += sizeof(uint64);
+		}
+
+		WriteDeltaRecord(delta, recordStart - previousRecordEnd, older + recordStart, newer + recordStart, recordEnd - recordStart);
+		previousRecordEnd = recordEnd;
+	}
+
+	if((alignedSize != size) && (memcmp(older + alignedSize, newer + alignedSize, size - alignedSize) != 0))
+	{
+		WriteDeltaRecord(delta, alignedSize - previousRecordEnd, older + alignedSize, newer + alignedSize, size - alignedSize);
+	}
+}
+
+void CRewindBuffer::ApplyDelta(Buffer& memory, const Buffer& delta)
+{
+	size_t position = 0;
+	size_t deltaPosition = 0;
+	while(deltaPosition < delta.size())
+	{
+		DELTA_RECORD_HEADER header;
+		assert((deltaPosition + sizeof(DELTA_RECORD_HEADER)) <= delta.size());
+		memcpy(&header, delta.data() + deltaPosition, sizeof(DELTA_RECORD_HEADER));
+		deltaPosition += sizeof(DELTA_RECORD_HEADER);
+		position += header.skip;
+		assert((position + header.length) <= memory.size());
+		assert((deltaPosition + header.length) <= delta.size());
+		auto dst = memory.data() + position;
+		auto src = delta.data() + deltaPosition;
+		for(uint32 i = 0; i < header.length; i++)
+		{
+			dst[i] ^= src[i];
+		}
+		position += header.length;
+		deltaPosition += header.length;
+	}
+}
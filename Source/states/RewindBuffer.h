@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include "Types.h"
+#include "StateSnapshot.h"
+
+//Keeps recent states in memory. Only the most recent state holds a complete copy of the memory, older states
+//store the difference (XOR) between their memory and the memory of the state captured after them, with runs of
+//identical words left out. Oldest states are dropped when the differences exceed the memory budget.
+class CRewindBuffer
+{
+public:
+	typedef CStateSnapshot::SaveFunction SaveFunction;
+	typedef std::function<void(Framework::CZipArchiveReader&)> LoadFunction;
+
+	CRewindBuffer(size_t);
+	CRewindBuffer(const CRewindBuffer&) = delete;
+	CRewindBuffer& operator=(const CRewindBuffer&) = delete;
+
+	void SetMemoryBudget(size_t);
+	//Memory used by the differences, the most recent state isn't accounted
+	size_t GetMemoryUsage() const;
+	unsigned int GetStateCount() const;
+
+	void Capture(const SaveFunction&);
+	//Loads the most recent state and removes it, returns false if there are no states left
+	bool Rewind(const LoadFunction&);
+	void Clear();
+
+private:
+	typedef CStateSnapshot::Buffer Buffer;
+	typedef std::map<std::string, Buffer> BufferMap;
+
+	enum
+	{
+		//Memory files of this size or more are stored as differences
+		DETACH_THRESHOLD = 0x1000,
+		//Number of identical words needed to end a difference record
+		RECORD_MIN_GAP = 2,
+	};
+
+	struct STATE
+	{
+		//Archive without the detached memory
+		Buffer archive;
+		//Difference between the memory of this state and the memory of the following state
+		BufferMap memoryDeltas;
+	};
+
+	static size_t GetStateSize(const STATE&);
+	static void EncodeDelta(Buffer&, const Buffer&, const Buffer&);
+	static void ApplyDelta(Buffer&, const Buffer&);
+	void TrimToBudget();
+
+	CStateSnapshot m_snapshot;
+	std::deque<STATE> m_states;
+	size_t m_memoryBudget = 0;
+	size_t m_memoryUsage = 0;
+
+	//Most recent state
+	bool m_hasCurrentState = false;
+	Buffer m_currentArchive;
+	BufferMap m_currentMemory;
+
+	Buffer m_deltaBuffer;
+};
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include "StateSnapshot.h"
+#include "MemoryStateFile.h"
+#include "RegisterStateFile.h"
+
+#define STATE_SNAPSHOT_INFO ("snapshot.xml")
+#define STATE_SNAPSHOT_INFO_ID ("Id")
+#define STATE_SNAPSHOT_INFO_BASEID ("BaseId")
+#define STATE_SNAPSHOT_DELTAS ("snapshot_deltas.xml")
+
+struct DELTA_HEADER
+{
+	uint32 pageSize;
+	uint32 pageCount;
+};
+
+//Snapshot capturing memory on the current thread
+static thread_local CStateSnapshot* g_captureSnapshot = nullptr;
+
+static uint64 GenerateId()
+{
+	std::random_device device;
+	uint64 id = 0;
+	while(id == 0)
+	{
+		id = (static_cast<uint64>(device()) << 32) | static_cast<uint64>(device());
+	}
+	return id;
+}
+
+void CStateSnapshot::Capture(const SaveFunction& saveFunction, const CStateSnapshot* base)
+{
+	assert(!m_archive);
+	assert(g_captureSnapshot == nullptr);
+	assert(!base || (!base->IsIncremental() && (base != this)));
+	assert(!base || (m_detachThreshold == 0));
+
+	m_archive = std::make_unique<Framework::CZipArchiveWriter>();
+	m_base = base;
+	m_id = GenerateId();
+	m_deltaSizes.clear();
+	m_detachedNames.clear();
+
+	//Buffers are moved to the new map as they are captured, the ones that aren't captured again are released
+	m_previousBuffers = std::move(m_buffers);
+	m_buffers.clear();
+
+	g_captureSnapshot = this;
+	try
+	{
+		saveFunction(*m_archive);
+	}
+	catch(...)
+	{
+		g_captureSnapshot = nullptr;
+		m_archive.reset();
+		m_previousBuffers.clear();
+		throw;
+	}
+	g_captureSnapshot = nullptr;
+	m_previousBuffers.clear();
+
+	{
+		auto infoFile = new CRegisterStateFile(STATE_SNAPSHOT_INFO);
+		infoFile->SetRegister64(STATE_SNAPSHOT_INFO_ID, m_id);
+		infoFile->SetRegister64(STATE_SNAPSHOT_INFO_BASEID, m_base ? m_base->m_id : 0);
+		m_archive->InsertFile(infoFile);
+	}
+
+	if(m_base)
+	{
+		auto deltasFile = new CRegisterStateFile(STATE_SNAPSHOT_DELTAS);
+		for(const auto& deltaSizePair : m_deltaSizes)
+		{
+			deltasFile->SetRegister64(deltaSizePair.first.c_str(), deltaSizePair.second);
+		}
+		m_archive->InsertFile(deltasFile);
+	}
+}
+
+bool CStateSnapshot::IsCaptured() const
+{
+	return static_cast<bool>(m_archive);
+}
+
+void CStateSnapshot::Write(Framework::CStream& stream)
+{
+	assert(m_archive);
+	auto archive = std::move(m_archive);
+	archive->Write(stream);
+}
+
+uint64 CStateSnapshot::GetId() const
+{
+	return m_id;
+}
+
+bool CStateSnapshot::IsIncremental() const
+{
+	return (m_base != nullptr);
+}
+
+void CStateSnapshot::SetDetachThreshold(size_t detachThreshold)
+{
+	m_detachThreshold = detachThreshold;
+}
+
+const CStateSnapshot::NameArray& CStateSnapshot::GetDetachedNames() const
+{
+	return m_detachedNames;
+}
+
+CStateSnapshot::Buffer& CStateSnapshot::GetDetachedMemory(const std::string& name)
+{
+	assert(std::find(std::begin(m_detachedNames), std::end(m_detachedNames), name) != std::end(m_detachedNames));
+	return m_buffers[name];
+}
+
+void CStateSnapshot::CaptureMemory(const char* name, const void*& memory, size_t& size)
+{
+	if(g_captureSnapshot == nullptr) return;
+	g_captureSnapshot->CaptureMemoryImpl(name, memory, size);
+}
+
+void CStateSnapshot::CaptureMemoryImpl(const char* name, const void*& memory, size_t& size)
+{
+	assert(m_buffers.find(name) == std::end(m_buffers));
+	auto& buffer = m_buffers[name];
+	auto previousBufferIterator = m_previousBuffers.find(name);
+	if(previousBufferIterator != std::end(m_previousBuffers))
+	{
+		buffer = std::move(previousBufferIterator->second);
+	}
+
+	auto src = reinterpret_cast<const uint8*>(memory);
+	const Buffer* baseBuffer = nullptr;
+	if(m_base && (size >= INCREMENTAL_MIN_SIZE))
+	{
+		auto baseBufferIterator = m_base->m_buffers.find(name);
+		if((baseBufferIterator != std::end(m_base->m_buffers)) && (baseBufferIterator->second.size() == size))
+		{
+			baseBuffer = &baseBufferIterator->second;
+		}
+	}
+
+	if(baseBuffer)
+	{
+		MakeDelta(buffer, src, size, *baseBuffer);
+		m_deltaSizes[name] = size;
+	}
+	else
+	{
+		buffer.resize(size);
+		if(size != 0)
+		{
+			memcpy(buffer.data(), src, size);
+		}
+	}
+
+	memory = buffer.data();
+	size = buffer.size();
+
+	if((m_detachThreshold != 0) && (size >= m_detachThreshold))
+	{
+		m_detachedNames.push_back(name);
+		size = 0;
+	}
+}
+
+//Delta layout: header, bitmap of the pages that differ from the base, content of those pages
+void CStateSnapshot::MakeDelta(Buffer& delta, const uint8* memory, size_t size, const Buffer& base)
+{
+	assert(base.size() == size);
+
+	DELTA_HEADER header;
+	header.pageSize = PAGE_SIZE;
+	header.pageCount = static_cast<uint32>((size + PAGE_SIZE - 1) / PAGE_SIZE);
+	size_t bitmapOffset = sizeof(DELTA_HEADER);
+	size_t bitmapSize = (header.pageCount + 7) / 8;
+
+	//Reserving for the worst case makes sure the buffer is only allocated on the first capture
+	delta.reserve(bitmapOffset + bitmapSize + size);
+	delta.assign(bitmapOffset + bitmapSize, 0);
+	memcpy(delta.data(), &header, sizeof(DELTA_HEADER));
+
+	for(uint32 page = 0; page < header.pageCount; page++)
+	{
+		size_t pageOffset = static_cast<size_t>(page) * PAGE_SIZE;
+		size_t pageSize = std::min<size_t>(PAGE_SIZE, size - pageOffset);
+		if(memcmp(memory + pageOffset, base.data() + pageOffset, pageSize) == 0) continue;
+		delta[bitmapOffset + (page / 8)] |= static_cast<uint8>(1 << (page % 8));
+		delta.insert(std::end(delta), memory + pageOffset, memory + pageOffset + pageSize);
+	}
+}
+
+void CStateSnapshot::ApplyDelta(Buffer& memory, const Buffer& delta)
+{
+	DELTA_HEADER header;
+	if(delta.size() < sizeof(DELTA_HEADER))
+	{
+		throw std::runtime_error("Invalid state delta.");
+	}
+	memcpy(&header, delta.data(), sizeof(DELTA_HEADER));
+	if((header.pageSize == 0) || (header.pageCount != ((memory.size() + header.pageSize - 1) / header.pageSize)))
+	{
+		throw std::runtime_error("State delta doesn't match base state.");
+	}
+
+	size_t bitmapOffset = sizeof(DELTA_HEADER);
+	size_t dataOffset = bitmapOffset + ((header.pageCount + 7) / 8);
+	for(uint32 page = 0; page < header.pageCount; page++)
+	{
+		if(dataOffset > delta.size())
+		{
+			throw std::runtime_error("Invalid state delta.");
+		}
+		if((delta[bitmapOffset + (page / 8)] & (1 << (page % 8))) == 0) continue;
+		size_t pageOffset = static_cast<size_t>(page) * header.pageSize;
+		size_t pageSize = std::min<size_t>(header.pageSize, memory.size() - pageOffset);
+		if((dataOffset + pageSize) > delta.size())
+		{
+			throw std::runtime_error("Invalid state delta.");
+		}
+		memcpy(memory.data() + pageOffset, delta.data() + dataOffset, pageSize);
+		dataOffset += pageSize;
+	}
+}
+
+static uint64 GetSnapshotInfo(Framework::CZipArchiveReader& archive, const char* name)
+{
+	if(!archive.GetFileHeader(STATE_SNAPSHOT_INFO))
+	{
+		return 0;
+	}
+	CRegisterStateFile infoFile(*archive.BeginReadFile(STATE_SNAPSHOT_INFO));
+	return infoFile.GetRegister64(name);
+}
+
+uint64 CStateSnapshot::GetStateId(Framework::CZipArchiveReader& archive)
+{
+	return GetSnapshotInfo(archive, STATE_SNAPSHOT_INFO_ID);
+}
+
+uint64 CStateSnapshot::GetBaseStateId(Framework::CZipArchiveReader& archive)
+{
+	return GetSnapshotInfo(archive, STATE_SNAPSHOT_INFO_BASEID);
+}
+
+void CStateSnapshot::ExpandIncrementalState(Framework::CZipArchiveReader& state, Framework::CZipArchiveReader& baseState, Framework::CStream& output)
+{
+	uint64 baseId = GetBaseStateId(state);
+	if((baseId == 0) || (baseId != GetStateId(baseState)))
+	{
+		throw std::runtime_error("State doesn't match base state.");
+	}
+
+	CRegisterStateFile deltasFile(*state.BeginReadFile(STATE_SNAPSHOT_DELTAS));
+
+	//Content must stay alive until the archive is written
+	std::list<Buffer> contents;
+	Framework::CZipArchiveWriter archive;
+	for(const auto& fileHeaderPair : state.GetFileHeaders())
+	{
+		const auto& name = fileHeaderPair.first;
+		if((name == STATE_SNAPSHOT_INFO) || (name == STATE_SNAPSHOT_DELTAS)) continue;
+
+		Buffer content(fileHeaderPair.second.uncompressedSize);
+		state.BeginReadFile(name.c_str())->Read(content.data(), content.size());
+
+		uint64 deltaSize = deltasFile.GetRegister64(name.c_str());
+		if(deltaSize != 0)
+		{
+			auto baseFileHeader = baseState.GetFileHeader(name.c_str());
+			if(!baseFileHeader || (baseFileHeader->uncompressedSize != deltaSize))
+			{
+				throw std::runtime_error("State delta doesn't match base state.");
+			}
+			Buffer memory(deltaSize);
+			baseState.BeginReadFile(name.c_str())->Read(memory.data(), memory.size());
+			ApplyDelta(memory, content);
+			content = std::move(memory);
+		}
+
+		contents.push_back(std::move(content));
+		archive.InsertFile(new CMemoryStateFile(name.c_str(), contents.back().data(), contents.back().size()));
+	}
+	archive.Write(output);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "zip/ZipArchiveWriter.h"
+#include "zip/ZipArchiveReader.h"
+
+//Captures a save state quickly enough to be done between two emulation slices, leaving compression and
+//writing to another thread. While a capture is in progress on a thread, memory state files created on that
+//thread copy the memory they refer to in buffers owned by the snapshot. Buffers are kept from one capture
+//to the next.
+//
+//Snapshots captured against a base snapshot produce incremental states: large memory files only contain
+//the pages that differ from the base. Dirty pages are found by comparing with the copy held by the base.
+class CStateSnapshot
+{
+public:
+	typedef std::function<void(Framework::CZipArchiveWriter&)> SaveFunction;
+	typedef std::vector<uint8> Buffer;
+	typedef std::vector<std::string> NameArray;
+
+	enum
+	{
+		PAGE_SIZE = 0x1000,
+		//Memory files smaller than this are always stored completely in incremental states
+		INCREMENTAL_MIN_SIZE = 0x10000,
+	};
+
+	CStateSnapshot() = default;
+	CStateSnapshot(const CStateSnapshot&) = delete;
+	CStateSnapshot& operator=(const CStateSnapshot&) = delete;
+
+	//Base must be a complete snapshot and must not be captured again until this one is written
+	void Capture(const SaveFunction&, const CStateSnapshot* base = nullptr);
+	bool IsCaptured() const;
+	//Can be called from any thread, releases the captured archive
+	void Write(Framework::CStream&);
+
+	uint64 GetId() const;
+	bool IsIncremental() const;
+
+	//Memory files of this size or more are left empty in the archive, their captured copy is only
+	//available through GetDetachedMemory. 0 disables detaching, which is required for incremental states.
+	void SetDetachThreshold(size_t);
+	const NameArray& GetDetachedNames() const;
+	Buffer& GetDetachedMemory(const std::string&);
+
+	//Used by memory state files, replaces the memory with the captured copy if a capture is in progress
+	static void CaptureMemory(const char*, const void*&, size_t&);
+
+	//Returns 0 for states written without a snapshot
+	static uint64 GetStateId(Framework::CZipArchiveReader&);
+	//Returns 0 for complete states
+	static uint64 GetBaseStateId(Framework::CZipArchiveReader&);
+	//Writes the complete state made of an incremental state and its base
+	static void ExpandIncrementalState(Framework::CZipArchiveReader&, Framework::CZipArchiveReader&, Framework::CStream&);
+
+private:
+	typedef std::map<std::string, Buffer> BufferMap;
+	typedef std::map<std::string, uint64> DeltaSizeMap;
+
+	void CaptureMemoryImpl(const char*, const void*&, size_t&);
+	static void MakeDelta(Buffer&, const uint8*, size_t, const Buffer&);
+	static void ApplyDelta(Buffer&, const Buffer&);
+
+	std::unique_ptr<Framework::CZipArchiveWriter> m_archive;
+	const CStateSnapshot* m_base = nullptr;
+	uint64 m_id = 0;
+	size_t m_detachThreshold = 0;
+	NameArray m_detachedNames;
+	//Captured memory, or pages that differ from the base for memory stored in deltas
+	BufferMap m_buffers;
+	//Buffers of the previous capture, only used while capturing
+	BufferMap m_previousBuffers;
+	//Complete size of memory stored in deltas
+	DeltaSizeMap m_deltaSizes;
+};
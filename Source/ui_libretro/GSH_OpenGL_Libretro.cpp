@@ -11,7 +11,7 @@ extern struct retro_hw_render_callback g_hw_render;
 CGSH_OpenGL_Libretro::CGSH_OpenGL_Libretro()
 {
 	m_mailBox.SetCanWait(false);
-	m_mailBox.SendCall([this] { m_threadDone = true; }, true, true);
+	SendGSCall([this] { m_threadDone = true; }, true, true);
 	m_thread.join();
 }
 
@@ -52,7 +52,7 @@ void CGSH_OpenGL_Libretro::InitializeImpl()
 
 void CGSH_OpenGL_Libretro::UpdatePresentation()
 {
-	m_mailBox.SendCall([this]() { UpdatePresentationImpl(); });
+	SendGSCall([this]() { UpdatePresentationImpl(); });
 }
 
 void CGSH_OpenGL_Libretro::UpdatePresentationImpl()
@@ -69,6 +69,7 @@ void CGSH_OpenGL_Libretro::UpdatePresentationImpl()
 void CGSH_OpenGL_Libretro::Reset()
 {
 	m_mailBox.Reset();
+	m_commandRing.Reset();
 	ResetBase();
 	CGSH_OpenGL::ReleaseImpl();
 	InitializeImpl();
@@ -77,6 +78,7 @@ void CGSH_OpenGL_Libretro::Reset()
 void CGSH_OpenGL_Libretro::Release()
 {
 	m_mailBox.Release();
+	m_commandRing.Reset();
 	ResetBase();
 	CGSH_OpenGL::ReleaseImpl();
 }
@@ -121,6 +121,9 @@ MainWindow::MainWindow(QWidget* parent)
 	connect(debugMenuUi->actionShowDebugger, &QAction::triggered, this, std::bind(&MainWindow::ShowDebugger, this));
 	connect(debugMenuUi->actionShowFrameDebugger, &QAction::triggered, this, std::bind(&MainWindow::ShowFrameDebugger, this));
 	connect(debugMenuUi->actionDumpNextFrame, &QAction::triggered, this, std::bind(&MainWindow::DumpNextFrame, this));
+	connect(debugMenuUi->actionDumpTraceProfile, &QAction::triggered, this, std::bind(&MainWindow::DumpTraceProfile, this));
+	connect(debugMenuUi->actionDumpPageFaultStats, &QAction::triggered, this, std::bind(&MainWindow::DumpPageFaultStats, this));
+	connect(debugMenuUi->actionDumpIdleLoops, &QAction::triggered, this, std::bind(&MainWindow::DumpIdleLoops, this));
 	connect(debugMenuUi->actionGsDrawEnabled, &QAction::triggered, this, std::bind(&MainWindow::ToggleGsDraw, this));
 #endif
 }
@@ -721,6 +724,24 @@ void MainWindow::DumpNextFrame()
 	    });
 }
 
+void MainWindow::DumpTraceProfile()
+{
+	m_virtualMachine->DumpEETraceProfile();
+	m_msgLabel->setText(QString("Dumped EE trace profile to standard output."));
+}
+
+void MainWindow::DumpPageFaultStats()
+{
+	m_virtualMachine->DumpEEPageFaultStats();
+	m_msgLabel->setText(QString("Dumped EE page fault statistics to standard output."));
+}
+
+void MainWindow::DumpIdleLoops()
+{
+	m_virtualMachine->DumpEEIdleLoops();
+	m_msgLabel->setText(QString("Dumped EE idle loops to standard output."));
+}
+
 void MainWindow::ToggleGsDraw()
 {
 	auto gs = m_virtualMachine->GetGSHandler();
@@ -52,6 +52,9 @@ public:
 	void ShowFrameDebugger();
 	boost::filesystem::path GetFrameDumpDirectoryPath();
 	void DumpNextFrame();
+	void DumpTraceProfile();
+	void DumpPageFaultStats();
+	void DumpIdleLoops();
 	void ToggleGsDraw();
 #endif
 
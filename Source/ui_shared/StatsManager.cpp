@@ -2,6 +2,7 @@
 #include "StatsManager.h"
 #include "string_format.h"
 #include "PS2VM.h"
+#include "BlockCompileQueue.h"
 
 void CStatsManager::OnNewFrame(uint32 drawCalls)
 {
@@ -69,6 +70,69 @@ std::string CStatsManager::GetProfilingInfo()
 
 		result += string_format("EE Usage:  %6.2f%%\r\n", (1.f - eeIdleRatio) * 100.f);
 		result += string_format("IOP Usage: %6.2f%%\r\n", (1.f - iopIdleRatio) * 100.f);
+
+		if((m_cpuUtilisation.eeSyncCount != 0) || (m_cpuUtilisation.iopSyncCount != 0))
+		{
+			float eeSyncsPerFrame = (m_frames != 0) ? static_cast<float>(m_cpuUtilisation.eeSyncCount) / static_cast<float>(m_frames) : 0;
+			float iopSyncsPerFrame = (m_frames != 0) ? static_cast<float>(m_cpuUtilisation.iopSyncCount) / static_cast<float>(m_frames) : 0;
+			result += string_format("IOP Sync:  %6.2f EE, %6.2f IOP per frame\r\n", eeSyncsPerFrame, iopSyncsPerFrame);
+		}
+
+		if(m_cpuUtilisation.vu1RunTime != 0)
+		{
+			//Times are in nanoseconds
+			uint64 overlapTime = (m_cpuUtilisation.vu1RunTime > m_cpuUtilisation.vu1WaitTime) ? (m_cpuUtilisation.vu1RunTime - m_cpuUtilisation.vu1WaitTime) : 0;
+			float overlapRatio = static_cast<double>(overlapTime) / static_cast<double>(m_cpuUtilisation.vu1RunTime);
+			float runMsPerFrame = (m_frames != 0) ? static_cast<double>(m_cpuUtilisation.vu1RunTime) / static_cast<double>(m_frames * 1000000ULL) : 0;
+			float vu1SyncsPerFrame = (m_frames != 0) ? static_cast<float>(m_cpuUtilisation.vu1SyncCount) / static_cast<float>(m_frames) : 0;
+			result += string_format("VU1 Async: %6.2fms, %6.2f%% overlap, %6.2f syncs per frame\r\n", runMsPerFrame, overlapRatio * 100.f, vu1SyncsPerFrame);
+		}
+
+		if(m_cpuUtilisation.spuMixTime != 0)
+		{
+			//Times are in nanoseconds
+			float mixMsPerFrame = (m_frames != 0) ? static_cast<double>(m_cpuUtilisation.spuMixTime) / static_cast<double>(m_frames * 1000000ULL) : 0;
+			float maxLatencyMs = static_cast<double>(m_cpuUtilisation.spuMaxLatency) / 1000000.0;
+			result += string_format("SPU Async: %6.2fms, %6.2fms max latency, %d underruns\r\n", mixMsPerFrame, maxLatencyMs, m_cpuUtilisation.spuUnderrunCount);
+		}
+	}
+
+	{
+		auto compileStats = CBlockCompileQueue::GetInstance().GetStats();
+		if(compileStats.compiledBlockCount != 0)
+		{
+			float avgLatencyMs = static_cast<double>(compileStats.totalLatencyNs) / static_cast<double>(compileStats.compiledBlockCount * timeScale);
+			float maxLatencyMs = static_cast<double>(compileStats.maxLatencyNs) / static_cast<double>(timeScale);
+			result += string_format("\r\nJIT Queue: %d (max %d)\r\n", compileStats.queueDepth, compileStats.maxQueueDepth);
+			result += string_format("JIT Latency: %6.2fms (max %6.2fms)\r\n", avgLatencyMs, maxLatencyMs);
+		}
+	}
+
+	{
+		static const float megabyte = 1024.f * 1024.f;
+		auto printCodeArenaStats =
+		    [&](const char* name, const CCodeArena::STATS& stats) {
+			    if(stats.chunkCount == 0) return;
+			    result += string_format("%-4s Code: %6.2fMB/%6.2fMB %6.2f%% used %6.2f%% frag\r\n",
+			                            name, static_cast<float>(stats.liveBytes) / megabyte, static_cast<float>(stats.reservedBytes) / megabyte,
+			                            stats.GetOccupancy() * 100.f, stats.GetFragmentation() * 100.f);
+		    };
+		result += "\r\n";
+		printCodeArenaStats("EE", m_codeArenaInfo.ee);
+		printCodeArenaStats("VU0", m_codeArenaInfo.vu0);
+		printCodeArenaStats("VU1", m_codeArenaInfo.vu1);
+		printCodeArenaStats("IOP", m_codeArenaInfo.iop);
+	}
+
+	{
+		auto printVuCacheStats =
+		    [&](const char* name, const CVuExecutor::MICROPROGRAM_CACHE_STATS& stats) {
+			    result += string_format("%-4s Cache: %d block hits, %d code hits, %d misses\r\n",
+			                            name, stats.blockHits, stats.codeHits, stats.codeMisses);
+		    };
+		result += "\r\n";
+		printVuCacheStats("VU0", m_vuCacheInfo.vu0);
+		printVuCacheStats("VU1", m_vuCacheInfo.vu1);
 	}
 
 	return result;
@@ -87,6 +151,7 @@ void CStatsManager::ClearStats()
 		zonePair.second.currentValue = 0;
 	}
 	m_cpuUtilisation = CPS2VM::CPU_UTILISATION_INFO();
+	CBlockCompileQueue::GetInstance().ResetStats();
 #endif
 }
 
@@ -112,6 +177,17 @@ void CStatsManager::OnProfileFrameDone(CPS2VM* virtualMachine, const CProfiler::
 	m_cpuUtilisation.eeIdleTicks += cpuUtilisation.eeIdleTicks;
 	m_cpuUtilisation.iopTotalTicks += cpuUtilisation.iopTotalTicks;
 	m_cpuUtilisation.iopIdleTicks += cpuUtilisation.iopIdleTicks;
+	m_cpuUtilisation.eeSyncCount += cpuUtilisation.eeSyncCount;
+	m_cpuUtilisation.iopSyncCount += cpuUtilisation.iopSyncCount;
+	m_cpuUtilisation.vu1SyncCount += cpuUtilisation.vu1SyncCount;
+	m_cpuUtilisation.vu1RunTime += cpuUtilisation.vu1RunTime;
+	m_cpuUtilisation.vu1WaitTime += cpuUtilisation.vu1WaitTime;
+	m_cpuUtilisation.spuUnderrunCount += cpuUtilisation.spuUnderrunCount;
+	m_cpuUtilisation.spuMixTime += cpuUtilisation.spuMixTime;
+	m_cpuUtilisation.spuMaxLatency = std::max(m_cpuUtilisation.spuMaxLatency, cpuUtilisation.spuMaxLatency);
+
+	m_codeArenaInfo = virtualMachine->GetCodeArenaInfo();
+	m_vuCacheInfo = virtualMachine->GetVuCacheInfo();
 }
 
 #endif
@@ -41,6 +41,8 @@ private:
 	typedef std::map<std::string, ZONEINFO> ZoneMap;
 
 	CPS2VM::CPU_UTILISATION_INFO m_cpuUtilisation;
+	CPS2VM::CODE_ARENA_INFO m_codeArenaInfo;
+	CPS2VM::VU_CACHE_INFO m_vuCacheInfo;
 
 	std::mutex m_profilerZonesMutex;
 	ZoneMap m_profilerZones;
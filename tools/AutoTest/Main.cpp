@@ -4,13 +4,16 @@
 #include "StdStreamUtils.h"
 #include "iop/IopBios.h"
 #include "JUnitTestReportWriter.h"
+#include "MemoryMapBenchmark.h"
 #include "gs/GSH_Null.h"
+#include "gs/GSH_Software.h"
 #ifdef _WIN32
 #include "gs/GSH_OpenGLWin32/GSH_OpenGLWin32.h"
 #include "gs/GSH_Direct3D9/GSH_Direct3D9.h"
 #endif
 
 #define GS_HANDLER_NAME_NULL "null"
+#define GS_HANDLER_NAME_SOFTWARE "software"
 #define GS_HANDLER_NAME_OGL "ogl"
 #define GS_HANDLER_NAME_D3D9 "d3d9"
 
@@ -19,6 +22,7 @@
 static std::set<std::string> g_validGsHandlersNames =
     {
         GS_HANDLER_NAME_NULL,
+        GS_HANDLER_NAME_SOFTWARE,
 #ifdef _WIN32
         GS_HANDLER_NAME_OGL,
         GS_HANDLER_NAME_D3D9,
@@ -45,6 +49,10 @@ CGSHandler::FactoryFunction GetGsHandlerFactoryFunction(const std::string& gsHan
 	{
 		return CGSH_Null::GetFactoryFunction();
 	}
+	else if(gsHandlerName == GS_HANDLER_NAME_SOFTWARE)
+	{
+		return CGSH_Software::GetFactoryFunction();
+	}
 #ifdef _WIN32
 	else if(gsHandlerName == GS_HANDLER_NAME_OGL)
 	{
@@ -250,6 +258,7 @@ int main(int argc, const char** argv)
 		printf("\t --junitreport <path>\t Writes JUnit format report at <path>.\r\n");
 		printf("\t --gshandler <%s>\tSelects which GS handler to instantiate (default is '%s').\r\n",
 		       validGsHandlerNamesString.c_str(), DEFAULT_GS_HANDLER_NAME);
+		printf("\t --memorymapbenchmark\t Measures memory map access throughput and exits.\r\n");
 		return -1;
 	}
 
@@ -287,6 +296,11 @@ int main(int argc, const char** argv)
 			}
 			i++;
 		}
+		else if(!strcmp(argv[i], "--memorymapbenchmark"))
+		{
+			RunMemoryMapBenchmark();
+			return 0;
+		}
 		else
 		{
 			autoTestRoot = argv[i];
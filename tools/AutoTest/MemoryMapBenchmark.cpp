@@ -0,0 +1,216 @@
+#include "MemoryMapBenchmark.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "MemoryMap.h"
+
+#define ACCESS_COUNT (0x2000000)
+#define ADDRESS_COUNT (0x1000)
+
+class CBenchmarkDevice
+{
+public:
+	uint32 ReadRegister(uint32 address)
+	{
+		return m_value + address;
+	}
+
+	uint32 WriteRegister(uint32 address, uint32 value)
+	{
+		m_value ^= address + value;
+		return 0;
+	}
+
+private:
+	uint32 m_value = 0;
+};
+
+//Emulates the lookup that was used before the page table: elements are scanned linearly
+//and handlers are called through std::function
+class CLegacyMemoryMap : public CMemoryMap_LSBF
+{
+public:
+	uint32 GetWord(uint32 address) override
+	{
+		auto e = FindElement(m_readMap.elements, address);
+		if(!e) return 0xCCCCCCCC;
+		if(e->nType == MEMORYMAP_TYPE_MEMORY)
+		{
+			return *reinterpret_cast<uint32*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart));
+		}
+		return e->handler(address, 0);
+	}
+
+	void SetWord(uint32 address, uint32 value) override
+	{
+		auto e = FindElement(m_writeMap.elements, address);
+		if(!e) return;
+		if(e->nType == MEMORYMAP_TYPE_MEMORY)
+		{
+			*reinterpret_cast<uint32*>(reinterpret_cast<uint8*>(e->pPointer) + (address - e->nStart)) = value;
+			return;
+		}
+		e->handler(address, value);
+	}
+
+private:
+	static const MEMORYMAPELEMENT* FindElement(const MemoryMapListType& elements, uint32 address)
+	{
+		for(const auto& element : elements)
+		{
+			if(address <= element.nEnd)
+			{
+				if(!(address >= element.nStart)) return nullptr;
+				return &element;
+			}
+		}
+		return nullptr;
+	}
+};
+
+enum BENCHMARK_PATH
+{
+	BENCHMARK_PATH_LEGACY,
+	BENCHMARK_PATH_PAGED,
+};
+
+struct BENCHMARK_MEMORY
+{
+	BENCHMARK_MEMORY()
+	    : ram(0x02000000)
+	    , scratchPad(0x4000)
+	    , vuMem(0x4000)
+	    , bios(0x00400000)
+	{
+	}
+
+	std::vector<uint8> ram;
+	std::vector<uint8> scratchPad;
+	std::vector<uint8> vuMem;
+	std::vector<uint8> bios;
+	CBenchmarkDevice device;
+};
+
+//Follows the EE's memory map layout
+static std::unique_ptr<CMemoryMap> CreateMemoryMap(BENCHMARK_PATH path, BENCHMARK_MEMORY& memory)
+{
+	std::unique_ptr<CMemoryMap> memoryMap;
+	if(path == BENCHMARK_PATH_LEGACY)
+	{
+		memoryMap = std::make_unique<CLegacyMemoryMap>();
+	}
+	else
+	{
+		memoryMap = std::make_unique<CMemoryMap_LSBF>();
+	}
+
+	auto device = &memory.device;
+	auto insertRegisters =
+	    [&](uint32 start, uint32 end, unsigned char key) {
+		    if(path == BENCHMARK_PATH_LEGACY)
+		    {
+			    memoryMap->InsertReadMap(start, end, std::bind(&CBenchmarkDevice::ReadRegister, device, std::placeholders::_1), key);
+			    memoryMap->InsertWriteMap(start, end, std::bind(&CBenchmarkDevice::WriteRegister, device, std::placeholders::_1, std::placeholders::_2), key);
+		    }
+		    else
+		    {
+			    memoryMap->InsertReadMap(start, end, &CMemoryMap::ReadHandlerProxy<CBenchmarkDevice, &CBenchmarkDevice::ReadRegister>, device, key);
+			    memoryMap->InsertWriteMap(start, end, &CMemoryMap::WriteHandlerProxy<CBenchmarkDevice, &CBenchmarkDevice::WriteRegister>, device, key);
+		    }
+	    };
+	auto insertMemory =
+	    [&](uint32 start, std::vector<uint8>& buffer, unsigned char key) {
+		    uint32 end = start + static_cast<uint32>(buffer.size()) - 1;
+		    memoryMap->InsertReadMap(start, end, buffer.data(), key);
+		    memoryMap->InsertWriteMap(start, end, buffer.data(), key);
+	    };
+
+	insertMemory(0x00000000, memory.ram, 0x00);
+	insertMemory(0x02000000, memory.scratchPad, 0x01);
+	insertRegisters(0x10000000, 0x10FFFFFF, 0x02);
+	insertMemory(0x11000000, memory.vuMem, 0x03);
+	insertMemory(0x11004000, memory.vuMem, 0x04);
+	insertMemory(0x11008000, memory.vuMem, 0x05);
+	insertMemory(0x1100C000, memory.vuMem, 0x06);
+	insertRegisters(0x12000000, 0x12FFFFFF, 0x07);
+	memoryMap->InsertReadMap(0x1FC00000, 0x1FC00000 + static_cast<uint32>(memory.bios.size()) - 1, memory.bios.data(), 0x08);
+
+	return memoryMap;
+}
+
+//Addresses are kept in a small working set to measure lookup cost rather than cache misses
+static std::vector<uint32> GenerateAddresses(uint32 base, uint32 size)
+{
+	std::vector<uint32> addresses;
+	addresses.reserve(ADDRESS_COUNT);
+	uint32 seed = 0x12345678;
+	for(uint32 i = 0; i < ADDRESS_COUNT; i++)
+	{
+		seed = (seed * 1103515245) + 12345;
+		uint32 offset = (seed >> 8) % size;
+		//Keep 64 bytes per page
+		offset = (offset & ~0xFFF) | (offset & 0x3C);
+		addresses.push_back(base + offset);
+	}
+	return addresses;
+}
+
+static double MeasureAccessesPerSecond(BENCHMARK_PATH path, const std::vector<uint32>& addresses, bool write)
+{
+	BENCHMARK_MEMORY memory;
+	auto memoryMap = CreateMemoryMap(path, memory);
+
+	uint32 checksum = 0;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for(uint32 i = 0; i < ACCESS_COUNT; i++)
+	{
+		uint32 address = addresses[i & (ADDRESS_COUNT - 1)];
+		if(write)
+		{
+			memoryMap->SetWord(address, i);
+		}
+		else
+		{
+			checksum += memoryMap->GetWord(address);
+		}
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	//Makes sure accesses are not optimized away
+	static volatile uint32 result = 0;
+	result = result + checksum;
+
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+	return static_cast<double>(ACCESS_COUNT) / seconds;
+}
+
+void RunMemoryMapBenchmark()
+{
+	struct REGION
+	{
+		const char* name;
+		uint32 base;
+		uint32 size;
+		bool write;
+	};
+
+	static const REGION regions[] =
+	    {
+	        {"RAM read", 0x00000000, 0x02000000, false},
+	        {"RAM write", 0x00000000, 0x02000000, true},
+	        {"VU1 mem read", 0x1100C000, 0x00004000, false},
+	        {"BIOS read", 0x1FC00000, 0x00400000, false},
+	        {"IO read", 0x12000000, 0x00002000, false},
+	        {"IO write", 0x10000000, 0x00010000, true},
+	    };
+
+	printf("%-16s %16s %16s %8s\r\n", "Access", "Legacy (M/s)", "Paged (M/s)", "Speedup");
+	for(const auto& region : regions)
+	{
+		auto addresses = GenerateAddresses(region.base, region.size);
+		double legacy = MeasureAccessesPerSecond(BENCHMARK_PATH_LEGACY, addresses, region.write);
+		double paged = MeasureAccessesPerSecond(BENCHMARK_PATH_PAGED, addresses, region.write);
+		printf("%-16s %16.2f %16.2f %7.2fx\r\n", region.name, legacy / 1000000.0, paged / 1000000.0, paged / legacy);
+	}
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+//Measures the number of memory accesses per second going through CMemoryMap, comparing
+//the legacy lookup (linear scan, std::function handlers) with the paged lookup.
+void RunMemoryMapBenchmark();
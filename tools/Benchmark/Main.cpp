@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <nlohmann/json.hpp>
+#include "PS2VM.h"
+#include "PS2VM_Preferences.h"
+#include "AppConfig.h"
+#include "StdStreamUtils.h"
+#include "CoprocessorThread.h"
+#include "gs/GSH_Null.h"
+#include "SH_Null.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#define DEFAULT_FRAME_COUNT (1800)
+
+struct BENCHMARK_OPTIONS
+{
+	boost::filesystem::path bootPath;
+	uint32 frameCount = DEFAULT_FRAME_COUNT;
+	bool jitCacheEnabled = false;
+	bool hotTraceEnabled = false;
+	//Profiler zone events are written there when not empty (only available in PROFILE builds)
+	boost::filesystem::path tracePath;
+};
+
+struct BENCHMARK_RESULT
+{
+	std::string executableName;
+	uint32 frameCount = 0;
+	//Wall clock time from the moment the VM is resumed until the last frame, in seconds
+	double elapsedTime = 0;
+	//Time spent in each profiler zone, in nanoseconds (only available in PROFILE builds)
+	std::map<std::string, uint64> zoneTimes;
+	CPS2VM::CODE_ARENA_INFO codeArenaInfo;
+	CPS2VM::VU_CACHE_INFO vuCacheInfo;
+	CJitBlockCache::STATS eeBlockCacheStats;
+	uint64 peakResidentSize = 0;
+};
+
+//Forces preferences read by CPS2VM while the benchmark is running. Previous values are put back
+//when the overrides are destroyed, the configuration saved afterwards stays as it was.
+class CPreferenceOverrides
+{
+public:
+	CPreferenceOverrides() = default;
+	CPreferenceOverrides(const CPreferenceOverrides&) = delete;
+	CPreferenceOverrides& operator=(const CPreferenceOverrides&) = delete;
+
+	~CPreferenceOverrides()
+	{
+		auto& config = CAppConfig::GetInstance();
+		for(const auto& preference : m_booleans)
+		{
+			config.SetPreferenceBoolean(preference.first.c_str(), preference.second);
+		}
+		for(const auto& preference : m_integers)
+		{
+			config.SetPreferenceInteger(preference.first.c_str(), preference.second);
+		}
+		for(const auto& preference : m_paths)
+		{
+			config.SetPreferencePath(preference.first.c_str(), preference.second);
+		}
+	}
+
+	//Preferences are registered with the default used by CPS2VM in case they don't exist yet
+	void SetBoolean(const char* name, bool defaultValue, bool value)
+	{
+		auto& config = CAppConfig::GetInstance();
+		config.RegisterPreferenceBoolean(name, defaultValue);
+		m_booleans.emplace_back(name, config.GetPreferenceBoolean(name));
+		config.SetPreferenceBoolean(name, value);
+	}
+
+	void SetInteger(const char* name, int defaultValue, int value)
+	{
+		auto& config = CAppConfig::GetInstance();
+		config.RegisterPreferenceInteger(name, defaultValue);
+		m_integers.emplace_back(name, config.GetPreferenceInteger(name));
+		config.SetPreferenceInteger(name, value);
+	}
+
+	void SetPath(const char* name, const boost::filesystem::path& value)
+	{
+		auto& config = CAppConfig::GetInstance();
+		config.RegisterPreferencePath(name, "");
+		m_paths.emplace_back(name, config.GetPreferencePath(name));
+		config.SetPreferencePath(name, value);
+	}
+
+private:
+	std::vector<std::pair<std::string, bool>> m_booleans;
+	std::vector<std::pair<std::string, int>> m_integers;
+	std::vector<std::pair<std::string, boost::filesystem::path>> m_paths;
+};
+
+static uint64 GetPeakResidentSize()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#elif defined(__unix__) || defined(__APPLE__)
+	struct rusage usage = {};
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#if defined(__APPLE__)
+	return usage.ru_maxrss;
+#else
+	//Reported in kilobytes
+	return static_cast<uint64>(usage.ru_maxrss) * 1024;
+#endif
+#else
+	return 0;
+#endif
+}
+
+static bool IsElfPath(const boost::filesystem::path& path)
+{
+	auto extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".elf";
+}
+
+//Settings that make emulation run differently from one run to another (worker threads, block
+//compilation in the background, persisted caches) are turned off unless explicitly requested.
+static void SetupDeterministicPreferences(CPreferenceOverrides& overrides, const BENCHMARK_OPTIONS& options)
+{
+	overrides.SetBoolean(PREF_PS2_EE_ASYNCJIT_ENABLED, false, false);
+	overrides.SetBoolean(PREF_PS2_EE_JITCACHE_ENABLED, false, options.jitCacheEnabled);
+	overrides.SetBoolean(PREF_PS2_VU_JITCACHE_ENABLED, false, options.jitCacheEnabled);
+	overrides.SetBoolean(PREF_PS2_EE_HOTTRACE_ENABLED, false, options.hotTraceEnabled);
+	overrides.SetInteger(PREF_PS2_IOP_THREADMODE, CCoprocessorThread::MODE_SERIAL, CCoprocessorThread::MODE_SERIAL);
+	overrides.SetInteger(PREF_PS2_VU1_THREADMODE, CCoprocessorThread::MODE_SERIAL, CCoprocessorThread::MODE_SERIAL);
+	overrides.SetBoolean(PREF_PS2_REWIND_ENABLED, false, false);
+	overrides.SetBoolean(PREF_AUDIO_SPUMIXTHREAD_ENABLED, false, false);
+	if(!IsElfPath(options.bootPath))
+	{
+		overrides.SetPath(PREF_PS2_CDROM0_PATH, options.bootPath);
+	}
+}
+
+static BENCHMARK_RESULT RunBenchmark(const BENCHMARK_OPTIONS& options)
+{
+	BENCHMARK_RESULT result;
+	result.frameCount = options.frameCount;
+
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	bool done = false;
+
+	CPS2VM virtualMachine;
+	virtualMachine.Initialize();
+	virtualMachine.Reset();
+	virtualMachine.CreateGSHandler(CGSH_Null::GetFactoryFunction());
+	virtualMachine.CreateSoundHandler(&CSH_Null::HandlerFactory);
+	if(IsElfPath(options.bootPath))
+	{
+		virtualMachine.m_ee->m_os->BootFromFile(options.bootPath);
+	}
+	else
+	{
+		virtualMachine.m_ee->m_os->BootFromCDROM();
+	}
+
+	//Only accessed from the emulation thread
+	uint32 currentFrame = 0;
+
+#ifdef PROFILE
+	auto profileFrameDoneConnection = virtualMachine.ProfileFrameDone.Connect(
+	    [&](const CProfiler::ZoneArray& zones) {
+		    if(currentFrame >= options.frameCount) return;
+		    for(const auto& zone : zones)
+		    {
+			    result.zoneTimes[zone.name] += zone.totalTime;
+		    }
+	    });
+#endif
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	//Results are gathered on the emulation thread as soon as the last frame starts, the VM
+	//keeps running a bit until the main thread pauses it but this isn't measured
+	auto vblankStartConnection = virtualMachine.VBlankStart.Connect(
+	    [&]() {
+		    if(currentFrame >= options.frameCount) return;
+		    currentFrame++;
+		    if(currentFrame != options.frameCount) return;
+		    auto elapsedTime = std::chrono::steady_clock::now() - startTime;
+		    result.elapsedTime = std::chrono::duration<double>(elapsedTime).count();
+		    result.codeArenaInfo = virtualMachine.GetCodeArenaInfo();
+		    result.vuCacheInfo = virtualMachine.GetVuCacheInfo();
+		    result.eeBlockCacheStats = virtualMachine.GetEeBlockCacheStats();
+		    {
+			    std::lock_guard<std::mutex> doneLock(doneMutex);
+			    done = true;
+		    }
+		    doneCondition.notify_one();
+	    });
+
+	bool traceEnabled = !options.tracePath.empty();
+	CProfiler::GetInstance().SetTraceEnabled(traceEnabled);
+
+	virtualMachine.Resume();
+	{
+		std::unique_lock<std::mutex> doneLock(doneMutex);
+		doneCondition.wait(doneLock, [&]() { return done; });
+	}
+	virtualMachine.Pause();
+
+	if(traceEnabled)
+	{
+		CProfiler::GetInstance().SetTraceEnabled(false);
+		auto traceStream = Framework::CreateOutputStdStream(options.tracePath.native());
+		CProfiler::GetInstance().WriteTrace(traceStream);
+	}
+
+	result.executableName = virtualMachine.m_ee->m_os->GetExecutableName();
+
+	virtualMachine.DestroySoundHandler();
+	virtualMachine.DestroyGSHandler();
+	virtualMachine.Destroy();
+
+	result.peakResidentSize = GetPeakResidentSize();
+	return result;
+}
+
+static double GetHitRate(uint32 hits, uint32 misses)
+{
+	uint32 total = hits + misses;
+	return (total == 0) ? 0 : static_cast<double>(hits) / static_cast<double>(total);
+}
+
+static nlohmann::json MakeCodeArenaReport(const CCodeArena::STATS& stats)
+{
+	nlohmann::json report;
+	report["compiledBlocks"] = stats.totalAllocationCount;
+	report["liveBlocks"] = stats.allocationCount;
+	report["liveBytes"] = stats.liveBytes;
+	report["reservedBytes"] = stats.reservedBytes;
+	return report;
+}
+
+static nlohmann::json MakeMicroprogramCacheReport(const CVuExecutor::MICROPROGRAM_CACHE_STATS& stats)
+{
+	nlohmann::json report;
+	report["blockHits"] = stats.blockHits;
+	report["codeHits"] = stats.codeHits;
+	report["codeMisses"] = stats.codeMisses;
+	report["hitRate"] = GetHitRate(stats.blockHits + stats.codeHits, stats.codeMisses);
+	return report;
+}
+
+static nlohmann::json MakeReport(const BENCHMARK_OPTIONS& options, const BENCHMARK_RESULT& result)
+{
+	nlohmann::json report;
+	report["bootPath"] = options.bootPath.string();
+	report["executable"] = result.executableName;
+	report["frames"] = result.frameCount;
+	report["elapsedTime"] = result.elapsedTime;
+	report["emulatedFps"] = (result.elapsedTime == 0) ? 0 : (result.frameCount / result.elapsedTime);
+	report["peakResidentBytes"] = result.peakResidentSize;
+
+	{
+		nlohmann::json settings;
+		settings["jitCache"] = options.jitCacheEnabled;
+		settings["hotTrace"] = options.hotTraceEnabled;
+#ifdef PROFILE
+		settings["profile"] = true;
+#else
+		settings["profile"] = false;
+#endif
+		report["settings"] = settings;
+	}
+
+	{
+		nlohmann::json zones = nlohmann::json::object();
+		for(const auto& zoneTimePair : result.zoneTimes)
+		{
+			zones[zoneTimePair.first] = zoneTimePair.second;
+		}
+		report["profilerZones"] = zones;
+	}
+
+	{
+		nlohmann::json jit;
+		jit["ee"] = MakeCodeArenaReport(result.codeArenaInfo.ee);
+		jit["iop"] = MakeCodeArenaReport(result.codeArenaInfo.iop);
+		jit["vu0"] = MakeCodeArenaReport(result.codeArenaInfo.vu0);
+		jit["vu1"] = MakeCodeArenaReport(result.codeArenaInfo.vu1);
+		report["jit"] = jit;
+	}
+
+	{
+		const auto& eeStats = result.eeBlockCacheStats;
+		nlohmann::json caches;
+		caches["ee"]["hits"] = eeStats.hits;
+		caches["ee"]["misses"] = eeStats.misses;
+		caches["ee"]["rejected"] = eeStats.rejected;
+		caches["ee"]["hitRate"] = GetHitRate(eeStats.hits, eeStats.misses);
+		caches["vu0"] = MakeMicroprogramCacheReport(result.vuCacheInfo.vu0);
+		caches["vu1"] = MakeMicroprogramCacheReport(result.vuCacheInfo.vu1);
+		report["caches"] = caches;
+	}
+
+	return report;
+}
+
+int main(int argc, const char** argv)
+{
+	if(argc < 2)
+	{
+		printf("Usage: Benchmark [options] <elf or disc image path>\r\n");
+		printf("Options: \r\n");
+		printf("\t --frames <count>\t Number of frames to emulate (default is %d).\r\n", DEFAULT_FRAME_COUNT);
+		printf("\t --report <path>\t Writes JSON report at <path> instead of standard output.\r\n");
+		printf("\t --jitcache\t\t Uses the persistent EE and VU JIT caches.\r\n");
+		printf("\t --hottrace\t\t Enables EE hot traces.\r\n");
+		printf("\t --trace <path>\t\t Writes profiler zone timelines at <path> (Chrome trace format).\r\n");
+		return -1;
+	}
+
+	BENCHMARK_OPTIONS options;
+	boost::filesystem::path reportPath;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--frames"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Frame count must be specified for --frames option.\r\n");
+				return -1;
+			}
+			int frameCount = atoi(argv[i + 1]);
+			if(frameCount <= 0)
+			{
+				printf("Error: Invalid frame count '%s'.\r\n", argv[i + 1]);
+				return -1;
+			}
+			options.frameCount = frameCount;
+			i++;
+		}
+		else if(!strcmp(argv[i], "--report"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --report option.\r\n");
+				return -1;
+			}
+			reportPath = boost::filesystem::path(argv[i + 1]);
+			i++;
+		}
+		else if(!strcmp(argv[i], "--jitcache"))
+		{
+			options.jitCacheEnabled = true;
+		}
+		else if(!strcmp(argv[i], "--hottrace"))
+		{
+			options.hotTraceEnabled = true;
+		}
+		else if(!strcmp(argv[i], "--trace"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --trace option.\r\n");
+				return -1;
+			}
+			options.tracePath = boost::filesystem::path(argv[i + 1]);
+			i++;
+		}
+		else
+		{
+			options.bootPath = argv[i];
+			break;
+		}
+	}
+
+	if(options.bootPath.empty())
+	{
+		printf("Error: No executable or disc image specified.\r\n");
+		return -1;
+	}
+
+	nlohmann::json report;
+	try
+	{
+		CPreferenceOverrides preferenceOverrides;
+		SetupDeterministicPreferences(preferenceOverrides, options);
+		auto result = RunBenchmark(options);
+		report = MakeReport(options, result);
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Error: Failed to run benchmark: %s\r\n", exception.what());
+		return -1;
+	}
+
+	auto reportString = report.dump(4);
+	if(reportPath.empty())
+	{
+		printf("%s\n", reportString.c_str());
+	}
+	else
+	{
+		std::ofstream reportStream(reportPath.string());
+		if(!reportStream)
+		{
+			printf("Error: Failed to write report to '%s'.\r\n", reportPath.string().c_str());
+			return -1;
+		}
+		reportStream << reportString << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include "Benchmark.h"
+
+CBenchmarkTimer::CBenchmarkTimer()
+    : m_startTime(std::chrono::high_resolution_clock::now())
+{
+}
+
+void CBenchmarkTimer::Restart()
+{
+	m_startTime = std::chrono::high_resolution_clock::now();
+}
+
+double CBenchmarkTimer::GetElapsedMilliseconds() const
+{
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_startTime);
+	return static_cast<double>(elapsed.count()) / 1000000.0;
+}
+
+void PrintBenchmarkResults(const std::string& title, const BenchmarkResultArray& results, const char* unit, int precision)
+{
+	printf("%s:", title.c_str());
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const auto& result = results[i];
+		printf("%s %s %0.*f%s", (i == 0) ? "" : ",", result.first.c_str(), precision, result.second, unit);
+	}
+	printf(".\r\n");
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Measures time elapsed since construction or the last call to Restart
+class CBenchmarkTimer
+{
+public:
+	CBenchmarkTimer();
+
+	void Restart();
+	double GetElapsedMilliseconds() const;
+
+private:
+	std::chrono::high_resolution_clock::time_point m_startTime;
+};
+
+typedef std::pair<std::string, double> BenchmarkResult;
+typedef std::vector<BenchmarkResult> BenchmarkResultArray;
+
+//Prints results on a single line, ie.: "<title>: scalar 1.000ms, simd 0.500ms."
+void PrintBenchmarkResults(const std::string& title, const BenchmarkResultArray&, const char* unit = "ms", int precision = 3);
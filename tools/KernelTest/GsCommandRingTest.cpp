@@ -0,0 +1,135 @@
+#include <thread>
+#include "GsCommandRingTest.h"
+#include "Benchmark.h"
+#include "MailBox.h"
+#include "gs/GsCommandRing.h"
+#include "string_format.h"
+
+#define WRITE_COUNT (0x100000)
+#define FLUSH_BATCH_SIZE (0x100)
+
+static uint64 GetExpectedSum()
+{
+	uint64 sum = 0;
+	for(uint32 i = 0; i < WRITE_COUNT; i++)
+	{
+		sum += i;
+	}
+	return sum;
+}
+
+static uint64 RunMailBox(double& elapsedTime)
+{
+	CMailBox mailBox;
+	uint64 sum = 0;
+	bool done = false;
+	std::thread consumerThread(
+	    [&]() {
+		    while(!done)
+		    {
+			    mailBox.WaitForCall(100);
+			    while(mailBox.IsPending())
+			    {
+				    mailBox.ReceiveCall();
+			    }
+		    }
+	    });
+
+	CBenchmarkTimer timer;
+	for(uint32 i = 0; i < WRITE_COUNT; i++)
+	{
+		uint64 value = i;
+		mailBox.SendCall([&sum, value]() { sum += value; });
+	}
+	mailBox.SendCall([&done]() { done = true; }, true);
+	elapsedTime = timer.GetElapsedMilliseconds();
+
+	consumerThread.join();
+	return sum;
+}
+
+static uint64 RunCommandRing(double& elapsedTime)
+{
+	CMailBox mailBox;
+	CGsCommandRing commandRing;
+	uint64 sum = 0;
+	bool done = false;
+	std::thread consumerThread(
+	    [&]() {
+		    while(!done)
+		    {
+			    mailBox.WaitForCall(100);
+			    while(mailBox.IsPending())
+			    {
+				    mailBox.ReceiveCall();
+			    }
+		    }
+	    });
+
+	auto processCommands =
+	    [&](uint32 fence) {
+		    while(commandRing.HasCommandBefore(fence))
+		    {
+			    sum += commandRing.GetFrontCommand().value;
+			    commandRing.Pop();
+		    }
+	    };
+
+	auto flush =
+	    [&]() {
+		    uint32 fence = commandRing.GetWritePosition();
+		    mailBox.SendCall([&processCommands, fence]() { processCommands(fence); });
+	    };
+
+	CBenchmarkTimer timer;
+	uint32 unflushedCount = 0;
+	for(uint32 i = 0; i < WRITE_COUNT; i++)
+	{
+		if(!commandRing.HasCommandSpace())
+		{
+			flush();
+			unflushedCount = 0;
+			while(!commandRing.HasCommandSpace())
+			{
+				std::this_thread::yield();
+			}
+		}
+		CGsCommandRing::COMMAND command = {};
+		command.type = CGsCommandRing::COMMAND_WRITE_REGISTER;
+		command.value = i;
+		commandRing.Push(command);
+		unflushedCount++;
+		if(unflushedCount == FLUSH_BATCH_SIZE)
+		{
+			flush();
+			unflushedCount = 0;
+		}
+	}
+	uint32 fence = commandRing.GetWritePosition();
+	mailBox.SendCall(
+	    [&processCommands, &done, fence]() {
+		    processCommands(fence);
+		    done = true;
+	    },
+	    true);
+	elapsedTime = timer.GetElapsedMilliseconds();
+
+	consumerThread.join();
+	return sum;
+}
+
+void CGsCommandRingTest::Execute()
+{
+	uint64 expectedSum = GetExpectedSum();
+
+	double mailBoxTime = 0;
+	uint64 mailBoxSum = RunMailBox(mailBoxTime);
+	TEST_VERIFY(mailBoxSum == expectedSum);
+
+	double commandRingTime = 0;
+	uint64 commandRingSum = RunCommandRing(commandRingTime);
+	TEST_VERIFY(commandRingSum == expectedSum);
+
+	PrintBenchmarkResults(string_format("%d GS register writes", WRITE_COUNT),
+	                      {{"mailbox", mailBoxTime}, {"command ring", commandRingTime}});
+}
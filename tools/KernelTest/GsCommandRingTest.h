@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../VuTest/Test.h"
+
+//Compares throughput of register writes sent through the mailbox and through the GS command ring
+class CGsCommandRingTest : public CTestBase<>
+{
+public:
+	void Execute() override;
+};
@@ -0,0 +1,267 @@
+#include <vector>
+#include "GsRasterizerTest.h"
+#include "Benchmark.h"
+#include "gs/GsRasterizer.h"
+#include "gs/GSHandler.h"
+#include "gs/GsPixelFormats.h"
+#include "string_format.h"
+
+#define FRAME_WIDTH (640)
+#define FRAME_HEIGHT (448)
+#define FRAME_BUFWIDTH (FRAME_WIDTH / 64)
+#define ZBUF_POINTER (0x200000)
+#define TEXTURE_POINTER (0x300000)
+#define BATCH_COUNT (40)
+#define BATCH_PRIMITIVE_COUNT (30)
+#define PARALLEL_WORKER_COUNT (4)
+
+typedef std::vector<uint8> ByteArray;
+
+class CRandom
+{
+public:
+	CRandom(uint32 seed)
+	    : m_seed(seed)
+	{
+	}
+
+	uint32 operator()(uint32 range)
+	{
+		m_seed = (m_seed * 1103515245) + 12345;
+		return ((m_seed >> 8) & 0xFFFFFF) % range;
+	}
+
+private:
+	uint32 m_seed = 0;
+};
+
+static void FillRandom(ByteArray& buffer, uint32 seed)
+{
+	for(auto& value : buffer)
+	{
+		seed = (seed * 1103515245) + 12345;
+		value = static_cast<uint8>(seed >> 16);
+	}
+}
+
+static CGsRasterizer::STATE MakeRandomState(CRandom& random)
+{
+	static const uint32 framePsms[] = {CGSHandler::PSMCT32, CGSHandler::PSMCT24, CGSHandler::PSMCT16, CGSHandler::PSMCT16S};
+	static const uint32 zbufPsms[] = {CGSHandler::PSMZ32, CGSHandler::PSMZ24, CGSHandler::PSMZ16, CGSHandler::PSMZ16S};
+	static const uint32 texturePsms[] = {CGSHandler::PSMCT32, CGSHandler::PSMCT24, CGSHandler::PSMCT16, CGSHandler::PSMT8,
+	                                     CGSHandler::PSMT4, CGSHandler::PSMT8H, CGSHandler::PSMT4HL, CGSHandler::PSMT4HH};
+
+	CGsRasterizer::STATE state;
+
+	state.frameBufWidth = FRAME_BUFWIDTH;
+	state.framePsm = framePsms[random(4)];
+	state.frameMask = (random(4) == 0) ? 0xFF00FF00 : 0;
+
+	state.zbufPtr = ZBUF_POINTER;
+	state.zbufPsm = zbufPsms[random(4)];
+	state.zbufMask = random(2);
+
+	state.scissorX0 = random(50);
+	state.scissorY0 = random(50);
+	state.scissorX1 = (FRAME_WIDTH - 1) - random(50);
+	state.scissorY1 = (FRAME_HEIGHT - 1) - random(50);
+
+	state.alphaTestEnabled = random(2);
+	state.alphaTestMethod = random(8);
+	state.alphaTestRef = random(0x100);
+	state.alphaTestFail = random(4);
+	state.destAlphaTestEnabled = (random(4) == 0);
+	state.destAlphaTestMode = random(2);
+	state.depthTestEnabled = random(2);
+	state.depthTestMethod = 1 + random(3);
+
+	state.alphaBlendEnabled = random(2);
+	state.alphaBlendA = random(3);
+	state.alphaBlendB = random(3);
+	state.alphaBlendC = random(3);
+	state.alphaBlendD = random(3);
+	state.alphaBlendFix = random(0x100);
+	state.pabe = random(2);
+	state.fba = random(2);
+	state.colClamp = random(2);
+
+	state.gouraudShading = random(2);
+	state.fogEnabled = random(2);
+	state.fogColor = random(0x1000000);
+
+	state.textureEnabled = random(2);
+	state.textureUseUV = random(2);
+	state.textureBufPtr = TEXTURE_POINTER;
+	state.textureBufWidth = 4;
+	state.texturePsm = texturePsms[random(8)];
+	state.textureWidth = 1 << (4 + random(4));
+	state.textureHeight = 1 << (4 + random(4));
+	state.textureHasAlpha = random(2);
+	state.textureFunction = random(4);
+	state.textureLinearFilter = random(2);
+	state.textureWrapModeU = random(4);
+	state.textureWrapModeV = random(4);
+	state.textureMinU = random(64);
+	state.textureMaxU = random(64);
+	state.textureMinV = random(64);
+	state.textureMaxV = random(64);
+	state.textureAlpha0 = random(0x100);
+	state.textureAlpha1 = random(0x100);
+	state.textureAlphaExpand = random(2);
+
+	return state;
+}
+
+static CGsRasterizer::VERTEX MakeRandomVertex(CRandom& random)
+{
+	//Some vertices land outside of the scissor area
+	CGsRasterizer::VERTEX vertex;
+	vertex.x = static_cast<int32>(random((FRAME_WIDTH + 60) * 16)) - (30 * 16);
+	vertex.y = static_cast<int32>(random((FRAME_HEIGHT + 60) * 16)) - (30 * 16);
+	vertex.z = random(0x1000000) * 0x100;
+	vertex.r = random(0x100);
+	vertex.g = random(0x100);
+	vertex.b = random(0x100);
+	vertex.a = random(0x100);
+	vertex.s = static_cast<float>(random(10000)) / 100.0f - 20.0f;
+	vertex.t = static_cast<float>(random(10000)) / 100.0f - 20.0f;
+	vertex.q = 0.5f + static_cast<float>(random(100)) / 50.0f;
+	vertex.fog = random(0x100);
+	return vertex;
+}
+
+static double DrawRandomScene(uint8* ram, uint32 seed, CGsRasterizer::SPAN_SET spanSet, unsigned int workerCount)
+{
+	CRandom random(seed);
+
+	uint32 clut[CGsRasterizer::CLUT_ENTRY_COUNT];
+	for(auto& color : clut)
+	{
+		color = random(0x10000) | (random(0x10000) << 16);
+	}
+
+	CBenchmarkTimer timer;
+
+	CGsRasterizer rasterizer(ram);
+	rasterizer.SetSpanSet(spanSet);
+	rasterizer.SetWorkerCount(workerCount);
+	for(uint32 batch = 0; batch < BATCH_COUNT; batch++)
+	{
+		rasterizer.SetState(MakeRandomState(random), clut);
+		for(uint32 i = 0; i < BATCH_PRIMITIVE_COUNT; i++)
+		{
+			switch(random(4))
+			{
+			case 0:
+				rasterizer.DrawPoint(MakeRandomVertex(random));
+				break;
+			case 1:
+				rasterizer.DrawLine(MakeRandomVertex(random), MakeRandomVertex(random));
+				break;
+			case 2:
+				rasterizer.DrawTriangle(MakeRandomVertex(random), MakeRandomVertex(random), MakeRandomVertex(random));
+				break;
+			case 3:
+				rasterizer.DrawSprite(MakeRandomVertex(random), MakeRandomVertex(random));
+				break;
+			}
+		}
+	}
+	rasterizer.Flush();
+
+	return timer.GetElapsedMilliseconds();
+}
+
+static void TestRandomScene(uint32 seed)
+{
+	ByteArray scalarRam(CGSHandler::RAMSIZE);
+	FillRandom(scalarRam, seed);
+	ByteArray simdRam(scalarRam);
+	ByteArray parallelRam(scalarRam);
+	ByteArray initialRam(scalarRam);
+
+	double scalarTime = DrawRandomScene(scalarRam.data(), seed, CGsRasterizer::SPAN_SET_SCALAR, 0);
+	double simdTime = DrawRandomScene(simdRam.data(), seed, CGsRasterizer::SPAN_SET_SIMD, 0);
+	double parallelTime = DrawRandomScene(parallelRam.data(), seed, CGsRasterizer::SPAN_SET_SIMD, PARALLEL_WORKER_COUNT);
+
+	TEST_VERIFY(scalarRam != initialRam);
+	TEST_VERIFY(simdRam == scalarRam);
+	TEST_VERIFY(parallelRam == scalarRam);
+
+	PrintBenchmarkResults(string_format("Random scene %d", seed),
+	                      {{"scalar", scalarTime}, {"simd", simdTime}, {string_format("simd with %d workers", PARALLEL_WORKER_COUNT), parallelTime}});
+}
+
+static void TestCoverage()
+{
+	//Two triangles sharing an edge and a sprite, additive blending with a constant source.
+	//Every covered pixel must be written exactly once.
+	ByteArray ram(CGSHandler::RAMSIZE);
+
+	CGsRasterizer::STATE state;
+	state.frameBufWidth = FRAME_BUFWIDTH;
+	state.scissorX1 = FRAME_WIDTH - 1;
+	state.scissorY1 = FRAME_HEIGHT - 1;
+	state.alphaBlendEnabled = 1;
+	state.alphaBlendA = CGSHandler::ALPHABLEND_ABD_CS;
+	state.alphaBlendB = CGSHandler::ALPHABLEND_ABD_ZERO;
+	state.alphaBlendC = CGSHandler::ALPHABLEND_C_FIX;
+	state.alphaBlendD = CGSHandler::ALPHABLEND_ABD_CD;
+	state.alphaBlendFix = 0x80;
+
+	auto makeVertex =
+	    [](int32 x, int32 y) {
+		    CGsRasterizer::VERTEX vertex;
+		    vertex.x = x;
+		    vertex.y = y;
+		    vertex.r = 1;
+		    return vertex;
+	    };
+
+	CGsRasterizer rasterizer(ram.data());
+	rasterizer.SetState(state);
+	auto v0 = makeVertex((10 * 16) + 3, (10 * 16) + 5);
+	auto v1 = makeVertex((90 * 16) + 7, 13 * 16);
+	auto v2 = makeVertex((20 * 16) + 1, (80 * 16) + 9);
+	auto v3 = makeVertex(95 * 16, (85 * 16) + 2);
+	rasterizer.DrawTriangle(v0, v1, v2);
+	rasterizer.DrawTriangle(v1, v3, v2);
+	rasterizer.DrawSprite(makeVertex(200 * 16, 200 * 16), makeVertex(216 * 16, 216 * 16));
+	rasterizer.Flush();
+
+	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(ram.data(), 0, FRAME_BUFWIDTH);
+	uint32 quadPixelCount = 0;
+	uint32 spritePixelCount = 0;
+	for(uint32 y = 0; y < FRAME_HEIGHT; y++)
+	{
+		for(uint32 x = 0; x < FRAME_WIDTH; x++)
+		{
+			uint32 red = indexor.GetPixel(x, y) & 0xFF;
+			TEST_VERIFY(red <= 1);
+			if(red == 0)
+			{
+				continue;
+			}
+			if(x < 150)
+			{
+				quadPixelCount++;
+			}
+			else
+			{
+				spritePixelCount++;
+			}
+		}
+	}
+
+	TEST_VERIFY(quadPixelCount != 0);
+	TEST_VERIFY(spritePixelCount == (16 * 16));
+}
+
+void CGsRasterizerTest::Execute()
+{
+	TestCoverage();
+	for(uint32 seed = 1; seed <= 2; seed++)
+	{
+		TestRandomScene(seed);
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../VuTest/Test.h"
+
+//Checks that the rasterizer gives the same results with every span set and worker count
+class CGsRasterizerTest : public CTestBase<>
+{
+public:
+	void Execute() override;
+};
@@ -0,0 +1,159 @@
+#include <vector>
+#include "GsTransferKernelsTest.h"
+#include "Benchmark.h"
+#include "gs/GsTransferKernels.h"
+#include "string_format.h"
+
+#define TRANSFER_WIDTH (512)
+#define TRANSFER_HEIGHT (512)
+#define BUFFER_WIDTH (TRANSFER_WIDTH / 64)
+#define BUFFER_POINTER (0x100000)
+#define ITERATION_COUNT (16)
+
+typedef std::vector<uint8> ByteArray;
+
+static void FillRandom(ByteArray& buffer, uint32 seed)
+{
+	for(auto& value : buffer)
+	{
+		seed = (seed * 1103515245) + 12345;
+		value = static_cast<uint8>(seed >> 16);
+	}
+}
+
+template <typename Storage>
+static void WritePixel(CGsPixelFormats::CPixelIndexor<Storage>& indexor, uint32 x, uint32 y, const uint8* src)
+{
+	auto pixels = reinterpret_cast<const typename Storage::Unit*>(src);
+	indexor.SetPixel(x, y, pixels[x + (y * TRANSFER_WIDTH)]);
+}
+
+template <>
+void WritePixel<CGsPixelFormats::STORAGEPSMT4>(CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT4>& indexor, uint32 x, uint32 y, const uint8* src)
+{
+	uint32 pixelIndex = x + (y * TRANSFER_WIDTH);
+	indexor.SetPixel(x, y, (src[pixelIndex / 2] >> ((pixelIndex & 1) * 4)) & 0x0F);
+}
+
+template <typename Storage>
+static double WriteWithIndexor(uint8* ram, const uint8* src)
+{
+	CBenchmarkTimer timer;
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		CGsPixelFormats::CPixelIndexor<Storage> indexor(ram, BUFFER_POINTER, BUFFER_WIDTH);
+		for(uint32 y = 0; y < TRANSFER_HEIGHT; y++)
+		{
+			for(uint32 x = 0; x < TRANSFER_WIDTH; x++)
+			{
+				WritePixel<Storage>(indexor, x, y, src);
+			}
+		}
+	}
+	return timer.GetElapsedMilliseconds() / ITERATION_COUNT;
+}
+
+template <typename Storage>
+static double WriteWithKernel(uint8* ram, const uint8* src, CGsTransferKernels::KERNEL_SET kernelSet)
+{
+	auto writeBlock = CGsTransferKernels::GetWriteBlockFunction<Storage>(CGsTransferKernels::GetKernels(kernelSet));
+	uint32 srcStride = (TRANSFER_WIDTH * CGsTransferKernels::GetPixelBits<Storage>()) / 8;
+	CBenchmarkTimer timer;
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		for(uint32 y = 0; y < TRANSFER_HEIGHT; y += Storage::BLOCKHEIGHT)
+		{
+			for(uint32 x = 0; x < TRANSFER_WIDTH; x += Storage::BLOCKWIDTH)
+			{
+				auto block = CGsTransferKernels::GetBlockAddress<Storage>(ram, BUFFER_POINTER, BUFFER_WIDTH, x, y);
+				auto blockSrc = src + (y * srcStride) + ((x * CGsTransferKernels::GetPixelBits<Storage>()) / 8);
+				writeBlock(block, blockSrc, srcStride);
+			}
+		}
+	}
+	return timer.GetElapsedMilliseconds() / ITERATION_COUNT;
+}
+
+template <typename Storage>
+static void TestWrite(const char* name)
+{
+	ByteArray src((TRANSFER_WIDTH * TRANSFER_HEIGHT * CGsTransferKernels::GetPixelBits<Storage>()) / 8);
+	FillRandom(src, 1);
+
+	ByteArray referenceRam(CGSHandler::RAMSIZE);
+	FillRandom(referenceRam, 2);
+	ByteArray scalarRam(referenceRam);
+	ByteArray simdRam(referenceRam);
+
+	double indexorTime = WriteWithIndexor<Storage>(referenceRam.data(), src.data());
+	double scalarTime = WriteWithKernel<Storage>(scalarRam.data(), src.data(), CGsTransferKernels::KERNEL_SET_SCALAR);
+	double simdTime = WriteWithKernel<Storage>(simdRam.data(), src.data(), CGsTransferKernels::KERNEL_SET_SIMD);
+
+	TEST_VERIFY(scalarRam == referenceRam);
+	TEST_VERIFY(simdRam == referenceRam);
+
+	PrintBenchmarkResults(string_format("%s write (%dx%d)", name, TRANSFER_WIDTH, TRANSFER_HEIGHT),
+	                      {{"indexor", indexorTime}, {"scalar", scalarTime}, {"simd", simdTime}});
+}
+
+template <typename Storage>
+static void TestRead(const char* name)
+{
+	typedef typename Storage::Unit Unit;
+
+	ByteArray ram(CGSHandler::RAMSIZE);
+	FillRandom(ram, 3);
+
+	ByteArray referenceDst(TRANSFER_WIDTH * TRANSFER_HEIGHT * sizeof(Unit));
+	ByteArray scalarDst(referenceDst.size());
+	ByteArray simdDst(referenceDst.size());
+
+	CGsPixelFormats::CPixelIndexor<Storage> indexor(ram.data(), BUFFER_POINTER, BUFFER_WIDTH);
+	auto referencePixels = reinterpret_cast<Unit*>(referenceDst.data());
+	for(uint32 y = 0; y < TRANSFER_HEIGHT; y++)
+	{
+		for(uint32 x = 0; x < TRANSFER_WIDTH; x++)
+		{
+			referencePixels[x + (y * TRANSFER_WIDTH)] = indexor.GetPixel(x, y);
+		}
+	}
+
+	uint32 dstStride = TRANSFER_WIDTH * sizeof(Unit);
+	auto readAll =
+	    [&](ByteArray& dst, CGsTransferKernels::KERNEL_SET kernelSet) {
+		    auto readBlock = CGsTransferKernels::GetReadBlockFunction<Storage>(CGsTransferKernels::GetKernels(kernelSet));
+		    CBenchmarkTimer timer;
+		    for(uint32 i = 0; i < ITERATION_COUNT; i++)
+		    {
+			    for(uint32 y = 0; y < TRANSFER_HEIGHT; y += Storage::BLOCKHEIGHT)
+			    {
+				    for(uint32 x = 0; x < TRANSFER_WIDTH; x += Storage::BLOCKWIDTH)
+				    {
+					    auto block = CGsTransferKernels::GetBlockAddress<Storage>(ram.data(), BUFFER_POINTER, BUFFER_WIDTH, x, y);
+					    readBlock(dst.data() + (y * dstStride) + (x * sizeof(Unit)), dstStride, block);
+				    }
+			    }
+		    }
+		    return timer.GetElapsedMilliseconds() / ITERATION_COUNT;
+	    };
+
+	double scalarTime = readAll(scalarDst, CGsTransferKernels::KERNEL_SET_SCALAR);
+	double simdTime = readAll(simdDst, CGsTransferKernels::KERNEL_SET_SIMD);
+
+	TEST_VERIFY(scalarDst == referenceDst);
+	TEST_VERIFY(simdDst == referenceDst);
+
+	PrintBenchmarkResults(string_format("%s read (%dx%d)", name, TRANSFER_WIDTH, TRANSFER_HEIGHT),
+	                      {{"scalar", scalarTime}, {"simd", simdTime}});
+}
+
+void CGsTransferKernelsTest::Execute()
+{
+	TestWrite<CGsPixelFormats::STORAGEPSMCT32>("PSMCT32");
+	TestWrite<CGsPixelFormats::STORAGEPSMCT16>("PSMCT16");
+	TestWrite<CGsPixelFormats::STORAGEPSMCT16S>("PSMCT16S");
+	TestWrite<CGsPixelFormats::STORAGEPSMT8>("PSMT8");
+	TestWrite<CGsPixelFormats::STORAGEPSMT4>("PSMT4");
+	TestRead<CGsPixelFormats::STORAGEPSMCT32>("PSMCT32");
+	TestRead<CGsPixelFormats::STORAGEPSMT8>("PSMT8");
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../VuTest/Test.h"
+
+//Checks that block transfer kernels match the pixel indexors and measures their throughput
+class CGsTransferKernelsTest : public CTestBase<>
+{
+public:
+	void Execute() override;
+};
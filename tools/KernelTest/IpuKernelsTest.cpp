@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "IpuKernelsTest.h"
+#include "Benchmark.h"
+#include "ee/IpuKernels.h"
+
+#define MACROBLOCK_COUNT (0x1000)
+#define BLOCKS_PER_MACROBLOCK (6)
+#define ITERATION_COUNT (4)
+//The reference IDCT comes from Framework and might be built with fused multiply-adds
+#define IDCT_TOLERANCE (1)
+
+typedef std::vector<int16> BlockArray;
+typedef std::vector<uint8> ByteArray;
+typedef std::vector<uint16> HalfArray;
+typedef std::vector<uint32> WordArray;
+
+//Blocks look like the ones found in video streams: a DC coefficient, a few low frequency
+//coefficients and the odd high frequency one. Some extreme values cover the saturation paths.
+static BlockArray MakeBlocks(std::mt19937& random)
+{
+	BlockArray blocks(MACROBLOCK_COUNT * BLOCKS_PER_MACROBLOCK * CIpuKernels::BLOCK_SIZE);
+	for(uint32 block = 0; block < MACROBLOCK_COUNT * BLOCKS_PER_MACROBLOCK; block++)
+	{
+		auto coefficients = blocks.data() + (block * CIpuKernels::BLOCK_SIZE);
+		coefficients[0] = static_cast<int16>(random() % 256);
+		uint32 lowCount = random() % 8;
+		for(uint32 i = 0; i < lowCount; i++)
+		{
+			coefficients[1 + (random() % 20)] = static_cast<int16>(static_cast<int32>(random() % 64) - 32);
+		}
+		if((random() % 4) == 0)
+		{
+			coefficients[random() % CIpuKernels::BLOCK_SIZE] = static_cast<int16>(static_cast<int32>(random() % 4096) - 2048);
+		}
+	}
+	return blocks;
+}
+
+static void MakeMatrix(std::mt19937& random, uint8* matrix)
+{
+	for(uint32 i = 0; i < CIpuKernels::BLOCK_SIZE; i++)
+	{
+		matrix[i] = static_cast<uint8>(1 + (random() % 255));
+	}
+}
+
+static double GetMacroblocksPerSecond(double timeMs)
+{
+	return (timeMs == 0) ? 0 : (static_cast<double>(MACROBLOCK_COUNT * ITERATION_COUNT) * 1000.0 / timeMs);
+}
+
+struct DECODE_RESULT
+{
+	BlockArray intraBlocks;
+	BlockArray nonIntraBlocks;
+	BlockArray samples;
+	double dequantiseTime = 0;
+	double idctTime = 0;
+};
+
+static DECODE_RESULT Decode(const BlockArray& blocks, const uint8* intraMatrix, const uint8* nonIntraMatrix, CIpuKernels::KERNEL_SET kernelSet)
+{
+	const auto& kernels = CIpuKernels::GetKernels(kernelSet);
+	uint32 blockCount = MACROBLOCK_COUNT * BLOCKS_PER_MACROBLOCK;
+
+	DECODE_RESULT result;
+	result.samples.resize(blocks.size());
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		result.intraBlocks = blocks;
+		result.nonIntraBlocks = blocks;
+		CBenchmarkTimer timer;
+		for(uint32 block = 0; block < blockCount; block++)
+		{
+			int32 quantScale = 1 + (block % 31);
+			kernels.dequantiseIntraBlock(result.intraBlocks.data() + (block * CIpuKernels::BLOCK_SIZE), intraMatrix, quantScale, 1 << (block % 4));
+			kernels.dequantiseNonIntraBlock(result.nonIntraBlocks.data() + (block * CIpuKernels::BLOCK_SIZE), nonIntraMatrix, quantScale, 0);
+		}
+		result.dequantiseTime += timer.GetElapsedMilliseconds();
+
+		timer.Restart();
+		for(uint32 block = 0; block < blockCount; block++)
+		{
+			uint32 offset = block * CIpuKernels::BLOCK_SIZE;
+			kernels.idct(result.intraBlocks.data() + offset, result.samples.data() + offset);
+		}
+		result.idctTime += timer.GetElapsedMilliseconds();
+	}
+	return result;
+}
+
+struct CONVERT_RESULT
+{
+	WordArray rgb32;
+	HalfArray rgb16;
+	HalfArray rgb16Dithered;
+	double rgb32Time = 0;
+	double rgb16Time = 0;
+};
+
+static CONVERT_RESULT Convert(const ByteArray& macroblocks, CIpuKernels::KERNEL_SET kernelSet)
+{
+	const auto& kernels = CIpuKernels::GetKernels(kernelSet);
+	//Alpha thresholds are chosen to produce every alpha value
+	const uint32 th0 = 0x40;
+	const uint32 th1 = 0xC0;
+
+	CONVERT_RESULT result;
+	result.rgb32.resize(MACROBLOCK_COUNT * CIpuKernels::MACROBLOCK_PIXELS);
+	result.rgb16.resize(MACROBLOCK_COUNT * CIpuKernels::MACROBLOCK_PIXELS);
+	result.rgb16Dithered.resize(MACROBLOCK_COUNT * CIpuKernels::MACROBLOCK_PIXELS);
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		CBenchmarkTimer timer;
+		for(uint32 mb = 0; mb < MACROBLOCK_COUNT; mb++)
+		{
+			kernels.convertRgb32(result.rgb32.data() + (mb * CIpuKernels::MACROBLOCK_PIXELS), macroblocks.data() + (mb * CIpuKernels::MACROBLOCK_SIZE), th0, th1);
+		}
+		result.rgb32Time += timer.GetElapsedMilliseconds();
+
+		timer.Restart();
+		for(uint32 mb = 0; mb < MACROBLOCK_COUNT; mb++)
+		{
+			uint32 pixelOffset = mb * CIpuKernels::MACROBLOCK_PIXELS;
+			const uint8* samples = macroblocks.data() + (mb * CIpuKernels::MACROBLOCK_SIZE);
+			kernels.convertRgb16(result.rgb16.data() + pixelOffset, samples, th0, th1);
+			kernels.convertRgb16Dithered(result.rgb16Dithered.data() + pixelOffset, samples, th0, th1);
+		}
+		result.rgb16Time += timer.GetElapsedMilliseconds();
+	}
+	return result;
+}
+
+void CIpuKernelsTest::Execute()
+{
+	std::mt19937 random(1);
+	auto blocks = MakeBlocks(random);
+	uint8 intraMatrix[CIpuKernels::BLOCK_SIZE];
+	uint8 nonIntraMatrix[CIpuKernels::BLOCK_SIZE];
+	MakeMatrix(random, intraMatrix);
+	MakeMatrix(random, nonIntraMatrix);
+
+	auto scalarDecode = Decode(blocks, intraMatrix, nonIntraMatrix, CIpuKernels::KERNEL_SET_SCALAR);
+	auto simdDecode = Decode(blocks, intraMatrix, nonIntraMatrix, CIpuKernels::KERNEL_SET_SIMD);
+
+	TEST_VERIFY(scalarDecode.intraBlocks == simdDecode.intraBlocks);
+	TEST_VERIFY(scalarDecode.nonIntraBlocks == simdDecode.nonIntraBlocks);
+	TEST_VERIFY(scalarDecode.samples.size() == simdDecode.samples.size());
+	for(uint32 i = 0; i < scalarDecode.samples.size(); i++)
+	{
+		TEST_VERIFY(std::abs(scalarDecode.samples[i] - simdDecode.samples[i]) <= IDCT_TOLERANCE);
+	}
+
+	//Macroblocks are built from the decoded samples, like the IDEC command does
+	ByteArray macroblocks(MACROBLOCK_COUNT * CIpuKernels::MACROBLOCK_SIZE);
+	for(uint32 i = 0; i < macroblocks.size(); i++)
+	{
+		macroblocks[i] = static_cast<uint8>(std::min<int32>(std::max<int32>(scalarDecode.samples[i] + 128, 0), 255));
+	}
+
+	auto scalarConvert = Convert(macroblocks, CIpuKernels::KERNEL_SET_SCALAR);
+	auto simdConvert = Convert(macroblocks, CIpuKernels::KERNEL_SET_SIMD);
+
+	TEST_VERIFY(scalarConvert.rgb32 == simdConvert.rgb32);
+	TEST_VERIFY(scalarConvert.rgb16 == simdConvert.rgb16);
+	TEST_VERIFY(scalarConvert.rgb16Dithered == simdConvert.rgb16Dithered);
+
+	auto printThroughput =
+	    [](const char* title, double scalarTime, double simdTime) {
+		    PrintBenchmarkResults(title, {{"scalar", GetMacroblocksPerSecond(scalarTime)}, {"simd", GetMacroblocksPerSecond(simdTime)}}, " mb/s", 0);
+	    };
+	printThroughput("IPU dequantise", scalarDecode.dequantiseTime, simdDecode.dequantiseTime);
+	printThroughput("IPU IDCT", scalarDecode.idctTime, simdDecode.idctTime);
+	printThroughput("IPU CSC (RGB32)", scalarConvert.rgb32Time, simdConvert.rgb32Time);
+	printThroughput("IPU CSC (RGB16)", scalarConvert.rgb16Time, simdConvert.rgb16Time);
+}
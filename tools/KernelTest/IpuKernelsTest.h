@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../VuTest/Test.h"
+
+//Checks that SIMD IPU kernels produce the same output as the scalar ones and measures their throughput
+class CIpuKernelsTest : public CTestBase<>
+{
+public:
+	void Execute() override;
+};
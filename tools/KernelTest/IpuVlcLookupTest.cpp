@@ -0,0 +1,290 @@
+#include <random>
+#include <vector>
+#include "IpuVlcLookupTest.h"
+#include "Benchmark.h"
+#include "ee/IPU_VLCLookupTable.h"
+#include "ee/IPU_MacroblockAddressIncrementTable.h"
+#include "ee/IPU_MotionCodeTable.h"
+#include "mpeg2/DctCoefficientTable0.h"
+#include "mpeg2/DctCoefficientTable1.h"
+
+#define WINDOW_COUNT (0x40000)
+#define BLOCK_COUNT (0x8000)
+
+using namespace IPU;
+using namespace MPEG2;
+
+typedef std::vector<uint8> ByteArray;
+
+//MSB first bit stream over a buffer, zeroes are read past the end of the buffer
+class CBufferBitStream : public Framework::CBitStream
+{
+public:
+	CBufferBitStream(const ByteArray& buffer)
+	    : m_buffer(buffer)
+	{
+	}
+
+	void Advance(uint8 bits) override
+	{
+		m_position += bits;
+	}
+
+	uint8 GetBitIndex() const override
+	{
+		return static_cast<uint8>(m_position);
+	}
+
+	bool TryPeekBits_LSBF(uint8, uint32&) override
+	{
+		return false;
+	}
+
+	bool TryPeekBits_MSBF(uint8 size, uint32& result) override
+	{
+		result = 0;
+		for(uint32 i = 0; i < size; i++)
+		{
+			uint32 position = m_position + i;
+			uint32 byte = (position / 8) < m_buffer.size() ? m_buffer[position / 8] : 0;
+			result = (result << 1) | ((byte >> (7 - (position % 8))) & 1);
+		}
+		return true;
+	}
+
+	uint32 GetPosition() const
+	{
+		return m_position;
+	}
+
+	bool IsAtEnd() const
+	{
+		return m_position >= (m_buffer.size() * 8);
+	}
+
+private:
+	const ByteArray& m_buffer;
+	uint32 m_position = 0;
+};
+
+class CBitWriter
+{
+public:
+	void Write(uint32 value, uint32 size)
+	{
+		for(uint32 i = 0; i < size; i++)
+		{
+			if((m_position % 8) == 0)
+			{
+				m_buffer.push_back(0);
+			}
+			uint32 bit = (value >> (size - i - 1)) & 1;
+			m_buffer.back() |= static_cast<uint8>(bit << (7 - (m_position % 8)));
+			m_position++;
+		}
+	}
+
+	const ByteArray& GetBuffer() const
+	{
+		return m_buffer;
+	}
+
+private:
+	ByteArray m_buffer;
+	uint32 m_position = 0;
+};
+
+static ByteArray MakeWindow(uint32 window)
+{
+	return {static_cast<uint8>(window >> 24), static_cast<uint8>(window >> 16), static_cast<uint8>(window >> 8), static_cast<uint8>(window)};
+}
+
+static void TestVlcTable(std::mt19937& random, const CVLCLookupTable& lookupTable)
+{
+	for(uint32 i = 0; i < WINDOW_COUNT; i++)
+	{
+		auto window = MakeWindow(static_cast<uint32>(random()));
+		CBufferBitStream lookupStream(window);
+		CBufferBitStream stream(window);
+		uint32 lookupSymbol = 0;
+		uint32 symbol = 0;
+		auto lookupResult = lookupTable.TryGetSymbol(&lookupStream, lookupSymbol);
+		auto result = lookupTable.GetTable()->TryGetSymbol(&stream, symbol);
+		TEST_VERIFY(lookupResult == result);
+		if(result == CVLCTable::DECODE_STATUS_SUCCESS)
+		{
+			TEST_VERIFY(lookupSymbol == symbol);
+			TEST_VERIFY(lookupStream.GetPosition() == stream.GetPosition());
+		}
+	}
+}
+
+static void TestDctEntries(std::mt19937& random, CDctCoefficientTable& table, const CDctCoefficientLookupTable& lookupTable)
+{
+	for(uint32 i = 0; i < WINDOW_COUNT; i++)
+	{
+		uint32 bits = static_cast<uint32>(random());
+		auto window = MakeWindow(bits);
+
+		const auto& entry = lookupTable.GetEntry(bits);
+		if(entry.length != 0)
+		{
+			CBufferBitStream stream(window);
+			bool isEob = false;
+			TEST_VERIFY(table.TryIsEndOfBlock(&stream, isEob) == CVLCTable::DECODE_STATUS_SUCCESS);
+			TEST_VERIFY(isEob == (entry.run == CDctCoefficientLookupTable::RUN_ENDOFBLOCK));
+			if(isEob)
+			{
+				TEST_VERIFY(table.TrySkipEndOfBlock(&stream) == CVLCTable::DECODE_STATUS_SUCCESS);
+			}
+			else
+			{
+				RUNLEVELPAIR runLevelPair;
+				TEST_VERIFY(table.TryGetRunLevelPair(&stream, &runLevelPair, true) == CVLCTable::DECODE_STATUS_SUCCESS);
+				TEST_VERIFY(runLevelPair.run == entry.run);
+				TEST_VERIFY(runLevelPair.level == entry.level);
+			}
+			TEST_VERIFY(stream.GetPosition() == entry.length);
+		}
+
+		const auto& firstEntry = lookupTable.GetFirstEntry(bits);
+		if(firstEntry.length != 0)
+		{
+			CBufferBitStream stream(window);
+			RUNLEVELPAIR runLevelPair;
+			TEST_VERIFY(table.TryGetRunLevelPairDc(&stream, &runLevelPair, true) == CVLCTable::DECODE_STATUS_SUCCESS);
+			TEST_VERIFY(runLevelPair.run == firstEntry.run);
+			TEST_VERIFY(runLevelPair.level == firstEntry.level);
+			TEST_VERIFY(stream.GetPosition() == firstEntry.length);
+		}
+	}
+}
+
+//Builds blocks made of symbols that can be resolved with the lookup table, followed by an end of block
+static ByteArray MakeBlocks(std::mt19937& random, const CDctCoefficientLookupTable& lookupTable, uint32& coefficientCount)
+{
+	static const uint32 indexShift = 32 - CDctCoefficientLookupTable::LOOKUP_BITS;
+	std::vector<uint32> coefficientIndices;
+	uint32 eobIndex = 0;
+	for(uint32 index = 0; index < (1 << CDctCoefficientLookupTable::LOOKUP_BITS); index++)
+	{
+		const auto& entry = lookupTable.GetEntry(index << indexShift);
+		if(entry.length == 0) continue;
+		if(entry.run == CDctCoefficientLookupTable::RUN_ENDOFBLOCK)
+		{
+			eobIndex = index;
+		}
+		else if(entry.run < 4)
+		{
+			coefficientIndices.push_back(index);
+		}
+	}
+
+	CBitWriter writer;
+	coefficientCount = 0;
+	for(uint32 i = 0; i < BLOCK_COUNT; i++)
+	{
+		uint32 blockIndex = 0;
+		uint32 blockCoefficientCount = random() % 16;
+		for(uint32 j = 0; j < blockCoefficientCount; j++)
+		{
+			uint32 index = coefficientIndices[random() % coefficientIndices.size()];
+			const auto& entry = lookupTable.GetEntry(index << indexShift);
+			if((blockIndex + entry.run + 1) >= 0x40) break;
+			blockIndex += entry.run + 1;
+			writer.Write(index >> (CDctCoefficientLookupTable::LOOKUP_BITS - entry.length), entry.length);
+			coefficientCount++;
+		}
+		const auto& eobEntry = lookupTable.GetEntry(eobIndex << indexShift);
+		writer.Write(eobIndex >> (CDctCoefficientLookupTable::LOOKUP_BITS - eobEntry.length), eobEntry.length);
+	}
+	return writer.GetBuffer();
+}
+
+static void TestDctBlocks(std::mt19937& random, CDctCoefficientTable& table, const CDctCoefficientLookupTable& lookupTable, const char* name)
+{
+	uint32 coefficientCount = 0;
+	auto blocks = MakeBlocks(random, lookupTable, coefficientCount);
+
+	int32 levelSum = 0;
+	CBenchmarkTimer timer;
+	{
+		CBufferBitStream stream(blocks);
+		for(uint32 i = 0; i < BLOCK_COUNT; i++)
+		{
+			while(1)
+			{
+				bool isEob = false;
+				table.TryIsEndOfBlock(&stream, isEob);
+				if(isEob)
+				{
+					table.TrySkipEndOfBlock(&stream);
+					break;
+				}
+				RUNLEVELPAIR runLevelPair;
+				table.TryGetRunLevelPair(&stream, &runLevelPair, true);
+				levelSum += runLevelPair.level + runLevelPair.run;
+			}
+		}
+	}
+	double tableTime = timer.GetElapsedMilliseconds();
+
+	int32 lookupLevelSum = 0;
+	timer.Restart();
+	{
+		CBufferBitStream stream(blocks);
+		for(uint32 i = 0; i < BLOCK_COUNT; i++)
+		{
+			bool isEob = false;
+			while(!isEob)
+			{
+				uint32 window = 0;
+				stream.TryPeekBits_MSBF(32, window);
+				uint32 usedBits = 0;
+				while((usedBits + CDctCoefficientLookupTable::LOOKUP_BITS) <= 32)
+				{
+					const auto& entry = lookupTable.GetEntry(window << usedBits);
+					TEST_VERIFY(entry.length != 0);
+					usedBits += entry.length;
+					if(entry.run == CDctCoefficientLookupTable::RUN_ENDOFBLOCK)
+					{
+						isEob = true;
+						break;
+					}
+					lookupLevelSum += entry.level + entry.run;
+				}
+				stream.Advance(static_cast<uint8>(usedBits));
+			}
+		}
+		TEST_VERIFY(stream.GetPosition() <= (blocks.size() * 8));
+	}
+	double lookupTime = timer.GetElapsedMilliseconds();
+
+	TEST_VERIFY(levelSum == lookupLevelSum);
+
+	auto getSymbolsPerSecond =
+	    [&](double timeMs) {
+		    return (timeMs == 0) ? 0 : static_cast<double>(coefficientCount + BLOCK_COUNT) * 1000.0 / timeMs;
+	    };
+
+	PrintBenchmarkResults(std::string("IPU ") + name,
+	                      {{"table", getSymbolsPerSecond(tableTime)}, {"lookup", getSymbolsPerSecond(lookupTime)}}, " symbols/s", 0);
+}
+
+void CIpuVlcLookupTest::Execute()
+{
+	std::mt19937 random(1);
+
+	TestVlcTable(random, CVLCLookupTable::GetInstance<CMacroblockAddressIncrementTable>());
+	TestVlcTable(random, CVLCLookupTable::GetInstance<CMotionCodeTable>());
+
+	auto& table0 = CDctCoefficientTable0::GetInstance();
+	auto& table1 = CDctCoefficientTable1::GetInstance();
+	const auto& lookupTable0 = CDctCoefficientLookupTable::GetTable0Instance();
+	const auto& lookupTable1 = CDctCoefficientLookupTable::GetTable1Instance();
+
+	TestDctEntries(random, table0, lookupTable0);
+	TestDctEntries(random, table1, lookupTable1);
+	TestDctBlocks(random, table0, lookupTable0, "DCT table 0");
+	TestDctBlocks(random, table1, lookupTable1, "DCT table 1");
+}
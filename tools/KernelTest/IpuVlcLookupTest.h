@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../VuTest/Test.h"
+
+//Checks that IPU VLC lookup tables decode the same symbols as the generic tables and measures their throughput
+class CIpuVlcLookupTest : public CTestBase<>
+{
+public:
+	void Execute() override;
+};
@@ -0,0 +1,28 @@
+#include <functional>
+#include "GsCommandRingTest.h"
+#include "GsRasterizerTest.h"
+#include "GsTransferKernelsTest.h"
+#include "IpuKernelsTest.h"
+#include "IpuVlcLookupTest.h"
+
+typedef std::function<CTestBase<>*()> TestFactoryFunction;
+
+static const TestFactoryFunction s_factories[] =
+    {
+        []() { return new CGsCommandRingTest(); },
+        []() { return new CGsTransferKernelsTest(); },
+        []() { return new CGsRasterizerTest(); },
+        []() { return new CIpuKernelsTest(); },
+        []() { return new CIpuVlcLookupTest(); },
+};
+
+int main(int argc, const char** argv)
+{
+	for(const auto& factory : s_factories)
+	{
+		auto test = factory();
+		test->Execute();
+		delete test;
+	}
+	return 0;
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <stdio.h>
+#include "iop/Iop_SpuBase.h"
+#include "iop/Iop_Spu2.h"
+#include "iop/Iop_Spu2_Core.h"
+
+//Checks that the SIMD SPU kernels produce the exact same output as the scalar ones,
+//first on the kernels themselves and then on the output of complete SPU cores.
+
+using namespace Iop;
+using namespace Iop::Spu2;
+
+#define RAM_SIZE (0x200000)
+#define SAMPLE_DATA_ADDRESS (0x80000)
+#define SAMPLE_DATA_SIZE (0x40000)
+#define ADPCM_BLOCK_COUNT (0x10000)
+#define MIX_SAMPLE_COUNT (0x10000)
+#define RENDER_FRAME_COUNT (600)
+#define RENDER_FRAME_SIZE (1470)
+#define SAMPLE_RATE (44100)
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::vector<uint8> ByteArray;
+typedef std::vector<int16> SampleArray;
+
+static double GetElapsedMs(Clock::time_point startTime)
+{
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime);
+	return static_cast<double>(elapsed.count()) / 1000000.0;
+}
+
+static ByteArray MakeAdpcmData(std::mt19937& random, uint32 size)
+{
+	ByteArray data(size);
+	for(uint32 i = 0; i < size; i += CSpuKernels::ADPCM_BLOCK_SIZE)
+	{
+		//Header: predictor and shift factor, then flags (mostly no flags, some loops and ends)
+		data[i + 0] = static_cast<uint8>(((random() % 5) << 4) | (random() % 13));
+		uint32 flags = random() % 16;
+		data[i + 1] = (flags == 0) ? 0x03 : (flags == 1) ? 0x01 : (flags == 2) ? 0x04 : 0x00;
+		for(uint32 j = 2; j < CSpuKernels::ADPCM_BLOCK_SIZE; j++)
+		{
+			data[i + j] = static_cast<uint8>(random());
+		}
+	}
+	return data;
+}
+
+static bool TestDecodeAdpcmBlock()
+{
+	std::mt19937 random(1);
+	auto data = MakeAdpcmData(random, ADPCM_BLOCK_COUNT * CSpuKernels::ADPCM_BLOCK_SIZE);
+
+	auto decodeAll =
+	    [&](SampleArray& samples, CSpuKernels::KERNEL_SET kernelSet) {
+		    auto decodeAdpcmBlock = CSpuKernels::GetKernels(kernelSet).decodeAdpcmBlock;
+		    int32 s1 = 0;
+		    int32 s2 = 0;
+		    auto startTime = Clock::now();
+		    for(uint32 i = 0; i < ADPCM_BLOCK_COUNT; i++)
+		    {
+			    decodeAdpcmBlock(samples.data() + (i * CSpuKernels::ADPCM_BLOCK_SAMPLES), data.data() + (i * CSpuKernels::ADPCM_BLOCK_SIZE), s1, s2);
+		    }
+		    return GetElapsedMs(startTime);
+	    };
+
+	SampleArray scalarSamples(ADPCM_BLOCK_COUNT * CSpuKernels::ADPCM_BLOCK_SAMPLES);
+	SampleArray simdSamples(scalarSamples.size());
+	double scalarTime = decodeAll(scalarSamples, CSpuKernels::KERNEL_SET_SCALAR);
+	double simdTime = decodeAll(simdSamples, CSpuKernels::KERNEL_SET_SIMD);
+
+	bool succeeded = (scalarSamples == simdSamples);
+	printf("ADPCM decode (%d blocks): scalar %0.3fms, simd %0.3fms, %s.\r\n",
+	       ADPCM_BLOCK_COUNT, scalarTime, simdTime, succeeded ? "match" : "MISMATCH");
+	return succeeded;
+}
+
+static bool TestMixSamples()
+{
+	std::mt19937 random(2);
+	SampleArray samples(MIX_SAMPLE_COUNT);
+	SampleArray volumes(MIX_SAMPLE_COUNT * 2);
+	SampleArray output(MIX_SAMPLE_COUNT * 2);
+	for(auto& sample : samples)
+	{
+		sample = static_cast<int16>(random());
+	}
+	for(auto& volume : volumes)
+	{
+		volume = static_cast<int16>(random() & 0x7FFF);
+	}
+	for(auto& sample : output)
+	{
+		sample = static_cast<int16>(random());
+	}
+	//Cover the limits of the products and of the saturation
+	samples[0] = SHRT_MIN;
+	samples[1] = SHRT_MAX;
+	volumes[0] = volumes[1] = volumes[2] = volumes[3] = 0x7FFF;
+	output[0] = SHRT_MIN;
+	output[2] = SHRT_MAX;
+
+	auto mixAll =
+	    [&](SampleArray& result, CSpuKernels::KERNEL_SET kernelSet) {
+		    auto mixSamples = CSpuKernels::GetKernels(kernelSet).mixSamples;
+		    result = output;
+		    auto startTime = Clock::now();
+		    //Uneven sizes make sure partial groups are handled
+		    for(uint32 i = 0; i < MIX_SAMPLE_COUNT;)
+		    {
+			    uint32 count = std::min<uint32>(MIX_SAMPLE_COUNT - i, 1 + (i % 67));
+			    mixSamples(result.data() + (i * 2), samples.data() + i, volumes.data() + (i * 2), count);
+			    i += count;
+		    }
+		    return GetElapsedMs(startTime);
+	    };
+
+	SampleArray scalarOutput;
+	SampleArray simdOutput;
+	double scalarTime = mixAll(scalarOutput, CSpuKernels::KERNEL_SET_SCALAR);
+	double simdTime = mixAll(simdOutput, CSpuKernels::KERNEL_SET_SIMD);
+
+	bool succeeded = (scalarOutput == simdOutput);
+	printf("Mix (%d samples): scalar %0.3fms, simd %0.3fms, %s.\r\n",
+	       MIX_SAMPLE_COUNT, scalarTime, simdTime, succeeded ? "match" : "MISMATCH");
+	return succeeded;
+}
+
+//Renders both SPU2 cores from a random stream of register writes, which is the same for every kernel set
+static double RenderSpu(SampleArray& output, CSpuKernels::KERNEL_SET kernelSet)
+{
+	ByteArray ram(RAM_SIZE);
+	CSpuBase core0(ram.data(), RAM_SIZE, 0);
+	CSpuBase core1(ram.data(), RAM_SIZE, 1);
+	core0.Reset();
+	core1.Reset();
+	core0.SetKernelSet(kernelSet);
+	core1.SetKernelSet(kernelSet);
+	CSpu2 spu(core0, core1);
+
+	std::mt19937 random(3);
+	for(unsigned int coreId = 0; coreId < 2; coreId++)
+	{
+		uint32 coreBase = coreId * 0x400;
+		spu.WriteRegister(CCore::CORE_ATTR + coreBase, 0x80E0);
+		spu.WriteRegister(CCore::A_ESA_HI + coreBase, 0x1);
+		spu.WriteRegister(CCore::A_ESA_LO + coreBase, 0x0000);
+		spu.WriteRegister(CCore::A_EEA_HI + coreBase, 0x1);
+		//Offsets stay small compared to the work area, feedback sources (first 2 registers) are smaller than other offsets
+		for(uint32 reg = CCore::RVB_A_REG_BASE; reg < CCore::RVB_A_REG_END; reg += 4)
+		{
+			bool isFeedbackSource = (reg < (CCore::RVB_A_REG_BASE + 8));
+			spu.WriteRegister(reg + coreBase + 0, 0);
+			spu.WriteRegister(reg + coreBase + 2, isFeedbackSource ? (random() & 0xFF) : (0x100 + (random() & 0xFFF)));
+		}
+		//Small coefficients keep the reverb filter stable
+		for(uint32 reg = CCore::RVB_C_REG_BASE; reg < CCore::RVB_C_REG_END; reg += 2)
+		{
+			spu.WriteRegister(reg + coreBase, random() & 0x0FFF);
+		}
+	}
+
+	//Sample data is kept away from the reverb work area
+	auto sampleData = MakeAdpcmData(random, SAMPLE_DATA_SIZE);
+	spu.WriteRegister(CCore::A_TSA_HI, SAMPLE_DATA_ADDRESS >> 17);
+	spu.WriteRegister(CCore::A_TSA_LO, (SAMPLE_DATA_ADDRESS >> 1) & 0xFFFF);
+	core0.ReceiveDma(sampleData.data(), 0x100, SAMPLE_DATA_SIZE / 0x100);
+
+	output.clear();
+	output.reserve(RENDER_FRAME_COUNT * RENDER_FRAME_SIZE * 2);
+
+	double renderTime = 0;
+	for(unsigned int frame = 0; frame < RENDER_FRAME_COUNT; frame++)
+	{
+		unsigned int writeCount = random() % 6;
+		for(unsigned int i = 0; i < writeCount; i++)
+		{
+			uint32 coreBase = (random() & 1) * 0x400;
+			uint32 channel = random() % 24;
+			uint32 channelBase = coreBase + (channel * 0x10);
+			switch(random() % 6)
+			{
+			case 0:
+				spu.WriteRegister(CCore::VP_PITCH + channelBase, 0x400 + (random() % 0x3000));
+				break;
+			case 1:
+				spu.WriteRegister(CCore::VP_VOLL + channelBase, random() & 0x3FFF);
+				spu.WriteRegister(CCore::VP_VOLR + channelBase, random() & 0x7FFF);
+				break;
+			case 2:
+				spu.WriteRegister(CCore::VP_ADSR1 + channelBase, random() & 0xFFFF);
+				spu.WriteRegister(CCore::VP_ADSR2 + channelBase, random() & 0xFFFF);
+				break;
+			case 3:
+			{
+				uint32 channelAddressBase = coreBase + (channel * 12);
+				uint32 address = SAMPLE_DATA_ADDRESS + ((random() % (SAMPLE_DATA_SIZE / CSpuKernels::ADPCM_BLOCK_SIZE)) * CSpuKernels::ADPCM_BLOCK_SIZE);
+				spu.WriteRegister(CCore::VA_SSA_HI + channelAddressBase, address >> 17);
+				spu.WriteRegister(CCore::VA_SSA_LO + channelAddressBase, (address >> 1) & 0xFFFF);
+			}
+			break;
+			case 4:
+				spu.WriteRegister(CCore::A_KON_HI + coreBase, random() & 0xFFFF);
+				spu.WriteRegister(CCore::A_KON_LO + coreBase, random() & 0xFF);
+				break;
+			case 5:
+				spu.WriteRegister(CCore::S_VMIXER_HI + coreBase, random() & 0xFFFF);
+				spu.WriteRegister(CCore::S_VMIXEL_HI + coreBase, random() & 0xFFFF);
+				break;
+			}
+		}
+
+		int16 samples0[RENDER_FRAME_SIZE];
+		int16 samples1[RENDER_FRAME_SIZE];
+		auto startTime = Clock::now();
+		core0.Render(samples0, RENDER_FRAME_SIZE, SAMPLE_RATE);
+		core1.Render(samples1, RENDER_FRAME_SIZE, SAMPLE_RATE);
+		renderTime += GetElapsedMs(startTime);
+		output.insert(output.end(), std::begin(samples0), std::end(samples0));
+		output.insert(output.end(), std::begin(samples1), std::end(samples1));
+	}
+	return renderTime;
+}
+
+static bool TestRender()
+{
+	SampleArray scalarOutput;
+	SampleArray simdOutput;
+	double scalarTime = RenderSpu(scalarOutput, CSpuKernels::KERNEL_SET_SCALAR);
+	double simdTime = RenderSpu(simdOutput, CSpuKernels::KERNEL_SET_SIMD);
+
+	bool succeeded = (scalarOutput == simdOutput);
+	printf("Render (%d frames): scalar %0.3fms, simd %0.3fms, %s.\r\n",
+	       RENDER_FRAME_COUNT, scalarTime, simdTime, succeeded ? "match" : "MISMATCH");
+	return succeeded;
+}
+
+int main(int, const char**)
+{
+	if(!CSpuKernels::IsSimdSupported())
+	{
+		printf("SIMD kernels not supported on this host, comparing scalar kernels against themselves.\r\n");
+	}
+
+	bool succeeded = true;
+	succeeded &= TestDecodeAdpcmBlock();
+	succeeded &= TestMixSamples();
+	succeeded &= TestRender();
+	return succeeded ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "AddTest.h"
+#include "TestVm.h"
 #include "VuAssembler.h"
 
 static uint32 FloatToInt(float value)
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+#include "BlockInvalidationTest.h"
+#include "TestVm.h"
+#include "GenericMipsExecutor.h"
+#include "MA_MIPSIV.h"
+#include "MIPSAssembler.h"
+
+#define BLOCK_COUNT (10000)
+#define RAM_SIZE (0x20000)
+#define ITERATION_COUNT (8)
+
+//Each block is a branch to the next one with a counter increment in its delay slot.
+//The last block branches back to the first one.
+static void AssembleBlocks(uint32* ram)
+{
+	CMIPSAssembler assembler(ram);
+	for(uint32 i = 0; i < BLOCK_COUNT; i++)
+	{
+		uint32 blockAddress = i * 8;
+		uint32 targetAddress = ((i + 1) == BLOCK_COUNT) ? 0 : blockAddress + 8;
+		int32 offset = static_cast<int32>(targetAddress - (blockAddress + 4)) / 4;
+		assembler.BEQ(CMIPS::R0, CMIPS::R0, static_cast<uint16>(offset));
+		assembler.ADDIU(CMIPS::T0, CMIPS::T0, 1);
+	}
+}
+
+void CBlockInvalidationTest::Execute(CTestVm&)
+{
+	static_assert((BLOCK_COUNT * 8) <= RAM_SIZE, "Not enough RAM for blocks.");
+
+	std::vector<uint32> ram(RAM_SIZE / 4, 0);
+	AssembleBlocks(ram.data());
+
+	CMIPS context(MEMORYMAP_ENDIAN_LSBF);
+	CMA_MIPSIV arch(MIPS_REGSIZE_32);
+	context.m_pMemoryMap->InsertReadMap(0, RAM_SIZE - 1, ram.data(), 0x01);
+	context.m_pMemoryMap->InsertInstructionMap(0, RAM_SIZE - 1, ram.data(), 0x01);
+	context.m_pArch = &arch;
+	context.m_pAddrTranslator = &CMIPS::TranslateAddress64;
+
+	auto executor = new CGenericMipsExecutor<BlockLookupOneWay>(context, RAM_SIZE);
+	context.m_executor.reset(executor);
+
+	uint32 lastBlockAddress = (BLOCK_COUNT - 1) * 8;
+	std::chrono::nanoseconds totalTime(0);
+	std::chrono::nanoseconds maxTime(0);
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		//Run through all blocks to create and link them
+		context.m_State.nPC = 0;
+		context.m_State.nGPR[CMIPS::T0].nV0 = 0;
+		executor->Execute(BLOCK_COUNT * 4);
+		TEST_VERIFY(context.m_State.nGPR[CMIPS::T0].nV0 >= BLOCK_COUNT);
+		TEST_VERIFY(!executor->FindBlockStartingAt(0)->IsEmpty());
+		TEST_VERIFY(!executor->FindBlockStartingAt(lastBlockAddress)->IsEmpty());
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		executor->ClearActiveBlocksInRange(0, BLOCK_COUNT * 8, false);
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime);
+		totalTime += elapsed;
+		maxTime = std::max(maxTime, elapsed);
+
+		TEST_VERIFY(executor->FindBlockStartingAt(0)->IsEmpty());
+		TEST_VERIFY(executor->FindBlockStartingAt(lastBlockAddress)->IsEmpty());
+	}
+
+	printf("Invalidation of %d blocks: average %0.3fms, max %0.3fms.\r\n",
+	       BLOCK_COUNT,
+	       static_cast<double>(totalTime.count()) / static_cast<double>(ITERATION_COUNT * 1000000),
+	       static_cast<double>(maxTime.count()) / 1000000.0);
+}
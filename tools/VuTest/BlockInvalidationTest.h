@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Test.h"
+
+//Measures the time needed to invalidate a large range of linked blocks
+class CBlockInvalidationTest : public CTest
+{
+public:
+	void Execute(CTestVm&) override;
+};
@@ -1,4 +1,5 @@
 #include "FlagsTest.h"
+#include "TestVm.h"
 #include "VuAssembler.h"
 
 void CFlagsTest::Execute(CTestVm& virtualMachine)
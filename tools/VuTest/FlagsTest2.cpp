@@ -1,4 +1,5 @@
 #include "FlagsTest2.h"
+#include "TestVm.h"
 #include "VuAssembler.h"
 
 void CFlagsTest2::Execute(CTestVm& virtualMachine)
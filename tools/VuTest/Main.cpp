@@ -2,9 +2,12 @@
 #include <assert.h>
 #include <fenv.h>
 #include "AddTest.h"
+#include "BlockInvalidationTest.h"
 #include "FlagsTest.h"
 #include "FlagsTest2.h"
+#include "TestVm.h"
 #include "TriAceTest.h"
+#include "VifUnpackTest.h"
 
 typedef std::function<CTest*()> TestFactoryFunction;
 
@@ -14,6 +17,8 @@ static const TestFactoryFunction s_factories[] =
         []() { return new CFlagsTest(); },
         []() { return new CFlagsTest2(); },
         []() { return new CTriAceTest(); },
+        []() { return new CBlockInvalidationTest(); },
+        []() { return new CVifUnpackTest(); },
 };
 
 int main(int argc, const char** argv)
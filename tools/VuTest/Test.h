@@ -1,7 +1,5 @@
 #pragma once
 
-#include "TestVm.h"
-
 #define TEST_VERIFY(a) \
 	if(!(a))           \
 	{                  \
@@ -9,11 +7,16 @@
 		(*p) = 0;      \
 	}
 
-class CTest
+//Also used by KernelTest, whose tests don't need a VM and derive from CTestBase<>
+template <typename... Args>
+class CTestBase
 {
 public:
-	virtual ~CTest()
+	virtual ~CTestBase()
 	{
 	}
-	virtual void Execute(CTestVm&) = 0;
+	virtual void Execute(Args...) = 0;
 };
+
+class CTestVm;
+typedef CTestBase<CTestVm&> CTest;
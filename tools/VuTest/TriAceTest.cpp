@@ -1,4 +1,5 @@
 #include "TriAceTest.h"
+#include "TestVm.h"
 #include "VuAssembler.h"
 
 void CTriAceTest::Execute(CTestVm& virtualMachine)
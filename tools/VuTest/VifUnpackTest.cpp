@@ -0,0 +1,199 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include "VifUnpackTest.h"
+#include "TestVm.h"
+#include "Ps2Const.h"
+#include "ee/DMAC.h"
+#include "ee/Dmac_Channel.h"
+#include "ee/GIF.h"
+#include "ee/INTC.h"
+#include "ee/Vpu.h"
+#include "ee/Vif.h"
+
+#define COMMAND_COUNT (2000)
+#define ITERATION_COUNT (16)
+#define VU_MEMORY_QWC (PS2::VUMEM1SIZE / 0x10)
+
+typedef std::vector<uint8> ByteArray;
+typedef std::vector<uint32> WordArray;
+typedef std::vector<uint64> HashArray;
+
+static uint32 MakeCode(uint32 cmd, uint32 num, uint32 imm)
+{
+	return (cmd << 24) | (num << 16) | imm;
+}
+
+//Builds a stream of VIF commands covering every unpack format with various cycle, mode and mask settings
+static WordArray MakePacket()
+{
+	static const uint32 cycles[][2] =
+	    {
+	        {1, 1},
+	        {4, 4},
+	        {4, 2},
+	        {2, 1},
+	        {7, 3},
+	        {1, 4},
+	        {2, 3},
+	    };
+
+	std::mt19937 random(1);
+	WordArray packet;
+	uint32 cl = 1;
+	uint32 wl = 1;
+	for(uint32 i = 0; i < COMMAND_COUNT; i++)
+	{
+		switch(random() % 8)
+		{
+		case 0:
+		{
+			//STCYCL
+			const auto& cycle = cycles[random() % (sizeof(cycles) / sizeof(cycles[0]))];
+			cl = cycle[0];
+			wl = cycle[1];
+			packet.push_back(MakeCode(0x01, 0, cl | (wl << 8)));
+		}
+		break;
+		case 1:
+			//STMOD
+			packet.push_back(MakeCode(0x05, 0, random() % 3));
+			break;
+		case 2:
+			//STROW
+			packet.push_back(MakeCode(0x30, 0, 0));
+			for(uint32 j = 0; j < 4; j++)
+			{
+				packet.push_back(random());
+			}
+			break;
+		case 3:
+			//STMASK, mostly cleared to allow masked commands on the fast path
+			packet.push_back(MakeCode(0x20, 0, 0));
+			packet.push_back(((random() % 4) == 0) ? random() : 0);
+			break;
+		default:
+		{
+			//UNPACK
+			uint32 format = random() % 0x10;
+			if((format & 0x03) == 0x03 && (format != 0x0F))
+			{
+				format &= ~0x03;
+			}
+			uint32 num = random() % 0x100;
+			uint32 writeCount = (num == 0) ? 0x100 : num;
+			uint32 readCount = writeCount;
+			//Commands must fit in VU memory, skipped qwords included
+			uint32 span = writeCount;
+			if(cl > wl)
+			{
+				span = cl * ((writeCount + wl - 1) / wl);
+			}
+			else if(cl < wl)
+			{
+				readCount = ((writeCount / wl) * cl) + std::min(writeCount % wl, cl);
+			}
+			uint32 elementSize = CVifUnpackKernels::GetElementSize(format);
+			uint32 cmd = 0x60 | ((random() & 1) ? 0x10 : 0) | format;
+			uint32 imm = (random() % (VU_MEMORY_QWC - span + 1)) | ((random() & 1) ? 0x4000 : 0);
+			packet.push_back(MakeCode(cmd, num, imm));
+			uint32 dataSize = ((readCount * elementSize) + 3) & ~3;
+			for(uint32 j = 0; j < dataSize; j += 4)
+			{
+				packet.push_back(random());
+			}
+		}
+		break;
+		}
+	}
+
+	//Pad to a qword boundary with NOPs
+	while(packet.size() & 3)
+	{
+		packet.push_back(0);
+	}
+	return packet;
+}
+
+static uint64 HashMemory(const uint8* memory, uint32 size)
+{
+	uint64 hash = 0xCBF29CE484222325ULL;
+	for(uint32 i = 0; i < size; i++)
+	{
+		hash = (hash ^ memory[i]) * 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+//Sends the packet to the VIF in transfers of various sizes to make sure commands can be resumed in the
+//middle of their data. When hashes are requested, VU memory is hashed after every transfer.
+static void SendPacket(CVif& vif, CTestVm& virtualMachine, uint32 packetSize, HashArray* hashes)
+{
+	vif.Reset();
+	memset(virtualMachine.m_vuMem, 0, PS2::VUMEM1SIZE);
+	std::mt19937 random(2);
+	uint32 address = 0;
+	uint32 qwc = packetSize / 0x10;
+	while(qwc != 0)
+	{
+		uint32 transferQwc = std::min<uint32>(qwc, 1 + (random() % 0x80));
+		uint32 processedQwc = vif.ReceiveDMA(address, transferQwc, Dmac::CChannel::CHCR_DIR_FROM, false);
+		TEST_VERIFY(processedQwc != 0);
+		address += processedQwc * 0x10;
+		qwc -= processedQwc;
+		if(hashes)
+		{
+			hashes->push_back(HashMemory(virtualMachine.m_vuMem, PS2::VUMEM1SIZE));
+		}
+	}
+}
+
+//Processes the packet through a VIF1 using the specified kernels and returns the average time per iteration
+static double UnpackAll(CTestVm& virtualMachine, ByteArray& ram, uint32 packetSize, const CVifUnpackKernels::KERNELS* kernels, HashArray& hashes)
+{
+	ByteArray spr(PS2::EE_SPR_SIZE);
+	ByteArray vuMem0(PS2::VUMEM0SIZE);
+	CGSHandler* gs = nullptr;
+	CDMAC dmac(ram.data(), spr.data(), vuMem0.data(), virtualMachine.m_cpu);
+	CINTC intc(dmac);
+	CGIF gif(gs, ram.data(), spr.data());
+	CVpu vpu(1, CVpu::VPUINIT(virtualMachine.m_microMem, virtualMachine.m_vuMem, &virtualMachine.m_cpu), gif, intc, ram.data(), spr.data());
+
+	auto& vif = vpu.GetVif();
+	vif.SetUnpackKernels(kernels);
+
+	hashes.clear();
+	SendPacket(vif, virtualMachine, packetSize, &hashes);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for(uint32 i = 0; i < ITERATION_COUNT; i++)
+	{
+		SendPacket(vif, virtualMachine, packetSize, nullptr);
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - startTime);
+	return static_cast<double>(elapsed.count()) / static_cast<double>(ITERATION_COUNT * 1000000);
+}
+
+void CVifUnpackTest::Execute(CTestVm& virtualMachine)
+{
+	auto packet = MakePacket();
+	uint32 packetSize = static_cast<uint32>(packet.size() * sizeof(uint32));
+
+	ByteArray ram(PS2::EE_RAM_SIZE);
+	memcpy(ram.data(), packet.data(), packetSize);
+
+	HashArray referenceVuMem;
+	HashArray scalarVuMem;
+	HashArray simdVuMem;
+	double referenceTime = UnpackAll(virtualMachine, ram, packetSize, nullptr, referenceVuMem);
+	double scalarTime = UnpackAll(virtualMachine, ram, packetSize, &CVifUnpackKernels::GetKernels(CVifUnpackKernels::KERNEL_SET_SCALAR), scalarVuMem);
+	double simdTime = UnpackAll(virtualMachine, ram, packetSize, &CVifUnpackKernels::GetKernels(CVifUnpackKernels::KERNEL_SET_SIMD), simdVuMem);
+
+	TEST_VERIFY(scalarVuMem == referenceVuMem);
+	TEST_VERIFY(simdVuMem == referenceVuMem);
+
+	printf("VIF unpack (%d bytes): element %0.3fms, scalar %0.3fms, simd %0.3fms.\r\n",
+	       packetSize, referenceTime, scalarTime, simdTime);
+}
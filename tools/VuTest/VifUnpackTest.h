@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Test.h"
+
+//Checks that VIF unpack kernels produce the same VU memory as the element by element path and measures their throughput
+class CVifUnpackTest : public CTest
+{
+public:
+	void Execute(CTestVm&) override;
+};